@@ -33,6 +33,7 @@ xf_decode_init(xfInfo * xfi)
 	{
 		case XF_CODEC_REMOTEFX:
 			xfi->rfx_context = rfx_context_new();
+			rfx_context_set_num_threads((RFX_CONTEXT *) xfi->rfx_context, 0);
 			break;
 
 		default:
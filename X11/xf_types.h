@@ -31,6 +31,10 @@
 #include "config.h"
 #endif
 
+#ifdef HAVE_XSHM
+#include <X11/extensions/XShm.h>
+#endif
+
 #define SET_XFI(_inst, _xfi) (_inst)->param1 = _xfi
 #define GET_XFI(_inst) ((xfInfo *) ((_inst)->param1))
 
@@ -92,6 +96,17 @@ struct xf_info
 	RD_BOOL focused;
 	RD_BOOL mouse_into;
 
+	/* software GDI frame buffer, in shared memory when gdi_shm is set */
+	XImage * gdi_image;
+	int gdi_shm;
+#ifdef HAVE_XSHM
+	XShmSegmentInfo gdi_shminfo;
+	/* the server may still be reading the last upload out of the segment,
+	   until an event of type gdi_shm_completion says otherwise */
+	int gdi_shm_busy;
+	int gdi_shm_completion;
+#endif
+
 	/* XVideo stuff */
 	long xv_port;
 	Atom xv_colorkey_atom;
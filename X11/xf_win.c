@@ -44,6 +44,11 @@
 #include <X11/extensions/Xinerama.h>
 #endif
 
+#ifdef HAVE_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
 #define MWM_HINTS_DECORATIONS   (1L << 1)
 #define PROP_MOTIF_WM_HINTS_ELEMENTS    5
 
@@ -224,39 +229,204 @@ l_ui_end_update(struct rdp_inst * inst)
 	XFlush(xfi->display);
 }
 
+#ifdef HAVE_XSHM
+static int xf_shm_error;
+
+static int
+xf_shm_error_handler(Display * display, XErrorEvent * event)
+{
+	xf_shm_error = 1;
+	return 0;
+}
+
+static Bool
+xf_shm_completion_predicate(Display * display, XEvent * event, XPointer arg)
+{
+	xfInfo * xfi = (xfInfo *) arg;
+	return event->type == xfi->gdi_shm_completion;
+}
+#endif
+
+/* waits until the server is done with the last upload, before gdi paints
+   into the shared segment again */
+static void
+xf_gdi_shm_wait(xfInfo * xfi)
+{
+#ifdef HAVE_XSHM
+	XEvent xevent;
+
+	if (xfi->gdi_shm_busy)
+	{
+		XIfEvent(xfi->display, &xevent, xf_shm_completion_predicate, (XPointer) xfi);
+		xfi->gdi_shm_busy = 0;
+	}
+#endif
+}
+
+/* Creates the software GDI image in a MIT-SHM segment and returns its
+   pixels for gdi_init, or NULL when the X server cannot share memory
+   with us, for instance because it is remote */
+static uint8 *
+xf_gdi_shm_new(xfInfo * xfi, int width, int height)
+{
+#ifdef HAVE_XSHM
+	XErrorHandler handler;
+	XShmSegmentInfo * shminfo = &xfi->gdi_shminfo;
+
+	if (!XShmQueryExtension(xfi->display))
+		return NULL;
+
+	xfi->gdi_image = XShmCreateImage(xfi->display, xfi->visual, xfi->depth,
+			ZPixmap, NULL, shminfo, width, height);
+
+	if (xfi->gdi_image == NULL)
+		return NULL;
+
+	/* gdi rows are 32 bpp and not padded */
+	if (xfi->gdi_image->bits_per_pixel != 32 || xfi->gdi_image->bytes_per_line != width * 4)
+	{
+		XFree(xfi->gdi_image);
+		xfi->gdi_image = NULL;
+		return NULL;
+	}
+
+	shminfo->shmid = shmget(IPC_PRIVATE, xfi->gdi_image->bytes_per_line * height, IPC_CREAT | 0600);
+	shminfo->shmaddr = (shminfo->shmid == -1) ? (char *) -1 : shmat(shminfo->shmid, 0, 0);
+	shminfo->readOnly = False;
+
+	if (shminfo->shmaddr == (char *) -1)
+	{
+		printf("xf_gdi_shm_new: no shared memory segment.\n");
+		if (shminfo->shmid != -1)
+			shmctl(shminfo->shmid, IPC_RMID, NULL);
+		XFree(xfi->gdi_image);
+		xfi->gdi_image = NULL;
+		return NULL;
+	}
+
+	xfi->gdi_image->data = shminfo->shmaddr;
+
+	/* a server that cannot attach only tells us through an X error */
+	xf_shm_error = 0;
+	XSync(xfi->display, False);
+	handler = XSetErrorHandler(xf_shm_error_handler);
+	if (!XShmAttach(xfi->display, shminfo))
+		xf_shm_error = 1;
+	XSync(xfi->display, False);
+	XSetErrorHandler(handler);
+
+	/* the segment goes away with the last detach */
+	shmctl(shminfo->shmid, IPC_RMID, NULL);
+
+	if (xf_shm_error)
+	{
+		printf("xf_gdi_shm_new: XShmAttach failed.\n");
+		shmdt(shminfo->shmaddr);
+		xfi->gdi_image->data = NULL;
+		XFree(xfi->gdi_image);
+		xfi->gdi_image = NULL;
+		return NULL;
+	}
+
+	xfi->gdi_shm = 1;
+	xfi->gdi_shm_busy = 0;
+	xfi->gdi_shm_completion = XShmGetEventBase(xfi->display) + ShmCompletion;
+	return (uint8 *) shminfo->shmaddr;
+#else
+	return NULL;
+#endif
+}
+
+static void
+xf_gdi_init(xfInfo * xfi)
+{
+	GDI *gdi;
+	uint8 * buffer;
+
+	buffer = xf_gdi_shm_new(xfi, xfi->settings->width, xfi->settings->height);
+	gdi_init(xfi->inst, CLRCONV_ALPHA | CLRBUF_32BPP, buffer);
+	gdi = GET_GDI(xfi->inst);
+
+	if (!xfi->gdi_shm)
+	{
+		xfi->gdi_image = XCreateImage(xfi->display, xfi->visual, xfi->depth, ZPixmap, 0,
+				(char *) gdi->primary_buffer, gdi->width, gdi->height, xfi->bitmap_pad, 0);
+	}
+}
+
+/* the pixels stay with gdi, unless they are in the shared segment */
+static void
+xf_gdi_image_free(xfInfo * xfi)
+{
+	if (xfi->gdi_image == NULL)
+		return;
+
+#ifdef HAVE_XSHM
+	if (xfi->gdi_shm)
+	{
+		/* its completion must not be taken for one of the next segment */
+		xf_gdi_shm_wait(xfi);
+		XShmDetach(xfi->display, &xfi->gdi_shminfo);
+		XSync(xfi->display, False);
+		shmdt(xfi->gdi_shminfo.shmaddr);
+		xfi->gdi_shm = 0;
+	}
+#endif
+
+	xfi->gdi_image->data = NULL;
+	XFree(xfi->gdi_image);
+	xfi->gdi_image = NULL;
+}
+
 static void
 l_ui_gdi_begin_update(struct rdp_inst * inst)
 {
 	GDI *gdi = GET_GDI(inst);
+	xf_gdi_shm_wait(GET_XFI(inst));
 	gdi->primary->hdc->hwnd->invalid->null = 1;
+	gdi->primary->hdc->hwnd->ninvalid = 0;
 }
 
 static void
 l_ui_gdi_end_update(struct rdp_inst * inst)
 {
-	XImage * image;
+	int i;
+	HGDI_RGN cinvalid;
 	GDI *gdi = GET_GDI(inst);
 	xfInfo * xfi = GET_XFI(inst);
 
 	if (gdi->primary->hdc->hwnd->invalid->null)
 		return;
 
-	image = XCreateImage(xfi->display, xfi->visual, xfi->depth, ZPixmap, 0,
-			(char *) gdi->primary_buffer, gdi->width, gdi->height, xfi->bitmap_pad, 0);
-
-	XPutImage(xfi->display, xfi->backstore, xfi->gc_default, image, 0, 0, 0, 0, gdi->width, gdi->height);
+	/* upload only what was painted, not the whole frame */
+	cinvalid = gdi->primary->hdc->hwnd->cinvalid;
+	for (i = 0; i < gdi->primary->hdc->hwnd->ninvalid; i++)
+	{
+#ifdef HAVE_XSHM
+		if (xfi->gdi_shm)
+		{
+			/* the requests run in order, one completion covers the update */
+			XShmPutImage(xfi->display, xfi->backstore, xfi->gc_default, xfi->gdi_image,
+					cinvalid[i].x, cinvalid[i].y, cinvalid[i].x, cinvalid[i].y,
+					cinvalid[i].w, cinvalid[i].h, i == gdi->primary->hdc->hwnd->ninvalid - 1);
+			xfi->gdi_shm_busy = 1;
+		}
+		else
+#endif
+		{
+			XPutImage(xfi->display, xfi->backstore, xfi->gc_default, xfi->gdi_image,
+					cinvalid[i].x, cinvalid[i].y, cinvalid[i].x, cinvalid[i].y,
+					cinvalid[i].w, cinvalid[i].h);
+		}
 
-	XCopyArea(xfi->display, xfi->backstore, xfi->wnd, xfi->gc_default,
-			gdi->primary->hdc->hwnd->invalid->x,
-			gdi->primary->hdc->hwnd->invalid->y,
-			gdi->primary->hdc->hwnd->invalid->w,
-			gdi->primary->hdc->hwnd->invalid->h,
-			gdi->primary->hdc->hwnd->invalid->x,
-			gdi->primary->hdc->hwnd->invalid->y);
+		XCopyArea(xfi->display, xfi->backstore, xfi->wnd, xfi->gc_default,
+				cinvalid[i].x, cinvalid[i].y, cinvalid[i].w, cinvalid[i].h,
+				cinvalid[i].x, cinvalid[i].y);
+	}
 
+	/* the server reads the shared segment when it runs the requests,
+	   the next begin update waits for that */
 	XFlush(xfi->display);
-
-	XFree(image);
 }
 
 
@@ -791,8 +961,9 @@ l_ui_resize_window(struct rdp_inst * inst)
 
 	if (xfi->settings->software_gdi == 1)
 	{
+		xf_gdi_image_free(xfi);
 		gdi_free(inst);
-		gdi_init(inst, CLRCONV_ALPHA | CLRBUF_32BPP);		
+		xf_gdi_init(xfi);
 	}
 	
 	printf("ui_resize_window:\n");
@@ -1428,9 +1599,7 @@ xf_post_connect(xfInfo * xfi)
 
 	if (xfi->settings->software_gdi == 1)
 	{
-		GDI *gdi;
-		gdi_init(xfi->inst, CLRCONV_ALPHA | CLRBUF_32BPP);
-		gdi = GET_GDI(xfi->inst);
+		xf_gdi_init(xfi);
 
 		xfi->inst->ui_begin_update = l_ui_gdi_begin_update;
 		xfi->inst->ui_end_update = l_ui_gdi_end_update;
@@ -1455,6 +1624,7 @@ xf_destroy_window(xfInfo * xfi)
 	xfi->gc = 0;
 	XDestroyWindow(xfi->display, xfi->wnd);
 	xfi->wnd = 0;
+	xf_gdi_image_free(xfi);
 
 	if (xfi->backstore)
 	{
@@ -1489,6 +1659,13 @@ xf_check_fds(xfInfo * xfi)
 		memset(&xevent, 0, sizeof(xevent));
 		XNextEvent(xfi->display, &xevent);
 
+#ifdef HAVE_XSHM
+		if (xfi->gdi_shm && (xevent.type == xfi->gdi_shm_completion))
+		{
+			xfi->gdi_shm_busy = 0;
+			continue;
+		}
+#endif
 		if (xf_handle_event(xfi, &xevent) != 0)
 		{
 			return 1;
@@ -35,6 +35,7 @@
 #include <freerdp/kbd.h>
 #include <freerdp/errinfo.h>
 #include <freerdp/utils/semaphore.h>
+#include <freerdp/utils/event_loop.h>
 #include "xf_types.h"
 #include "xf_win.h"
 #include "xf_keyboard.h"
@@ -131,6 +132,7 @@ out_args(void)
 		"\t--no-nla: disable network level authentication\n"
 		"\t--sec: force protocol security (rdp, tls or nla)\n"
 #endif
+		"\t--connect-timeout: give up connecting after this many milliseconds\n"
 		"\t--plugin: load a virtual channel plugin\n"
 		"\t--no-osb: disable off screen bitmaps, default on\n"
 		"\t--rfx: ask for RemoteFX session\n"
@@ -515,6 +517,16 @@ process_params(xfInfo * xfi, int argc, char ** argv, int * pindex)
 			}
 		}
 #endif
+		else if (strcmp("--connect-timeout", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			if (*pindex == argc)
+			{
+				printf("missing timeout\n");
+				exit(XF_EXIT_WRONG_PARAM);
+			}
+			settings->tcp_connect_timeout = atoi(argv[*pindex]);
+		}
 		else if (strcmp("--plugin", argv[*pindex]) == 0)
 		{
 			*pindex = *pindex + 1;
@@ -633,6 +645,67 @@ process_params(xfInfo * xfi, int argc, char ** argv, int * pindex)
 	exit(XF_EXIT_WRONG_PARAM);
 }
 
+/* the rdp socket is readable */
+static int
+xf_rdp_ready(int fd, int events, void * arg)
+{
+	xfInfo * xfi = (xfInfo *) arg;
+
+	if (xfi->inst->rdp_check_fds(xfi->inst) != 0)
+	{
+		printf("run_xfreerdp: inst->rdp_check_fds failed\n");
+		return 1;
+	}
+	return 0;
+}
+
+/* the X connection is readable */
+static int
+xf_x_ready(int fd, int events, void * arg)
+{
+	xfInfo * xfi = (xfInfo *) arg;
+
+	if (xf_check_fds(xfi) != 0)
+	{
+		/* xfreerdp is usually terminated by this failing because the X windows has been closed */
+		DEBUG_X11("xf_check_fds failed");
+		return 1;
+	}
+	return 0;
+}
+
+/* a channel has signalled data or an event for the main thread */
+static int
+xf_chan_ready(int fd, int events, void * arg)
+{
+	xfInfo * xfi = (xfInfo *) arg;
+	RD_EVENT * event;
+
+	if (freerdp_chanman_check_fds(xfi->chan_man, xfi->inst) != 0)
+	{
+		printf("run_xfreerdp: freerdp_chanman_check_fds failed\n");
+		return 1;
+	}
+	event = freerdp_chanman_pop_event(xfi->chan_man);
+	if (event)
+	{
+		switch (event->event_type)
+		{
+			case RD_EVENT_TYPE_VIDEO_FRAME:
+				xf_video_process_frame(xfi, (RD_VIDEO_FRAME_EVENT *) event);
+				break;
+			case RD_EVENT_TYPE_REDRAW:
+				xf_handle_redraw_event(xfi, (RD_REDRAW_EVENT *) event);
+				break;
+			default:
+				printf("run_xfreerdp: unknown event type %d\n", event->event_type);
+				break;
+		}
+		freerdp_chanman_free_event(xfi->chan_man, event);
+	}
+	return 0;
+}
+
 static int
 run_xfreerdp(xfInfo * xfi)
 {
@@ -641,12 +714,9 @@ run_xfreerdp(xfInfo * xfi)
 	void * write_fds[32];
 	int read_count;
 	int write_count;
-	int index;
-	int sck;
-	int max_sck;
-	fd_set rfds;
-	fd_set wfds;
-	RD_EVENT * event;
+	int rdp_sck;
+	uint32 rdp_generation;
+	EVENT_LOOP * loop;
 
 	/* create an instance of the library */
 	inst = freerdp_new(xfi->settings);
@@ -700,106 +770,63 @@ run_xfreerdp(xfInfo * xfi)
 	xf_video_init(xfi);
 	xf_decode_init(xfi);
 
+	loop = event_loop_new();
+	if (loop == NULL)
+	{
+		return XF_EXIT_MEMORY;
+	}
+
+	/* the x and channel fds stay the same for the whole session */
+	read_count = 0;
+	write_count = 0;
+	xf_get_fds(xfi, read_fds, &read_count, write_fds, &write_count);
+	event_loop_add(loop, (int)(long) (read_fds[0]), EVENT_LOOP_READ, xf_x_ready, xfi);
+	read_count = 0;
+	freerdp_chanman_get_fds(xfi->chan_man, inst, read_fds, &read_count, write_fds, &write_count);
+	if (read_count > 0)
+		event_loop_add(loop, (int)(long) (read_fds[0]), EVENT_LOOP_READ, xf_chan_ready, xfi);
+	rdp_sck = -1;
+	rdp_generation = 0;
+
 	/* program main loop */
 	while (1)
 	{
 		read_count = 0;
 		write_count = 0;
-		/* get libfreerdp fds */
+		/* get libfreerdp fds, this also sends the input queued since the last round */
 		if (inst->rdp_get_fds(inst, read_fds, &read_count, write_fds, &write_count) != 0)
 		{
 			printf("run_xfreerdp: inst->rdp_get_fds failed\n");
 			break;
 		}
-		/* get x fds */
-		if (xf_get_fds(xfi, read_fds, &read_count, write_fds, &write_count) != 0)
-		{
-			printf("run_xfreerdp: xf_get_fds failed\n");
-			break;
-		}
-		/* get channel fds */
-		if (freerdp_chanman_get_fds(xfi->chan_man, inst, read_fds, &read_count, write_fds, &write_count) != 0)
+		/* after a redirect the socket is a new one, possibly with the old
+		   number, which the generation tells apart */
+		if ((rdp_sck != (int)(long) (read_fds[0])) || (rdp_generation != inst->sock_generation))
 		{
-			printf("run_xfreerdp: freerdp_chanman_get_fds failed\n");
-			break;
-		}
-		max_sck = 0;
-		/* setup read fds */
-		FD_ZERO(&rfds);
-		for (index = 0; index < read_count; index++)
-		{
-			sck = (int)(long) (read_fds[index]);
-			if (sck > max_sck)
-				max_sck = sck;
-			FD_SET(sck, &rfds);
-		}
-		/* setup write fds */
-		FD_ZERO(&wfds);
-		for (index = 0; index < write_count; index++)
-		{
-			sck = (int)(long) (write_fds[index]);
-			if (sck > max_sck)
-				max_sck = sck;
-			FD_SET(sck, &wfds);
-		}
-		/* exit if nothing to do */
-		if (max_sck == 0)
-		{
-			printf("run_xfreerdp: max_sck is zero\n");
-			break;
-		}
-		/* do the wait */
-		if (select(max_sck + 1, &rfds, &wfds, NULL, NULL) == -1)
-		{
-			/* these are not really errors */
-			if (!((errno == EAGAIN) ||
-				(errno == EWOULDBLOCK) ||
-				(errno == EINPROGRESS) ||
-				(errno == EINTR))) /* signal occurred */
+			if ((rdp_sck != -1) && (rdp_sck != (int)(long) (read_fds[0])))
+				event_loop_remove(loop, rdp_sck);
+			rdp_sck = (int)(long) (read_fds[0]);
+			rdp_generation = inst->sock_generation;
+			if (event_loop_add(loop, rdp_sck, EVENT_LOOP_READ, xf_rdp_ready, xfi) != 0)
 			{
-				printf("run_xfreerdp: select failed\n");
 				break;
 			}
 		}
-		/* check the libfreerdp fds */
-		if (inst->rdp_check_fds(inst) != 0)
-		{
-			printf("run_xfreerdp: inst->rdp_check_fds failed\n");
-			break;
-		}
-		/* check x fds */
-		if (xf_check_fds(xfi) != 0)
+		/* Xlib may have read events off the socket while painting */
+		if (XEventsQueued(xfi->display, QueuedAlready) > 0)
 		{
-			/* xfreerdp is usually terminated by this failing because the X windows has been closed */
-			DEBUG_X11("xf_check_fds failed");
-			break;
+			if (xf_x_ready(xfi->x_socket, EVENT_LOOP_READ, xfi) != 0)
+				break;
 		}
-		/* check channel fds */
-		if (freerdp_chanman_check_fds(xfi->chan_man, inst) != 0)
+		/* do the wait */
+		if (event_loop_wait(loop, -1) < 0)
 		{
-			printf("run_xfreerdp: freerdp_chanman_check_fds failed\n");
 			break;
 		}
-		/* check channel event */
-		event = freerdp_chanman_pop_event(xfi->chan_man);
-		if (event)
-		{
-			switch (event->event_type)
-			{
-				case RD_EVENT_TYPE_VIDEO_FRAME:
-					xf_video_process_frame(xfi, (RD_VIDEO_FRAME_EVENT *) event);
-					break;
-				case RD_EVENT_TYPE_REDRAW:
-					xf_handle_redraw_event(xfi, (RD_REDRAW_EVENT *) event);
-					break;
-				default:
-					printf("run_xfreerdp: unknown event type %d\n", event->event_type);
-					break;
-			}
-			freerdp_chanman_free_event(xfi->chan_man, event);
-		}
 	}
 
+	event_loop_free(loop);
+
 	DEBUG_X11("disconnected, reason %d", inst->disc_reason);
 
 	g_disconnect_reason = inst->disc_reason;
@@ -26,6 +26,13 @@
 
 #define MAX_PLUGINS 10
 
+/* channel ids are handed out by the server, usually in sequence, so the
+   low bits spread them well; must be a power of 2 */
+#define CHANNEL_HASH_SIZE 64
+#define CHANNEL_HASH(_id) ((_id) & (CHANNEL_HASH_SIZE - 1))
+
+typedef struct _DVCMAN_CHANNEL DVCMAN_CHANNEL;
+
 typedef struct _DVCMAN DVCMAN;
 struct _DVCMAN
 {
@@ -42,6 +49,8 @@ struct _DVCMAN
 
 	IWTSVirtualChannel * channel_list_head;
 	IWTSVirtualChannel * channel_list_tail;
+	/* the same channels, chained by hash of their id */
+	DVCMAN_CHANNEL * channel_hash[CHANNEL_HASH_SIZE];
 };
 
 typedef struct _DVCMAN_LISTENER DVCMAN_LISTENER;
@@ -64,13 +73,13 @@ struct _DVCMAN_ENTRY_POINTS
 	RD_PLUGIN_DATA * plugin_data;
 };
 
-typedef struct _DVCMAN_CHANNEL DVCMAN_CHANNEL;
 struct _DVCMAN_CHANNEL
 {
 	IWTSVirtualChannel iface;
 
 	DVCMAN * dvcman;
 	DVCMAN_CHANNEL * next;
+	DVCMAN_CHANNEL * hash_next;
 	uint32 channel_id;
 	IWTSVirtualChannelCallback * channel_callback;
 
@@ -297,8 +306,17 @@ dvcman_close_channel_iface(IWTSVirtualChannel * pChannel)
 	DVCMAN * dvcman = channel->dvcman;
 	DVCMAN_CHANNEL * prev;
 	DVCMAN_CHANNEL * curr;
+	DVCMAN_CHANNEL ** link;
 
 	LLOGLN(10, ("dvcman_channel_close: id=%d", channel->channel_id));
+	for (link = &dvcman->channel_hash[CHANNEL_HASH(channel->channel_id)]; *link; link = &(*link)->hash_next)
+	{
+		if (*link == channel)
+		{
+			*link = channel->hash_next;
+			break;
+		}
+	}
 	for (prev = NULL, curr = (DVCMAN_CHANNEL *) dvcman->channel_list_head; curr; prev = curr, curr = curr->next)
 	{
 		if (curr == channel)
@@ -327,6 +345,7 @@ dvcman_create_channel(IWTSVirtualChannelManager * pChannelMgr, uint32 ChannelId,
 	int i;
 	DVCMAN_LISTENER * listener;
 	DVCMAN_CHANNEL * channel;
+	DVCMAN_CHANNEL ** link;
 	int bAccept;
 	IWTSVirtualChannelCallback * pCallback;
 
@@ -351,6 +370,11 @@ dvcman_create_channel(IWTSVirtualChannelManager * pChannelMgr, uint32 ChannelId,
 				LLOGLN(0, ("dvcman_create_channel: listener %s created new channel %d",
 					listener->channel_name, channel->channel_id));
 				channel->channel_callback = pCallback;
+				/* at the end of its chain, so a reused id still finds the
+				   oldest channel as the list walk did */
+				for (link = &dvcman->channel_hash[CHANNEL_HASH(ChannelId)]; *link; link = &(*link)->hash_next)
+					;
+				*link = channel;
 				if (dvcman->channel_list_tail)
 				{
 					((DVCMAN_CHANNEL *) dvcman->channel_list_tail)->next = channel;
@@ -380,7 +404,7 @@ dvcman_find_channel_by_id(IWTSVirtualChannelManager * pChannelMgr, uint32 Channe
 	DVCMAN * dvcman = (DVCMAN *) pChannelMgr;
 	DVCMAN_CHANNEL * curr;
 
-	for (curr = (DVCMAN_CHANNEL *) dvcman->channel_list_head; curr; curr = curr->next)
+	for (curr = dvcman->channel_hash[CHANNEL_HASH(ChannelId)]; curr; curr = curr->hash_next)
 	{
 		if (curr->channel_id == ChannelId)
 		{
@@ -0,0 +1,420 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Planar Bitmap Decompression Benchmark
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <freerdp/freerdp.h>
+#include "bitmap.h"
+
+/*
+   A synthetic frame is cut in bitmaps of the given size and each of them
+   encoded planar, as a server sends a 32bpp bitmap update. Every iteration
+   decodes all of them, once with the plain decoder and once with the SIMD
+   kernels picked for this CPU.
+*/
+
+struct _BENCH_BITMAP
+{
+	int width;
+	int height;
+	uint8 * data;
+	int size;
+};
+typedef struct _BENCH_BITMAP BENCH_BITMAP;
+
+struct _BENCH_RESULT
+{
+	double ns_per_frame;
+	double mpixels_per_s;
+	double p50;
+	double p90;
+	double p99;
+};
+typedef struct _BENCH_RESULT BENCH_RESULT;
+
+static uint64_t
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+bench_compare(const void * a, const void * b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+/* synthetic 32bpp frames, loosely like what a desktop session sends */
+static void
+bench_fill_frame(uint8 * frame, int width, int height, const char * pattern)
+{
+	int x, y;
+	int i;
+	uint8 * p;
+	uint32 seed = 1;
+	uint8 value;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			p = frame + (y * width + x) * 4;
+			seed = seed * 1103515245 + 12345;
+
+			for (i = 0; i < 3; i++)
+			{
+				if (strcmp(pattern, "flat") == 0)
+				{
+					value = 0xE0;
+				}
+				else if (strcmp(pattern, "gradient") == 0)
+				{
+					value = (uint8) ((x * (i + 1) + y * (3 - i)) >> 2);
+				}
+				else if (strcmp(pattern, "noise") == 0)
+				{
+					value = (uint8) (seed >> (8 + i * 8));
+				}
+				else if (y < height / 8)
+				{
+					/* title bar */
+					value = (uint8) (0x40 + (x * 0x80) / width + i * 0x10);
+				}
+				else if (x >= width / 2 && y >= height / 2)
+				{
+					/* picture */
+					value = (uint8) (((x + y) >> 1) + ((seed >> (8 + i * 8)) & 0x3F));
+				}
+				else
+				{
+					/* text on a plain background */
+					value = ((x % 8) < 5 && (y % 12) < 9 && ((x * 7 + y * 13) % 5) < 2) ? 0x20 : 0xF0;
+				}
+
+				p[i] = value;
+			}
+
+			p[3] = 0xFF;
+		}
+	}
+}
+
+/* one line of a plane: raw values on the first line, deltas to the line above after it */
+static uint8 *
+bench_encode_line(uint8 * out, uint8 * values, int width)
+{
+	int i = 0;
+	int collen, replen;
+	int run;
+	uint8 color = 0;
+
+	while (i < width)
+	{
+		/* repeats of the current color */
+		for (run = 0; i + run < width && values[i + run] == color; run++);
+
+		if (run >= 16)
+		{
+			replen = (run > 47) ? 47 : run;
+			*out++ = ((replen & 0xF) << 4) | (replen >> 4);
+			i += replen;
+			continue;
+		}
+
+		if (run >= 3)
+		{
+			*out++ = run;
+			i += run;
+			continue;
+		}
+
+		/* literals, up to where a run starts */
+		for (collen = 0; collen < 15 && i + collen < width; collen++)
+		{
+			if (collen > 0 && i + collen + 2 < width && values[i + collen] == values[i + collen - 1] &&
+				values[i + collen + 1] == values[i + collen - 1] && values[i + collen + 2] == values[i + collen - 1])
+				break;
+		}
+
+		color = values[i + collen - 1];
+		for (run = 0; run < 15 && i + collen + run < width && values[i + collen + run] == color; run++);
+
+		/* 1 and 2 would read as a long run */
+		replen = (run >= 3) ? run : 0;
+
+		*out++ = (collen << 4) | replen;
+		memcpy(out, values + i, collen);
+		out += collen;
+		i += collen + replen;
+	}
+
+	return out;
+}
+
+/* a width x height bitmap at the given position of the frame, encoded planar */
+static void
+bench_encode_bitmap(BENCH_BITMAP * bitmap, uint8 * frame, int frame_width, int left, int top)
+{
+	int x, y;
+	int plane;
+	uint8 * out;
+	uint8 * values;
+	uint8 * pixel;
+	uint8 * above;
+	int d;
+
+	/* alpha, red, green and blue from the bottom line up, at most 2 bytes a value */
+	bitmap->data = (uint8 *) malloc(bitmap->width * bitmap->height * 8 + 1);
+	values = (uint8 *) malloc(bitmap->width);
+	out = bitmap->data;
+	*out++ = 0x10;
+
+	for (plane = 3; plane >= 0; plane--)
+	{
+		for (y = bitmap->height - 1; y >= 0; y--)
+		{
+			for (x = 0; x < bitmap->width; x++)
+			{
+				pixel = frame + ((top + y) * frame_width + left + x) * 4 + plane;
+
+				if (y == bitmap->height - 1)
+				{
+					values[x] = *pixel;
+				}
+				else
+				{
+					above = pixel + frame_width * 4;
+					d = (sint8) (*pixel - *above);
+					values[x] = (d >= 0) ? d * 2 : -d * 2 - 1;
+				}
+			}
+
+			out = bench_encode_line(out, values, bitmap->width);
+		}
+	}
+
+	bitmap->size = (int) (out - bitmap->data);
+	free(values);
+}
+
+static void
+bench_run(BENCH_BITMAP * bitmaps, int num_bitmaps, uint8 * output, int pixels, int iterations,
+	BENCH_RESULT * result)
+{
+	int i, j;
+	uint64_t start;
+	uint64_t total;
+	uint64_t * samples;
+
+	samples = (uint64_t *) malloc(iterations * sizeof(uint64_t));
+
+	total = 0;
+	for (i = -1; i < iterations; i++)
+	{
+		start = bench_now();
+		for (j = 0; j < num_bitmaps; j++)
+		{
+			bitmap_decompress(NULL, NULL, output, bitmaps[j].width, bitmaps[j].height,
+				bitmaps[j].data, bitmaps[j].size, 4);
+		}
+
+		/* the first one warms up */
+		if (i < 0)
+			continue;
+
+		samples[i] = bench_now() - start;
+		total += samples[i];
+	}
+
+	qsort(samples, iterations, sizeof(uint64_t), bench_compare);
+
+	result->ns_per_frame = (double) total / iterations;
+	result->mpixels_per_s = (double) pixels * 1000.0 / result->ns_per_frame;
+	result->p50 = (double) samples[(iterations - 1) * 50 / 100];
+	result->p90 = (double) samples[(iterations - 1) * 90 / 100];
+	result->p99 = (double) samples[(iterations - 1) * 99 / 100];
+
+	free(samples);
+}
+
+static void
+bench_usage(const char * name)
+{
+	printf("Usage: %s [options]\n"
+		"  -n <iterations>  frames decoded on each path (default 100)\n"
+		"  -w <width>       width of the synthetic frames (default 1024)\n"
+		"  -h <height>      height of the synthetic frames (default 768)\n"
+		"  -b <size>        bitmaps the frame is cut in, size x size (default 64)\n"
+		"  -p <pattern>     synthetic frames: desktop, flat, gradient, noise or all (default desktop)\n"
+		"  --csv            machine readable output, one line per result\n"
+		"Times are per frame, in nanoseconds, from a monotonic clock.\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+	int index = 1;
+	int *pindex = &index;
+	int iterations = 100;
+	int width = 1024;
+	int height = 768;
+	int bitmap_size = 64;
+	int csv = 0;
+	const char * pattern = "desktop";
+	const char * patterns[] = { "desktop", "flat", "gradient", "noise" };
+	const char * paths[] = { "scalar", "simd" };
+	int num_patterns;
+	BENCH_BITMAP * bitmaps;
+	int num_bitmaps;
+	BENCH_RESULT result;
+	uint8 * frame;
+	uint8 * output;
+	int stream_size;
+	int x, y;
+	int i, k;
+
+	while (*pindex < argc)
+	{
+		if (strcmp("--csv", argv[*pindex]) == 0)
+		{
+			csv = 1;
+		}
+		else if (*pindex + 1 < argc && strcmp("-n", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			iterations = atoi(argv[*pindex]);
+		}
+		else if (*pindex + 1 < argc && strcmp("-w", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			width = atoi(argv[*pindex]);
+		}
+		else if (*pindex + 1 < argc && strcmp("-h", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			height = atoi(argv[*pindex]);
+		}
+		else if (*pindex + 1 < argc && strcmp("-b", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			bitmap_size = atoi(argv[*pindex]);
+		}
+		else if (*pindex + 1 < argc && strcmp("-p", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			pattern = argv[*pindex];
+		}
+		else
+		{
+			bench_usage(argv[0]);
+			return 1;
+		}
+
+		*pindex = *pindex + 1;
+	}
+
+	if (iterations < 1 || width < 1 || height < 1 || bitmap_size < 1)
+	{
+		bench_usage(argv[0]);
+		return 1;
+	}
+
+	if (strcmp(pattern, "all") == 0)
+	{
+		num_patterns = sizeof(patterns) / sizeof(patterns[0]);
+	}
+	else
+	{
+		patterns[0] = pattern;
+		num_patterns = 1;
+	}
+
+	if (csv)
+		printf("path,input,bitmaps,stream_bytes,iterations,ns_per_frame,mpixels_per_s,p50_ns,p90_ns,p99_ns\n");
+	else
+		printf("%-7s %-10s %7s %10s %12s %9s %12s %12s %12s\n",
+			"path", "input", "bitmaps", "bytes", "ns/frame", "Mpix/s", "p50", "p90", "p99");
+
+	frame = (uint8 *) malloc(width * height * 4);
+	output = (uint8 *) malloc(bitmap_size * bitmap_size * 4);
+	bitmaps = (BENCH_BITMAP *) malloc(sizeof(BENCH_BITMAP) *
+		((width + bitmap_size - 1) / bitmap_size) * ((height + bitmap_size - 1) / bitmap_size));
+
+	for (k = 0; k < num_patterns; k++)
+	{
+		bench_fill_frame(frame, width, height, patterns[k]);
+
+		num_bitmaps = 0;
+		stream_size = 0;
+		for (y = 0; y < height; y += bitmap_size)
+		{
+			for (x = 0; x < width; x += bitmap_size)
+			{
+				bitmaps[num_bitmaps].width = (width - x < bitmap_size) ? width - x : bitmap_size;
+				bitmaps[num_bitmaps].height = (height - y < bitmap_size) ? height - y : bitmap_size;
+				bench_encode_bitmap(&bitmaps[num_bitmaps], frame, width, x, y);
+				stream_size += bitmaps[num_bitmaps].size;
+				num_bitmaps++;
+			}
+		}
+
+		for (i = 0; i < 2; i++)
+		{
+			bitmap_init(i);
+			bench_run(bitmaps, num_bitmaps, output, width * height, iterations, &result);
+
+			if (csv)
+			{
+				printf("%s,%s,%d,%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f\n", paths[i], patterns[k],
+					num_bitmaps, stream_size, iterations, result.ns_per_frame, result.mpixels_per_s,
+					result.p50, result.p90, result.p99);
+			}
+			else
+			{
+				printf("%-7s %-10s %7d %10d %12.1f %9.1f %12.1f %12.1f %12.1f\n", paths[i], patterns[k],
+					num_bitmaps, stream_size, result.ns_per_frame, result.mpixels_per_s,
+					result.p50, result.p90, result.p99);
+			}
+
+			fflush(stdout);
+		}
+
+		for (i = 0; i < num_bitmaps; i++)
+			free(bitmaps[i].data);
+	}
+
+	free(bitmaps);
+	free(output);
+	free(frame);
+
+	return 0;
+}
@@ -0,0 +1,231 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   GDI Scrolling Benchmark
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <freerdp/freerdp.h>
+#include "gdi.h"
+
+#ifdef WITH_SSE
+#include "gdi_sse.h"
+#endif
+
+/*
+   The whole surface but one line or column is moved by one line or column
+   within itself, as a screen to screen blit does when a window scrolls.
+   Every direction is run once with the plain word copies and once with the
+   SIMD kernels picked for this CPU.
+*/
+
+struct _BENCH_RESULT
+{
+	double ns_per_frame;
+	double mbytes_per_s;
+	double p50;
+	double p90;
+	double p99;
+};
+typedef struct _BENCH_RESULT BENCH_RESULT;
+
+static uint64_t
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+bench_compare(const void * a, const void * b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+bench_run(HGDI_DC hdc, int width, int height, int dx, int dy, int iterations, BENCH_RESULT * result)
+{
+	int i;
+	int nWidth;
+	int nHeight;
+	uint64_t start;
+	uint64_t total;
+	uint64_t * samples;
+
+	samples = (uint64_t *) malloc(iterations * sizeof(uint64_t));
+	nWidth = width - abs(dx);
+	nHeight = height - abs(dy);
+
+	total = 0;
+	for (i = -1; i < iterations; i++)
+	{
+		start = bench_now();
+		gdi_BitBlt(hdc, (dx > 0) ? dx : 0, (dy > 0) ? dy : 0, nWidth, nHeight,
+			hdc, (dx < 0) ? -dx : 0, (dy < 0) ? -dy : 0, GDI_SRCCOPY);
+
+		/* the first one warms up */
+		if (i < 0)
+			continue;
+
+		samples[i] = bench_now() - start;
+		total += samples[i];
+	}
+
+	qsort(samples, iterations, sizeof(uint64_t), bench_compare);
+
+	result->ns_per_frame = (double) total / iterations;
+	result->mbytes_per_s = (double) nWidth * nHeight * hdc->bytesPerPixel * 1000.0 / result->ns_per_frame;
+	result->p50 = (double) samples[(iterations - 1) * 50 / 100];
+	result->p90 = (double) samples[(iterations - 1) * 90 / 100];
+	result->p99 = (double) samples[(iterations - 1) * 99 / 100];
+
+	free(samples);
+}
+
+static void
+bench_usage(const char * name)
+{
+	printf("Usage: %s [options]\n"
+		"  -n <iterations>  scrolls in each direction on each path (default 100)\n"
+		"  -w <width>       width of the surface (default 1920)\n"
+		"  -h <height>      height of the surface (default 1080)\n"
+		"  -b <bpp>         bits per pixel of the surface, 8, 16 or 32 (default 32)\n"
+		"  --csv            machine readable output, one line per result\n"
+		"Times are per scroll, in nanoseconds, from a monotonic clock.\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+	int index = 1;
+	int *pindex = &index;
+	int iterations = 100;
+	int width = 1920;
+	int height = 1080;
+	int bpp = 32;
+	int csv = 0;
+	const char * directions[] = { "up", "down", "left", "right" };
+	const int moves[4][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
+	const char * paths[] = { "scalar", "simd" };
+	BENCH_RESULT result;
+	HGDI_DC hdc;
+	HGDI_BITMAP hBmp;
+	uint8 * data;
+	int size;
+	int i, k;
+
+	while (*pindex < argc)
+	{
+		if (strcmp("--csv", argv[*pindex]) == 0)
+		{
+			csv = 1;
+		}
+		else if (*pindex + 1 < argc && strcmp("-n", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			iterations = atoi(argv[*pindex]);
+		}
+		else if (*pindex + 1 < argc && strcmp("-w", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			width = atoi(argv[*pindex]);
+		}
+		else if (*pindex + 1 < argc && strcmp("-h", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			height = atoi(argv[*pindex]);
+		}
+		else if (*pindex + 1 < argc && strcmp("-b", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			bpp = atoi(argv[*pindex]);
+		}
+		else
+		{
+			bench_usage(argv[0]);
+			return 1;
+		}
+
+		*pindex = *pindex + 1;
+	}
+
+	if (iterations < 1 || width < 2 || height < 2 || (bpp != 8 && bpp != 16 && bpp != 32))
+	{
+		bench_usage(argv[0]);
+		return 1;
+	}
+
+	if (csv)
+		printf("path,direction,width,height,bpp,iterations,ns_per_scroll,mbytes_per_s,p50_ns,p90_ns,p99_ns\n");
+	else
+		printf("%-7s %-6s %12s %9s %12s %12s %12s\n",
+			"path", "scroll", "ns/scroll", "MB/s", "p50", "p90", "p99");
+
+	hdc = gdi_GetDC();
+	hdc->bytesPerPixel = bpp / 8;
+	hdc->bitsPerPixel = bpp;
+
+	size = width * height * hdc->bytesPerPixel;
+	data = (uint8 *) malloc(size);
+	for (i = 0; i < size; i++)
+		data[i] = (uint8) (i * 7 + (i >> 8));
+
+	hBmp = gdi_CreateBitmap(width, height, bpp, data);
+	gdi_SelectObject(hdc, (HGDIOBJECT) hBmp);
+	gdi_SetNullClipRgn(hdc);
+
+	for (k = 0; k < 4; k++)
+	{
+		for (i = 0; i < 2; i++)
+		{
+			memset(&gdi_rop_funcs, 0, sizeof(GDI_ROP_FUNCS));
+#ifdef WITH_SSE
+			if (i > 0)
+				gdi_init_sse(NULL);
+#endif
+			bench_run(hdc, width, height, moves[k][0], moves[k][1], iterations, &result);
+
+			if (csv)
+			{
+				printf("%s,%s,%d,%d,%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f\n", paths[i], directions[k],
+					width, height, bpp, iterations, result.ns_per_frame, result.mbytes_per_s,
+					result.p50, result.p90, result.p99);
+			}
+			else
+			{
+				printf("%-7s %-6s %12.1f %9.1f %12.1f %12.1f %12.1f\n", paths[i], directions[k],
+					result.ns_per_frame, result.mbytes_per_s, result.p50, result.p90, result.p99);
+			}
+
+			fflush(stdout);
+		}
+	}
+
+	gdi_DeleteObject((HGDIOBJECT) hBmp);
+
+	return 0;
+}
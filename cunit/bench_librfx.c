@@ -0,0 +1,930 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   RemoteFX Codec Library Benchmark
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <freerdp/rfx.h>
+#include "rfx_rlgr.h"
+#include "rfx_differential.h"
+#include "rfx_quantization.h"
+#include "rfx_dwt.h"
+#include "rfx_decode.h"
+#include "rfx_encode.h"
+
+#ifdef WITH_SSE
+#include "rfx_sse2.h"
+#endif
+
+#ifdef WITH_AVX2
+#include "rfx_avx2.h"
+#endif
+
+/*
+   Every stage runs over a whole tile set per iteration. The stages working in
+   place copy their input into the work buffers first, which is counted in
+   their time, the same for every implementation.
+   Throughput is given in MB of 32bpp pixels, 64x64x4 bytes per tile.
+*/
+
+#define BENCH_TILE_BYTES	(64 * 64 * 4)
+#define BENCH_MAX_IMPLS		4
+
+static const uint32 bench_quants[] =
+{
+	6, 6, 6, 6, 7, 7, 8, 8, 8, 9
+};
+
+/* the per-tile routines of one implementation, NULL where it has none */
+struct _BENCH_IMPL
+{
+	const char * name;
+	void (* decode_YCbCr_to_RGB)(sint16 * y_r_buf, sint16 * cb_g_buf, sint16 * cr_b_buf);
+	void (* encode_RGB_to_YCbCr)(sint16 * y_r_buf, sint16 * cb_g_buf, sint16 * cr_b_buf);
+	void (* quantization_decode)(sint16 * buffer, const uint32 * quantization_values);
+	void (* quantization_encode)(sint16 * buffer, const uint32 * quantization_values);
+	void (* dwt_2d_decode)(sint16 * buffer, sint16 * dwt_buffer);
+	void (* dwt_2d_encode)(sint16 * buffer, sint16 * dwt_buffer);
+};
+typedef struct _BENCH_IMPL BENCH_IMPL;
+
+/*
+   The input of every stage for each tile, 3 components of 4096 coefficients,
+   obtained by running the tiles through the scalar codec once.
+*/
+struct _BENCH_TILESET
+{
+	const char * name;
+	int num_tiles;
+
+	sint16 * rgb;		/* RGB_to_YCbCr */
+	sint16 * ycbcr;		/* dwt_encode */
+	sint16 * dwt;		/* quantization_encode */
+	sint16 * quantized;	/* rlgr_encode, differential_decode, quantization_decode */
+	sint16 * dequantized;	/* dwt_decode */
+	sint16 * idwt;		/* YCbCr_to_RGB */
+	uint8 * rlgr;		/* rlgr_decode, 3 * 8192 bytes per tile */
+	int * rlgr_size;	/* 3 per tile */
+
+	/* whole messages for message_decode, and the frame for message_encode */
+	uint8 * stream;
+	int stream_size;
+	int * message_size;
+	int num_messages;
+	uint8 * frame;
+	int width;
+	int height;
+};
+typedef struct _BENCH_TILESET BENCH_TILESET;
+
+struct _BENCH_RESULT
+{
+	double ns_per_tile;
+	double mb_per_s;
+	double p50;
+	double p90;
+	double p99;
+	double min;
+};
+typedef struct _BENCH_RESULT BENCH_RESULT;
+
+typedef void (* BENCH_FUNC)(BENCH_TILESET * set, BENCH_IMPL * impl);
+
+static sint16 work_buffer[3][4096] __attribute__((aligned(32)));
+static sint16 dwt_buffer[32 * 32 * 2 * 2] __attribute__((aligned(32)));
+static uint8 rlgr_buffer[3 * 8192];
+
+static RFX_CONTEXT * message_context;
+static uint8 * message_buffer;
+static int message_buffer_size;
+
+static uint64_t
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+bench_compare(const void * a, const void * b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+/* load the three components of tile i of a stage input into the work buffers */
+static void
+bench_load(sint16 * data, int i)
+{
+	memcpy(work_buffer[0], data + (i * 3) * 4096, 4096 * sizeof(sint16));
+	memcpy(work_buffer[1], data + (i * 3 + 1) * 4096, 4096 * sizeof(sint16));
+	memcpy(work_buffer[2], data + (i * 3 + 2) * 4096, 4096 * sizeof(sint16));
+}
+
+static void
+bench_rlgr_decode(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	int i, j;
+
+	for (i = 0; i < set->num_tiles; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			rfx_rlgr_decode(RLGR3, set->rlgr + (i * 3 + j) * 8192, set->rlgr_size[i * 3 + j],
+				work_buffer[j], 4096);
+		}
+	}
+}
+
+static void
+bench_rlgr_encode(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	int i, j;
+
+	for (i = 0; i < set->num_tiles; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			rfx_rlgr_encode(RLGR3, set->quantized + (i * 3 + j) * 4096, 4096,
+				rlgr_buffer + j * 8192, 8192);
+		}
+	}
+}
+
+static void
+bench_differential_decode(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	int i, j;
+
+	for (i = 0; i < set->num_tiles; i++)
+	{
+		bench_load(set->quantized, i);
+
+		for (j = 0; j < 3; j++)
+			rfx_differential_decode(work_buffer[j] + 4032, 64);
+	}
+}
+
+static void
+bench_differential_encode(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	int i, j;
+
+	for (i = 0; i < set->num_tiles; i++)
+	{
+		bench_load(set->quantized, i);
+
+		for (j = 0; j < 3; j++)
+			rfx_differential_encode(work_buffer[j] + 4032, 64);
+	}
+}
+
+static void
+bench_quantization_decode(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	int i, j;
+
+	for (i = 0; i < set->num_tiles; i++)
+	{
+		bench_load(set->quantized, i);
+
+		for (j = 0; j < 3; j++)
+			impl->quantization_decode(work_buffer[j], bench_quants);
+	}
+}
+
+static void
+bench_quantization_encode(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	int i, j;
+
+	for (i = 0; i < set->num_tiles; i++)
+	{
+		bench_load(set->dwt, i);
+
+		for (j = 0; j < 3; j++)
+			impl->quantization_encode(work_buffer[j], bench_quants);
+	}
+}
+
+static void
+bench_dwt_decode(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	int i, j;
+
+	for (i = 0; i < set->num_tiles; i++)
+	{
+		bench_load(set->dequantized, i);
+
+		for (j = 0; j < 3; j++)
+			impl->dwt_2d_decode(work_buffer[j], dwt_buffer);
+	}
+}
+
+static void
+bench_dwt_encode(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	int i, j;
+
+	for (i = 0; i < set->num_tiles; i++)
+	{
+		bench_load(set->ycbcr, i);
+
+		for (j = 0; j < 3; j++)
+			impl->dwt_2d_encode(work_buffer[j], dwt_buffer);
+	}
+}
+
+static void
+bench_YCbCr_to_RGB(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	int i;
+
+	for (i = 0; i < set->num_tiles; i++)
+	{
+		bench_load(set->idwt, i);
+		impl->decode_YCbCr_to_RGB(work_buffer[0], work_buffer[1], work_buffer[2]);
+	}
+}
+
+static void
+bench_RGB_to_YCbCr(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	int i;
+
+	for (i = 0; i < set->num_tiles; i++)
+	{
+		bench_load(set->rgb, i);
+		impl->encode_RGB_to_YCbCr(work_buffer[0], work_buffer[1], work_buffer[2]);
+	}
+}
+
+static void
+bench_message_decode(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	int i;
+	int offset = 0;
+
+	for (i = 0; i < set->num_messages; i++)
+	{
+		rfx_message_free(message_context,
+			rfx_process_message(message_context, set->stream + offset, set->message_size[i]));
+		offset += set->message_size[i];
+	}
+}
+
+static void
+bench_message_encode(BENCH_TILESET * set, BENCH_IMPL * impl)
+{
+	RFX_RECT rect;
+
+	rect.x = 0;
+	rect.y = 0;
+	rect.width = set->width;
+	rect.height = set->height;
+
+	rfx_compose_message_data(message_context, message_buffer, message_buffer_size,
+		&rect, 1, set->frame, set->width, set->height, set->width * 4);
+}
+
+/* whether an implementation has the routine a per-implementation stage runs */
+static int
+bench_impl_supports(BENCH_IMPL * impl, BENCH_FUNC func)
+{
+	if (func == bench_quantization_decode)
+		return impl->quantization_decode != NULL;
+	else if (func == bench_quantization_encode)
+		return impl->quantization_encode != NULL;
+	else if (func == bench_dwt_decode)
+		return impl->dwt_2d_decode != NULL;
+	else if (func == bench_dwt_encode)
+		return impl->dwt_2d_encode != NULL;
+	else if (func == bench_YCbCr_to_RGB)
+		return impl->decode_YCbCr_to_RGB != NULL;
+	else if (func == bench_RGB_to_YCbCr)
+		return impl->encode_RGB_to_YCbCr != NULL;
+
+	return 0;
+}
+
+/* the implementations built in and usable on this CPU, scalar first */
+static int
+bench_get_impls(BENCH_IMPL * impls)
+{
+	int num_impls = 0;
+	BENCH_IMPL * impl;
+
+	impl = &impls[num_impls++];
+	memset(impl, 0, sizeof(BENCH_IMPL));
+	impl->name = "scalar";
+	impl->decode_YCbCr_to_RGB = rfx_decode_YCbCr_to_RGB;
+	impl->encode_RGB_to_YCbCr = rfx_encode_RGB_to_YCbCr;
+	impl->quantization_decode = rfx_quantization_decode;
+	impl->quantization_encode = rfx_quantization_encode;
+	impl->dwt_2d_decode = rfx_dwt_2d_decode;
+	impl->dwt_2d_encode = rfx_dwt_2d_encode;
+
+#ifdef WITH_SSE
+	impl = &impls[num_impls++];
+	memset(impl, 0, sizeof(BENCH_IMPL));
+	impl->name = "sse2";
+	impl->decode_YCbCr_to_RGB = rfx_decode_YCbCr_to_RGB_SSE2;
+	impl->encode_RGB_to_YCbCr = rfx_encode_RGB_to_YCbCr_SSE2;
+	impl->quantization_decode = rfx_quantization_decode_SSE2;
+	impl->quantization_encode = rfx_quantization_encode_SSE2;
+	impl->dwt_2d_decode = rfx_dwt_2d_decode_SSE2;
+	impl->dwt_2d_encode = rfx_dwt_2d_encode_SSE2;
+#endif
+
+#ifdef WITH_AVX2
+	if (rfx_cpu_has_avx2())
+	{
+		/* there are only decode kernels for AVX2 */
+		impl = &impls[num_impls++];
+		memset(impl, 0, sizeof(BENCH_IMPL));
+		impl->name = "avx2";
+		impl->decode_YCbCr_to_RGB = rfx_decode_YCbCr_to_RGB_AVX2;
+		impl->quantization_decode = rfx_quantization_decode_AVX2;
+		impl->dwt_2d_decode = rfx_dwt_2d_decode_AVX2;
+	}
+#endif
+
+#ifdef WITH_NEON
+	{
+		/* the NEON routines are only reachable through a context */
+		RFX_CONTEXT * context = rfx_context_new();
+
+		impl = &impls[num_impls++];
+		memset(impl, 0, sizeof(BENCH_IMPL));
+		impl->name = "neon";
+		impl->decode_YCbCr_to_RGB = context->decode_YCbCr_to_RGB;
+		impl->encode_RGB_to_YCbCr = context->encode_RGB_to_YCbCr;
+		impl->quantization_decode = context->quantization_decode;
+		impl->quantization_encode = context->quantization_encode;
+		impl->dwt_2d_decode = context->dwt_2d_decode;
+		impl->dwt_2d_encode = context->dwt_2d_encode;
+
+		rfx_context_free(context);
+	}
+#endif
+
+	return num_impls;
+}
+
+/* synthetic 32bpp frames, loosely like what a desktop session sends */
+static void
+bench_fill_frame(uint8 * frame, int width, int height, const char * pattern)
+{
+	int x, y;
+	int i;
+	uint8 * p;
+	uint32 seed = 1;
+	uint8 value;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			p = frame + (y * width + x) * 4;
+			seed = seed * 1103515245 + 12345;
+
+			for (i = 0; i < 3; i++)
+			{
+				if (strcmp(pattern, "flat") == 0)
+				{
+					value = 0xE0;
+				}
+				else if (strcmp(pattern, "gradient") == 0)
+				{
+					value = (uint8) ((x * (i + 1) + y * (3 - i)) >> 2);
+				}
+				else if (strcmp(pattern, "noise") == 0)
+				{
+					value = (uint8) (seed >> (8 + i * 8));
+				}
+				else if (y < height / 8)
+				{
+					/* title bar */
+					value = (uint8) (0x40 + (x * 0x80) / width + i * 0x10);
+				}
+				else if (x >= width / 2 && y >= height / 2)
+				{
+					/* picture */
+					value = (uint8) (((x + y) >> 1) + ((seed >> (8 + i * 8)) & 0x3F));
+				}
+				else
+				{
+					/* text on a plain background */
+					value = ((x % 8) < 5 && (y % 12) < 9 && ((x * 7 + y * 13) % 5) < 2) ? 0x20 : 0xF0;
+				}
+
+				p[i] = value;
+			}
+
+			p[3] = 0xFF;
+		}
+	}
+}
+
+/* the stage inputs of a 64x64 BGRA tile, through the scalar codec */
+static void
+bench_add_tile(BENCH_TILESET * set, const uint8 * tile, int rowstride, int width, int height)
+{
+	int i, j;
+	int x, y;
+	int n = set->num_tiles++;
+	sint16 * rgb = set->rgb + n * 3 * 4096;
+	sint16 * plane;
+
+	for (y = 0; y < 64; y++)
+	{
+		for (x = 0; x < 64; x++)
+		{
+			for (j = 0; j < 3; j++)
+			{
+				/* BGRA to R, G, B planes, zero outside the image */
+				rgb[j * 4096 + y * 64 + x] = (x < width && y < height) ?
+					tile[y * rowstride + x * 4 + 2 - j] : 0;
+			}
+		}
+	}
+
+	memcpy(set->ycbcr + n * 3 * 4096, rgb, 3 * 4096 * sizeof(sint16));
+	plane = set->ycbcr + n * 3 * 4096;
+	rfx_encode_RGB_to_YCbCr(plane, plane + 4096, plane + 2 * 4096);
+
+	for (j = 0; j < 3; j++)
+	{
+		i = n * 3 + j;
+
+		memcpy(set->dwt + i * 4096, set->ycbcr + i * 4096, 4096 * sizeof(sint16));
+		rfx_dwt_2d_encode(set->dwt + i * 4096, dwt_buffer);
+
+		memcpy(set->quantized + i * 4096, set->dwt + i * 4096, 4096 * sizeof(sint16));
+		rfx_quantization_encode(set->quantized + i * 4096, bench_quants);
+
+		memcpy(work_buffer[0], set->quantized + i * 4096, 4096 * sizeof(sint16));
+		rfx_differential_encode(work_buffer[0] + 4032, 64);
+		set->rlgr_size[i] = rfx_rlgr_encode(RLGR3, work_buffer[0], 4096, set->rlgr + i * 8192, 8192);
+
+		memcpy(set->dequantized + i * 4096, set->quantized + i * 4096, 4096 * sizeof(sint16));
+		rfx_quantization_decode(set->dequantized + i * 4096, bench_quants);
+
+		memcpy(set->idwt + i * 4096, set->dequantized + i * 4096, 4096 * sizeof(sint16));
+		rfx_dwt_2d_decode(set->idwt + i * 4096, dwt_buffer);
+	}
+}
+
+static void
+bench_alloc_tiles(BENCH_TILESET * set, int max_tiles)
+{
+	set->rgb = (sint16 *) malloc(max_tiles * 3 * 4096 * sizeof(sint16));
+	set->ycbcr = (sint16 *) malloc(max_tiles * 3 * 4096 * sizeof(sint16));
+	set->dwt = (sint16 *) malloc(max_tiles * 3 * 4096 * sizeof(sint16));
+	set->quantized = (sint16 *) malloc(max_tiles * 3 * 4096 * sizeof(sint16));
+	set->dequantized = (sint16 *) malloc(max_tiles * 3 * 4096 * sizeof(sint16));
+	set->idwt = (sint16 *) malloc(max_tiles * 3 * 4096 * sizeof(sint16));
+	set->rlgr = (uint8 *) malloc(max_tiles * 3 * 8192);
+	set->rlgr_size = (int *) malloc(max_tiles * 3 * sizeof(int));
+	set->num_tiles = 0;
+}
+
+/* a synthetic tile set: the tiles of a frame and the frame composed as one message */
+static void
+bench_tileset_synthetic(BENCH_TILESET * set, const char * pattern, int width, int height)
+{
+	int xIdx, yIdx;
+	int numTilesX = (width + 63) / 64;
+	int numTilesY = (height + 63) / 64;
+	int size;
+	RFX_CONTEXT * context;
+	RFX_RECT rect = {0, 0, width, height};
+
+	memset(set, 0, sizeof(BENCH_TILESET));
+	set->name = pattern;
+	set->width = width;
+	set->height = height;
+	set->frame = (uint8 *) malloc(width * height * 4);
+	bench_fill_frame(set->frame, width, height, pattern);
+
+	bench_alloc_tiles(set, numTilesX * numTilesY);
+	for (yIdx = 0; yIdx < numTilesY; yIdx++)
+	{
+		for (xIdx = 0; xIdx < numTilesX; xIdx++)
+		{
+			bench_add_tile(set, set->frame + (yIdx * 64 * width + xIdx * 64) * 4, width * 4,
+				width - xIdx * 64, height - yIdx * 64);
+		}
+	}
+
+	context = rfx_context_new();
+	context->mode = RLGR3;
+	context->width = width;
+	context->height = height;
+	rfx_context_set_pixel_format(context, RFX_PIXEL_FORMAT_BGRA);
+
+	set->stream = (uint8 *) malloc(width * height * 8 + 1024);
+	size = rfx_compose_message_header(context, set->stream, width * height * 8 + 1024);
+	size += rfx_compose_message_data(context, set->stream + size, width * height * 8 + 1024 - size,
+		&rect, 1, set->frame, width, height, width * 4);
+	set->stream_size = size;
+	set->message_size = (int *) malloc(sizeof(int));
+	set->message_size[0] = size;
+	set->num_messages = 1;
+
+	rfx_context_free(context);
+}
+
+/*
+   A recorded tile set: a file with a RemoteFX stream as sent by a server,
+   header blocks followed by frames. message_decode runs on the stream as is,
+   the other stages on its decoded tiles.
+*/
+static int
+bench_tileset_recorded(BENCH_TILESET * set, const char * filename)
+{
+	FILE * fp;
+	int offset;
+	int start;
+	int blockType;
+	int blockLen;
+	int max_tiles;
+	int i;
+	RFX_CONTEXT * context;
+	RFX_MESSAGE * message;
+
+	memset(set, 0, sizeof(BENCH_TILESET));
+	set->name = filename;
+
+	fp = fopen(filename, "rb");
+	if (fp == NULL)
+	{
+		printf("bench_librfx: cannot open %s.\n", filename);
+		return 0;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	set->stream_size = (int) ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	set->stream = (uint8 *) malloc(set->stream_size);
+	if (fread(set->stream, 1, set->stream_size, fp) != (size_t) set->stream_size)
+		set->stream_size = 0;
+	fclose(fp);
+
+	/* split it into messages, each ending with a frame end */
+	set->message_size = (int *) malloc((set->stream_size / 8 + 1) * sizeof(int));
+	for (offset = start = 0; offset + 6 <= set->stream_size; offset += blockLen)
+	{
+		blockType = set->stream[offset] | (set->stream[offset + 1] << 8);
+		blockLen = set->stream[offset + 2] | (set->stream[offset + 3] << 8) |
+			(set->stream[offset + 4] << 16) | (set->stream[offset + 5] << 24);
+
+		if (blockLen < 6 || offset + blockLen > set->stream_size)
+			break;
+
+		if (blockType == WBT_FRAME_END)
+		{
+			set->message_size[set->num_messages++] = offset + blockLen - start;
+			start = offset + blockLen;
+		}
+	}
+
+	if (set->num_messages == 0)
+	{
+		printf("bench_librfx: no RemoteFX frame in %s.\n", filename);
+		return 0;
+	}
+
+	context = rfx_context_new();
+	rfx_context_set_pixel_format(context, RFX_PIXEL_FORMAT_BGRA);
+
+	max_tiles = 0;
+	offset = 0;
+	for (i = 0; i < set->num_messages; i++)
+	{
+		message = rfx_process_message(context, set->stream + offset, set->message_size[i]);
+		max_tiles += message->num_tiles;
+		rfx_message_free(context, message);
+		offset += set->message_size[i];
+	}
+
+	bench_alloc_tiles(set, max_tiles);
+	offset = 0;
+	for (i = 0; i < set->num_messages; i++)
+	{
+		int j;
+
+		message = rfx_process_message(context, set->stream + offset, set->message_size[i]);
+		for (j = 0; j < message->num_tiles; j++)
+			bench_add_tile(set, message->tiles[j]->data, 64 * 4, 64, 64);
+		rfx_message_free(context, message);
+		offset += set->message_size[i];
+	}
+
+	rfx_context_free(context);
+
+	return 1;
+}
+
+static void
+bench_tileset_free(BENCH_TILESET * set)
+{
+	free(set->rgb);
+	free(set->ycbcr);
+	free(set->dwt);
+	free(set->quantized);
+	free(set->dequantized);
+	free(set->idwt);
+	free(set->rlgr);
+	free(set->rlgr_size);
+	free(set->stream);
+	free(set->message_size);
+	free(set->frame);
+}
+
+/* run a stage for the given number of iterations, after one to warm up */
+static void
+bench_run(BENCH_FUNC func, BENCH_TILESET * set, BENCH_IMPL * impl, int num_tiles, int iterations,
+	BENCH_RESULT * result)
+{
+	int i;
+	uint64_t start;
+	uint64_t total;
+	uint64_t * samples;
+
+	samples = (uint64_t *) malloc(iterations * sizeof(uint64_t));
+
+	func(set, impl);
+
+	total = 0;
+	for (i = 0; i < iterations; i++)
+	{
+		start = bench_now();
+		func(set, impl);
+		samples[i] = bench_now() - start;
+		total += samples[i];
+	}
+
+	qsort(samples, iterations, sizeof(uint64_t), bench_compare);
+
+	result->ns_per_tile = (double) total / iterations / num_tiles;
+	result->mb_per_s = (double) BENCH_TILE_BYTES * 1000.0 / result->ns_per_tile;
+	result->p50 = (double) samples[(iterations - 1) * 50 / 100] / num_tiles;
+	result->p90 = (double) samples[(iterations - 1) * 90 / 100] / num_tiles;
+	result->p99 = (double) samples[(iterations - 1) * 99 / 100] / num_tiles;
+	result->min = (double) samples[0] / num_tiles;
+
+	free(samples);
+}
+
+static void
+bench_print(int csv, const char * stage, const char * impl, BENCH_TILESET * set, int num_tiles,
+	int iterations, BENCH_RESULT * result)
+{
+	if (csv)
+	{
+		printf("%s,%s,%s,%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", stage, impl, set->name,
+			num_tiles, iterations, result->ns_per_tile, result->mb_per_s,
+			result->p50, result->p90, result->p99, result->min);
+	}
+	else
+	{
+		printf("%-20s %-7s %-10s %6d %10.1f %9.1f %10.1f %10.1f %10.1f\n", stage, impl, set->name,
+			num_tiles, result->ns_per_tile, result->mb_per_s, result->p50, result->p90, result->p99);
+	}
+
+	fflush(stdout);
+}
+
+static void
+bench_usage(const char * name)
+{
+	printf("Usage: %s [options]\n"
+		"  -n <iterations>  iterations of each stage (default 50)\n"
+		"  -w <width>       width of the synthetic frames (default 1024)\n"
+		"  -h <height>      height of the synthetic frames (default 768)\n"
+		"  -p <pattern>     synthetic frames: desktop, flat, gradient, noise or all (default desktop)\n"
+		"  -f <file>        recorded RemoteFX stream to use instead of synthetic frames\n"
+		"  -s <stage>       run only this stage\n"
+		"  -t <threads>     threads for the message stages (default 1, 0 for one per cpu)\n"
+		"  --csv            machine readable output, one line per result\n"
+		"Times are per tile, in nanoseconds, from a monotonic clock.\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+	int index = 1;
+	int *pindex = &index;
+	int iterations = 50;
+	int width = 1024;
+	int height = 768;
+	int num_threads = 1;
+	int csv = 0;
+	const char * pattern = "desktop";
+	const char * filename = NULL;
+	const char * only = NULL;
+	const char * patterns[] = { "desktop", "flat", "gradient", "noise" };
+	int num_patterns;
+	BENCH_IMPL impls[BENCH_MAX_IMPLS];
+	int num_impls;
+	BENCH_TILESET set;
+	BENCH_RESULT result;
+	int i, j, k;
+
+	/* the stages, and whether each implementation has its own routine for them */
+	struct
+	{
+		const char * name;
+		BENCH_FUNC func;
+		int per_impl;
+	} stages[] =
+	{
+		{ "rlgr_decode", bench_rlgr_decode, 0 },
+		{ "rlgr_encode", bench_rlgr_encode, 0 },
+		{ "differential_decode", bench_differential_decode, 0 },
+		{ "differential_encode", bench_differential_encode, 0 },
+		{ "quantization_decode", bench_quantization_decode, 1 },
+		{ "quantization_encode", bench_quantization_encode, 1 },
+		{ "dwt_decode", bench_dwt_decode, 1 },
+		{ "dwt_encode", bench_dwt_encode, 1 },
+		{ "YCbCr_to_RGB", bench_YCbCr_to_RGB, 1 },
+		{ "RGB_to_YCbCr", bench_RGB_to_YCbCr, 1 },
+		{ "message_decode", bench_message_decode, 0 },
+		{ "message_encode", bench_message_encode, 0 }
+	};
+	int num_stages = sizeof(stages) / sizeof(stages[0]);
+
+	while (*pindex < argc)
+	{
+		if (strcmp("--csv", argv[*pindex]) == 0)
+		{
+			csv = 1;
+		}
+		else if (*pindex + 1 < argc && strcmp("-n", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			iterations = atoi(argv[*pindex]);
+		}
+		else if (*pindex + 1 < argc && strcmp("-w", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			width = atoi(argv[*pindex]);
+		}
+		else if (*pindex + 1 < argc && strcmp("-h", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			height = atoi(argv[*pindex]);
+		}
+		else if (*pindex + 1 < argc && strcmp("-p", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			pattern = argv[*pindex];
+		}
+		else if (*pindex + 1 < argc && strcmp("-f", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			filename = argv[*pindex];
+		}
+		else if (*pindex + 1 < argc && strcmp("-s", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			only = argv[*pindex];
+		}
+		else if (*pindex + 1 < argc && strcmp("-t", argv[*pindex]) == 0)
+		{
+			*pindex = *pindex + 1;
+			num_threads = atoi(argv[*pindex]);
+		}
+		else
+		{
+			bench_usage(argv[0]);
+			return 1;
+		}
+
+		*pindex = *pindex + 1;
+	}
+
+	if (iterations < 1 || width < 1 || height < 1)
+	{
+		bench_usage(argv[0]);
+		return 1;
+	}
+
+	num_impls = bench_get_impls(impls);
+
+	if (filename != NULL)
+	{
+		num_patterns = 1;
+	}
+	else if (strcmp(pattern, "all") == 0)
+	{
+		num_patterns = sizeof(patterns) / sizeof(patterns[0]);
+	}
+	else
+	{
+		patterns[0] = pattern;
+		num_patterns = 1;
+	}
+
+	if (csv)
+		printf("stage,impl,input,tiles,iterations,ns_per_tile,mb_per_s,p50_ns,p90_ns,p99_ns,min_ns\n");
+	else
+		printf("%-20s %-7s %-10s %6s %10s %9s %10s %10s %10s\n",
+			"stage", "impl", "input", "tiles", "ns/tile", "MB/s", "p50", "p90", "p99");
+
+	message_buffer_size = width * height * 8 + 1024;
+	message_buffer = (uint8 *) malloc(message_buffer_size);
+
+	for (k = 0; k < num_patterns; k++)
+	{
+		if (filename != NULL)
+		{
+			if (!bench_tileset_recorded(&set, filename))
+				return 1;
+		}
+		else
+		{
+			bench_tileset_synthetic(&set, patterns[k], width, height);
+		}
+
+		if (set.num_tiles == 0)
+		{
+			bench_tileset_free(&set);
+			continue;
+		}
+
+		for (i = 0; i < num_stages; i++)
+		{
+			if (only != NULL && strcmp(only, stages[i].name) != 0)
+				continue;
+
+			if (stages[i].func == bench_message_decode || stages[i].func == bench_message_encode)
+			{
+				/* the whole codec, with whatever the context picked for this CPU */
+				if (stages[i].func == bench_message_encode && set.frame == NULL)
+					continue;
+
+				message_context = rfx_context_new();
+				message_context->mode = RLGR3;
+				message_context->width = set.width;
+				message_context->height = set.height;
+				rfx_context_set_pixel_format(message_context, RFX_PIXEL_FORMAT_BGRA);
+				rfx_context_set_num_threads(message_context, num_threads);
+
+				bench_run(stages[i].func, &set, NULL, set.num_tiles, iterations, &result);
+				bench_print(csv, stages[i].name, "auto", &set, set.num_tiles, iterations, &result);
+
+				rfx_context_free(message_context);
+			}
+			else if (!stages[i].per_impl)
+			{
+				bench_run(stages[i].func, &set, &impls[0], set.num_tiles, iterations, &result);
+				bench_print(csv, stages[i].name, impls[0].name, &set, set.num_tiles, iterations, &result);
+			}
+			else
+			{
+				for (j = 0; j < num_impls; j++)
+				{
+					if (!bench_impl_supports(&impls[j], stages[i].func))
+						continue;
+
+					bench_run(stages[i].func, &set, &impls[j], set.num_tiles, iterations, &result);
+					bench_print(csv, stages[i].name, impls[j].name, &set, set.num_tiles, iterations, &result);
+				}
+			}
+		}
+
+		bench_tileset_free(&set);
+	}
+
+	free(message_buffer);
+
+	return 0;
+}
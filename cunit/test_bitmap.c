@@ -0,0 +1,704 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Bitmap Decompression Unit Tests
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <freerdp/freerdp.h>
+#include "frdp.h"
+#include <freerdp/utils/memory.h>
+#include <freerdp/utils/thread_pool.h>
+#include "stream.h"
+#include "rdp.h"
+#include "bitmap.h"
+#include "test_bitmap.h"
+
+#ifdef WITH_SSE
+#include "bitmap_sse2.h"
+#endif
+
+#ifdef WITH_AVX2
+#include "bitmap_avx2.h"
+#endif
+
+static uint32 seed = 1;
+
+static uint32
+test_rand(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) & 0xFFFFFF;
+}
+
+int init_bitmap_suite(void)
+{
+	return 0;
+}
+
+int clean_bitmap_suite(void)
+{
+	bitmap_init(True);
+
+	return 0;
+}
+
+int add_bitmap_suite(void)
+{
+	add_test_suite(bitmap);
+
+	add_test_function(bitmap_run);
+	add_test_function(bitmap_decompress);
+	add_test_function(bitmap_planar);
+	add_test_function(bitmap_updates);
+
+	return 0;
+}
+
+/* check a run kernel against a plain loop, for every pixel pair size, length and alignment */
+static void
+test_bitmap_run_func(void (* run)(uint8 * dst, uint8 * src, uint8 * pattern, int n))
+{
+	static const int periods[] = { 2, 4, 6 };
+	int i, k;
+	int n;
+	int align;
+	int period;
+	int failed = 0;
+	uint8 pattern[BITMAP_PATTERN_SIZE];
+	uint8 src[400];
+	uint8 dst[400];
+	uint8 expected[400];
+
+	for (i = 0; i < sizeof(src); i++)
+		src[i] = test_rand() & 0xFF;
+
+	for (k = 0; k < 3; k++)
+	{
+		period = periods[k];
+		for (i = 0; i < BITMAP_PATTERN_SIZE; i++)
+			pattern[i] = (i % period) * 37 + period;
+
+		for (n = 0; n <= 300; n++)
+		{
+			for (align = 0; align < 4; align++)
+			{
+				memset(dst, 0xCC, sizeof(dst));
+				memset(expected, 0xCC, sizeof(expected));
+				for (i = 0; i < n; i++)
+					expected[align + i] = pattern[i % period];
+				run(dst + align, NULL, pattern, n);
+				if (memcmp(dst, expected, sizeof(dst)) != 0)
+					failed++;
+
+				memset(dst, 0xCC, sizeof(dst));
+				for (i = 0; i < n; i++)
+					expected[align + i] = src[i + 3 - align] ^ pattern[i % period];
+				run(dst + align, src + 3 - align, pattern, n);
+				if (memcmp(dst, expected, sizeof(dst)) != 0)
+					failed++;
+			}
+		}
+	}
+
+	CU_ASSERT(failed == 0);
+}
+
+void test_bitmap_run(void)
+{
+#ifdef WITH_SSE
+	test_bitmap_run_func(bitmap_run_SSE2);
+#endif
+#ifdef WITH_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		test_bitmap_run_func(bitmap_run_AVX2);
+#endif
+}
+
+static uint8 *
+test_put_count(uint8 * p, int opcode, int count)
+{
+	int isfillormix = (opcode == 2) || (opcode == 7);
+	int lite = (opcode >= 6);
+	int max_short = lite ? 15 : 31;
+	int offset = lite ? 16 : 32;
+	int code = lite ? (opcode + 6) << 4 : opcode << 5;
+
+	if (isfillormix && (count % 8) == 0 && count / 8 <= max_short)
+	{
+		*p++ = code | (count / 8);
+	}
+	else if (isfillormix && count <= 256)
+	{
+		*p++ = code;
+		*p++ = count - 1;
+	}
+	else if (!isfillormix && count <= max_short)
+	{
+		*p++ = code | count;
+	}
+	else if (!isfillormix && count < offset + 256)
+	{
+		*p++ = code;
+		*p++ = count - offset;
+	}
+	else
+	{
+		/* mega mega */
+		*p++ = 0xF0 | opcode;
+		*p++ = count & 0xFF;
+		*p++ = count >> 8;
+	}
+
+	return p;
+}
+
+static uint8 *
+test_put_pixel(uint8 * p, int Bpp)
+{
+	int i;
+	uint8 c = (test_rand() % 4) * 0x55;
+
+	for (i = 0; i < Bpp; i++)
+		*p++ = c ^ (i * 0x0F);
+
+	return p;
+}
+
+/*
+   Generate an interleaved RLE stream for a width x height bitmap, biased to
+   the long runs a scrolled window gives, but with every opcode in every form.
+*/
+static int
+test_bitmap_stream(uint8 * stream, int width, int height, int Bpp)
+{
+	static const int opcodes[] = { 0, 0, 1, 1, 2, 3, 3, 4, 6, 7, 8, 8, 9, 10, 13, 14 };
+	uint8 * p = stream;
+	int remaining = width * height;
+	int opcode;
+	int count;
+	int pixels;
+	int i;
+
+	while (remaining > 0)
+	{
+		opcode = opcodes[test_rand() % 16];
+
+		if (test_rand() % 2)
+			count = 1 + test_rand() % (2 * width + 8);
+		else
+			count = 1 + test_rand() % 40;
+
+		if (opcode == 2 || opcode == 7)
+		{
+			if (test_rand() % 2)
+				count = (count + 7) & ~7;
+		}
+
+		pixels = (opcode == 8) ? count * 2 : count;
+		if (opcode == 9 || opcode == 10)
+			pixels = 8;
+		if (opcode == 13 || opcode == 14)
+			pixels = 1;
+
+		if (pixels > remaining)
+		{
+			if (opcode >= 9)
+				continue;
+			count = (opcode == 8) ? remaining / 2 : remaining;
+			if (count == 0)
+				continue;
+			pixels = (opcode == 8) ? count * 2 : count;
+		}
+
+		if (opcode >= 9)
+			*p++ = 0xF0 | opcode;
+		else
+			p = test_put_count(p, opcode, count);
+
+		switch (opcode)
+		{
+			case 2:
+			case 7:
+				if (opcode == 7)
+					p = test_put_pixel(p, Bpp);
+				for (i = 0; i < (count + 7) / 8; i++)
+					*p++ = test_rand() & 0xFF;
+				break;
+			case 3:
+			case 6:
+				p = test_put_pixel(p, Bpp);
+				break;
+			case 4:
+				for (i = 0; i < count * Bpp; i++)
+					*p++ = test_rand() & 0xFF;
+				break;
+			case 8:
+				p = test_put_pixel(p, Bpp);
+				p = test_put_pixel(p, Bpp);
+				break;
+		}
+
+		remaining -= pixels;
+	}
+
+	return (int) (p - stream);
+}
+
+/* decode generated streams with and without the run kernels, the output must not change */
+void test_bitmap_decompress(void)
+{
+	static const int widths[] = { 1, 7, 16, 37, 64, 300 };
+	uint8 * stream;
+	uint8 * expected;
+	uint8 * output;
+	int width, height;
+	int Bpp;
+	int size;
+	int n;
+	RD_BOOL status;
+	RD_BOOL expected_status;
+	int failed = 0;
+
+	stream = (uint8 *) malloc(300 * 64 * 3 * 4);
+	expected = (uint8 *) malloc(300 * 64 * 3);
+	output = (uint8 *) malloc(300 * 64 * 3);
+
+	for (n = 0; n < 600; n++)
+	{
+		width = widths[n % 6];
+		height = 1 + test_rand() % 64;
+		Bpp = 1 + (n / 6) % 3;
+		size = test_bitmap_stream(stream, width, height, Bpp);
+
+		memset(expected, 0xCC, 300 * 64 * 3);
+		memset(output, 0xCC, 300 * 64 * 3);
+
+		bitmap_init(False);
+		expected_status = bitmap_decompress(NULL, NULL, expected, width, height, stream, size, Bpp);
+		bitmap_init(True);
+		status = bitmap_decompress(NULL, NULL, output, width, height, stream, size, Bpp);
+
+		CU_ASSERT(expected_status == True);
+		if (status != expected_status || memcmp(output, expected, width * height * Bpp) != 0)
+			failed++;
+	}
+
+	CU_ASSERT(failed == 0);
+
+	free(stream);
+	free(expected);
+	free(output);
+}
+
+/* the planar decoder as it was before it went through plane buffers, the reference */
+static int
+test_process_plane(uint8 * in, int width, int height, uint8 * out, int size)
+{
+	int indexw;
+	int indexh;
+	int code;
+	int collen;
+	int replen;
+	int color;
+	int x;
+	int revcode;
+	uint8 * last_line;
+	uint8 * this_line;
+	uint8 * org_in;
+	uint8 * org_out;
+
+	org_in = in;
+	org_out = out;
+	last_line = 0;
+	indexh = 0;
+	while (indexh < height)
+	{
+		out = (org_out + width * height * 4) - ((indexh + 1) * width * 4);
+		color = 0;
+		this_line = out;
+		indexw = 0;
+		if (last_line == 0)
+		{
+			while (indexw < width)
+			{
+				code = *in++;
+				replen = code & 0xf;
+				collen = (code >> 4) & 0xf;
+				revcode = (replen << 4) | collen;
+				if ((revcode <= 47) && (revcode >= 16))
+				{
+					replen = revcode;
+					collen = 0;
+				}
+				while (collen > 0)
+				{
+					color = *in++;
+					*out = color;
+					out += 4;
+					indexw++;
+					collen--;
+				}
+				while (replen > 0)
+				{
+					*out = color;
+					out += 4;
+					indexw++;
+					replen--;
+				}
+			}
+		}
+		else
+		{
+			while (indexw < width)
+			{
+				code = *in++;
+				replen = code & 0xf;
+				collen = (code >> 4) & 0xf;
+				revcode = (replen << 4) | collen;
+				if ((revcode <= 47) && (revcode >= 16))
+				{
+					replen = revcode;
+					collen = 0;
+				}
+				while (collen > 0)
+				{
+					x = *in++;
+					if (x & 1)
+					{
+						x = x >> 1;
+						x = x + 1;
+						color = -x;
+					}
+					else
+					{
+						x = x >> 1;
+						color = x;
+					}
+					x = last_line[indexw * 4] + color;
+					*out = x;
+					out += 4;
+					indexw++;
+					collen--;
+				}
+				while (replen > 0)
+				{
+					x = last_line[indexw * 4] + color;
+					*out = x;
+					out += 4;
+					indexw++;
+					replen--;
+				}
+			}
+		}
+		indexh++;
+		last_line = this_line;
+	}
+	return (int) (in - org_in);
+}
+
+static RD_BOOL
+test_bitmap_decompress4(uint8 * output, int width, int height, uint8 * input, int size)
+{
+	int i;
+	int total_pro = 1;
+
+	if (*input++ != 0x10)
+		return False;
+
+	for (i = 3; i >= 0; i--)
+	{
+		int bytes_pro = test_process_plane(input, width, height, output + i, size - total_pro);
+		total_pro += bytes_pro;
+		input += bytes_pro;
+	}
+
+	return size == total_pro;
+}
+
+/* a planar stream with every kind of code, each line filled exactly */
+static int
+test_planar_stream(uint8 * stream, int width, int height)
+{
+	uint8 * p = stream;
+	int plane, y;
+	int remaining;
+	int collen, replen;
+	int i;
+
+	*p++ = 0x10;
+
+	for (plane = 0; plane < 4; plane++)
+	{
+		for (y = 0; y < height; y++)
+		{
+			for (remaining = width; remaining > 0; remaining -= collen + replen)
+			{
+				if (remaining >= 16 && test_rand() % 3 == 0)
+				{
+					/* a long run, 16 to 47 */
+					replen = 16 + test_rand() % MIN(32, remaining - 15);
+					collen = 0;
+					*p++ = ((replen & 0xF) << 4) | (replen >> 4);
+					continue;
+				}
+
+				do
+				{
+					collen = test_rand() % 16;
+					replen = test_rand() % 16;
+				}
+				while (replen == 1 || replen == 2 || collen + replen == 0 || collen + replen > remaining);
+
+				*p++ = (collen << 4) | replen;
+				for (i = 0; i < collen; i++)
+					*p++ = (test_rand() % 4 == 0) ? test_rand() & 0xFF : test_rand() % 6;
+			}
+		}
+	}
+
+	return (int) (p - stream);
+}
+
+/* planar bitmaps against the reference, with and without simd, and truncated;
+   every other one goes through a scratch that grows and is reused */
+void test_bitmap_planar(void)
+{
+	static const int widths[] = { 1, 5, 16, 31, 64, 100 };
+	BITMAP_SCRATCH * scratch;
+	BITMAP_SCRATCH * s;
+	uint8 * stream;
+	uint8 * expected;
+	uint8 * output;
+	int width, height;
+	int size;
+	int simd;
+	int n;
+	int failed = 0;
+
+	stream = (uint8 *) malloc(100 * 100 * 4 * 2 + 1);
+	expected = (uint8 *) malloc(100 * 100 * 4);
+	output = (uint8 *) malloc(100 * 100 * 4);
+	scratch = (BITMAP_SCRATCH *) bitmap_scratch_new();
+
+	for (n = 0; n < 300; n++)
+	{
+		s = (n & 1) ? scratch : NULL;
+		width = widths[n % 6];
+		height = 1 + test_rand() % 100;
+		size = test_planar_stream(stream, width, height);
+
+		memset(expected, 0xCC, width * height * 4);
+		CU_ASSERT(test_bitmap_decompress4(expected, width, height, stream, size) == True);
+
+		for (simd = 0; simd < 2; simd++)
+		{
+			bitmap_init(simd);
+			memset(output, 0xCC, width * height * 4);
+			if (bitmap_decompress(NULL, s, output, width, height, stream, size, 4) != True ||
+				memcmp(output, expected, width * height * 4) != 0)
+				failed++;
+
+			/* short of a byte, or of a whole plane */
+			if (bitmap_decompress(NULL, s, output, width, height, stream, size - 1, 4) != False)
+				failed++;
+			if (bitmap_decompress(NULL, s, output, width, height, stream, 1 + (size - 1) / 2, 4) != False)
+				failed++;
+		}
+	}
+
+	CU_ASSERT(failed == 0);
+	CU_ASSERT(scratch->size > 64 * 64 * 4 + BITMAP_PLANE_PAD);
+
+	bitmap_scratch_free(scratch);
+	free(stream);
+	free(expected);
+	free(output);
+}
+
+/* rects in the test update, 64x64 each side by side: far above BITMAP_PARALLEL_MIN */
+#define TEST_UPDATE_RECTS 20
+/* the rect whose stream overruns its bitmap, it must not be painted */
+#define TEST_UPDATE_BAD 9
+
+/* every ui_paint_bitmap call, its arguments followed by the pixels it got */
+struct _PAINT_LOG
+{
+	uint8 * data;
+	int size;
+	int calls;
+	int bad_painted;
+};
+typedef struct _PAINT_LOG PAINT_LOG;
+
+static PAINT_LOG * paint_log;
+static int update_Bpp[TEST_UPDATE_RECTS];
+
+static void
+test_ui_paint_bitmap(rdpInst * inst, int x, int y, int cx, int cy, int width, int height, uint8 * data)
+{
+	int args[6];
+	int size;
+
+	args[0] = x;
+	args[1] = y;
+	args[2] = cx;
+	args[3] = cy;
+	args[4] = width;
+	args[5] = height;
+	size = width * height * update_Bpp[x / 64];
+
+	paint_log->data = (uint8 *) realloc(paint_log->data, paint_log->size + sizeof(args) + size);
+	memcpy(paint_log->data + paint_log->size, args, sizeof(args));
+	memcpy(paint_log->data + paint_log->size + sizeof(args), data, size);
+	paint_log->size += sizeof(args) + size;
+	paint_log->calls++;
+
+	if (x == TEST_UPDATE_BAD * 64)
+		paint_log->bad_painted = 1;
+}
+
+/*
+   A bitmap update with raw rects, compressed rects with and without the
+   compression header, at 8, 16 and 24 bpp, and one rect in the middle that
+   fails to decode.
+*/
+static STREAM
+test_bitmap_update(void)
+{
+	STREAM s;
+	uint8 * data;
+	int compress;
+	int size;
+	int Bpp;
+	int i, k;
+
+	s = stream_new(TEST_UPDATE_RECTS * (64 * 64 * 3 * 4 + 32));
+	data = (uint8 *) malloc(64 * 64 * 3 * 4);
+
+	out_uint16_le(s, TEST_UPDATE_RECTS);
+
+	for (i = 0; i < TEST_UPDATE_RECTS; i++)
+	{
+		Bpp = 1 + i % 3;
+		update_Bpp[i] = Bpp;
+		compress = (i % 4 == 0) ? 0 : ((i % 4 == 1) ? 0x401 : 1);
+
+		if (i == TEST_UPDATE_BAD)
+		{
+			/* a fill running past the last line */
+			data[0] = 0xF0;
+			data[1] = (64 * 65) & 0xFF;
+			data[2] = (64 * 65) >> 8;
+			size = 3;
+		}
+		else if (compress)
+		{
+			size = test_bitmap_stream(data, 64, 64, Bpp);
+		}
+		else
+		{
+			size = 64 * 64 * Bpp;
+			for (k = 0; k < size; k++)
+				data[k] = test_rand() & 0xFF;
+		}
+
+		out_uint16_le(s, i * 64); /* left */
+		out_uint16_le(s, i % 3); /* top */
+		out_uint16_le(s, i * 64 + 63 - i % 5); /* right */
+		out_uint16_le(s, i % 3 + 63); /* bottom */
+		out_uint16_le(s, 64); /* width */
+		out_uint16_le(s, 64); /* height */
+		out_uint16_le(s, Bpp * 8); /* bpp */
+		out_uint16_le(s, compress);
+		out_uint16_le(s, (compress & 0x400) ? size : 0); /* bufsize */
+
+		if (compress && !(compress & 0x400))
+		{
+			out_uint16_le(s, 0); /* pad */
+			out_uint16_le(s, size);
+			out_uint16_le(s, 64 * Bpp); /* line_size */
+			out_uint16_le(s, 64 * 64 * Bpp); /* final_size */
+		}
+
+		out_uint8p(s, data, size);
+	}
+
+	s->end = s->p;
+	free(data);
+
+	return s;
+}
+
+static void
+test_bitmap_updates_run(STREAM s, int num_threads, PAINT_LOG * log)
+{
+	rdpInst inst;
+	rdpRdp * rdp;
+
+	memset(&inst, 0, sizeof(rdpInst));
+	inst.ui_paint_bitmap = test_ui_paint_bitmap;
+
+	rdp = (rdpRdp *) xmalloc(sizeof(rdpRdp));
+	memset(rdp, 0, sizeof(rdpRdp));
+	rdp->inst = &inst;
+	rdp->num_threads = num_threads;
+
+	memset(log, 0, sizeof(PAINT_LOG));
+	paint_log = log;
+	s->p = s->data;
+	process_bitmap_updates(rdp, s);
+
+	/* the update was big enough for the workers to take it */
+	CU_ASSERT((rdp->thread_pool != NULL) == (num_threads > 1));
+	CU_ASSERT(s->p == s->end);
+
+	thread_pool_free(rdp->thread_pool);
+	xfree(rdp->bitmap_rects);
+	xfree(rdp->buffer);
+	xfree(rdp);
+}
+
+/* the rects of an update decoded on the workers are painted as decoding them in turn does */
+void test_bitmap_updates(void)
+{
+	static const int threads[] = { 2, 4 };
+	PAINT_LOG expected;
+	PAINT_LOG log;
+	STREAM s;
+	int i;
+
+	s = test_bitmap_update();
+
+	test_bitmap_updates_run(s, 1, &expected);
+	CU_ASSERT(expected.calls == TEST_UPDATE_RECTS - 1);
+	CU_ASSERT(expected.bad_painted == 0);
+
+	for (i = 0; i < 2; i++)
+	{
+		test_bitmap_updates_run(s, threads[i], &log);
+		CU_ASSERT(log.calls == expected.calls);
+		CU_ASSERT(log.bad_painted == 0);
+		CU_ASSERT(log.size == expected.size && memcmp(log.data, expected.data, log.size) == 0);
+		free(log.data);
+	}
+
+	free(expected.data);
+	stream_delete(s);
+}
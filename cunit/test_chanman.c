@@ -0,0 +1,414 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Channel Manager Unit Tests
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <freerdp/freerdp.h>
+#include <freerdp/chanman.h>
+#include <freerdp/vchan.h>
+#include "chan_queue.h"
+#include "dvcman.h"
+#include "test_chanman.h"
+
+#define TEST_NUM_PRODUCERS	6
+#define TEST_NUM_ITEMS		200000
+
+static struct chan_queue queue;
+
+int init_chanman_suite(void)
+{
+	return 0;
+}
+
+int clean_chanman_suite(void)
+{
+	return 0;
+}
+
+int add_chanman_suite(void)
+{
+	add_test_suite(chanman);
+
+	add_test_function(chanman_queue);
+	add_test_function(chanman_queue_stress);
+	add_test_function(chanman_static_ids);
+	add_test_function(chanman_dvc_ids);
+
+	return 0;
+}
+
+void test_chanman_queue(void)
+{
+	struct chan_queue_item item;
+	int failed = 0;
+	int i;
+
+	chan_queue_init(&queue);
+	CU_ASSERT(chan_queue_pending(&queue) == 0);
+	CU_ASSERT(chan_queue_pop(&queue, &item) == 0);
+
+	/* fill it, one more does not fit */
+	for (i = 0; i < CHAN_QUEUE_SIZE; i++)
+	{
+		item.index = i;
+		item.data = &queue;
+		item.data_length = i * 10;
+		item.user_data = NULL;
+		if (!chan_queue_push(&queue, &item))
+			failed++;
+	}
+	CU_ASSERT(failed == 0);
+	CU_ASSERT(chan_queue_push(&queue, &item) == 0);
+
+	/* comes out in order, and the slots can be used again on the next lap */
+	for (i = 0; i < CHAN_QUEUE_SIZE * 3; i++)
+	{
+		if (!chan_queue_pending(&queue) || !chan_queue_pop(&queue, &item))
+		{
+			failed++;
+			break;
+		}
+		if ((item.index != i) || (item.data_length != i * 10) || (item.data != &queue))
+			failed++;
+		item.index = i + CHAN_QUEUE_SIZE;
+		item.data_length = (i + CHAN_QUEUE_SIZE) * 10;
+		if (!chan_queue_push(&queue, &item))
+			failed++;
+	}
+	CU_ASSERT(failed == 0);
+}
+
+/* a plugin thread writing as fast as it can, and waiting while the queue
+   is full the way MyVirtualChannelWrite does on its semaphore */
+static void *
+test_producer_thread(void * arg)
+{
+	struct chan_queue_item item;
+	long producer = (long) arg;
+	int i;
+
+	item.index = (int) producer;
+	item.user_data = NULL;
+	for (i = 0; i < TEST_NUM_ITEMS; i++)
+	{
+		item.data = NULL;
+		item.data_length = i;
+		while (!chan_queue_push(&queue, &item))
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+void test_chanman_queue_stress(void)
+{
+	pthread_t threads[TEST_NUM_PRODUCERS];
+	uint32 next[TEST_NUM_PRODUCERS];
+	struct chan_queue_item item;
+	long total;
+	long i;
+	int failed = 0;
+
+	chan_queue_init(&queue);
+	memset(next, 0, sizeof(next));
+
+	for (i = 0; i < TEST_NUM_PRODUCERS; i++)
+		pthread_create(&threads[i], NULL, test_producer_thread, (void *) i);
+
+	/* the main thread drains everything that is queued on every wake up;
+	   each producer's items have to come out complete and in order */
+	total = 0;
+	while (total < TEST_NUM_PRODUCERS * TEST_NUM_ITEMS)
+	{
+		if (!chan_queue_pop(&queue, &item))
+		{
+			sched_yield();
+			continue;
+		}
+		if ((item.index < 0) || (item.index >= TEST_NUM_PRODUCERS) ||
+			(item.data_length != next[item.index]))
+		{
+			failed++;
+			break;
+		}
+		next[item.index]++;
+		total++;
+	}
+
+	for (i = 0; i < TEST_NUM_PRODUCERS; i++)
+		pthread_join(threads[i], NULL);
+
+	CU_ASSERT(failed == 0);
+	CU_ASSERT(total == TEST_NUM_PRODUCERS * TEST_NUM_ITEMS);
+	CU_ASSERT(chan_queue_pending(&queue) == 0);
+}
+
+/* a plugin asking for TEST_NUM_STATIC static channels, and which of them data reaches */
+#define TEST_NUM_STATIC 4
+
+static CHANNEL_ENTRY_POINTS_EX test_entry_points;
+static uint32 test_open_handles[TEST_NUM_STATIC];
+static int test_static_received;
+
+static void VCHAN_CC
+test_static_open_event(uint32 openHandle, uint32 event, void * pData, uint32 dataLength,
+	uint32 totalLength, uint32 dataFlags)
+{
+	int i;
+
+	for (i = 0; i < TEST_NUM_STATIC; i++)
+	{
+		if (test_open_handles[i] == openHandle)
+			test_static_received = i + 1;
+	}
+}
+
+static void VCHAN_CC
+test_static_init_event(void * pInitHandle, uint32 event, void * pData, uint32 dataLength)
+{
+	char name[CHANNEL_NAME_LEN + 1];
+	int i;
+
+	if (event != CHANNEL_EVENT_CONNECTED)
+		return;
+
+	for (i = 0; i < TEST_NUM_STATIC; i++)
+	{
+		snprintf(name, sizeof(name), "test%d", i);
+		test_entry_points.pVirtualChannelOpen(pInitHandle, &test_open_handles[i], name,
+			test_static_open_event);
+	}
+}
+
+static int VCHAN_CC
+test_static_entry(PCHANNEL_ENTRY_POINTS pEntryPoints)
+{
+	CHANNEL_DEF defs[TEST_NUM_STATIC];
+	void * init_handle;
+	int i;
+
+	memcpy(&test_entry_points, pEntryPoints, sizeof(CHANNEL_ENTRY_POINTS_EX));
+	memset(defs, 0, sizeof(defs));
+	for (i = 0; i < TEST_NUM_STATIC; i++)
+		snprintf(defs[i].name, sizeof(defs[i].name), "test%d", i);
+
+	return test_entry_points.pVirtualChannelInit(&init_handle, defs, TEST_NUM_STATIC,
+		VIRTUAL_CHANNEL_VERSION_WIN2000, test_static_init_event) == CHANNEL_RC_OK;
+}
+
+/* the number of the channel data for chan_id reaches, 0 for none */
+static int
+test_static_route(rdpInst * inst, int chan_id)
+{
+	char data = 0;
+
+	test_static_received = 0;
+	if (freerdp_chanman_data(inst, chan_id, &data, 1, CHANNEL_FLAG_FIRST | CHANNEL_FLAG_LAST, 1) != 0)
+		return 0;
+
+	return test_static_received;
+}
+
+void test_chanman_static_ids(void)
+{
+	static const int in_sequence[TEST_NUM_STATIC] = { 1004, 1005, 1006, 1007 };
+	/* below the first id and beyond the table, only the scan finds these */
+	static const int out_of_sequence[TEST_NUM_STATIC] = { 1007, 1003, 1007 + 100, 1002 };
+	rdpChanMan * chan_man;
+	rdpSet * settings;
+	rdpInst inst;
+	int failed = 0;
+	int i;
+
+	freerdp_chanman_init();
+	chan_man = freerdp_chanman_new();
+
+	settings = (rdpSet *) malloc(sizeof(rdpSet));
+	memset(settings, 0, sizeof(rdpSet));
+	strcpy(settings->server, "test");
+	memset(&inst, 0, sizeof(rdpInst));
+	inst.settings = settings;
+	inst.core_vchannels_number = 1;
+	inst.core_vchannels[0] = test_static_entry;
+
+	freerdp_chanman_pre_connect(chan_man, &inst);
+	CU_ASSERT(settings->num_channels == TEST_NUM_STATIC);
+
+	/* the ids the server hands out in sequence */
+	for (i = 0; i < TEST_NUM_STATIC; i++)
+		settings->channels[i].chan_id = in_sequence[i];
+	freerdp_chanman_post_connect(chan_man, &inst);
+
+	for (i = 0; i < TEST_NUM_STATIC; i++)
+	{
+		if (test_static_route(&inst, in_sequence[i]) != i + 1)
+			failed++;
+	}
+	CU_ASSERT(failed == 0);
+	CU_ASSERT(test_static_route(&inst, 1003) == 0);
+	CU_ASSERT(test_static_route(&inst, 1008) == 0);
+
+	/* connected again with ids out of sequence, none of the old ones is left */
+	for (i = 0; i < TEST_NUM_STATIC; i++)
+		settings->channels[i].chan_id = out_of_sequence[i];
+	freerdp_chanman_post_connect(chan_man, &inst);
+
+	for (i = 0; i < TEST_NUM_STATIC; i++)
+	{
+		if (test_static_route(&inst, out_of_sequence[i]) != i + 1)
+			failed++;
+	}
+	CU_ASSERT(failed == 0);
+	CU_ASSERT(test_static_route(&inst, 1004) == 0);
+	CU_ASSERT(test_static_route(&inst, 1005) == 0);
+	CU_ASSERT(test_static_route(&inst, 1008) == 0);
+
+	freerdp_chanman_free(chan_man);
+	freerdp_chanman_uninit();
+	free(settings);
+}
+
+/* dvcman calls back into the drdynvc plugin, which is not linked in */
+int
+drdynvc_write_data(drdynvcPlugin * plugin, uint32 ChannelId, char * data, uint32 data_size)
+{
+	return 0;
+}
+
+int
+drdynvc_push_event(drdynvcPlugin * plugin, RD_EVENT * event)
+{
+	return 0;
+}
+
+/* a dynamic channel the test listener accepted, numbered in order of creation */
+struct _TEST_DVC
+{
+	IWTSVirtualChannelCallback iface;
+	int number;
+};
+typedef struct _TEST_DVC TEST_DVC;
+
+static int test_dvc_created;
+static int test_dvc_open;
+static int test_dvc_received;
+static int test_dvc_closed;
+
+static int
+test_dvc_on_data_received(IWTSVirtualChannelCallback * pChannelCallback, uint32 cbSize, char * pBuffer)
+{
+	test_dvc_received = ((TEST_DVC *) pChannelCallback)->number;
+	return 0;
+}
+
+static int
+test_dvc_on_close(IWTSVirtualChannelCallback * pChannelCallback)
+{
+	test_dvc_closed = ((TEST_DVC *) pChannelCallback)->number;
+	test_dvc_open--;
+	free(pChannelCallback);
+	return 0;
+}
+
+static int
+test_dvc_on_new_channel(IWTSListenerCallback * pListenerCallback, IWTSVirtualChannel * pChannel,
+	char * Data, int * pbAccept, IWTSVirtualChannelCallback ** ppCallback)
+{
+	TEST_DVC * dvc;
+
+	dvc = (TEST_DVC *) malloc(sizeof(TEST_DVC));
+	dvc->iface.OnDataReceived = test_dvc_on_data_received;
+	dvc->iface.OnClose = test_dvc_on_close;
+	dvc->number = ++test_dvc_created;
+	test_dvc_open++;
+	*ppCallback = (IWTSVirtualChannelCallback *) dvc;
+
+	return 0;
+}
+
+/* the number of the channel data for ChannelId reaches, 0 for none */
+static int
+test_dvc_route(IWTSVirtualChannelManager * mgr, uint32 ChannelId)
+{
+	char data = 0;
+
+	test_dvc_received = 0;
+	if (dvcman_receive_channel_data(mgr, ChannelId, &data, 1) != 0)
+		return 0;
+
+	return test_dvc_received;
+}
+
+void test_chanman_dvc_ids(void)
+{
+	IWTSVirtualChannelManager * mgr;
+	IWTSListenerCallback listener;
+
+	test_dvc_created = 0;
+	test_dvc_open = 0;
+	listener.OnNewChannelConnection = test_dvc_on_new_channel;
+
+	mgr = dvcman_new(NULL);
+	CU_ASSERT(mgr->CreateListener(mgr, "TEST", 0, &listener, NULL) == 0);
+
+	/* 5, 5 + 64 and 5 + 128 share a hash chain */
+	CU_ASSERT(dvcman_create_channel(mgr, 5, "TEST") == 0);
+	CU_ASSERT(dvcman_create_channel(mgr, 5 + 64, "TEST") == 0);
+	CU_ASSERT(dvcman_create_channel(mgr, 5 + 128, "TEST") == 0);
+	CU_ASSERT(dvcman_create_channel(mgr, 6, "TEST") == 0);
+	CU_ASSERT(test_dvc_route(mgr, 5) == 1);
+	CU_ASSERT(test_dvc_route(mgr, 5 + 64) == 2);
+	CU_ASSERT(test_dvc_route(mgr, 5 + 128) == 3);
+	CU_ASSERT(test_dvc_route(mgr, 6) == 4);
+	CU_ASSERT(test_dvc_route(mgr, 5 + 192) == 0);
+
+	/* closed from the middle of the chain, then from its head */
+	CU_ASSERT(dvcman_close_channel(mgr, 5 + 64) == 0);
+	CU_ASSERT(test_dvc_closed == 2);
+	CU_ASSERT(test_dvc_route(mgr, 5 + 64) == 0);
+	CU_ASSERT(test_dvc_route(mgr, 5) == 1);
+	CU_ASSERT(test_dvc_route(mgr, 5 + 128) == 3);
+
+	CU_ASSERT(dvcman_close_channel(mgr, 5) == 0);
+	CU_ASSERT(test_dvc_closed == 1);
+	CU_ASSERT(test_dvc_route(mgr, 5) == 0);
+	CU_ASSERT(test_dvc_route(mgr, 5 + 128) == 3);
+	CU_ASSERT(dvcman_close_channel(mgr, 5) == 1);
+
+	/* the server hands the closed ids out again, to new channels */
+	CU_ASSERT(dvcman_create_channel(mgr, 5, "TEST") == 0);
+	CU_ASSERT(dvcman_create_channel(mgr, 5 + 64, "TEST") == 0);
+	CU_ASSERT(test_dvc_route(mgr, 5) == 5);
+	CU_ASSERT(test_dvc_route(mgr, 5 + 64) == 6);
+	CU_ASSERT(test_dvc_route(mgr, 5 + 128) == 3);
+
+	/* and from its tail */
+	CU_ASSERT(dvcman_close_channel(mgr, 5 + 128) == 0);
+	CU_ASSERT(test_dvc_closed == 3);
+	CU_ASSERT(test_dvc_route(mgr, 5 + 128) == 0);
+	CU_ASSERT(test_dvc_route(mgr, 5) == 5);
+	CU_ASSERT(test_dvc_route(mgr, 5 + 64) == 6);
+	CU_ASSERT(test_dvc_route(mgr, 6) == 4);
+
+	/* the ones left close with the manager */
+	CU_ASSERT(test_dvc_open == 3);
+	dvcman_free(mgr);
+	CU_ASSERT(test_dvc_open == 0);
+}
@@ -0,0 +1,202 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Event Loop Unit Tests
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <freerdp/utils/event_loop.h>
+#include "test_event_loop.h"
+
+/* more pipes than the 32 fds the old main loop could wait on */
+#define TEST_NUM_PIPES 40
+
+static EVENT_LOOP * loop;
+static int pipes[TEST_NUM_PIPES][2];
+static int calls[TEST_NUM_PIPES];
+
+int init_event_loop_suite(void)
+{
+	int index;
+
+	loop = event_loop_new();
+	if (loop == NULL)
+		return 1;
+
+	for (index = 0; index < TEST_NUM_PIPES; index++)
+	{
+		if (pipe(pipes[index]) != 0)
+			return 1;
+	}
+	return 0;
+}
+
+int clean_event_loop_suite(void)
+{
+	int index;
+
+	event_loop_free(loop);
+	for (index = 0; index < TEST_NUM_PIPES; index++)
+	{
+		close(pipes[index][0]);
+		close(pipes[index][1]);
+	}
+	return 0;
+}
+
+int add_event_loop_suite(void)
+{
+	add_test_suite(event_loop);
+
+	add_test_function(event_loop_dispatch);
+	add_test_function(event_loop_remove);
+	add_test_function(event_loop_many);
+
+	return 0;
+}
+
+/* counts the call and drains the byte that made the pipe readable */
+static int
+test_read_ready(int fd, int events, void * arg)
+{
+	char byte;
+
+	calls[(long) arg]++;
+	if (read(fd, &byte, 1) != 1)
+		return 1;
+	return 0;
+}
+
+/* also removes the source of the pipe after it, whether it is ready or not */
+static int
+test_remove_next(int fd, int events, void * arg)
+{
+	long index = (long) arg;
+
+	test_read_ready(fd, events, arg);
+	event_loop_remove(loop, pipes[index + 1][0]);
+	return 0;
+}
+
+static int
+test_stop(int fd, int events, void * arg)
+{
+	calls[(long) arg]++;
+	return 1;
+}
+
+static void
+test_signal(int index)
+{
+	CU_ASSERT(write(pipes[index][1], "x", 1) == 1);
+}
+
+void test_event_loop_dispatch(void)
+{
+	memset(calls, 0, sizeof(calls));
+	CU_ASSERT(event_loop_add(loop, pipes[0][0], EVENT_LOOP_READ, test_read_ready, (void *) 0L) == 0);
+	CU_ASSERT(event_loop_add(loop, pipes[1][0], EVENT_LOOP_READ, test_read_ready, (void *) 1L) == 0);
+
+	/* nothing ready, the timeout expires */
+	CU_ASSERT(event_loop_wait(loop, 0) == 0);
+
+	/* only the ready fd gets called back */
+	test_signal(1);
+	CU_ASSERT(event_loop_wait(loop, 1000) == 1);
+	CU_ASSERT(calls[0] == 0);
+	CU_ASSERT(calls[1] == 1);
+
+	/* both ready */
+	test_signal(0);
+	test_signal(1);
+	CU_ASSERT(event_loop_wait(loop, 1000) == 2);
+	CU_ASSERT(calls[0] == 1);
+	CU_ASSERT(calls[1] == 2);
+
+	/* adding again replaces the callback */
+	CU_ASSERT(event_loop_add(loop, pipes[0][0], EVENT_LOOP_READ, test_stop, (void *) 0L) == 0);
+	test_signal(0);
+	CU_ASSERT(event_loop_wait(loop, 1000) == -1);
+	CU_ASSERT(calls[0] == 2);
+	CU_ASSERT(event_loop_add(loop, pipes[0][0], EVENT_LOOP_READ, test_read_ready, (void *) 0L) == 0);
+	CU_ASSERT(event_loop_wait(loop, 1000) == 1);
+	CU_ASSERT(calls[0] == 3);
+
+	CU_ASSERT(event_loop_remove(loop, pipes[0][0]) == 0);
+	CU_ASSERT(event_loop_remove(loop, pipes[1][0]) == 0);
+	CU_ASSERT(event_loop_remove(loop, pipes[1][0]) != 0);
+}
+
+void test_event_loop_remove(void)
+{
+	memset(calls, 0, sizeof(calls));
+	CU_ASSERT(event_loop_add(loop, pipes[0][0], EVENT_LOOP_READ, test_remove_next, (void *) 0L) == 0);
+	CU_ASSERT(event_loop_add(loop, pipes[1][0], EVENT_LOOP_READ, test_read_ready, (void *) 1L) == 0);
+
+	/* whichever of the two comes first, pipe 1 is not called back once
+	   pipe 0 removed it */
+	test_signal(0);
+	test_signal(1);
+	CU_ASSERT(event_loop_wait(loop, 1000) >= 1);
+	CU_ASSERT(calls[0] == 1);
+	if (calls[1] == 0)
+	{
+		/* still readable but no longer watched */
+		CU_ASSERT(event_loop_wait(loop, 0) == 0);
+		CU_ASSERT(calls[1] == 0);
+		test_read_ready(pipes[1][0], EVENT_LOOP_READ, (void *) 1L);
+	}
+
+	CU_ASSERT(event_loop_remove(loop, pipes[0][0]) == 0);
+	CU_ASSERT(event_loop_wait(loop, 0) == 0);
+}
+
+void test_event_loop_many(void)
+{
+	long index;
+	int total;
+
+	memset(calls, 0, sizeof(calls));
+	for (index = 0; index < TEST_NUM_PIPES; index++)
+	{
+		CU_ASSERT(event_loop_add(loop, pipes[index][0], EVENT_LOOP_READ,
+			test_read_ready, (void *) index) == 0);
+	}
+
+	for (index = 0; index < TEST_NUM_PIPES; index++)
+		test_signal(index);
+
+	/* more ready fds than one wait reports come out over a few waits */
+	total = 0;
+	while (total < TEST_NUM_PIPES)
+	{
+		int rv = event_loop_wait(loop, 1000);
+		CU_ASSERT(rv > 0);
+		if (rv <= 0)
+			break;
+		total += rv;
+	}
+	CU_ASSERT(total == TEST_NUM_PIPES);
+	for (index = 0; index < TEST_NUM_PIPES; index++)
+		CU_ASSERT(calls[index] == 1);
+
+	/* all drained */
+	CU_ASSERT(event_loop_wait(loop, 0) == 0);
+
+	for (index = 0; index < TEST_NUM_PIPES; index++)
+		CU_ASSERT(event_loop_remove(loop, pipes[index][0]) == 0);
+}
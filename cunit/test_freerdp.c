@@ -19,10 +19,16 @@
 
 #include "CUnit/Basic.h"
 
+#include "test_bitmap.h"
+#include "test_chanman.h"
 #include "test_color.h"
+#include "test_event_loop.h"
 #include "test_libgdi.h"
 #include "test_librfx.h"
+#include "test_mppc.h"
+#include "test_network.h"
 #include "test_ntlmssp.h"
+#include "test_wait_obj.h"
 #include "test_freerdp.h"
 
 void dump_data(unsigned char * p, int len, int width, char* name)
@@ -61,19 +67,37 @@ int main(int argc, char* argv[])
 
 	if (argc < *pindex + 1)
 	{
+		add_bitmap_suite();
+		add_chanman_suite();
 		add_color_suite();
+		add_event_loop_suite();
 		add_libgdi_suite();
 		add_librfx_suite();
+		add_mppc_suite();
+		add_network_suite();
 		add_ntlmssp_suite();
+		add_wait_obj_suite();
 	}
 	else
 	{
 		while (*pindex < argc)
 		{
-			if (strcmp("color", argv[*pindex]) == 0)
+			if (strcmp("bitmap", argv[*pindex]) == 0)
+			{
+				add_bitmap_suite();
+			}
+			else if (strcmp("chanman", argv[*pindex]) == 0)
+			{
+				add_chanman_suite();
+			}
+			else if (strcmp("color", argv[*pindex]) == 0)
 			{
 				add_color_suite();
 			}
+			else if (strcmp("event_loop", argv[*pindex]) == 0)
+			{
+				add_event_loop_suite();
+			}
 			else if (strcmp("libgdi", argv[*pindex]) == 0)
 			{
 				add_libgdi_suite();
@@ -82,10 +106,22 @@ int main(int argc, char* argv[])
 			{
 				add_librfx_suite();
 			}
+			else if (strcmp("mppc", argv[*pindex]) == 0)
+			{
+				add_mppc_suite();
+			}
+			else if (strcmp("network", argv[*pindex]) == 0)
+			{
+				add_network_suite();
+			}
 			else if (strcmp("ntlmssp", argv[*pindex]) == 0)
 			{
 				add_ntlmssp_suite();
 			}
+			else if (strcmp("wait_obj", argv[*pindex]) == 0)
+			{
+				add_wait_obj_suite();
+			}
 
 			*pindex = *pindex + 1;
 		}
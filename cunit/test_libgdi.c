@@ -36,6 +36,14 @@
 
 #include "test_libgdi.h"
 
+#ifdef WITH_SSE
+#include "gdi_sse2.h"
+#endif
+
+#ifdef WITH_AVX2
+#include "gdi_avx2.h"
+#endif
+
 int init_libgdi_suite(void)
 {
 	return 0;
@@ -70,8 +78,11 @@ int add_libgdi_suite(void)
 	add_test_function(gdi_BitBlt_32bpp);
 	add_test_function(gdi_BitBlt_16bpp);
 	add_test_function(gdi_BitBlt_8bpp);
+	add_test_function(gdi_BitBlt_rows);
+	add_test_function(gdi_copy_mem);
 	add_test_function(gdi_ClipCoords);
 	add_test_function(gdi_InvalidateRegion);
+	add_test_function(gdi_InvalidateRegion_damage);
 
 	return 0;
 }
@@ -2859,6 +2870,7 @@ void test_gdi_InvalidateRegion(void)
 	gdi_SetNullClipRgn(hdc);
 
 	hdc->hwnd = (HGDI_WND) malloc(sizeof(GDI_WND));
+	memset(hdc->hwnd, 0, sizeof(GDI_WND));
 	hdc->hwnd->invalid = gdi_CreateRectRgn(0, 0, 0, 0);
 	hdc->hwnd->invalid->null = 1;
 	invalid = hdc->hwnd->invalid;
@@ -2980,3 +2992,377 @@ void test_gdi_InvalidateRegion(void)
 	gdi_InvalidateRegion(hdc, rgn1->x, rgn1->y, rgn1->w, rgn1->h);
 	CU_ASSERT(gdi_EqualRgn(invalid, rgn2) == 1);
 }
+
+static int test_damage_overlap(HGDI_RGN rgn1, HGDI_RGN rgn2)
+{
+	return (rgn1->x < rgn2->x + rgn2->w && rgn2->x < rgn1->x + rgn1->w &&
+		rgn1->y < rgn2->y + rgn2->h && rgn2->y < rgn1->y + rgn1->h);
+}
+
+static int test_damage_find(HGDI_WND hwnd, HGDI_RGN rgn)
+{
+	int i;
+
+	for (i = 0; i < hwnd->ninvalid; i++)
+	{
+		if (gdi_EqualRgn(&hwnd->cinvalid[i], rgn))
+			return 1;
+	}
+
+	return 0;
+}
+
+void test_gdi_InvalidateRegion_damage(void)
+{
+	int i, j;
+	int covered;
+	HGDI_DC hdc;
+	HGDI_RGN rgn;
+	HGDI_WND hwnd;
+	HGDI_BITMAP bmp;
+
+	hdc = gdi_GetDC();
+	hdc->bytesPerPixel = 4;
+	hdc->bitsPerPixel = 32;
+	bmp = gdi_CreateBitmap(1024, 768, 4, NULL);
+	gdi_SelectObject(hdc, (HGDIOBJECT) bmp);
+	gdi_SetNullClipRgn(hdc);
+
+	hwnd = (HGDI_WND) malloc(sizeof(GDI_WND));
+	hwnd->invalid = gdi_CreateRectRgn(0, 0, 0, 0);
+	hwnd->invalid->null = 1;
+	hwnd->count = GDI_MAX_INVALID;
+	hwnd->cinvalid = (HGDI_RGN) malloc(sizeof(GDI_RGN) * GDI_MAX_INVALID);
+	hwnd->ninvalid = 0;
+	hdc->hwnd = hwnd;
+
+	rgn = gdi_CreateRectRgn(0, 0, 0, 0);
+	rgn->null = 0;
+
+	/* opposite corners stay apart */
+	gdi_InvalidateRegion(hdc, 0, 0, 10, 10);
+	gdi_InvalidateRegion(hdc, 1000, 750, 10, 10);
+	CU_ASSERT(hwnd->ninvalid == 2);
+	gdi_SetRgn(rgn, 0, 0, 10, 10);
+	CU_ASSERT(test_damage_find(hwnd, rgn) == 1);
+	gdi_SetRgn(rgn, 1000, 750, 10, 10);
+	CU_ASSERT(test_damage_find(hwnd, rgn) == 1);
+
+	/* overlapping */
+	gdi_InvalidateRegion(hdc, 5, 5, 10, 10);
+	CU_ASSERT(hwnd->ninvalid == 2);
+	gdi_SetRgn(rgn, 0, 0, 15, 15);
+	CU_ASSERT(test_damage_find(hwnd, rgn) == 1);
+
+	/* inside */
+	gdi_InvalidateRegion(hdc, 1, 1, 2, 2);
+	CU_ASSERT(hwnd->ninvalid == 2);
+	CU_ASSERT(test_damage_find(hwnd, rgn) == 1);
+
+	/* adjacent strip */
+	gdi_InvalidateRegion(hdc, 0, 15, 15, 5);
+	CU_ASSERT(hwnd->ninvalid == 2);
+	gdi_SetRgn(rgn, 0, 0, 15, 20);
+	CU_ASSERT(test_damage_find(hwnd, rgn) == 1);
+
+	/* clipped to the bitmap */
+	gdi_InvalidateRegion(hdc, 1020, 760, 10, 10);
+	CU_ASSERT(hwnd->ninvalid == 3);
+	gdi_SetRgn(rgn, 1020, 760, 4, 8);
+	CU_ASSERT(test_damage_find(hwnd, rgn) == 1);
+
+	/* more rects than the list holds */
+	hwnd->ninvalid = 0;
+	for (i = 0; i < GDI_MAX_INVALID + 8; i++)
+		gdi_InvalidateRegion(hdc, (i % 16) * 60, (i / 16) * 200, 4, 4);
+
+	CU_ASSERT(hwnd->ninvalid <= GDI_MAX_INVALID);
+
+	for (i = 0; i < hwnd->ninvalid; i++)
+	{
+		for (j = i + 1; j < hwnd->ninvalid; j++)
+			CU_ASSERT(test_damage_overlap(&hwnd->cinvalid[i], &hwnd->cinvalid[j]) == 0);
+	}
+
+	for (i = 0; i < GDI_MAX_INVALID + 8; i++)
+	{
+		gdi_SetRgn(rgn, (i % 16) * 60, (i / 16) * 200, 4, 4);
+		covered = 0;
+
+		for (j = 0; j < hwnd->ninvalid; j++)
+		{
+			if (rgn->x >= hwnd->cinvalid[j].x && rgn->y >= hwnd->cinvalid[j].y &&
+				rgn->x + rgn->w <= hwnd->cinvalid[j].x + hwnd->cinvalid[j].w &&
+				rgn->y + rgn->h <= hwnd->cinvalid[j].y + hwnd->cinvalid[j].h)
+				covered = 1;
+		}
+
+		CU_ASSERT(covered == 1);
+	}
+}
+
+static uint32 test_rows_seed = 1;
+
+static uint8
+test_rows_rand(void)
+{
+	test_rows_seed = test_rows_seed * 1103515245 + 12345;
+	return (test_rows_seed >> 16) & 0xFF;
+}
+
+/* blit with the given kernels, or with the plain loops when funcs is NULL */
+static void test_rows_blit(GDI_ROP_FUNCS* funcs, HGDI_DC hdcDst, HGDI_BITMAP hBmpDst, uint8* original,
+	int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop)
+{
+	if (funcs != NULL)
+		gdi_rop_funcs = *funcs;
+	else
+		memset(&gdi_rop_funcs, 0, sizeof(GDI_ROP_FUNCS));
+
+	memcpy(hBmpDst->data, original, hBmpDst->width * hBmpDst->height * hdcDst->bytesPerPixel);
+	gdi_SelectObject(hdcDst, (HGDIOBJECT) hBmpDst);
+
+	if (rop == GDI_PATCOPY || rop == GDI_PATINVERT)
+		gdi_PatBlt(hdcDst, nXDest, nYDest, nWidth, nHeight, rop);
+	else
+		gdi_BitBlt(hdcDst, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc, rop);
+
+	memset(&gdi_rop_funcs, 0, sizeof(GDI_ROP_FUNCS));
+}
+
+/* the row kernels must give exactly what the plain loops give, for every width and offset */
+static void test_gdi_BitBlt_rows_func(GDI_ROP_FUNCS* funcs, int bitsPerPixel)
+{
+	static const int rops[] =
+	{
+		GDI_NOTSRCCOPY, GDI_DSTINVERT, GDI_SRCERASE, GDI_NOTSRCERASE, GDI_SRCINVERT,
+		GDI_SRCAND, GDI_SRCPAINT, GDI_DSna, GDI_MERGEPAINT, GDI_PATCOPY, GDI_PATINVERT
+	};
+	int i, k;
+	int x, width;
+	int size;
+	int failed = 0;
+	uint8* original;
+	HGDI_DC hdcSrc;
+	HGDI_DC hdcDst;
+	HGDI_BRUSH hBrush;
+	HGDI_BITMAP hBmpSrc;
+	HGDI_BITMAP hBmpExpected;
+	HGDI_BITMAP hBmpActual;
+
+	hdcSrc = gdi_GetDC();
+	hdcSrc->bytesPerPixel = bitsPerPixel / 8;
+	hdcSrc->bitsPerPixel = bitsPerPixel;
+
+	hdcDst = gdi_GetDC();
+	hdcDst->bytesPerPixel = bitsPerPixel / 8;
+	hdcDst->bitsPerPixel = bitsPerPixel;
+	hdcDst->invert = 0;
+	hdcDst->rgb555 = 0;
+
+	size = 80 * 8 * hdcDst->bytesPerPixel;
+	original = (uint8*) malloc(size);
+
+	hBmpSrc = gdi_CreateBitmap(80, 8, bitsPerPixel, (uint8*) malloc(size));
+	hBmpExpected = gdi_CreateBitmap(80, 8, bitsPerPixel, (uint8*) malloc(size));
+	hBmpActual = gdi_CreateBitmap(80, 8, bitsPerPixel, (uint8*) malloc(size));
+
+	for (i = 0; i < size; i++)
+	{
+		hBmpSrc->data[i] = test_rows_rand();
+		original[i] = test_rows_rand();
+	}
+
+	gdi_SelectObject(hdcSrc, (HGDIOBJECT) hBmpSrc);
+	gdi_SetNullClipRgn(hdcSrc);
+	gdi_SetNullClipRgn(hdcDst);
+
+	hBrush = gdi_CreateSolidBrush(0xFF123456);
+	hdcDst->brush = hBrush;
+
+	for (k = 0; k < sizeof(rops) / sizeof(rops[0]); k++)
+	{
+		for (width = 1; width <= 72; width++)
+		{
+			for (x = 0; x < 4; x++)
+			{
+				test_rows_blit(NULL, hdcDst, hBmpExpected, original, x, 1, width, 6, hdcSrc, 3 - x, 2, rops[k]);
+				test_rows_blit(funcs, hdcDst, hBmpActual, original, x, 1, width, 6, hdcSrc, 3 - x, 2, rops[k]);
+
+				if (memcmp(hBmpExpected->data, hBmpActual->data, size) != 0)
+					failed++;
+			}
+		}
+
+		/* within one bitmap, overlapping or not */
+		for (x = 0; x < 8; x++)
+		{
+			gdi_SelectObject(hdcSrc, (HGDIOBJECT) hBmpExpected);
+			test_rows_blit(NULL, hdcDst, hBmpExpected, original, x, x / 4, 70, 4, hdcSrc, 2, 1, rops[k]);
+			gdi_SelectObject(hdcSrc, (HGDIOBJECT) hBmpActual);
+			test_rows_blit(funcs, hdcDst, hBmpActual, original, x, x / 4, 70, 4, hdcSrc, 2, 1, rops[k]);
+
+			if (memcmp(hBmpExpected->data, hBmpActual->data, size) != 0)
+				failed++;
+		}
+
+		gdi_SelectObject(hdcSrc, (HGDIOBJECT) hBmpSrc);
+	}
+
+	CU_ASSERT(failed == 0);
+
+	hdcDst->brush = NULL;
+	gdi_DeleteObject((HGDIOBJECT) hBrush);
+	gdi_DeleteObject((HGDIOBJECT) hBmpSrc);
+	gdi_DeleteObject((HGDIOBJECT) hBmpExpected);
+	gdi_DeleteObject((HGDIOBJECT) hBmpActual);
+	free(original);
+}
+
+void test_gdi_BitBlt_rows(void)
+{
+#ifdef WITH_SSE
+	GDI_ROP_FUNCS funcs;
+
+	memset(&funcs, 0, sizeof(GDI_ROP_FUNCS));
+	gdi_init_rop_SSE2(&funcs);
+	test_gdi_BitBlt_rows_func(&funcs, 32);
+	test_gdi_BitBlt_rows_func(&funcs, 16);
+#endif
+#ifdef WITH_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		memset(&funcs, 0, sizeof(GDI_ROP_FUNCS));
+		gdi_init_rop_AVX2(&funcs);
+		test_gdi_BitBlt_rows_func(&funcs, 32);
+		test_gdi_BitBlt_rows_func(&funcs, 16);
+	}
+#endif
+}
+
+/* gdi_copy_mem against memmove, both ways, for every length and misalignment up to a few vectors */
+static void test_gdi_copy_mem_func(GDI_ROP_FUNCS* funcs)
+{
+	int i, n;
+	int d, s;
+	int failed = 0;
+	uint8 buffer[512];
+	uint8 expected[512];
+
+	if (funcs != NULL)
+		gdi_rop_funcs = *funcs;
+	else
+		memset(&gdi_rop_funcs, 0, sizeof(GDI_ROP_FUNCS));
+
+	for (n = 0; n <= 300; n++)
+	{
+		for (d = 0; d < 40; d += 3)
+		{
+			for (s = 0; s < 40; s += 5)
+			{
+				for (i = 0; i < sizeof(buffer); i++)
+					buffer[i] = test_rows_rand();
+
+				memcpy(expected, buffer, sizeof(buffer));
+				memmove(expected + 100 + d, expected + 100 + s, n);
+				gdi_copy_mem(buffer + 100 + d, buffer + 100 + s, n);
+
+				if (memcmp(buffer, expected, sizeof(buffer)) != 0)
+					failed++;
+
+				if (d >= s)
+				{
+					memcpy(buffer, expected, sizeof(buffer));
+					memmove(expected + 100 + d, expected + 100 + s, n);
+					gdi_copy_memb(buffer + 100 + d, buffer + 100 + s, n);
+
+					if (memcmp(buffer, expected, sizeof(buffer)) != 0)
+						failed++;
+				}
+			}
+		}
+	}
+
+	memset(&gdi_rop_funcs, 0, sizeof(GDI_ROP_FUNCS));
+	CU_ASSERT(failed == 0);
+}
+
+/* scrolling by one pixel each way matches the same move done a row at a time */
+static void test_gdi_copy_mem_scroll(GDI_ROP_FUNCS* funcs)
+{
+	static const int moves[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+	int i, k, y;
+	int size;
+	int stride;
+	int failed = 0;
+	uint8* expected;
+	HGDI_DC hdc;
+	HGDI_BITMAP hBmp;
+
+	hdc = gdi_GetDC();
+	hdc->bytesPerPixel = 4;
+	hdc->bitsPerPixel = 32;
+
+	stride = 101 * 4;
+	size = stride * 30;
+	hBmp = gdi_CreateBitmap(101, 30, 32, (uint8*) malloc(size));
+	expected = (uint8*) malloc(size);
+	gdi_SelectObject(hdc, (HGDIOBJECT) hBmp);
+	gdi_SetNullClipRgn(hdc);
+
+	for (k = 0; k < 4; k++)
+	{
+		for (i = 0; i < size; i++)
+			hBmp->data[i] = expected[i] = test_rows_rand();
+
+		/* the 99x28 block at (1, 1) moves by moves[k] */
+		for (y = 0; y < 28; y++)
+		{
+			i = (moves[k][1] > 0) ? 27 - y : y;
+			memmove(expected + (1 + i + moves[k][1]) * stride + (1 + moves[k][0]) * 4,
+				expected + (1 + i) * stride + 4, 99 * 4);
+		}
+
+		if (funcs != NULL)
+			gdi_rop_funcs = *funcs;
+
+		gdi_BitBlt(hdc, 1 + moves[k][0], 1 + moves[k][1], 99, 28, hdc, 1, 1, GDI_SRCCOPY);
+		memset(&gdi_rop_funcs, 0, sizeof(GDI_ROP_FUNCS));
+
+		if (memcmp(hBmp->data, expected, size) != 0)
+			failed++;
+	}
+
+	CU_ASSERT(failed == 0);
+
+	gdi_DeleteObject((HGDIOBJECT) hBmp);
+	free(expected);
+}
+
+void test_gdi_copy_mem(void)
+{
+#ifdef WITH_SSE
+	GDI_ROP_FUNCS funcs;
+#endif
+
+	test_gdi_copy_mem_func(NULL);
+	test_gdi_copy_mem_scroll(NULL);
+
+#ifdef WITH_SSE
+	memset(&funcs, 0, sizeof(GDI_ROP_FUNCS));
+	gdi_init_rop_SSE2(&funcs);
+	test_gdi_copy_mem_func(&funcs);
+	test_gdi_copy_mem_scroll(&funcs);
+#endif
+#ifdef WITH_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		memset(&funcs, 0, sizeof(GDI_ROP_FUNCS));
+		gdi_init_rop_AVX2(&funcs);
+		test_gdi_copy_mem_func(&funcs);
+		test_gdi_copy_mem_scroll(&funcs);
+	}
+#endif
+}
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <freerdp/rfx.h>
 #include "rfx_bitstream.h"
 #include "rfx_rlgr.h"
@@ -34,6 +35,10 @@
 #include "rfx_decode.h"
 #include "rfx_encode.h"
 
+#ifdef WITH_AVX2
+#include "rfx_avx2.h"
+#endif
+
 #include "test_librfx.h"
 
 static const uint8 y_data[] =
@@ -177,6 +182,16 @@ int add_librfx_suite(void)
 	add_test_function(decode);
 	add_test_function(encode);
 	add_test_function(message);
+	add_test_function(message_threads);
+	add_test_function(message_encode_threads);
+	add_test_function(message_surface);
+	add_test_function(message_allocations);
+	add_test_function(message_differencing);
+	add_test_function(message_quant);
+	add_test_function(avx2_YCbCr_to_RGB);
+	add_test_function(avx2_quantization);
+	add_test_function(avx2_dwt);
+	add_test_function(avx2_dwt_bounds);
 
 	return 0;
 }
@@ -397,3 +412,743 @@ test_message(void)
 	rfx_context_free(context);
 	free(rgb_data);
 }
+
+/* the pixels test_librfx_make_frame fills a frame with */
+enum
+{
+	FRAME_GRADIENT,		/* ramps in all three channels */
+	FRAME_COLUMNS		/* two flat columns of tiles, a smooth one and a noisy one */
+};
+
+/* a generated frame, the encoder for it and its stream, which starts with the header */
+struct _RFX_TEST_FRAME
+{
+	RFX_CONTEXT * context;
+	RFX_RECT rect;
+	int width;
+	int height;
+	int stride;
+	uint8 * data;
+	uint8 * buffer;
+	int buffer_size;
+	int header_size;
+	uint8 * stream;
+};
+typedef struct _RFX_TEST_FRAME RFX_TEST_FRAME;
+
+static RFX_TEST_FRAME *
+test_librfx_make_frame(int width, int height, RFX_PIXEL_FORMAT format, int pattern)
+{
+	RFX_TEST_FRAME * frame;
+	uint8 * pixel;
+	uint32 seed = 1;
+	int bpp;
+	int x, y;
+	int i;
+
+	frame = (RFX_TEST_FRAME *) malloc(sizeof(RFX_TEST_FRAME));
+	memset(frame, 0, sizeof(RFX_TEST_FRAME));
+
+	frame->context = rfx_context_new();
+	frame->context->mode = RLGR3;
+	frame->context->width = width;
+	frame->context->height = height;
+	rfx_context_set_pixel_format(frame->context, format);
+	bpp = frame->context->bytes_per_pixel;
+
+	frame->rect.width = width;
+	frame->rect.height = height;
+	frame->width = width;
+	frame->height = height;
+	frame->stride = width * bpp;
+
+	frame->data = (uint8 *) malloc(height * frame->stride);
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			pixel = frame->data + y * frame->stride + x * bpp;
+			seed = seed * 1103515245 + 12345;
+
+			if (pattern == FRAME_GRADIENT)
+			{
+				pixel[0] = (uint8) (x + y);
+				pixel[1] = (uint8) ((x * y) >> 4);
+				pixel[2] = (uint8) ((x ^ y) & 0xF0);
+			}
+			else
+			{
+				for (i = 0; i < 3; i++)
+				{
+					if (x < 128)
+						pixel[i] = 0xC0;
+					else if (x < 192)
+						pixel[i] = (uint8) (x * 4);
+					else
+						pixel[i] = (uint8) (seed >> (8 + i * 8));
+				}
+			}
+
+			if (bpp == 4)
+				pixel[3] = 0xFF;
+		}
+	}
+
+	frame->buffer_size = height * frame->stride * 2;
+	frame->buffer = (uint8 *) malloc(frame->buffer_size);
+	frame->header_size = rfx_compose_message_header(frame->context, frame->buffer, frame->buffer_size);
+	frame->stream = frame->buffer + frame->header_size;
+
+	return frame;
+}
+
+static void
+test_librfx_free_frame(RFX_TEST_FRAME * frame)
+{
+	rfx_context_free(frame->context);
+	free(frame->buffer);
+	free(frame->data);
+	free(frame);
+}
+
+/* encodes the whole of data, laid out like the frame, after the header of the stream */
+static int
+test_librfx_compose(RFX_TEST_FRAME * frame, uint8 * data)
+{
+	return rfx_compose_message_data(frame->context, frame->stream, frame->buffer_size - frame->header_size,
+		&frame->rect, 1, data, frame->width, frame->height, frame->stride);
+}
+
+/* a decoder that has already been through the header of the stream */
+static RFX_CONTEXT *
+test_librfx_make_decoder(RFX_TEST_FRAME * frame, RFX_PIXEL_FORMAT format, int num_threads)
+{
+	RFX_CONTEXT * context;
+
+	context = rfx_context_new();
+	rfx_context_set_pixel_format(context, format);
+	rfx_context_set_num_threads(context, num_threads);
+	rfx_message_free(context, rfx_process_message(context, frame->buffer, frame->header_size));
+
+	return context;
+}
+
+
+void
+test_message_threads(void)
+{
+	RFX_TEST_FRAME * frame;
+	RFX_CONTEXT * serial_context;
+	RFX_CONTEXT * threaded_context;
+	RFX_MESSAGE * serial_message;
+	RFX_MESSAGE * threaded_message;
+	int size;
+	int i;
+
+	frame = test_librfx_make_frame(1920, 1080, RFX_PIXEL_FORMAT_RGB, FRAME_GRADIENT);
+	serial_context = test_librfx_make_decoder(frame, RFX_PIXEL_FORMAT_RGB, 1);
+	threaded_context = test_librfx_make_decoder(frame, RFX_PIXEL_FORMAT_RGB, 4);
+
+	size = test_librfx_compose(frame, frame->data);
+
+	serial_message = rfx_process_message(serial_context, frame->stream, size);
+	threaded_message = rfx_process_message(threaded_context, frame->stream, size);
+
+	CU_ASSERT(serial_message->num_tiles == 30 * 17);
+	CU_ASSERT(threaded_message->num_tiles == serial_message->num_tiles);
+
+	for (i = 0; i < serial_message->num_tiles; i++)
+	{
+		CU_ASSERT(threaded_message->tiles[i]->x == serial_message->tiles[i]->x);
+		CU_ASSERT(threaded_message->tiles[i]->y == serial_message->tiles[i]->y);
+		CU_ASSERT(memcmp(threaded_message->tiles[i]->data, serial_message->tiles[i]->data, 4096 * 3) == 0);
+	}
+
+	rfx_message_free(serial_context, serial_message);
+	rfx_message_free(threaded_context, threaded_message);
+
+	rfx_context_free(serial_context);
+	rfx_context_free(threaded_context);
+	test_librfx_free_frame(frame);
+}
+
+void
+test_message_encode_threads(void)
+{
+	RFX_TEST_FRAME * serial;
+	RFX_TEST_FRAME * threaded;
+	int serial_size;
+	int threaded_size;
+	int short_size;
+	int y;
+
+	serial = test_librfx_make_frame(1000, 600, RFX_PIXEL_FORMAT_BGRA, FRAME_GRADIENT);
+	rfx_context_set_num_threads(serial->context, 1);
+
+	threaded = test_librfx_make_frame(1000, 600, RFX_PIXEL_FORMAT_BGRA, FRAME_GRADIENT);
+	rfx_context_set_num_threads(threaded->context, 4);
+
+	/* the whole frame, including the partial tiles of the last row and column */
+	serial_size = test_librfx_compose(serial, serial->data);
+	threaded_size = test_librfx_compose(threaded, serial->data);
+	CU_ASSERT(threaded_size == serial_size);
+	CU_ASSERT(memcmp(threaded->stream, serial->stream, serial_size) == 0);
+
+	/* a stream too short for the frame is cut the same way */
+	short_size = serial_size / 2;
+	serial_size = rfx_compose_message_data(serial->context, serial->stream, short_size,
+		&serial->rect, 1, serial->data, 1000, 600, serial->stride);
+	threaded_size = rfx_compose_message_data(threaded->context, threaded->stream, short_size,
+		&threaded->rect, 1, serial->data, 1000, 600, threaded->stride);
+	CU_ASSERT(threaded_size == serial_size);
+	CU_ASSERT(memcmp(threaded->stream, serial->stream, serial_size) == 0);
+
+	/* only the dirty tiles with differencing */
+	rfx_context_set_differencing(serial->context, 1);
+	rfx_context_set_differencing(threaded->context, 1);
+	test_librfx_compose(serial, serial->data);
+	test_librfx_compose(threaded, serial->data);
+
+	for (y = 100; y < 500; y += 7)
+		serial->data[(y * 1000 + y + 300) * 4] ^= 0xFF;
+
+	serial_size = test_librfx_compose(serial, serial->data);
+	threaded_size = test_librfx_compose(threaded, serial->data);
+	CU_ASSERT(threaded_size == serial_size);
+	CU_ASSERT(memcmp(threaded->stream, serial->stream, serial_size) == 0);
+
+	test_librfx_free_frame(serial);
+	test_librfx_free_frame(threaded);
+}
+
+/* composite the tiles of a message by hand, the way a client would */
+static void
+composite_message_tiles(RFX_MESSAGE * message, int bpp, int left, int top,
+	uint8 * dst, int dst_width, int dst_height, const RFX_RECT * clip)
+{
+	int i, j;
+	int x, y;
+	int px, py;
+	int inside;
+
+	for (i = 0; i < message->num_tiles; i++)
+	{
+		for (y = 0; y < 64; y++)
+		{
+			for (x = 0; x < 64; x++)
+			{
+				px = left + message->tiles[i]->x + x;
+				py = top + message->tiles[i]->y + y;
+
+				if (px < 0 || py < 0 || px >= dst_width || py >= dst_height)
+					continue;
+
+				if (clip != NULL && (px < clip->x || py < clip->y ||
+					px >= clip->x + clip->width || py >= clip->y + clip->height))
+					continue;
+
+				inside = 0;
+				for (j = 0; j < message->num_rects; j++)
+				{
+					if (px >= left + message->rects[j].x && py >= top + message->rects[j].y &&
+						px < left + message->rects[j].x + message->rects[j].width &&
+						py < top + message->rects[j].y + message->rects[j].height)
+						inside = 1;
+				}
+
+				if (inside)
+				{
+					memcpy(dst + (py * dst_width + px) * bpp,
+						message->tiles[i]->data + (y * 64 + x) * bpp, bpp);
+				}
+			}
+		}
+	}
+}
+
+void
+test_message_surface(void)
+{
+	RFX_TEST_FRAME * frame;
+	RFX_CONTEXT * tile_context;
+	RFX_CONTEXT * surface_context;
+	RFX_MESSAGE * tile_message;
+	RFX_MESSAGE * surface_message;
+	RFX_RECT rects[] = { { 0, 0, 200, 100 }, { 130, 70, 100, 122 } };
+	RFX_RECT clip = { 50, 30, 180, 150 };
+	RFX_PIXEL_FORMAT formats[] = { RFX_PIXEL_FORMAT_BGRA, RFX_PIXEL_FORMAT_RGB };
+	int bpps[] = { 4, 3 };
+	int offsets[][2] = { { 37, 21 }, { 200, 150 } };
+	uint8 * expected;
+	uint8 * actual;
+	int size;
+	int f, o, c;
+
+	frame = test_librfx_make_frame(256, 192, RFX_PIXEL_FORMAT_RGB, FRAME_GRADIENT);
+	size = rfx_compose_message_data(frame->context, frame->stream, frame->buffer_size - frame->header_size,
+		rects, 2, frame->data, 256, 192, frame->stride);
+
+	expected = (uint8 *) malloc(400 * 300 * 4);
+	actual = (uint8 *) malloc(400 * 300 * 4);
+
+	for (f = 0; f < 2; f++)
+	{
+		for (o = 0; o < 2; o++)
+		{
+			for (c = 0; c < 2; c++)
+			{
+				tile_context = test_librfx_make_decoder(frame, formats[f], 1);
+				surface_context = test_librfx_make_decoder(frame, RFX_PIXEL_FORMAT_BGRA, 3);
+
+				memset(expected, 0x5A, 400 * 300 * 4);
+				memset(actual, 0x5A, 400 * 300 * 4);
+
+				tile_message = rfx_process_message(tile_context, frame->stream, size);
+				composite_message_tiles(tile_message, bpps[f], offsets[o][0], offsets[o][1],
+					expected, 400, 300, c ? &clip : NULL);
+
+				surface_message = rfx_process_message_ex(surface_context, frame->stream, size,
+					offsets[o][0], offsets[o][1], actual, 400, 300, 400 * bpps[f], formats[f],
+					c ? &clip : NULL, 1);
+
+				CU_ASSERT(tile_message->num_tiles == 12);
+				CU_ASSERT(surface_message->num_tiles == 0);
+				CU_ASSERT(surface_message->tiles == NULL);
+				CU_ASSERT(surface_message->num_rects == 2);
+				CU_ASSERT(memcmp(expected, actual, 400 * 300 * 4) == 0);
+
+				rfx_message_free(tile_context, tile_message);
+				rfx_message_free(surface_context, surface_message);
+				rfx_context_free(tile_context);
+				rfx_context_free(surface_context);
+			}
+		}
+	}
+
+	free(expected);
+	free(actual);
+	test_librfx_free_frame(frame);
+}
+
+void
+test_message_allocations(void)
+{
+	RFX_TEST_FRAME * frame;
+	RFX_CONTEXT * context;
+	RFX_MESSAGE * message;
+	uint32 allocations;
+	int size;
+	int i;
+
+	frame = test_librfx_make_frame(256, 192, RFX_PIXEL_FORMAT_RGB, FRAME_GRADIENT);
+	size = test_librfx_compose(frame, frame->data);
+
+	context = test_librfx_make_decoder(frame, RFX_PIXEL_FORMAT_BGRA, 2);
+
+	/* the first frame fills the arena */
+	message = rfx_process_message(context, frame->stream, size);
+	CU_ASSERT(message->num_tiles == 12);
+	rfx_message_free(context, message);
+	CU_ASSERT(context->pool->count == 12);
+
+	/* after that, decoding must not touch the heap */
+	allocations = context->pool->allocations;
+	for (i = 0; i < 10; i++)
+	{
+		message = rfx_process_message(context, frame->stream, size);
+		CU_ASSERT(message->num_tiles == 12);
+		CU_ASSERT(message->num_rects == 1);
+		rfx_message_free(context, message);
+	}
+	CU_ASSERT(context->pool->allocations == allocations);
+
+	/* free tiles above the high-water mark are released */
+	rfx_context_set_pool_limit(context, 4);
+	CU_ASSERT(context->pool->count == 4);
+
+	message = rfx_process_message(context, frame->stream, size);
+	CU_ASSERT(context->pool->allocations == allocations + 8 * 2);
+	rfx_message_free(context, message);
+	CU_ASSERT(context->pool->count == 4);
+
+	rfx_context_free(context);
+	test_librfx_free_frame(frame);
+}
+
+void
+test_message_differencing(void)
+{
+	RFX_TEST_FRAME * frame;
+	RFX_TEST_FRAME * full;
+	RFX_CONTEXT * dec_context;
+	RFX_MESSAGE * full_message;
+	RFX_MESSAGE * message;
+	int full_size;
+	int size;
+	int x, y;
+	int i, j;
+
+	frame = test_librfx_make_frame(250, 190, RFX_PIXEL_FORMAT_RGB, FRAME_GRADIENT);
+	rfx_context_set_differencing(frame->context, 1);
+
+	full = test_librfx_make_frame(250, 190, RFX_PIXEL_FORMAT_RGB, FRAME_GRADIENT);
+
+	dec_context = test_librfx_make_decoder(frame, RFX_PIXEL_FORMAT_RGB, 1);
+
+	/* the first frame is sent whole */
+	full_size = test_librfx_compose(full, frame->data);
+	size = test_librfx_compose(frame, frame->data);
+	CU_ASSERT(size == full_size);
+	CU_ASSERT(memcmp(frame->stream, full->stream, size) == 0);
+
+	/* an unchanged frame has no tiles and no region */
+	size = test_librfx_compose(frame, frame->data);
+	CU_ASSERT(size <= 64);
+	message = rfx_process_message(dec_context, frame->stream, size);
+	CU_ASSERT(message->num_tiles == 0);
+	CU_ASSERT(message->num_rects == 0);
+	rfx_message_free(dec_context, message);
+
+	/* touch one pixel of tile (1, 0) and a block across tiles (2, 1) and (3, 1) in the short last column */
+	frame->data[(10 * 250 + 70) * 3] ^= 0xFF;
+	for (y = 100; y < 110; y++)
+	{
+		for (x = 180; x < 200; x++)
+			frame->data[(y * 250 + x) * 3 + 1] = 0;
+	}
+
+	size = test_librfx_compose(frame, frame->data);
+	full_size = test_librfx_compose(full, frame->data);
+	CU_ASSERT(size < full_size / 2);
+
+	message = rfx_process_message(dec_context, frame->stream, size);
+	CU_ASSERT(message->num_tiles == 3);
+	CU_ASSERT(message->num_rects == 2);
+	CU_ASSERT(message->rects[0].x == 64 && message->rects[0].y == 0);
+	CU_ASSERT(message->rects[0].width == 64 && message->rects[0].height == 64);
+	CU_ASSERT(message->rects[1].x == 128 && message->rects[1].y == 64);
+	CU_ASSERT(message->rects[1].width == 122 && message->rects[1].height == 64);
+
+	/* the tiles sent match the same tiles of the whole frame */
+	full_message = rfx_process_message(dec_context, full->stream, full_size);
+	CU_ASSERT(full_message->num_tiles == 12);
+	for (i = 0; i < message->num_tiles; i++)
+	{
+		for (j = 0; j < full_message->num_tiles; j++)
+		{
+			if (full_message->tiles[j]->x == message->tiles[i]->x &&
+				full_message->tiles[j]->y == message->tiles[i]->y)
+			{
+				CU_ASSERT(memcmp(message->tiles[i]->data, full_message->tiles[j]->data, 4096 * 3) == 0);
+				break;
+			}
+		}
+		CU_ASSERT(j < full_message->num_tiles);
+	}
+	rfx_message_free(dec_context, full_message);
+	rfx_message_free(dec_context, message);
+
+	/* tiles changed on consecutive rows with the same span are merged into one rect */
+	for (y = 60; y < 70; y++)
+		frame->data[(y * 250 + 5) * 3 + 2] ^= 0x55;
+
+	size = test_librfx_compose(frame, frame->data);
+	message = rfx_process_message(dec_context, frame->stream, size);
+	CU_ASSERT(message->num_tiles == 2);
+	CU_ASSERT(message->num_rects == 1);
+	CU_ASSERT(message->rects[0].x == 0 && message->rects[0].y == 0);
+	CU_ASSERT(message->rects[0].width == 64 && message->rects[0].height == 128);
+	rfx_message_free(dec_context, message);
+
+	/* enabling it again sends the next frame whole */
+	rfx_context_set_differencing(frame->context, 1);
+	size = test_librfx_compose(frame, frame->data);
+	full_size = test_librfx_compose(full, frame->data);
+	CU_ASSERT(size == full_size);
+
+	rfx_context_free(dec_context);
+	test_librfx_free_frame(frame);
+	test_librfx_free_frame(full);
+}
+
+/* quantIdxY of the tiles of the tileset in a composed message, in stream order */
+static int
+message_tile_quants(const uint8 * buffer, int size, int * quants)
+{
+	const uint8 * end = buffer + size;
+	const uint8 * tile;
+	int numQuants;
+	int numTiles;
+	int i;
+
+	while (buffer + 6 <= end)
+	{
+		if ((buffer[0] | (buffer[1] << 8)) == WBT_EXTENSION && (buffer[8] | (buffer[9] << 8)) == CBT_TILESET)
+		{
+			numQuants = buffer[14];
+			numTiles = buffer[16] | (buffer[17] << 8);
+			tile = buffer + 22 + numQuants * 5;
+
+			for (i = 0; i < numTiles; i++)
+			{
+				quants[i] = tile[6];
+				tile += tile[2] | (tile[3] << 8) | (tile[4] << 16) | (tile[5] << 24);
+			}
+
+			return numTiles;
+		}
+
+		buffer += buffer[2] | (buffer[3] << 8) | (buffer[4] << 16) | (buffer[5] << 24);
+	}
+
+	return 0;
+}
+
+void
+test_message_quant(void)
+{
+	RFX_TEST_FRAME * frame;
+	RFX_TEST_FRAME * fixed;
+	RFX_CONTEXT * dec_context;
+	RFX_MESSAGE * message;
+	RFX_MESSAGE * fixed_message;
+	int quants[8];
+	int fixed_size;
+	int first_size;
+	int size;
+	int i;
+
+	frame = test_librfx_make_frame(256, 128, RFX_PIXEL_FORMAT_BGRA, FRAME_COLUMNS);
+	rfx_context_set_adaptive_quant(frame->context, 1);
+
+	fixed = test_librfx_make_frame(256, 128, RFX_PIXEL_FORMAT_BGRA, FRAME_COLUMNS);
+
+	dec_context = test_librfx_make_decoder(frame, RFX_PIXEL_FORMAT_BGRA, 1);
+
+	size = test_librfx_compose(frame, frame->data);
+	fixed_size = test_librfx_compose(fixed, frame->data);
+	CU_ASSERT(size < fixed_size);
+
+	/* coarse sets for the flat tiles, medium for the smooth ones, fine for the noisy ones */
+	CU_ASSERT(message_tile_quants(frame->stream, size, quants) == 8);
+	for (i = 0; i < 8; i++)
+	{
+		if (i % 4 < 2)
+		{
+			CU_ASSERT(quants[i] == RFX_QUANT_COARSE * 3);
+		}
+		else if (i % 4 == 2)
+		{
+			CU_ASSERT(quants[i] == RFX_QUANT_MEDIUM * 3);
+		}
+		else
+		{
+			CU_ASSERT(quants[i] == RFX_QUANT_FINE * 3);
+		}
+	}
+
+	message = rfx_process_message(dec_context, frame->stream, size);
+	CU_ASSERT(message->num_tiles == 8);
+	CU_ASSERT(dec_context->num_quants == RFX_QUANT_LEVELS * 3);
+	CU_ASSERT(dec_context->quants[0] == 6 && dec_context->quants[9] == 9);
+	CU_ASSERT(dec_context->quants[RFX_QUANT_COARSE * 30] == 9 && dec_context->quants[RFX_QUANT_COARSE * 30 + 9] == 12);
+
+	/* the fine set is the fixed one, so the detailed tiles come out the same */
+	fixed_message = rfx_process_message(dec_context, fixed->stream, fixed_size);
+	for (i = 0; i < 8; i++)
+	{
+		if (i % 4 == 3)
+		{
+			CU_ASSERT(memcmp(message->tiles[i]->data, fixed_message->tiles[i]->data, 4096 * 4) == 0);
+		}
+	}
+	rfx_message_free(dec_context, fixed_message);
+	rfx_message_free(dec_context, message);
+
+	/* over budget the frames get smaller, far under it they get bigger again */
+	rfx_context_set_adaptive_quant(frame->context, 0);
+	rfx_context_set_tile_budget(frame->context, 1000);
+	first_size = test_librfx_compose(frame, frame->data);
+	CU_ASSERT(first_size == fixed_size);
+
+	for (i = 0; i < 4; i++)
+	{
+		size = test_librfx_compose(frame, frame->data);
+	}
+	CU_ASSERT(frame->context->quant_offset > 0);
+	CU_ASSERT(size < first_size);
+
+	rfx_context_set_tile_budget(frame->context, 100000);
+	CU_ASSERT(frame->context->quant_offset == 0);
+	for (i = 0; i < 4; i++)
+	{
+		size = test_librfx_compose(frame, frame->data);
+	}
+	CU_ASSERT(frame->context->quant_offset < 0);
+	CU_ASSERT(size > first_size);
+
+	rfx_context_free(dec_context);
+	test_librfx_free_frame(frame);
+	test_librfx_free_frame(fixed);
+}
+
+#ifdef WITH_AVX2
+
+/* 16 byte aligned like the context buffers, the AVX2 kernels must cope with that */
+static sint16 scalar_mem[3][4096 + 16];
+static sint16 avx2_mem[3][4096 + 16];
+static sint16 dwt_mem[32 * 32 * 2 * 2 + 16];
+
+static sint16 *
+aligned_buffer(sint16 * mem)
+{
+	return (sint16 *)(((uintptr_t) mem + 16) & ~ 0x0F);
+}
+
+static void
+fill_random(sint16 * buf, int n, int min, int max)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		buf[i] = min + rand() % (max - min + 1);
+}
+
+#endif
+
+void
+test_avx2_YCbCr_to_RGB(void)
+{
+#ifdef WITH_AVX2
+	int i;
+	sint16 * s[3];
+	sint16 * a[3];
+
+	if (!rfx_cpu_has_avx2())
+		return;
+
+	srand(1);
+	for (i = 0; i < 3; i++)
+	{
+		s[i] = aligned_buffer(scalar_mem[i]);
+		a[i] = aligned_buffer(avx2_mem[i]);
+		fill_random(s[i], 4096, -256, 255);
+		memcpy(a[i], s[i], 4096 * sizeof(sint16));
+	}
+
+	rfx_decode_YCbCr_to_RGB(s[0], s[1], s[2]);
+	rfx_decode_YCbCr_to_RGB_AVX2(a[0], a[1], a[2]);
+
+	for (i = 0; i < 3; i++)
+		CU_ASSERT(memcmp(s[i], a[i], 4096 * sizeof(sint16)) == 0);
+#endif
+}
+
+void
+test_avx2_quantization(void)
+{
+#ifdef WITH_AVX2
+	int i;
+	sint16 * s;
+	sint16 * a;
+	uint32 quants[10];
+
+	if (!rfx_cpu_has_avx2())
+		return;
+
+	srand(2);
+	s = aligned_buffer(scalar_mem[0]);
+	a = aligned_buffer(avx2_mem[0]);
+	fill_random(s, 4096, -64, 63);
+	memcpy(a, s, 4096 * sizeof(sint16));
+
+	for (i = 0; i < 10; i++)
+		quants[i] = 6 + i % 5;
+
+	rfx_quantization_decode(s, quants);
+	rfx_quantization_decode_AVX2(a, quants);
+	CU_ASSERT(memcmp(s, a, 4096 * sizeof(sint16)) == 0);
+
+	rfx_quantization_decode(s, test_quantization_values);
+	rfx_quantization_decode_AVX2(a, test_quantization_values);
+	CU_ASSERT(memcmp(s, a, 4096 * sizeof(sint16)) == 0);
+#endif
+}
+
+void
+test_avx2_dwt(void)
+{
+#ifdef WITH_AVX2
+	int i;
+	sint16 * s;
+	sint16 * a;
+	sint16 * dwt;
+
+	if (!rfx_cpu_has_avx2())
+		return;
+
+	s = aligned_buffer(scalar_mem[0]);
+	a = aligned_buffer(avx2_mem[0]);
+	dwt = aligned_buffer(dwt_mem);
+
+	/* real coefficients from the sample tile */
+	rfx_rlgr_decode(RLGR3, y_data, sizeof(y_data), s, 4096);
+	rfx_differential_decode(s + 4032, 64);
+	rfx_quantization_decode(s, test_quantization_values);
+	memcpy(a, s, 4096 * sizeof(sint16));
+
+	rfx_dwt_2d_decode(s, dwt);
+	rfx_dwt_2d_decode_AVX2(a, dwt);
+	CU_ASSERT(memcmp(s, a, 4096 * sizeof(sint16)) == 0);
+
+	/* random coefficients */
+	srand(3);
+	for (i = 0; i < 16; i++)
+	{
+		fill_random(s, 4096, -256, 255);
+		memcpy(a, s, 4096 * sizeof(sint16));
+
+		rfx_dwt_2d_decode(s, dwt);
+		rfx_dwt_2d_decode_AVX2(a, dwt);
+		CU_ASSERT(memcmp(s, a, 4096 * sizeof(sint16)) == 0);
+	}
+#endif
+}
+
+/*
+   The same with the coefficients and the scratch in heap blocks of exactly
+   their size, without the alignment slack of the buffers above, so that a
+   build with -fsanitize=address catches a kernel reading outside the bands.
+*/
+void
+test_avx2_dwt_bounds(void)
+{
+#ifdef WITH_AVX2
+	int i;
+	sint16 * s;
+	sint16 * a;
+	sint16 * dwt;
+
+	if (!rfx_cpu_has_avx2())
+		return;
+
+	s = (sint16 *) malloc(4096 * sizeof(sint16));
+	a = (sint16 *) malloc(4096 * sizeof(sint16));
+	dwt = (sint16 *) malloc(32 * 32 * 2 * 2 * sizeof(sint16));
+
+	srand(4);
+	for (i = 0; i < 4; i++)
+	{
+		fill_random(s, 4096, -256, 255);
+		memcpy(a, s, 4096 * sizeof(sint16));
+
+		rfx_dwt_2d_decode(s, dwt);
+		rfx_dwt_2d_decode_AVX2(a, dwt);
+		CU_ASSERT(memcmp(s, a, 4096 * sizeof(sint16)) == 0);
+	}
+
+	free(s);
+	free(a);
+	free(dwt);
+#endif
+}
@@ -41,4 +41,24 @@ void
 test_encode(void);
 void
 test_message(void);
+void
+test_message_threads(void);
+void
+test_message_encode_threads(void);
+void
+test_message_surface(void);
+void
+test_message_allocations(void);
+void
+test_message_differencing(void);
+void
+test_message_quant(void);
+void
+test_avx2_YCbCr_to_RGB(void);
+void
+test_avx2_quantization(void);
+void
+test_avx2_dwt(void);
+void
+test_avx2_dwt_bounds(void);
 
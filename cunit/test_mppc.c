@@ -0,0 +1,771 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   MPPC Bulk Decompression Unit Tests
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <freerdp/freerdp.h>
+#include "frdp.h"
+#include "rdp.h"
+#include "test_mppc.h"
+
+/*
+   The bit at a time decoder mppc_expand was before it became table driven,
+   the reference the current one is checked against.
+*/
+static int
+mppc_expand_reference(RDPCOMP * comp, uint8 * data, uint32 clen, uint8 ctype, uint32 * roff, uint32 * rlen)
+{
+	int k, walker_len = 0, walker;
+	uint32 i = 0;
+	int next_offset, match_off;
+	int match_len;
+	int old_offset, match_bits;
+	RD_BOOL big = ctype & RDP_MPPC_BIG ? True : False;
+
+	uint8 *dict = comp->hist;
+
+	if ((ctype & RDP_MPPC_COMPRESSED) == 0)
+	{
+		*roff = 0;
+		*rlen = clen;
+		return 0;
+	}
+
+	if ((ctype & RDP_MPPC_RESET) != 0)
+		comp->roff = 0;
+
+	if ((ctype & RDP_MPPC_FLUSH) != 0)
+	{
+		memset(dict, 0, RDP_MPPC_DICT_SIZE);
+		comp->roff = 0;
+	}
+
+	*roff = 0;
+	*rlen = 0;
+
+	walker = comp->roff;
+
+	next_offset = walker;
+	old_offset = next_offset;
+	*roff = old_offset;
+	if (clen == 0)
+		return 0;
+	clen += i;
+
+	do
+	{
+		if (walker_len == 0)
+		{
+			if (i >= clen)
+				break;
+			walker = data[i++] << 24;
+			walker_len = 8;
+		}
+		if (walker >= 0)
+		{
+			if (walker_len < 8)
+			{
+				if (i >= clen)
+				{
+					if (walker != 0)
+						return -1;
+					break;
+				}
+				walker |= (data[i++] & 0xff) << (24 - walker_len);
+				walker_len += 8;
+			}
+			if (next_offset >= RDP_MPPC_DICT_SIZE)
+				return -1;
+			dict[next_offset++] = (((uint32) walker) >> ((uint32) 24));
+			walker <<= 8;
+			walker_len -= 8;
+			continue;
+		}
+		walker <<= 1;
+		if (--walker_len == 0)
+		{
+			if (i >= clen)
+				return -1;
+			walker = data[i++] << 24;
+			walker_len = 8;
+		}
+		if (walker >= 0)
+		{
+			if (walker_len < 8)
+			{
+				if (i >= clen)
+					return -1;
+				walker |= (data[i++] & 0xff) << (24 - walker_len);
+				walker_len += 8;
+			}
+			if (next_offset >= RDP_MPPC_DICT_SIZE)
+				return -1;
+			dict[next_offset++] = (uint8) (walker >> 24 | 0x80);
+			walker <<= 8;
+			walker_len -= 8;
+			continue;
+		}
+
+		walker <<= 1;
+		if (--walker_len < (big ? 3 : 2))
+		{
+			if (i >= clen)
+				return -1;
+			walker |= (data[i++] & 0xff) << (24 - walker_len);
+			walker_len += 8;
+		}
+
+		if (big)
+		{
+			switch (((uint32) walker) >> ((uint32) 29))
+			{
+				case 7:
+					for (; walker_len < 9; walker_len += 8)
+					{
+						if (i >= clen)
+							return -1;
+						walker |= (data[i++] & 0xff) << (24 - walker_len);
+					}
+					walker <<= 3;
+					match_off = ((uint32) walker) >> ((uint32) 26);
+					walker <<= 6;
+					walker_len -= 9;
+					break;
+
+				case 6:
+					for (; walker_len < 11; walker_len += 8)
+					{
+						if (i >= clen)
+							return -1;
+						walker |= (data[i++] & 0xff) << (24 - walker_len);
+					}
+					walker <<= 3;
+					match_off = (((uint32) walker) >> ((uint32) 24)) + 64;
+					walker <<= 8;
+					walker_len -= 11;
+					break;
+
+				case 5:
+				case 4:
+					for (; walker_len < 13; walker_len += 8)
+					{
+						if (i >= clen)
+							return -1;
+						walker |= (data[i++] & 0xff) << (24 - walker_len);
+					}
+					walker <<= 2;
+					match_off = (((uint32) walker) >> ((uint32) 21)) + 320;
+					walker <<= 11;
+					walker_len -= 13;
+					break;
+
+				default:
+					for (; walker_len < 17; walker_len += 8)
+					{
+						if (i >= clen)
+							return -1;
+						walker |= (data[i++] & 0xff) << (24 - walker_len);
+					}
+					walker <<= 1;
+					match_off = (((uint32) walker) >> ((uint32) 16)) + 2368;
+					walker <<= 16;
+					walker_len -= 17;
+					break;
+			}
+		}
+		else
+		{
+			switch (((uint32) walker) >> ((uint32) 30))
+			{
+				case 3:
+					if (walker_len < 8)
+					{
+						if (i >= clen)
+							return -1;
+						walker |= (data[i++] & 0xff) << (24 - walker_len);
+						walker_len += 8;
+					}
+					walker <<= 2;
+					match_off = ((uint32) walker) >> ((uint32) 26);
+					walker <<= 6;
+					walker_len -= 8;
+					break;
+
+				case 2:
+					for (; walker_len < 10; walker_len += 8)
+					{
+						if (i >= clen)
+							return -1;
+						walker |= (data[i++] & 0xff) << (24 - walker_len);
+					}
+					walker <<= 2;
+					match_off = (((uint32) walker) >> ((uint32) 24)) + 64;
+					walker <<= 8;
+					walker_len -= 10;
+					break;
+
+				default:
+					for (; walker_len < 14; walker_len += 8)
+					{
+						if (i >= clen)
+							return -1;
+						walker |= (data[i++] & 0xff) << (24 - walker_len);
+					}
+					match_off = (walker >> 18) + 320;
+					walker <<= 14;
+					walker_len -= 14;
+					break;
+			}
+		}
+		if (walker_len == 0)
+		{
+			if (i >= clen)
+				return -1;
+			walker = data[i++] << 24;
+			walker_len = 8;
+		}
+
+		match_len = 0;
+		if (walker >= 0)
+		{
+			match_len = 3;
+			walker <<= 1;
+			walker_len--;
+		}
+		else
+		{
+			match_bits = big ? 14 : 11;
+			do
+			{
+				walker <<= 1;
+				if (--walker_len == 0)
+				{
+					if (i >= clen)
+						return -1;
+					walker = data[i++] << 24;
+					walker_len = 8;
+				}
+				if (walker >= 0)
+					break;
+				if (--match_bits == 0)
+					return -1;
+			}
+			while (1);
+			match_len = (big ? 16 : 13) - match_bits;
+			walker <<= 1;
+			if (--walker_len < match_len)
+			{
+				for (; walker_len < match_len; walker_len += 8)
+				{
+					if (i >= clen)
+						return -1;
+					walker |= (data[i++] & 0xff) << (24 - walker_len);
+				}
+			}
+
+			match_bits = match_len;
+			match_len = ((walker >> (32 - match_bits)) & (~(-1 << match_bits))) | (1 << match_bits);
+			walker <<= match_bits;
+			walker_len -= match_bits;
+		}
+		if (next_offset + match_len >= RDP_MPPC_DICT_SIZE)
+			return -1;
+
+		k = (next_offset - match_off) & (big ? 65535 : 8191);
+		do
+		{
+			/* the original read past the history here on a wrapped offset */
+			dict[next_offset++] = dict[(k++) & (RDP_MPPC_DICT_SIZE - 1)];
+		}
+		while (--match_len != 0);
+	}
+	while (1);
+
+	comp->roff = next_offset;
+
+	*roff = old_offset;
+	*rlen = next_offset - old_offset;
+
+	return 0;
+}
+
+/*
+   A small MPPC compressor producing the test streams: every literal, offset
+   and length class shows up, with overlapping matches and history flushes.
+*/
+
+struct mppc_test_encoder
+{
+	int big;
+	int history_size;
+	uint8 history[RDP_MPPC_DICT_SIZE];
+	int pos;
+	int last[4096];
+	int flushed;
+
+	uint8 * out;
+	int bit;
+};
+
+static uint32 seed = 1;
+
+static uint32
+test_rand(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) & 0xFFFFFF;
+}
+
+static void
+test_put_bits(struct mppc_test_encoder * enc, uint32 value, int n)
+{
+	while (n-- > 0)
+	{
+		if ((value >> n) & 1)
+			enc->out[enc->bit >> 3] |= 0x80 >> (enc->bit & 7);
+		enc->bit++;
+	}
+}
+
+static void
+test_put_literal(struct mppc_test_encoder * enc, uint8 c)
+{
+	if (c < 0x80)
+		test_put_bits(enc, c, 8);
+	else
+		test_put_bits(enc, 0x100 | (c & 0x7F), 9);
+}
+
+static void
+test_put_copy(struct mppc_test_encoder * enc, int offset, int length)
+{
+	int n;
+
+	if (enc->big)
+	{
+		if (offset < 64)
+		{
+			test_put_bits(enc, 0x1F, 5);
+			test_put_bits(enc, offset, 6);
+		}
+		else if (offset < 320)
+		{
+			test_put_bits(enc, 0x1E, 5);
+			test_put_bits(enc, offset - 64, 8);
+		}
+		else if (offset < 2368)
+		{
+			test_put_bits(enc, 0xE, 4);
+			test_put_bits(enc, offset - 320, 11);
+		}
+		else
+		{
+			test_put_bits(enc, 0x6, 3);
+			test_put_bits(enc, offset - 2368, 16);
+		}
+	}
+	else
+	{
+		if (offset < 64)
+		{
+			test_put_bits(enc, 0xF, 4);
+			test_put_bits(enc, offset, 6);
+		}
+		else if (offset < 320)
+		{
+			test_put_bits(enc, 0xE, 4);
+			test_put_bits(enc, offset - 64, 8);
+		}
+		else
+		{
+			test_put_bits(enc, 0x6, 3);
+			test_put_bits(enc, offset - 320, 13);
+		}
+	}
+
+	if (length == 3)
+	{
+		test_put_bits(enc, 0, 1);
+	}
+	else
+	{
+		/* n ones and a zero, then the n + 1 low bits */
+		for (n = 1; (length >> (n + 2)) != 0; n++);
+		test_put_bits(enc, ((1 << n) - 1) << 1, n + 1);
+		test_put_bits(enc, length & ((1 << (n + 1)) - 1), n + 1);
+	}
+}
+
+#define TEST_HASH(_p) ((((_p)[0] << 8) ^ ((_p)[1] << 4) ^ (_p)[2]) & 4095)
+
+/* compress a packet, returns its size and sets its flags */
+static int
+test_compress(struct mppc_test_encoder * enc, const uint8 * src, int len, uint8 * out, uint8 * ctype)
+{
+	int i;
+	int j;
+	int h;
+	int candidate;
+	int offset;
+	int length;
+	int max_length;
+
+	*ctype = RDP_MPPC_COMPRESSED | (enc->big ? RDP_MPPC_BIG : 0);
+
+	if (!enc->flushed || enc->pos + len >= enc->history_size)
+	{
+		*ctype |= RDP_MPPC_FLUSH;
+		memset(enc->history, 0, sizeof(enc->history));
+		memset(enc->last, 0xFF, sizeof(enc->last));
+		enc->pos = 0;
+		enc->flushed = 1;
+	}
+
+	memset(out, 0, len * 2 + 16);
+	enc->out = out;
+	enc->bit = 0;
+
+	memcpy(enc->history + enc->pos, src, len);
+	i = enc->pos;
+	len += enc->pos;
+
+	while (i < len)
+	{
+		length = 0;
+		offset = 0;
+
+		if (i + 3 <= len)
+		{
+			h = TEST_HASH(enc->history + i);
+			candidate = enc->last[h];
+
+			/* now and then look right behind instead, for overlapping copies */
+			if (test_rand() % 4 == 0 && i >= 1 + (int) (test_rand() % 7))
+				candidate = i - 1 - (test_rand() % 7);
+
+			if (candidate >= 0 && candidate < i && i - candidate < (enc->big ? 65536 : 8192))
+			{
+				/* sometimes cut the match short, to vary the length classes */
+				max_length = (test_rand() % 3 == 0) ? 3 + test_rand() % 40 : len - i;
+
+				for (j = 0; j < max_length && i + j < len && enc->history[candidate + j] == enc->history[i + j]; j++);
+
+				if (j >= 3)
+				{
+					length = j;
+					offset = i - candidate;
+				}
+			}
+
+			enc->last[h] = i;
+		}
+
+		if (length >= 3)
+		{
+			test_put_copy(enc, offset, length);
+			i += length;
+		}
+		else
+		{
+			test_put_literal(enc, enc->history[i]);
+			i++;
+		}
+	}
+
+	enc->pos = len;
+
+	return (enc->bit + 7) / 8;
+}
+
+/* payloads looking like what a server compresses */
+static void
+test_fill_payload(uint8 * data, int len, int kind)
+{
+	static const char * words[] = { "the ", "window ", "desktop ", "bitmap ", "order ", "glyph ", "cache ", "\r\n" };
+	int i, j;
+	int n;
+	uint8 c;
+
+	switch (kind)
+	{
+		case 0:
+			/* text */
+			for (i = 0; i < len; i += n)
+			{
+				const char * word = words[test_rand() % 8];
+				n = strlen(word);
+				if (n > len - i)
+					n = len - i;
+				memcpy(data + i, word, n);
+			}
+			break;
+
+		case 1:
+			/* long runs, distance 1 overlapping copies */
+			for (i = 0; i < len; i += n)
+			{
+				n = 1 + test_rand() % 3000;
+				if (n > len - i)
+					n = len - i;
+				memset(data + i, test_rand() & 0xFF, n);
+			}
+			break;
+
+		case 2:
+			/* random, all literals */
+			for (i = 0; i < len; i++)
+				data[i] = test_rand() & 0xFF;
+			break;
+
+		case 3:
+			/* records repeating with changes */
+			for (i = 0; i < len; i++)
+				data[i] = (i % 16 == (int) (test_rand() % 16)) ? test_rand() & 0xFF : (uint8) (i % 16 * 17);
+			break;
+
+		default:
+			/* short periodic patterns */
+			for (i = 0; i < len; i += n)
+			{
+				n = 2 + test_rand() % 6;
+				c = test_rand() & 0xFF;
+				for (j = 0; j < 200 && i + j < len; j++)
+					data[i + j] = c + (j % n);
+				n = j;
+			}
+			break;
+	}
+}
+
+static rdpRdp * rdp;
+static RDPCOMP * reference;
+
+int init_mppc_suite(void)
+{
+	rdp = (rdpRdp *) malloc(sizeof(rdpRdp));
+	memset(rdp, 0, sizeof(rdpRdp));
+	reference = (RDPCOMP *) malloc(sizeof(RDPCOMP));
+	memset(reference, 0, sizeof(RDPCOMP));
+
+	return 0;
+}
+
+int clean_mppc_suite(void)
+{
+	free(rdp);
+	free(reference);
+
+	return 0;
+}
+
+int add_mppc_suite(void)
+{
+	add_test_suite(mppc);
+
+	add_test_function(mppc_expand_rdp4);
+	add_test_function(mppc_expand_rdp5);
+	add_test_function(mppc_expand_invalid);
+	add_test_function(mppc_compress_rdp4);
+	add_test_function(mppc_compress_rdp5);
+
+	return 0;
+}
+
+/* compress a corpus of packets and check both decoders give them back */
+static void
+test_mppc_corpus(int big)
+{
+	struct mppc_test_encoder * enc;
+	uint8 payload[8000];
+	uint8 packet[8000 * 2 + 16];
+	uint8 ctype;
+	uint32 roff, rlen;
+	uint32 ref_roff, ref_rlen;
+	int status, ref_status;
+	int size;
+	int len;
+	int n;
+
+	enc = (struct mppc_test_encoder *) malloc(sizeof(struct mppc_test_encoder));
+	memset(enc, 0, sizeof(struct mppc_test_encoder));
+	enc->big = big;
+	enc->history_size = big ? RDP_MPPC_DICT_SIZE : 8192;
+
+	for (n = 0; n < 400; n++)
+	{
+		len = 1 + test_rand() % (big ? 8000 : 3000);
+		test_fill_payload(payload, len, test_rand() % 5);
+		size = test_compress(enc, payload, len, packet, &ctype);
+
+		status = mppc_expand(rdp, packet, size, ctype, &roff, &rlen);
+		ref_status = mppc_expand_reference(reference, packet, size, ctype, &ref_roff, &ref_rlen);
+
+		CU_ASSERT(status == 0);
+		CU_ASSERT(ref_status == 0);
+		CU_ASSERT(roff == ref_roff && rlen == ref_rlen);
+		CU_ASSERT(rlen == len);
+		CU_ASSERT(memcmp(rdp->mppc_dict.hist + roff, payload, len) == 0);
+		CU_ASSERT(memcmp(rdp->mppc_dict.hist, reference->hist, RDP_MPPC_DICT_SIZE) == 0);
+	}
+
+	free(enc);
+}
+
+void test_mppc_expand_rdp4(void)
+{
+	test_mppc_corpus(0);
+}
+
+void test_mppc_expand_rdp5(void)
+{
+	test_mppc_corpus(1);
+}
+
+/* on damaged streams both decoders fail, or give the same output, the same way */
+void test_mppc_expand_invalid(void)
+{
+	struct mppc_test_encoder * enc;
+	uint8 payload[4000];
+	uint8 packet[4000 * 2 + 16];
+	uint8 ctype;
+	uint32 roff, rlen;
+	uint32 ref_roff, ref_rlen;
+	int status, ref_status;
+	int size;
+	int len;
+	int n;
+	int i;
+
+	enc = (struct mppc_test_encoder *) malloc(sizeof(struct mppc_test_encoder));
+
+	for (n = 0; n < 2000; n++)
+	{
+		/* start from a valid packet of a fresh history */
+		memset(enc, 0, sizeof(struct mppc_test_encoder));
+		enc->big = n & 1;
+		enc->history_size = enc->big ? RDP_MPPC_DICT_SIZE : 8192;
+
+		len = 1 + test_rand() % 4000;
+		test_fill_payload(payload, len, test_rand() % 5);
+		size = test_compress(enc, payload, len, packet, &ctype);
+
+		switch (n % 3)
+		{
+			case 0:
+				/* cut short */
+				size = test_rand() % (size + 1);
+				break;
+
+			case 1:
+				/* flipped bits */
+				for (i = 0; i < 4; i++)
+					packet[test_rand() % size] ^= 1 << (test_rand() % 8);
+				break;
+
+			default:
+				/* noise */
+				for (i = 0; i < size; i++)
+					packet[i] = test_rand() & 0xFF;
+				break;
+		}
+
+		status = mppc_expand(rdp, packet, size, ctype, &roff, &rlen);
+		ref_status = mppc_expand_reference(reference, packet, size, ctype, &ref_roff, &ref_rlen);
+
+		CU_ASSERT(status == ref_status);
+		CU_ASSERT(rdp->mppc_dict.roff == reference->roff);
+
+		if (status == 0 && ref_status == 0)
+		{
+			CU_ASSERT(roff == ref_roff && rlen == ref_rlen);
+		}
+	}
+
+	free(enc);
+}
+
+/* compress packets with mppc_compress and get them back with mppc_expand */
+static void
+test_mppc_compress_corpus(RD_BOOL big)
+{
+	RDPCOMPENC * enc;
+	uint8 payload[8000];
+	uint8 packet[8000];
+	uint32 roff, rlen;
+	int compressed;
+	int ctype;
+	int size;
+	int len;
+	int n;
+
+	enc = mppc_enc_new(big);
+	memset(rdp->mppc_dict.hist, 0, RDP_MPPC_DICT_SIZE);
+	compressed = 0;
+
+	for (n = 0; n < 400; n++)
+	{
+		len = 1 + test_rand() % (big ? 8000 : 1600);
+		test_fill_payload(payload, len, test_rand() % 5);
+		ctype = mppc_compress(enc, payload, len, packet, &size);
+
+		if (ctype == 0)
+		{
+			/* sent as is, the next packet flushes */
+			CU_ASSERT(enc->flush == True);
+			continue;
+		}
+
+		compressed++;
+		CU_ASSERT(size > 0 && size < len);
+		CU_ASSERT(((ctype & RDP_MPPC_BIG) != 0) == big);
+		CU_ASSERT(mppc_expand(rdp, packet, size, ctype, &roff, &rlen) == 0);
+		CU_ASSERT(rlen == len);
+		CU_ASSERT(memcmp(rdp->mppc_dict.hist + roff, payload, len) == 0);
+	}
+
+	/* everything but noise compresses */
+	CU_ASSERT(compressed > 200);
+
+	/* a repeated packet comes out as a few long copies; on a fresh history,
+	   so that it is not reset in between, and not just one copy, as the
+	   chains may give out before they reach its start */
+	mppc_enc_free(enc);
+	enc = mppc_enc_new(big);
+	test_fill_payload(payload, 1000, 0);
+	ctype = mppc_compress(enc, payload, 1000, packet, &size);
+	CU_ASSERT(ctype != 0);
+	CU_ASSERT(mppc_expand(rdp, packet, size, ctype, &roff, &rlen) == 0);
+	ctype = mppc_compress(enc, payload, 1000, packet, &size);
+	CU_ASSERT(ctype != 0 && size <= 16);
+	CU_ASSERT(mppc_expand(rdp, packet, size, ctype, &roff, &rlen) == 0);
+	CU_ASSERT(rlen == 1000 && memcmp(rdp->mppc_dict.hist + roff, payload, 1000) == 0);
+
+	mppc_enc_free(enc);
+}
+
+void test_mppc_compress_rdp4(void)
+{
+	test_mppc_compress_corpus(False);
+}
+
+void test_mppc_compress_rdp5(void)
+{
+	test_mppc_compress_corpus(True);
+}
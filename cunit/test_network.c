@@ -0,0 +1,614 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Network Receive Unit Tests
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <freerdp/freerdp.h>
+#include "frdp.h"
+#include "network.h"
+#include "tcp.h"
+#include "test_network.h"
+
+/*
+   The stand-in server is the other end of a socketpair, it writes TPKT
+   framed PDUs with a known body the client side reads back through
+   network_recv, the way tpkt_recv does, and reads back what the client
+   queued with network_send.
+*/
+
+static rdpInst inst;
+static struct rdp_set settings;
+static rdpRdp * rdp;
+static rdpNetwork * net;
+static int server_fd;
+
+struct _SERVER_DATA
+{
+	uint8 * data;
+	int size;
+	int chunk;
+};
+typedef struct _SERVER_DATA SERVER_DATA;
+
+static int
+test_ui_select(rdpInst * inst, int rdp_socket)
+{
+	return 1;
+}
+
+static void
+test_ui_error(rdpInst * inst, const char * text)
+{
+	printf("%s", text);
+}
+
+int init_network_suite(void)
+{
+	int sv[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+		return 1;
+
+	memset(&inst, 0, sizeof(rdpInst));
+	inst.ui_select = test_ui_select;
+	inst.ui_error = test_ui_error;
+
+	rdp = (rdpRdp *) malloc(sizeof(rdpRdp));
+	memset(rdp, 0, sizeof(rdpRdp));
+	rdp->inst = &inst;
+	rdp->settings = &settings;
+	rdp->sec = (struct rdp_sec *) malloc(sizeof(struct rdp_sec));
+	memset(rdp->sec, 0, sizeof(struct rdp_sec));
+	rdp->sec->rdp = rdp;
+
+	net = network_new(rdp);
+	net->tcp->sockfd = sv[0];
+	server_fd = sv[1];
+
+	return 0;
+}
+
+int clean_network_suite(void)
+{
+	close(net->tcp->sockfd);
+	close(server_fd);
+	net->tcp->sockfd = -1;
+	network_free(net);
+	free(rdp->sec);
+	free(rdp);
+
+	return 0;
+}
+
+int add_network_suite(void)
+{
+	add_test_suite(network);
+
+	add_test_function(network_recv_batched);
+	add_test_function(network_recv_large);
+	add_test_function(network_send_batched);
+	add_test_function(network_send_before_recv);
+	add_test_function(network_input_coalesced);
+	add_test_function(network_input_split);
+	add_test_function(network_connect_refused);
+	add_test_function(network_connect_unresponsive);
+	add_test_function(network_connect_timeout);
+
+	return 0;
+}
+
+/* a TPKT header and a body of bytes counting up from seed */
+static int
+test_make_pdu(uint8 * pdu, int length, int seed)
+{
+	int i;
+
+	pdu[0] = 3;
+	pdu[1] = 0;
+	pdu[2] = (length >> 8) & 0xFF;
+	pdu[3] = length & 0xFF;
+
+	for (i = 4; i < length; i++)
+		pdu[i] = (uint8) (seed + i);
+
+	return length;
+}
+
+/* read one PDU as tpkt_recv does and check its body */
+static RD_BOOL
+test_recv_pdu(int expected_length, int seed)
+{
+	STREAM s;
+	int length;
+	int i;
+
+	s = network_recv(net, NULL, 4);
+	if (s == NULL)
+		return False;
+
+	in_uint8s(s, 2);
+	in_uint16_be(s, length);
+	if (length != expected_length)
+		return False;
+
+	s = network_recv(net, s, length - 4);
+	if (s == NULL || s->end - s->p != length - 4)
+		return False;
+
+	for (i = 4; i < length; i++)
+	{
+		if (s->p[i - 4] != (uint8) (seed + i))
+			return False;
+	}
+
+	return True;
+}
+
+static void *
+test_server_thread(void * arg)
+{
+	SERVER_DATA * server = (SERVER_DATA *) arg;
+	int sent = 0;
+	int n;
+
+	while (sent < server->size)
+	{
+		n = write(server_fd, server->data + sent, MIN(server->chunk, server->size - sent));
+		if (n <= 0)
+			break;
+		sent += n;
+	}
+
+	return NULL;
+}
+
+void test_network_recv_batched(void)
+{
+	uint8 * data;
+	int lengths[64];
+	int size = 0;
+	int failed = 0;
+	int i;
+
+	/* a burst of updates, already waiting on the socket when reading starts */
+	data = (uint8 *) malloc(64 * 1600);
+	for (i = 0; i < 64; i++)
+	{
+		lengths[i] = 100 + (i * 397) % 1500;
+		size += test_make_pdu(data + size, lengths[i], i);
+	}
+	CU_ASSERT(write(server_fd, data, size) == size);
+
+	net->recv_count = 0;
+	for (i = 0; i < 64; i++)
+	{
+		if (!test_recv_pdu(lengths[i], i))
+			failed++;
+		if (network_pending(net) != (i < 63))
+			failed++;
+	}
+
+	CU_ASSERT(failed == 0);
+	/* the whole burst in one read, against two per PDU before */
+	CU_ASSERT(net->recv_count == 1);
+
+	free(data);
+}
+
+void test_network_recv_large(void)
+{
+	pthread_t thread;
+	SERVER_DATA server;
+	uint8 * data;
+	int failed = 0;
+	int i;
+
+	/* PDUs of the largest size, more than the buffer holds at once and
+	   arriving piecewise */
+	server.size = 0;
+	server.chunk = 1000;
+	server.data = data = (uint8 *) malloc(6 * 0xFFFF);
+	for (i = 0; i < 6; i++)
+		server.size += test_make_pdu(data + server.size, (i & 1) ? 0xFFFF : 5000, i);
+
+	pthread_create(&thread, NULL, test_server_thread, &server);
+
+	net->recv_count = 0;
+	for (i = 0; i < 6; i++)
+	{
+		if (!test_recv_pdu((i & 1) ? 0xFFFF : 5000, i))
+			failed++;
+	}
+
+	pthread_join(thread, NULL);
+
+	CU_ASSERT(failed == 0);
+	CU_ASSERT(network_pending(net) == False);
+	CU_ASSERT(net->recv_count > 0);
+
+	free(data);
+}
+
+/* queue a PDU the way the protocol layers do, from a reused stream */
+static void
+test_send_pdu(uint8 * buffer, int length, int seed)
+{
+	struct stream s;
+
+	memset(&s, 0, sizeof(struct stream));
+	s.data = s.p = buffer;
+	s.end = s.data + test_make_pdu(buffer, length, seed);
+	s.size = length;
+
+	network_send(net, &s);
+}
+
+/* read size bytes off the server end and compare them */
+static RD_BOOL
+test_server_expect(uint8 * expected, int size)
+{
+	uint8 * data;
+	int rcvd = 0;
+	int n;
+	RD_BOOL ok;
+
+	data = (uint8 *) malloc(size);
+	while (rcvd < size)
+	{
+		n = read(server_fd, data + rcvd, size - rcvd);
+		if (n <= 0)
+			break;
+		rcvd += n;
+	}
+
+	ok = (rcvd == size) && (memcmp(data, expected, size) == 0);
+	free(data);
+
+	return ok;
+}
+
+void test_network_send_batched(void)
+{
+	uint8 buffer[20000];
+	uint8 * expected;
+	int size = 0;
+	int i;
+
+	/* a mouse drag worth of small input PDUs */
+	expected = (uint8 *) malloc(100 * 20 + 20000);
+	net->send_count = 0;
+	for (i = 0; i < 100; i++)
+	{
+		test_send_pdu(buffer, 20, i);
+		size += test_make_pdu(expected + size, 20, i);
+	}
+	CU_ASSERT(net->send_count == 0);
+
+	network_flush(net);
+	CU_ASSERT(net->send_count == 1);
+	CU_ASSERT(test_server_expect(expected, size) == True);
+
+	/* a PDU larger than the queue goes straight out, after what is queued */
+	size = 0;
+	net->send_count = 0;
+	test_send_pdu(buffer, 20, 1);
+	size += test_make_pdu(expected + size, 20, 1);
+	test_send_pdu(buffer, 20000, 2);
+	size += test_make_pdu(expected + size, 20000, 2);
+	network_flush(net);
+	CU_ASSERT(net->send_count == 2);
+	CU_ASSERT(test_server_expect(expected, size) == True);
+
+	free(expected);
+}
+
+void test_network_send_before_recv(void)
+{
+	uint8 buffer[100];
+	uint8 expected[100];
+
+	/* the reply is on its way already, the request must still go out
+	   before the client blocks for it */
+	test_make_pdu(buffer, 100, 3);
+	CU_ASSERT(write(server_fd, buffer, 100) == 100);
+
+	net->send_count = 0;
+	test_send_pdu(buffer, 50, 4);
+	test_make_pdu(expected, 50, 4);
+
+	CU_ASSERT(test_recv_pdu(100, 3) == True);
+	CU_ASSERT(net->send_count == 1);
+	CU_ASSERT(test_server_expect(expected, 50) == True);
+}
+
+/* a fast-path mouse event as rdp_send_input_mouse writes it */
+static uint8 *
+test_put_mouse(uint8 * p, uint16 flags, uint16 x, uint16 y)
+{
+	*p++ = FASTPATH_INPUT_EVENT_MOUSE << 5;
+	*p++ = flags & 0xFF;
+	*p++ = flags >> 8;
+	*p++ = x & 0xFF;
+	*p++ = x >> 8;
+	*p++ = y & 0xFF;
+	*p++ = y >> 8;
+
+	return p;
+}
+
+/* the fast-path header for num_events events of length bytes, short enough for a one byte length */
+static uint8 *
+test_put_fp_header(uint8 * p, int num_events, int length)
+{
+	*p++ = num_events << 2;
+	*p++ = 2 + length;
+
+	return p;
+}
+
+/* nothing more than what was checked reached the server */
+static RD_BOOL
+test_server_drained(void)
+{
+	uint8 byte;
+
+	return recv(server_fd, &byte, 1, MSG_DONTWAIT) < 0;
+}
+
+void test_network_input_coalesced(void)
+{
+	uint8 expected[64];
+	uint8 * p;
+
+	/* a drag: the moves in a row only keep the last position */
+	rdp->use_input_fast_path = 1;
+	net->send_count = 0;
+	rdp_send_input_mouse(rdp, 0, PTRFLAGS_MOVE, 10, 20);
+	rdp_send_input_mouse(rdp, 0, PTRFLAGS_MOVE, 30, 40);
+	rdp_send_input_mouse(rdp, 0, PTRFLAGS_DOWN | PTRFLAGS_BUTTON1, 30, 40);
+	rdp_send_input_mouse(rdp, 0, PTRFLAGS_MOVE, 50, 60);
+	rdp_send_input_scancode(rdp, 0, False, False, 0x1E);
+	rdp_send_input_mouse(rdp, 0, PTRFLAGS_MOVE, 70, 80);
+	CU_ASSERT(net->send_length == 0);
+
+	rdp_flush_input(rdp);
+	network_flush(net);
+	CU_ASSERT(net->send_count == 1);
+
+	p = test_put_fp_header(expected, 5, 4 * 7 + 2);
+	p = test_put_mouse(p, PTRFLAGS_MOVE, 30, 40);
+	p = test_put_mouse(p, PTRFLAGS_DOWN | PTRFLAGS_BUTTON1, 30, 40);
+	p = test_put_mouse(p, PTRFLAGS_MOVE, 50, 60);
+	*p++ = FASTPATH_INPUT_EVENT_SCANCODE << 5;
+	*p++ = 0x1E;
+	p = test_put_mouse(p, PTRFLAGS_MOVE, 70, 80);
+
+	CU_ASSERT(test_server_expect(expected, p - expected) == True);
+	CU_ASSERT(test_server_drained() == True);
+
+	/* the queue is empty again, a flush sends nothing */
+	rdp_flush_input(rdp);
+	network_flush(net);
+	CU_ASSERT(net->send_count == 1);
+
+	rdp->use_input_fast_path = 0;
+}
+
+void test_network_input_split(void)
+{
+	uint8 expected[256];
+	uint8 * p;
+	int i;
+
+	/* numberEvents has four bits: the sixteenth event sends the first fifteen */
+	rdp->use_input_fast_path = 1;
+	net->send_count = 0;
+	for (i = 0; i < 15; i++)
+		rdp_send_input_mouse(rdp, 0, (i & 1) ? PTRFLAGS_BUTTON1 : PTRFLAGS_DOWN | PTRFLAGS_BUTTON1, i, 2 * i);
+	CU_ASSERT(net->send_length == 0);
+
+	rdp_send_input_scancode(rdp, 0, True, False, 0x2A);
+	CU_ASSERT(net->send_length > 0);
+	rdp_send_input_mouse(rdp, 0, PTRFLAGS_MOVE, 100, 200);
+
+	rdp_flush_input(rdp);
+	network_flush(net);
+	CU_ASSERT(net->send_count == 1);
+
+	p = test_put_fp_header(expected, 15, 15 * 7);
+	for (i = 0; i < 15; i++)
+		p = test_put_mouse(p, (i & 1) ? PTRFLAGS_BUTTON1 : PTRFLAGS_DOWN | PTRFLAGS_BUTTON1, i, 2 * i);
+
+	p = test_put_fp_header(p, 2, 2 + 7);
+	*p++ = (FASTPATH_INPUT_EVENT_SCANCODE << 5) | FASTPATH_INPUT_KBDFLAGS_RELEASE;
+	*p++ = 0x2A;
+	p = test_put_mouse(p, PTRFLAGS_MOVE, 100, 200);
+
+	CU_ASSERT(test_server_expect(expected, p - expected) == True);
+	CU_ASSERT(test_server_drained() == True);
+
+	rdp->use_input_fast_path = 0;
+}
+
+enum
+{
+	TEST_LISTENER_OK,		/* accepts */
+	TEST_LISTENER_REFUSED,		/* bound but not listening, refuses */
+	TEST_LISTENER_UNRESPONSIVE	/* backlog full, drops the SYN */
+};
+
+static int test_filler_fd = -1;
+
+/* a listener on a free loopback port, described in address */
+static int
+test_listener(int kind, struct sockaddr_in * addr)
+{
+	socklen_t len = sizeof(struct sockaddr_in);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	memset(addr, 0, sizeof(struct sockaddr_in));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	bind(fd, (struct sockaddr *) addr, sizeof(struct sockaddr_in));
+	getsockname(fd, (struct sockaddr *) addr, &len);
+
+	if (kind == TEST_LISTENER_OK)
+	{
+		listen(fd, 8);
+	}
+	else if (kind == TEST_LISTENER_UNRESPONSIVE)
+	{
+		/* the one connection a zero backlog queues, never accepted */
+		listen(fd, 0);
+		test_filler_fd = socket(AF_INET, SOCK_STREAM, 0);
+		fcntl(test_filler_fd, F_SETFL, O_NONBLOCK);
+		connect(test_filler_fd, (struct sockaddr *) addr, sizeof(struct sockaddr_in));
+		tcp_can_send(test_filler_fd, 1000);
+	}
+
+	return fd;
+}
+
+static void
+test_listener_close(int fd)
+{
+	close(fd);
+	if (test_filler_fd != -1)
+	{
+		close(test_filler_fd);
+		test_filler_fd = -1;
+	}
+}
+
+static int
+test_elapsed(struct timeval * start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_usec - start->tv_usec) / 1000;
+}
+
+/* the port the connected socket ended up on */
+static int
+test_peer_port(int sockfd)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+
+	if (getpeername(sockfd, (struct sockaddr *) &addr, &len) != 0)
+		return -1;
+	return ntohs(addr.sin_port);
+}
+
+static void
+test_address(TCP_ADDRESS * address, struct sockaddr_in * addr)
+{
+	address->family = AF_INET;
+	address->addr = (struct sockaddr *) addr;
+	address->addrlen = sizeof(struct sockaddr_in);
+}
+
+void test_network_connect_refused(void)
+{
+	struct sockaddr_in addr[2];
+	TCP_ADDRESS addresses[2];
+	struct timeval start;
+	int fds[2];
+	int sockfd;
+
+	fds[0] = test_listener(TEST_LISTENER_REFUSED, &addr[0]);
+	fds[1] = test_listener(TEST_LISTENER_OK, &addr[1]);
+	test_address(&addresses[0], &addr[0]);
+	test_address(&addresses[1], &addr[1]);
+
+	/* a refusal starts the next address without waiting out the stagger */
+	gettimeofday(&start, NULL);
+	sockfd = tcp_connect_race(addresses, 2, 2000, 10000);
+	CU_ASSERT(sockfd != -1);
+	CU_ASSERT(test_elapsed(&start) < 1000);
+	CU_ASSERT(test_peer_port(sockfd) == ntohs(addr[1].sin_port));
+
+	close(sockfd);
+	test_listener_close(fds[0]);
+	test_listener_close(fds[1]);
+}
+
+void test_network_connect_unresponsive(void)
+{
+	struct sockaddr_in addr[3];
+	TCP_ADDRESS addresses[3];
+	struct timeval start;
+	int fds[3];
+	int sockfd;
+	int elapsed;
+
+	fds[0] = test_listener(TEST_LISTENER_UNRESPONSIVE, &addr[0]);
+	fds[1] = test_listener(TEST_LISTENER_OK, &addr[1]);
+	fds[2] = test_listener(TEST_LISTENER_OK, &addr[2]);
+	test_address(&addresses[0], &addr[0]);
+	test_address(&addresses[1], &addr[1]);
+	test_address(&addresses[2], &addr[2]);
+
+	/* the dead first address costs one stagger, not the OS timeout, and
+	   the second one wins before the third is tried */
+	gettimeofday(&start, NULL);
+	sockfd = tcp_connect_race(addresses, 3, 200, 10000);
+	elapsed = test_elapsed(&start);
+	CU_ASSERT(sockfd != -1);
+	CU_ASSERT(elapsed >= 150);
+	CU_ASSERT(elapsed < 2000);
+	CU_ASSERT(test_peer_port(sockfd) == ntohs(addr[1].sin_port));
+
+	close(sockfd);
+	test_listener_close(fds[0]);
+	test_listener_close(fds[1]);
+	test_listener_close(fds[2]);
+}
+
+void test_network_connect_timeout(void)
+{
+	struct sockaddr_in addr[2];
+	TCP_ADDRESS addresses[2];
+	struct timeval start;
+	int fds[2];
+	int elapsed;
+
+	fds[0] = test_listener(TEST_LISTENER_UNRESPONSIVE, &addr[0]);
+	fds[1] = test_listener(TEST_LISTENER_REFUSED, &addr[1]);
+	test_address(&addresses[0], &addr[0]);
+	test_address(&addresses[1], &addr[1]);
+
+	gettimeofday(&start, NULL);
+	CU_ASSERT(tcp_connect_race(addresses, 2, 100, 500) == -1);
+	elapsed = test_elapsed(&start);
+	CU_ASSERT(elapsed >= 450);
+	CU_ASSERT(elapsed < 3000);
+
+	test_listener_close(fds[0]);
+	test_listener_close(fds[1]);
+}
@@ -0,0 +1,43 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Network Receive Unit Tests
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "test_freerdp.h"
+
+int init_network_suite(void);
+int clean_network_suite(void);
+int add_network_suite(void);
+
+void
+test_network_recv_batched(void);
+void
+test_network_recv_large(void);
+void
+test_network_send_batched(void);
+void
+test_network_send_before_recv(void);
+void
+test_network_input_coalesced(void);
+void
+test_network_input_split(void);
+void
+test_network_connect_refused(void);
+void
+test_network_connect_unresponsive(void);
+void
+test_network_connect_timeout(void);
@@ -0,0 +1,141 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Wait Object Unit Tests
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <freerdp/utils/wait_obj.h>
+#include "test_wait_obj.h"
+
+#define TEST_NUM_ROUNDS 20000
+
+static struct wait_obj * ping;
+static struct wait_obj * pong;
+
+int init_wait_obj_suite(void)
+{
+	ping = wait_obj_new("testping");
+	pong = wait_obj_new("testpong");
+	if (ping == NULL || pong == NULL)
+		return 1;
+	return 0;
+}
+
+int clean_wait_obj_suite(void)
+{
+	wait_obj_free(ping);
+	wait_obj_free(pong);
+	return 0;
+}
+
+int add_wait_obj_suite(void)
+{
+	add_test_suite(wait_obj);
+
+	add_test_function(wait_obj_set_clear);
+	add_test_function(wait_obj_select);
+	add_test_function(wait_obj_threads);
+
+	return 0;
+}
+
+void test_wait_obj_set_clear(void)
+{
+	CU_ASSERT(wait_obj_is_set(ping) == 0);
+	CU_ASSERT(wait_obj_set(ping) == 0);
+	CU_ASSERT(wait_obj_is_set(ping) != 0);
+	/* setting twice needs one clear */
+	CU_ASSERT(wait_obj_set(ping) == 0);
+	CU_ASSERT(wait_obj_clear(ping) == 0);
+	CU_ASSERT(wait_obj_is_set(ping) == 0);
+	CU_ASSERT(wait_obj_clear(ping) == 0);
+	CU_ASSERT(wait_obj_is_set(ping) == 0);
+}
+
+void test_wait_obj_select(void)
+{
+	struct wait_obj * listobj[2];
+	int many[64];
+	int fds[2];
+	char byte;
+	int i;
+
+	listobj[0] = ping;
+	listobj[1] = pong;
+	CU_ASSERT(wait_obj_select(listobj, 2, NULL, 0, 0) == 0);
+
+	wait_obj_set(pong);
+	CU_ASSERT(wait_obj_select(listobj, 2, NULL, 0, -1) == 1);
+	wait_obj_clear(pong);
+	CU_ASSERT(wait_obj_select(listobj, 2, NULL, 0, 10) == 0);
+
+	/* plain fds are waited on alongside the objects */
+	if (pipe(fds) != 0)
+	{
+		CU_FAIL("pipe failed");
+		return;
+	}
+	CU_ASSERT(wait_obj_select(listobj, 2, fds, 1, 0) == 0);
+	CU_ASSERT(write(fds[1], "x", 1) == 1);
+	CU_ASSERT(wait_obj_select(listobj, 2, fds, 1, -1) == 1);
+	CU_ASSERT(read(fds[0], &byte, 1) == 1);
+
+	/* too many to wait on fails rather than leaving some out */
+	for (i = 0; i < 64; i++)
+		many[i] = fds[0];
+	CU_ASSERT(wait_obj_select(listobj, 2, many, 62, 0) == 0);
+	CU_ASSERT(wait_obj_select(listobj, 2, many, 63, -1) == -1);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static void *
+test_pong_thread(void * arg)
+{
+	int i;
+
+	for (i = 0; i < TEST_NUM_ROUNDS; i++)
+	{
+		while (!wait_obj_is_set(ping))
+			wait_obj_select(&ping, 1, NULL, 0, -1);
+		wait_obj_clear(ping);
+		wait_obj_set(pong);
+	}
+	return NULL;
+}
+
+/* every set has to wake the other side, a lost wake up hangs the test */
+void test_wait_obj_threads(void)
+{
+	pthread_t thread;
+	int i;
+
+	pthread_create(&thread, NULL, test_pong_thread, NULL);
+	for (i = 0; i < TEST_NUM_ROUNDS; i++)
+	{
+		wait_obj_set(ping);
+		while (!wait_obj_is_set(pong))
+			wait_obj_select(&pong, 1, NULL, 0, -1);
+		wait_obj_clear(pong);
+	}
+	pthread_join(thread, NULL);
+
+	CU_ASSERT(wait_obj_is_set(ping) == 0);
+	CU_ASSERT(wait_obj_is_set(pong) == 0);
+}
@@ -55,23 +55,30 @@ l_ui_gdi_begin_update(struct rdp_inst * inst)
 {
 	GDI *gdi = GET_GDI(inst);
 	gdi->primary->hdc->hwnd->invalid->null = 1;
+	gdi->primary->hdc->hwnd->ninvalid = 0;
 }
 
 static void
 l_ui_gdi_end_update(struct rdp_inst * inst)
 {
+	int i;
+	HGDI_RGN cinvalid;
 	dfbInfo *dfbi = GET_DFBI(inst);
 	GDI *gdi = GET_GDI(inst);
 
 	if (gdi->primary->hdc->hwnd->invalid->null)
 		return;
 
-	dfbi->update_rect.x = gdi->primary->hdc->hwnd->invalid->x;
-	dfbi->update_rect.y = gdi->primary->hdc->hwnd->invalid->y;
-	dfbi->update_rect.w = gdi->primary->hdc->hwnd->invalid->w;
-	dfbi->update_rect.h = gdi->primary->hdc->hwnd->invalid->h;
+	cinvalid = gdi->primary->hdc->hwnd->cinvalid;
+	for (i = 0; i < gdi->primary->hdc->hwnd->ninvalid; i++)
+	{
+		dfbi->update_rect.x = cinvalid[i].x;
+		dfbi->update_rect.y = cinvalid[i].y;
+		dfbi->update_rect.w = cinvalid[i].w;
+		dfbi->update_rect.h = cinvalid[i].h;
 
-	dfbi->primary->Blit(dfbi->primary, dfbi->surface, &(dfbi->update_rect), dfbi->update_rect.x, dfbi->update_rect.y);
+		dfbi->primary->Blit(dfbi->primary, dfbi->surface, &(dfbi->update_rect), dfbi->update_rect.x, dfbi->update_rect.y);
+	}
 }
 
 static void
@@ -522,7 +529,7 @@ dfb_post_connect(rdpInst * inst)
 	if (inst->settings->software_gdi == 1)
 	{
 		GDI *gdi;
-		gdi_init(inst, CLRCONV_ALPHA | CLRBUF_16BPP | CLRBUF_32BPP);
+		gdi_init(inst, CLRCONV_ALPHA | CLRBUF_16BPP | CLRBUF_32BPP, NULL);
 		gdi = GET_GDI(inst);
 
 		dfbi->err = DirectFBCreate(&(dfbi->dfb));
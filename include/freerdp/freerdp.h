@@ -28,7 +28,7 @@
 #include "vchan.h"
 
 
-#define FREERDP_INTERFACE_VERSION 4
+#define FREERDP_INTERFACE_VERSION 5
 
 #if defined _WIN32 || defined __CYGWIN__
   #ifdef FREERDP_EXPORTS
@@ -72,6 +72,9 @@ struct rdp_inst
 	void * param3;
 	void * param4;
 	uint32 disc_reason;
+	/* set by rdp_get_fds, changes when the returned socket is a new one,
+	   even if it got the number of the old one */
+	uint32 sock_generation;
 	/* calls from ui to library */
 	int (* rdp_connect)(rdpInst * inst);
 	int (* rdp_get_fds)(rdpInst * inst, void ** read_fds, int * read_count,
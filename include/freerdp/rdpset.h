@@ -55,6 +55,7 @@ struct rdp_set
 	char directory[256];
 	char username[256];
 	int tcp_port_rdp;
+	int tcp_connect_timeout; /* milliseconds, 0 for the default */
 	int keyboard_layout;
 	int keyboard_type;
 	int keyboard_subtype;
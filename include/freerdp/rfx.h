@@ -64,6 +64,12 @@ extern "C" {
 /* properties.qt */
 #define SCALAR_QUANTIZATION	0x1
 
+/* adaptive quantization levels, from fine to coarse */
+#define RFX_QUANT_FINE		0
+#define RFX_QUANT_MEDIUM	1
+#define RFX_QUANT_COARSE	2
+#define RFX_QUANT_LEVELS	3
+
 enum _RLGR_MODE
 {
 	RLGR1,
@@ -97,11 +103,21 @@ struct _RFX_TILE
 };
 typedef struct _RFX_TILE RFX_TILE;
 
+/*
+ * Per-context arena recycling the tiles and messages between frames, so that
+ * decoding does not touch the heap once the first frames have been seen.
+ * At most max_count free tiles are kept, the rest is released.
+ */
 struct _RFX_POOL
 {
 	int size;
 	int count;
+	int max_count;
 	RFX_TILE **tiles;
+
+	struct _RFX_MESSAGE * message; /* spare message, with its arrays */
+
+	uint32 allocations; /* heap allocations made for messages, for tests */
 };
 typedef struct _RFX_POOL RFX_POOL;
 
@@ -121,6 +137,10 @@ struct _RFX_MESSAGE
 	 */
 	uint16 num_tiles;
 	RFX_TILE** tiles;
+
+	/* allocated length of the rects and tiles arrays */
+	int max_rects;
+	int max_tiles;
 };
 typedef struct _RFX_MESSAGE RFX_MESSAGE;
 
@@ -141,6 +161,7 @@ struct _RFX_CONTEXT
 	uint32 frame_idx;
 	uint8 num_quants;
 	uint32 * quants;
+	int max_quants;
 	uint8 quant_idx_y;
 	uint8 quant_idx_cb;
 	uint8 quant_idx_cr;
@@ -161,6 +182,43 @@ struct _RFX_CONTEXT
 
 	sint16 * dwt_buffer;
 
+	/* worker threads used to decode and encode the tiles of a tileset in parallel */
+	int num_threads;
+	struct _THREAD_POOL * thread_pool;
+	struct _RFX_TILE_JOB * tile_jobs;
+	int max_tile_jobs;
+	struct _RFX_ENCODE_JOB * encode_jobs;
+	int max_encode_jobs;
+	uint8 * encode_buffer;
+	int max_encode_slots;
+
+	/* set while rfx_process_message_ex decodes into a caller framebuffer */
+	struct _RFX_DESTINATION * destination;
+	RFX_RECT * dst_rects;
+	int max_dst_rects;
+
+	/* encoder tile differencing: copy of the last frame and the tiles that changed */
+	int differencing;
+	uint8 * shadow;
+	int shadow_width;
+	int shadow_height;
+	uint8 * dirty_tiles;
+	RFX_RECT * dirty_rects;
+	int num_dirty_rects;
+	int max_dirty_tiles;
+
+	/*
+	 * encoder quantization control: with adaptive_quant the tileset carries
+	 * a fine, medium and coarse set per component and each tile picks one
+	 * by how detailed it is. With tile_budget set, quant_offset moves all
+	 * sets up or down from frame to frame to keep the average encoded tile
+	 * near that many bytes.
+	 */
+	int adaptive_quant;
+	int tile_budget;
+	int quant_offset;
+	uint32 encode_quants[RFX_QUANT_LEVELS * 3 * 10];
+
 	/* routines */
 	void (* decode_YCbCr_to_RGB)(sint16 * y_r_buf, sint16 * cb_g_buf, sint16 * cr_b_buf);
 	void (* encode_RGB_to_YCbCr)(sint16 * y_r_buf, sint16 * cb_g_buf, sint16 * cr_b_buf);
@@ -193,8 +251,16 @@ typedef struct _RFX_CONTEXT RFX_CONTEXT;
 RFX_CONTEXT* rfx_context_new(void);
 void rfx_context_free(RFX_CONTEXT * context);
 void rfx_context_set_pixel_format(RFX_CONTEXT * context, RFX_PIXEL_FORMAT pixel_format);
+void rfx_context_set_num_threads(RFX_CONTEXT * context, int num_threads);
+void rfx_context_set_pool_limit(RFX_CONTEXT * context, int max_tiles);
+void rfx_context_set_differencing(RFX_CONTEXT * context, int enabled);
+void rfx_context_set_adaptive_quant(RFX_CONTEXT * context, int enabled);
+void rfx_context_set_tile_budget(RFX_CONTEXT * context, int bytes_per_tile);
 
 RFX_MESSAGE* rfx_process_message(RFX_CONTEXT * context, uint8 * data, int size);
+RFX_MESSAGE* rfx_process_message_ex(RFX_CONTEXT * context, uint8 * data, int size,
+	int left, int top, uint8 * dst, int dst_width, int dst_height, int dst_stride,
+	RFX_PIXEL_FORMAT dst_format, const RFX_RECT * clip_rects, int num_clip_rects);
 void rfx_message_free(RFX_CONTEXT * context, RFX_MESSAGE * message);
 
 int rfx_compose_message_header(RFX_CONTEXT * context, uint8 * buffer, int buffer_size);
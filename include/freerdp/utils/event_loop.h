@@ -0,0 +1,37 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Event Loop
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __UTILS_EVENT_LOOP_H
+#define __UTILS_EVENT_LOOP_H
+
+#define EVENT_LOOP_READ		0x01
+#define EVENT_LOOP_WRITE	0x02
+
+/* Called with the EVENT_LOOP_* conditions fd is ready for. A non-zero
+   return stops event_loop_wait, which then returns -1. */
+typedef int (*EVENT_LOOP_CALLBACK)(int fd, int events, void * arg);
+
+typedef struct _EVENT_LOOP EVENT_LOOP;
+
+EVENT_LOOP * event_loop_new(void);
+void event_loop_free(EVENT_LOOP * loop);
+
+int event_loop_add(EVENT_LOOP * loop, int fd, int events, EVENT_LOOP_CALLBACK callback, void * arg);
+int event_loop_remove(EVENT_LOOP * loop, int fd);
+int event_loop_wait(EVENT_LOOP * loop, int timeout);
+
+#endif /* __UTILS_EVENT_LOOP_H */
@@ -0,0 +1,37 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Worker Thread Pool
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __UTILS_THREAD_POOL_H
+#define __UTILS_THREAD_POOL_H
+
+/*
+   A job gets the scratch of the thread running it: the one made for a
+   worker by the pool's scratch_new, or the one passed to thread_pool_run
+   when the calling thread takes the job.
+*/
+typedef void (* THREAD_JOB_FUNC)(void * arg, int index, void * scratch);
+typedef void * (* THREAD_SCRATCH_NEW)(void);
+typedef void (* THREAD_SCRATCH_FREE)(void * scratch);
+
+typedef struct _THREAD_POOL THREAD_POOL;
+
+int thread_pool_get_num_cpus(void);
+THREAD_POOL * thread_pool_new(int num_workers, THREAD_SCRATCH_NEW scratch_new, THREAD_SCRATCH_FREE scratch_free);
+void thread_pool_free(THREAD_POOL * pool);
+void thread_pool_run(THREAD_POOL * pool, THREAD_JOB_FUNC func, void * arg, int num_jobs, void * scratch);
+
+#endif /* __UTILS_THREAD_POOL_H */
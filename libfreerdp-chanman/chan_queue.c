@@ -0,0 +1,107 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Virtual Channel Manager - Plugin To Main Thread Queue
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#define ATOMIC_CAS(p, o, n) \
+	(InterlockedCompareExchange((LONG volatile *) (p), (LONG) (n), (LONG) (o)) == (LONG) (o))
+#define MEMORY_BARRIER() MemoryBarrier()
+#else
+#define ATOMIC_CAS(p, o, n) __sync_bool_compare_and_swap(p, o, n)
+#define MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+#include "chan_queue.h"
+
+#define CHAN_QUEUE_MASK (CHAN_QUEUE_SIZE - 1)
+
+void
+chan_queue_init(struct chan_queue * queue)
+{
+	uint32 index;
+
+	memset(queue, 0, sizeof(struct chan_queue));
+	for (index = 0; index < CHAN_QUEUE_SIZE; index++)
+		queue->slots[index].sequence = index;
+}
+
+/* can be called from any thread, returns 0 when the queue is full */
+int
+chan_queue_push(struct chan_queue * queue, struct chan_queue_item * item)
+{
+	struct chan_queue_slot * slot;
+	uint32 pos;
+	int diff;
+
+	pos = queue->tail;
+	while (1)
+	{
+		slot = queue->slots + (pos & CHAN_QUEUE_MASK);
+		diff = (int) (slot->sequence - pos);
+		if (diff == 0)
+		{
+			/* free for this position, claim it */
+			if (ATOMIC_CAS(&queue->tail, pos, pos + 1))
+				break;
+		}
+		else if (diff < 0)
+		{
+			/* still holds the item from one lap ago */
+			return 0;
+		}
+		pos = queue->tail;
+	}
+
+	slot->item = *item;
+	/* publish the item only after it is written */
+	MEMORY_BARRIER();
+	slot->sequence = pos + 1;
+	return 1;
+}
+
+/* called only from the consuming thread, returns 0 when nothing is ready */
+int
+chan_queue_pop(struct chan_queue * queue, struct chan_queue_item * item)
+{
+	struct chan_queue_slot * slot;
+	uint32 pos;
+
+	pos = queue->head;
+	slot = queue->slots + (pos & CHAN_QUEUE_MASK);
+	if ((int) (slot->sequence - (pos + 1)) < 0)
+		return 0;
+
+	MEMORY_BARRIER();
+	*item = slot->item;
+	MEMORY_BARRIER();
+	/* hand the slot to the push one lap ahead */
+	slot->sequence = pos + CHAN_QUEUE_SIZE;
+	queue->head = pos + 1;
+	return 1;
+}
+
+/* called only from the consuming thread, true when a pop would succeed */
+int
+chan_queue_pending(struct chan_queue * queue)
+{
+	struct chan_queue_slot * slot;
+
+	slot = queue->slots + (queue->head & CHAN_QUEUE_MASK);
+	return (int) (slot->sequence - (queue->head + 1)) >= 0;
+}
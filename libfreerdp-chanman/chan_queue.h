@@ -0,0 +1,61 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Virtual Channel Manager - Plugin To Main Thread Queue
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __CHAN_QUEUE_H
+#define __CHAN_QUEUE_H
+
+#include <freerdp/types/base.h>
+
+/* must be a power of 2 */
+#define CHAN_QUEUE_SIZE 64
+
+struct chan_queue_item
+{
+	int index;
+	void * data;
+	uint32 data_length;
+	void * user_data;
+};
+
+struct chan_queue_slot
+{
+	volatile uint32 sequence;
+	struct chan_queue_item item;
+};
+
+/*
+   Bounded queue any number of threads push to and one thread pops from,
+   without locks. Each slot carries a sequence number telling whether it is
+   free for the push at that position or holds the item for the pop there.
+*/
+struct chan_queue
+{
+	struct chan_queue_slot slots[CHAN_QUEUE_SIZE];
+	volatile uint32 head;	/* next pop, only the consumer moves it */
+	volatile uint32 tail;	/* next push, producers claim it by compare and swap */
+};
+
+void
+chan_queue_init(struct chan_queue * queue);
+int
+chan_queue_push(struct chan_queue * queue, struct chan_queue_item * item);
+int
+chan_queue_pop(struct chan_queue * queue, struct chan_queue_item * item);
+int
+chan_queue_pending(struct chan_queue * queue);
+
+#endif /* __CHAN_QUEUE_H */
@@ -47,6 +47,7 @@
 #define SEMAPHORE_WAIT(s) WaitForSingleObject(s, INFINITE)
 #define SEMAPHORE_POST(s) ReleaseSemaphore(s, 1, NULL)
 #define SEMAPHORE_DESTROY(s) CloseHandle(s)
+#define ATOMIC_EXCHANGE(p, v) InterlockedExchange((LONG volatile *) (p), v)
 #define CHR TCHAR
 #define DLOPEN(f) LoadLibrary(f)
 #define DLSYM(f, n) GetProcAddress(f, n)
@@ -69,6 +70,7 @@
 #define SEMAPHORE_WAIT(s) sem_wait(&s)
 #define SEMAPHORE_POST(s) sem_post(&s)
 #define SEMAPHORE_DESTROY(s) sem_destroy(&s)
+#define ATOMIC_EXCHANGE(p, v) (__sync_synchronize(), __sync_lock_test_and_set(p, v))
 #define CHR char
 #define DLOPEN(f) dlopen(f, RTLD_LOCAL | RTLD_LAZY)
 #define DLSYM(f, n) dlsym(f, n)
@@ -82,6 +84,7 @@
 #include <freerdp/utils/chan_plugin.h>
 
 #include "libchanman.h"
+#include "chan_queue.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -130,6 +133,7 @@ struct chan_data
 	int options;
 	int flags; /* 0 nothing 1 init 2 open */
 	PCHANNEL_OPEN_EVENT_FN open_event_proc;
+	int chan_id; /* rdp channel id, set in post_connect, 0 if not joined */
 };
 
 struct rdp_chan_man
@@ -144,6 +148,10 @@ struct rdp_chan_man
 	int num_libs;
 	struct chan_data chans[CHANNEL_MAX_COUNT];
 	int num_chans;
+	/* chans entries indexed by rdp channel id - chan_id_base, the ids
+	   are handed out in sequence. Set in post_connect */
+	struct chan_data * chans_by_id[CHANNEL_MAX_COUNT];
+	int chan_id_base;
 	rdpInitHandle init_handles[CHANNEL_MAX_COUNT];
 	int num_init_handles;
 
@@ -157,22 +165,23 @@ struct rdp_chan_man
 	/* used for locating the chan_man for a given instance */
 	rdpInst * inst;
 
-	/* used for sync write */
-	SEMAPHORE sem;
+	/* wakes up the main thread, set once for everything queued until
+	   freerdp_chanman_check_fds runs */
 #ifdef _WIN32
 	HANDLE chan_event;
 #else
 	int pipe_fd[2];
 #endif
+	volatile long signalled;
 
-	void * sync_data;
-	uint32 sync_data_length;
-	void * sync_user_data;
-	int sync_index;
+	/* writes queued for the main thread, sem counts the free slots */
+	SEMAPHORE sem;
+	struct chan_queue data_queue;
 
-	/* used for sync event */
+	/* events queued for freerdp_chanman_pop_event, sem_event counts the
+	   free slots */
 	SEMAPHORE sem_event;
-	RD_EVENT * event;
+	struct chan_queue event_queue;
 };
 
 /* returns the chan_man for the open handle passed in */
@@ -270,29 +279,52 @@ freerdp_chanman_find_rdp_chan_by_id(rdpChanMan * chan_man, rdpSet * settings,
 	return 0;
 }
 
-/* returns struct rdp_chan for the channel name passed in */
-static struct rdp_chan *
-freerdp_chanman_find_rdp_chan_by_name(rdpChanMan * chan_man, rdpSet * settings,
-	const char * chan_name, int * pindex)
+/* fill in the rdp channel ids and chans_by_id, once they are known
+   called only from main thread */
+static void
+freerdp_chanman_index_channels(rdpChanMan * chan_man, rdpSet * settings)
 {
-	int lindex;
-	int lcount;
+	int index;
+	int slot;
 	struct rdp_chan * lrdp_chan;
+	struct chan_data * lchan_data;
 
-	lcount = settings->num_channels;
-	for (lindex = 0; lindex < lcount; lindex++)
+	memset(chan_man->chans_by_id, 0, sizeof(chan_man->chans_by_id));
+	chan_man->chan_id_base = (settings->num_channels > 0) ? settings->channels[0].chan_id : 0;
+	for (index = 0; index < settings->num_channels; index++)
 	{
-		lrdp_chan = settings->channels + lindex;
-		if (strcmp(chan_name, lrdp_chan->name) == 0)
-		{
-			if (pindex != 0)
-			{
-				*pindex = lindex;
-			}
-			return lrdp_chan;
-		}
+		lrdp_chan = settings->channels + index;
+		lchan_data = freerdp_chanman_find_chan_data_by_name(chan_man, lrdp_chan->name, 0);
+		if (lchan_data == 0)
+			continue;
+		lchan_data->chan_id = lrdp_chan->chan_id;
+		slot = lrdp_chan->chan_id - chan_man->chan_id_base;
+		if ((slot >= 0) && (slot < CHANNEL_MAX_COUNT))
+			chan_man->chans_by_id[slot] = lchan_data;
 	}
-	return 0;
+}
+
+/* returns struct chan_data for the rdp channel id passed in */
+static struct chan_data *
+freerdp_chanman_find_chan_data_by_id(rdpChanMan * chan_man, rdpSet * settings, int chan_id)
+{
+	int slot;
+	struct rdp_chan * lrdp_chan;
+	struct chan_data * lchan_data;
+
+	slot = chan_id - chan_man->chan_id_base;
+	if ((slot >= 0) && (slot < CHANNEL_MAX_COUNT))
+	{
+		lchan_data = chan_man->chans_by_id[slot];
+		if ((lchan_data != 0) && (lchan_data->chan_id == chan_id))
+			return lchan_data;
+	}
+
+	/* ids out of sequence */
+	lrdp_chan = freerdp_chanman_find_rdp_chan_by_id(chan_man, settings, chan_id, 0);
+	if (lrdp_chan == 0)
+		return 0;
+	return freerdp_chanman_find_chan_data_by_name(chan_man, lrdp_chan->name, 0);
 }
 
 /* must be called by same thread that calls freerdp_chanman_load_plugin
@@ -500,6 +532,16 @@ freerdp_chanman_set_ev(rdpChanMan * chan_man)
 #endif
 }
 
+/* can be called from any thread, after queueing */
+static void
+freerdp_chanman_signal(rdpChanMan * chan_man)
+{
+	if (ATOMIC_EXCHANGE(&chan_man->signalled, 1) == 0)
+	{
+		freerdp_chanman_set_ev(chan_man);
+	}
+}
+
 static void
 freerdp_chanman_clear_ev(rdpChanMan * chan_man)
 {
@@ -527,6 +569,7 @@ MyVirtualChannelWrite(uint32 openHandle, void * pData, uint32 dataLength,
 	rdpChanMan * chan_man;
 	struct chan_data * lchan;
 	int index;
+	struct chan_queue_item item;
 
 	chan_man = freerdp_chanman_find_by_open_handle(openHandle, &index);
 	if ((chan_man == NULL) || (index < 0) || (index >= CHANNEL_MAX_COUNT))
@@ -555,19 +598,20 @@ MyVirtualChannelWrite(uint32 openHandle, void * pData, uint32 dataLength,
 		DEBUG_CHANMAN("MyVirtualChannelWrite: error not open");
 		return CHANNEL_RC_NOT_OPEN;
 	}
-	SEMAPHORE_WAIT(chan_man->sem); /* lock chan_man->sync* vars */
+	SEMAPHORE_WAIT(chan_man->sem); /* wait for a free slot in data_queue */
 	if (!chan_man->is_connected)
 	{
 		SEMAPHORE_POST(chan_man->sem);
 		DEBUG_CHANMAN("MyVirtualChannelWrite: error not connected");
 		return CHANNEL_RC_NOT_CONNECTED;
 	}
-	chan_man->sync_data = pData;
-	chan_man->sync_data_length = dataLength;
-	chan_man->sync_user_data = pUserData;
-	chan_man->sync_index = index;
+	item.index = index;
+	item.data = pData;
+	item.data_length = dataLength;
+	item.user_data = pUserData;
+	chan_queue_push(&chan_man->data_queue, &item);
 	/* set the event */
-	freerdp_chanman_set_ev(chan_man);
+	freerdp_chanman_signal(chan_man);
 	return CHANNEL_RC_OK;
 }
 
@@ -578,6 +622,7 @@ MyVirtualChannelEventPush(uint32 openHandle,
 	rdpChanMan * chan_man;
 	struct chan_data * lchan;
 	int index;
+	struct chan_queue_item item;
 
 	chan_man = freerdp_chanman_find_by_open_handle(openHandle, &index);
 	if ((chan_man == NULL) || (index < 0) || (index >= CHANNEL_MAX_COUNT))
@@ -601,16 +646,20 @@ MyVirtualChannelEventPush(uint32 openHandle,
 		DEBUG_CHANMAN("MyVirtualChannelEventPush: error not open");
 		return CHANNEL_RC_NOT_OPEN;
 	}
-	SEMAPHORE_WAIT(chan_man->sem_event); /* lock chan_man->event */
+	SEMAPHORE_WAIT(chan_man->sem_event); /* wait for a free slot in event_queue */
 	if (!chan_man->is_connected)
 	{
 		SEMAPHORE_POST(chan_man->sem_event);
 		DEBUG_CHANMAN("MyVirtualChannelEventPush: error not connected");
 		return CHANNEL_RC_NOT_CONNECTED;
 	}
-	chan_man->event = event;
+	item.index = index;
+	item.data = event;
+	item.data_length = 0;
+	item.user_data = NULL;
+	chan_queue_push(&chan_man->event_queue, &item);
 	/* set the event */
-	freerdp_chanman_set_ev(chan_man);
+	freerdp_chanman_signal(chan_man);
 	return CHANNEL_RC_OK;
 }
 
@@ -652,8 +701,10 @@ freerdp_chanman_new(void)
 	chan_man = (rdpChanMan *) malloc(sizeof(rdpChanMan));
 	memset(chan_man, 0, sizeof(rdpChanMan));
 
-	SEMAPHORE_INIT(chan_man->sem, 0, 1); /* start at 1 */
-	SEMAPHORE_INIT(chan_man->sem_event, 0, 1); /* start at 1 */
+	chan_queue_init(&chan_man->data_queue);
+	chan_queue_init(&chan_man->event_queue);
+	SEMAPHORE_INIT(chan_man->sem, 0, CHAN_QUEUE_SIZE); /* start at CHAN_QUEUE_SIZE */
+	SEMAPHORE_INIT(chan_man->sem_event, 0, CHAN_QUEUE_SIZE); /* start at CHAN_QUEUE_SIZE */
 #ifdef _WIN32
 	chan_man->chan_event = CreateEvent(NULL, TRUE, FALSE, NULL);
 #else
@@ -914,6 +965,7 @@ freerdp_chanman_post_connect(rdpChanMan * chan_man, rdpInst * inst)
 	struct lib_data * llib;
 	char * server_name;
 
+	freerdp_chanman_index_channels(chan_man, inst->settings);
 	chan_man->is_connected = 1;
 	server_name = inst->settings->server;
 	server_name_len = strlen(server_name);
@@ -938,9 +990,7 @@ freerdp_chanman_data(rdpInst * inst, int chan_id, char * data, int data_size,
 	int flags, int total_size)
 {
 	rdpChanMan * chan_man;
-	struct rdp_chan * lrdp_chan;
 	struct chan_data * lchan_data;
-	int index;
 
 	chan_man = freerdp_chanman_find_by_rdp_inst(inst);
 	if (chan_man == 0)
@@ -949,18 +999,10 @@ freerdp_chanman_data(rdpInst * inst, int chan_id, char * data, int data_size,
 		return 1;
 	}
 
-	lrdp_chan = freerdp_chanman_find_rdp_chan_by_id(chan_man, inst->settings,
-		chan_id, &index);
-	if (lrdp_chan == 0)
-	{
-		DEBUG_CHANMAN("freerdp_chanman_data: could not find channel id");
-		return 1;
-	}
-	lchan_data = freerdp_chanman_find_chan_data_by_name(chan_man, lrdp_chan->name,
-		&index);
+	lchan_data = freerdp_chanman_find_chan_data_by_id(chan_man, inst->settings, chan_id);
 	if (lchan_data == 0)
 	{
-		DEBUG_CHANMAN("freerdp_chanman_data: could not find channel name");
+		DEBUG_CHANMAN("freerdp_chanman_data: could not find channel id");
 		return 1;
 	}
 	if (lchan_data->open_event_proc != 0)
@@ -972,41 +1014,27 @@ freerdp_chanman_data(rdpInst * inst, int chan_id, char * data, int data_size,
 	return 0;
 }
 
-/* called only from main thread */
+/* called only from main thread, sends all queued writes */
 static void
 freerdp_chanman_process_sync(rdpChanMan * chan_man, rdpInst * inst)
 {
-	void * ldata;
-	uint32 ldata_len;
-	void * luser_data;
-	int lindex;
+	struct chan_queue_item item;
 	struct chan_data * lchan_data;
-	struct rdp_chan * lrdp_chan;
 
-	if (chan_man->sync_data == NULL)
-		return;
-
-	ldata = chan_man->sync_data;
-	ldata_len = chan_man->sync_data_length;
-	luser_data = chan_man->sync_user_data;
-	lindex = chan_man->sync_index;
-	chan_man->sync_data = NULL;
-	chan_man->sync_data_length = 0;
-	chan_man->sync_user_data = NULL;
-	chan_man->sync_index = 0;
-	SEMAPHORE_POST(chan_man->sem); /* release chan_man->sync* vars */
-	lchan_data = chan_man->chans + lindex;
-	lrdp_chan = freerdp_chanman_find_rdp_chan_by_name(chan_man, inst->settings,
-		lchan_data->name, &lindex);
-	if (lrdp_chan != 0)
-	{
-		inst->rdp_channel_data(inst, lrdp_chan->chan_id, ldata, ldata_len);
-	}
-	if (lchan_data->open_event_proc != 0)
+	while (chan_queue_pop(&chan_man->data_queue, &item))
 	{
-		lchan_data->open_event_proc(lchan_data->open_handle,
-			CHANNEL_EVENT_WRITE_COMPLETE,
-			luser_data, sizeof(void *), sizeof(void *), 0);
+		SEMAPHORE_POST(chan_man->sem); /* release the slot */
+		lchan_data = chan_man->chans + item.index;
+		if (lchan_data->chan_id != 0)
+		{
+			inst->rdp_channel_data(inst, lchan_data->chan_id, item.data, item.data_length);
+		}
+		if (lchan_data->open_event_proc != 0)
+		{
+			lchan_data->open_event_proc(lchan_data->open_handle,
+				CHANNEL_EVENT_WRITE_COMPLETE,
+				item.user_data, sizeof(void *), sizeof(void *), 0);
+		}
 	}
 }
 
@@ -1043,6 +1071,8 @@ freerdp_chanman_check_fds(rdpChanMan * chan_man, rdpInst * inst)
 	if (freerdp_chanman_is_ev_set(chan_man))
 	{
 		freerdp_chanman_clear_ev(chan_man);
+		/* whatever is queued from here on signals again */
+		ATOMIC_EXCHANGE(&chan_man->signalled, 0);
 		freerdp_chanman_process_sync(chan_man, inst);
 	}
 	return 0;
@@ -1051,14 +1081,18 @@ freerdp_chanman_check_fds(rdpChanMan * chan_man, rdpInst * inst)
 RD_EVENT *
 freerdp_chanman_pop_event(rdpChanMan * chan_man)
 {
-	RD_EVENT * event;
+	struct chan_queue_item item;
 
-	if (chan_man->event == NULL)
+	if (!chan_queue_pop(&chan_man->event_queue, &item))
 		return NULL;
-	event = chan_man->event;
-	chan_man->event = NULL;
-	SEMAPHORE_POST(chan_man->sem_event); /* release chan_man->event */
-	return event;
+	SEMAPHORE_POST(chan_man->sem_event); /* release the slot */
+	/* the ui takes one event per wake up, have it come back for the rest */
+	if (chan_queue_pending(&chan_man->event_queue))
+	{
+		ATOMIC_EXCHANGE(&chan_man->signalled, 1);
+		freerdp_chanman_set_ev(chan_man);
+	}
+	return (RD_EVENT *) item.data;
 }
 
 void
@@ -24,7 +24,18 @@
 /* indent is confused by this file */
 /* *INDENT-OFF* */
 
+#include <limits.h>
 #include "frdp.h"
+#include "bitmap.h"
+#include <freerdp/utils/memory.h>
+
+#ifdef WITH_SSE
+#include "bitmap_sse.h"
+#endif
+
+#ifndef BITMAP_INIT_SIMD
+#define BITMAP_INIT_SIMD(_funcs) do { } while (0)
+#endif
 
 #define CVAL(p)   (*(p++))
 #ifdef NEED_ALIGN
@@ -62,6 +73,58 @@
 	} \
 }
 
+/* no kernels, the interleaved runs and the planes have plain loops */
+static BITMAP_FUNCS bitmap_funcs = { NULL, NULL, NULL };
+
+static uint8 zero[3] = { 0, 0, 0 };
+
+/* shortest run, in pixels, worth building a pattern for */
+#define RUN_MIN 16
+
+/* repeat the pixel pair a, b over the whole pattern */
+static void
+bitmap_pattern(uint8 * pattern, uint8 * a, uint8 * b, int Bpp)
+{
+	int i;
+
+	for (i = 0; i < BITMAP_PATTERN_SIZE; i += Bpp * 2)
+	{
+		memcpy(pattern + i, a, Bpp);
+		memcpy(pattern + i + Bpp, b, Bpp);
+	}
+}
+
+/* the rest of the run on this line at once, either pixel xor the line above */
+#define RUN(dst, src, a, b, Bpp) \
+{ \
+	n = MIN(count, width - x); \
+	if ((bitmap_funcs.run != NULL) && (n >= RUN_MIN)) \
+	{ \
+		bitmap_pattern(pattern, (uint8 *) (a), (uint8 *) (b), Bpp); \
+		bitmap_funcs.run((uint8 *) (dst), (uint8 *) (src), pattern, n * (Bpp)); \
+		count -= n; \
+		x += n; \
+	} \
+}
+
+/* count is in pixel pairs, bicolor is set when color2 comes next */
+#define RUN_BICOLOR(dst, a, b, Bpp) \
+{ \
+	n = MIN(count * 2 - (bicolor ? 1 : 0), width - x); \
+	if ((bitmap_funcs.run != NULL) && (n >= RUN_MIN)) \
+	{ \
+		if (bicolor) \
+			bitmap_pattern(pattern, (uint8 *) (b), (uint8 *) (a), Bpp); \
+		else \
+			bitmap_pattern(pattern, (uint8 *) (a), (uint8 *) (b), Bpp); \
+		bitmap_funcs.run((uint8 *) (dst), NULL, pattern, n * (Bpp)); \
+		count -= bicolor ? (n + 1) / 2 : n / 2; \
+		if (n & 1) \
+			bicolor = bicolor ? False : True; \
+		x += n; \
+	} \
+}
+
 /* 1 byte bitmap decompress */
 static RD_BOOL
 bitmap_decompress1(void * inst, uint8 * output, int width, int height, uint8 * input, int size)
@@ -75,6 +138,8 @@ bitmap_decompress1(void * inst, uint8 * output, int width, int height, uint8 * i
 	uint8 mixmask, mask = 0;
 	uint8 mix = 0xff;
 	int fom_mask = 0;
+	int n;
+	uint8 pattern[BITMAP_PATTERN_SIZE];
 
 	while (input < end)
 	{
@@ -183,20 +248,24 @@ bitmap_decompress1(void * inst, uint8 * output, int width, int height, uint8 * i
 					}
 					if (prevline == NULL)
 					{
+						RUN(line + x, NULL, zero, zero, 1)
 						REPEAT(line[x] = 0)
 					}
 					else
 					{
+						RUN(line + x, prevline + x, zero, zero, 1)
 						REPEAT(line[x] = prevline[x])
 					}
 					break;
 				case 1:	/* Mix */
 					if (prevline == NULL)
 					{
+						RUN(line + x, NULL, &mix, &mix, 1)
 						REPEAT(line[x] = mix)
 					}
 					else
 					{
+						RUN(line + x, prevline + x, &mix, &mix, 1)
 						REPEAT(line[x] = prevline[x] ^ mix)
 					}
 					break;
@@ -225,12 +294,14 @@ bitmap_decompress1(void * inst, uint8 * output, int width, int height, uint8 * i
 					}
 					break;
 				case 3:	/* Colour */
+					RUN(line + x, NULL, &color2, &color2, 1)
 					REPEAT(line[x] = color2)
 					break;
 				case 4:	/* Copy */
 					REPEAT(line[x] = CVAL(input))
 					break;
 				case 8:	/* Bicolor */
+					RUN_BICOLOR(line + x, &color1, &color2, 1)
 					REPEAT
 					(
 						if (bicolor)
@@ -273,6 +344,8 @@ bitmap_decompress2(void * inst, uint8 * output, int width, int height, uint8 * i
 	uint8 mixmask, mask = 0;
 	uint16 mix = 0xffff;
 	int fom_mask = 0;
+	int n;
+	uint8 pattern[BITMAP_PATTERN_SIZE];
 
 	while (input < end)
 	{
@@ -381,20 +454,24 @@ bitmap_decompress2(void * inst, uint8 * output, int width, int height, uint8 * i
 					}
 					if (prevline == NULL)
 					{
+						RUN(line + x, NULL, zero, zero, 2)
 						REPEAT(line[x] = 0)
 					}
 					else
 					{
+						RUN(line + x, prevline + x, zero, zero, 2)
 						REPEAT(line[x] = prevline[x])
 					}
 					break;
 				case 1:	/* Mix */
 					if (prevline == NULL)
 					{
+						RUN(line + x, NULL, &mix, &mix, 2)
 						REPEAT(line[x] = mix)
 					}
 					else
 					{
+						RUN(line + x, prevline + x, &mix, &mix, 2)
 						REPEAT(line[x] = prevline[x] ^ mix)
 					}
 					break;
@@ -423,12 +500,14 @@ bitmap_decompress2(void * inst, uint8 * output, int width, int height, uint8 * i
 					}
 					break;
 				case 3:	/* Colour */
+					RUN(line + x, NULL, &color2, &color2, 2)
 					REPEAT(line[x] = color2)
 					break;
 				case 4:	/* Copy */
 					REPEAT(CVAL2(input, line[x]))
 					break;
 				case 8:	/* Bicolor */
+					RUN_BICOLOR(line + x, &color1, &color2, 2)
 					REPEAT
 					(
 						if (bicolor)
@@ -472,6 +551,8 @@ bitmap_decompress3(void * inst, uint8 * output, int width, int height, uint8 * i
 	uint8 mixmask, mask = 0;
 	uint8 mix[3] = {0xff, 0xff, 0xff};
 	int fom_mask = 0;
+	int n;
+	uint8 pattern[BITMAP_PATTERN_SIZE];
 
 	while (input < end)
 	{
@@ -598,6 +679,7 @@ bitmap_decompress3(void * inst, uint8 * output, int width, int height, uint8 * i
 					}
 					if (prevline == NULL)
 					{
+						RUN(line + x * 3, NULL, zero, zero, 3)
 						REPEAT
 						(
 							line[x * 3] = 0;
@@ -607,6 +689,7 @@ bitmap_decompress3(void * inst, uint8 * output, int width, int height, uint8 * i
 					}
 					else
 					{
+						RUN(line + x * 3, prevline + x * 3, zero, zero, 3)
 						REPEAT
 						(
 							line[x * 3] = prevline[x * 3];
@@ -618,6 +701,7 @@ bitmap_decompress3(void * inst, uint8 * output, int width, int height, uint8 * i
 				case 1:	/* Mix */
 					if (prevline == NULL)
 					{
+						RUN(line + x * 3, NULL, mix, mix, 3)
 						REPEAT
 						(
 							line[x * 3] = mix[0];
@@ -627,6 +711,7 @@ bitmap_decompress3(void * inst, uint8 * output, int width, int height, uint8 * i
 					}
 					else
 					{
+						RUN(line + x * 3, prevline + x * 3, mix, mix, 3)
 						REPEAT
 						(
 							line[x * 3] =
@@ -685,6 +770,7 @@ bitmap_decompress3(void * inst, uint8 * output, int width, int height, uint8 * i
 					}
 					break;
 				case 3:	/* Colour */
+					RUN(line + x * 3, NULL, color2, color2, 3)
 					REPEAT
 					(
 						line[x * 3] = color2 [0];
@@ -701,6 +787,7 @@ bitmap_decompress3(void * inst, uint8 * output, int width, int height, uint8 * i
 					)
 					break;
 				case 8:	/* Bicolor */
+					RUN_BICOLOR(line + x * 3, color1, color2, 3)
 					REPEAT
 					(
 						if (bicolor)
@@ -745,9 +832,9 @@ bitmap_decompress3(void * inst, uint8 * output, int width, int height, uint8 * i
 	return True;
 }
 
-/* decompress a color plane */
+/* decompress a color plane into every fourth byte of the bottom-up output */
 static int
-process_plane(uint8 * in, int width, int height, uint8 * out, int size)
+process_plane(uint8 * in, uint8 * end, int width, int height, uint8 * out)
 {
 	int indexw;
 	int indexh;
@@ -776,6 +863,8 @@ process_plane(uint8 * in, int width, int height, uint8 * out, int size)
 		{
 			while (indexw < width)
 			{
+				if (in >= end)
+					return -1;
 				code = CVAL(in);
 				replen = code & 0xf;
 				collen = (code >> 4) & 0xf;
@@ -785,6 +874,8 @@ process_plane(uint8 * in, int width, int height, uint8 * out, int size)
 					replen = revcode;
 					collen = 0;
 				}
+				if ((indexw + collen + replen > width) || (collen > end - in))
+					return -1;
 				while (collen > 0)
 				{
 					color = CVAL(in);
@@ -806,6 +897,8 @@ process_plane(uint8 * in, int width, int height, uint8 * out, int size)
 		{
 			while (indexw < width)
 			{
+				if (in >= end)
+					return -1;
 				code = CVAL(in);
 				replen = code & 0xf;
 				collen = (code >> 4) & 0xf;
@@ -815,6 +908,8 @@ process_plane(uint8 * in, int width, int height, uint8 * out, int size)
 					replen = revcode;
 					collen = 0;
 				}
+				if ((indexw + collen + replen > width) || (collen > end - in))
+					return -1;
 				while (collen > 0)
 				{
 					x = CVAL(in);
@@ -851,37 +946,158 @@ process_plane(uint8 * in, int width, int height, uint8 * out, int size)
 	return (int) (in - org_in);
 }
 
+/* decompress the planes apart with the line kernel and interleave them,
+   planes larger than a tile go to the scratch, or to a temporary buffer
+   without one */
+static RD_BOOL
+process_planes(BITMAP_SCRATCH * scratch, uint8 * output, int width, int height, uint8 * in, uint8 * end)
+{
+	int index;
+	int y;
+	int bytes_pro;
+	int plane_size;
+	int size;
+	uint8 * plane;
+	uint8 * last_line;
+	uint8 * planes;
+	uint8 small_planes[64 * 64 * 4 + BITMAP_PLANE_PAD];
+
+	if ((size_t) width * height > (INT_MAX - BITMAP_PLANE_PAD) / 4)
+		return False;
+
+	/* alpha, red, green and blue, one after the other */
+	plane_size = width * height;
+	size = plane_size * 4 + BITMAP_PLANE_PAD;
+	if (plane_size <= 64 * 64)
+	{
+		planes = small_planes;
+	}
+	else if (scratch != NULL)
+	{
+		if (size > scratch->size)
+		{
+			planes = (uint8 *) xrealloc(scratch->planes, size);
+			if (planes == NULL)
+				return False;
+			scratch->planes = planes;
+			scratch->size = size;
+		}
+		planes = scratch->planes;
+	}
+	else
+	{
+		planes = (uint8 *) xmalloc(size);
+		if (planes == NULL)
+			return False;
+	}
+	for (index = 0; index < 4; index++)
+	{
+		plane = planes + index * plane_size;
+		last_line = NULL;
+		for (y = 0; y < height; y++)
+		{
+			bytes_pro = bitmap_funcs.plane_line(plane + y * width, last_line, in, end, width);
+			if (bytes_pro < 0)
+				break;
+			in += bytes_pro;
+			last_line = plane + y * width;
+		}
+		if (y < height)
+			break;
+	}
+	if (index == 4)
+	{
+		/* the first line is the bottom one */
+		for (y = 0; y < height; y++)
+		{
+			bitmap_funcs.planes_to_argb(output + (height - 1 - y) * width * 4,
+				planes + y * width, planes + plane_size + y * width,
+				planes + 2 * plane_size + y * width, planes + 3 * plane_size + y * width, width);
+		}
+	}
+	if ((planes != small_planes) && (scratch == NULL))
+		xfree(planes);
+	return (index == 4) && (in == end);
+}
+
 /* 4 byte bitmap decompress */
 static RD_BOOL
-bitmap_decompress4(uint8 * output, int width, int height, uint8 * input, int size)
+bitmap_decompress4(BITMAP_SCRATCH * scratch, uint8 * output, int width, int height, uint8 * input, int size)
 {
 	int code;
 	int bytes_pro;
-	int total_pro;
+	uint8 * end;
 
+	end = input + size;
+	if (size < 1)
+	{
+		return False;
+	}
 	code = CVAL(input);
 	if (code != 0x10)
 	{
 		return False;
 	}
-	total_pro = 1;
-	bytes_pro = process_plane(input, width, height, output + 3, size - total_pro);
-	total_pro += bytes_pro;
+	if (bitmap_funcs.plane_line != NULL)
+	{
+		return process_planes(scratch, output, width, height, input, end);
+	}
+	bytes_pro = process_plane(input, end, width, height, output + 3);
+	if (bytes_pro < 0)
+		return False;
 	input += bytes_pro;
-	bytes_pro = process_plane(input, width, height, output + 2, size - total_pro);
-	total_pro += bytes_pro;
+	bytes_pro = process_plane(input, end, width, height, output + 2);
+	if (bytes_pro < 0)
+		return False;
 	input += bytes_pro;
-	bytes_pro = process_plane(input, width, height, output + 1, size - total_pro);
-	total_pro += bytes_pro;
+	bytes_pro = process_plane(input, end, width, height, output + 1);
+	if (bytes_pro < 0)
+		return False;
 	input += bytes_pro;
-	bytes_pro = process_plane(input, width, height, output + 0, size - total_pro);
-	total_pro += bytes_pro;
-	return size == total_pro;
+	bytes_pro = process_plane(input, end, width, height, output + 0);
+	if (bytes_pro < 0)
+		return False;
+	input += bytes_pro;
+	return input == end;
+}
+
+/* pick the decoding kernels, the plain ones are used without simd */
+void
+bitmap_init(RD_BOOL simd)
+{
+	bitmap_funcs.run = NULL;
+	bitmap_funcs.plane_line = NULL;
+	bitmap_funcs.planes_to_argb = NULL;
+
+	if (simd)
+		BITMAP_INIT_SIMD(&bitmap_funcs);
+}
+
+void *
+bitmap_scratch_new(void)
+{
+	BITMAP_SCRATCH * scratch;
+
+	scratch = (BITMAP_SCRATCH *) xmalloc(sizeof(BITMAP_SCRATCH));
+	memset(scratch, 0, sizeof(BITMAP_SCRATCH));
+
+	return scratch;
+}
+
+void
+bitmap_scratch_free(void * scratch)
+{
+	if (scratch != NULL)
+	{
+		xfree(((BITMAP_SCRATCH *) scratch)->planes);
+		xfree(scratch);
+	}
 }
 
-/* main decompress function */
+/* main decompress function, scratch may be NULL */
 RD_BOOL
-bitmap_decompress(void * inst, uint8 * output, int width, int height, uint8 * input, int size, int Bpp)
+bitmap_decompress(void * inst, BITMAP_SCRATCH * scratch, uint8 * output, int width, int height,
+	uint8 * input, int size, int Bpp)
 {
 	RD_BOOL rv = False;
 
@@ -897,7 +1113,7 @@ bitmap_decompress(void * inst, uint8 * output, int width, int height, uint8 * in
 			rv = bitmap_decompress3(inst, output, width, height, input, size);
 			break;
 		case 4:
-			rv = bitmap_decompress4(output, width, height, input, size);
+			rv = bitmap_decompress4(scratch, output, width, height, input, size);
 			break;
 		default:
 			ui_unimpl(inst, "Bpp %d\n", Bpp);
@@ -22,7 +22,40 @@
 
 #include <freerdp/types/ui.h>
 
+/* the pattern repeats every 96 bytes, a multiple of every pixel pair and vector size */
+#define BITMAP_PATTERN_SIZE	96
+/* slack after a decoded plane, a line decoder may write this far past the line */
+#define BITMAP_PLANE_PAD	32
+
+struct _BITMAP_FUNCS
+{
+	/* writes n bytes of pattern, or of src xor pattern when src is not NULL, may be NULL */
+	void (* run)(uint8 * dst, uint8 * src, uint8 * pattern, int n);
+	/* decodes a line of a planar colour plane, as deltas to prev unless it is NULL,
+	   returns the input bytes used or -1; when NULL the planes are decoded in place */
+	int (* plane_line)(uint8 * dst, uint8 * prev, uint8 * in, uint8 * end, int width);
+	/* interleaves n pixels of the alpha, red, green and blue planes */
+	void (* planes_to_argb)(uint8 * dst, uint8 * a, uint8 * r, uint8 * g, uint8 * b, int n);
+};
+typedef struct _BITMAP_FUNCS BITMAP_FUNCS;
+
+/* planes of the large 32 bpp bitmaps decoded by one thread, kept from one
+   bitmap to the next and only grown */
+struct _BITMAP_SCRATCH
+{
+	uint8 * planes;
+	int size;
+};
+typedef struct _BITMAP_SCRATCH BITMAP_SCRATCH;
+
+void
+bitmap_init(RD_BOOL simd);
+void *
+bitmap_scratch_new(void);
+void
+bitmap_scratch_free(void * scratch);
 RD_BOOL
-bitmap_decompress(void * inst, uint8 * output, int width, int height, uint8 * input, int size, int Bpp);
+bitmap_decompress(void * inst, BITMAP_SCRATCH * scratch, uint8 * output, int width, int height,
+	uint8 * input, int size, int Bpp);
 
 #endif
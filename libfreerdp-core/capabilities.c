@@ -746,6 +746,20 @@ void rdp_process_virtualchannel_capset(rdpRdp * rdp, STREAM s)
 	uint32 virtualChannelChunkSize;
 	in_uint32_le(s, virtualChannelCompressionFlags); /* virtual channel compression flags */
 	in_uint32_le(s, virtualChannelChunkSize); /* VCChunkSize */
+
+	/* client to server channel traffic is limited to RDP 4.0 compression */
+	if (rdp->settings->bulk_compression && (virtualChannelCompressionFlags & VCCAPS_COMPR_CS_8K))
+	{
+		if (rdp->mppc_enc == NULL)
+			rdp->mppc_enc = mppc_enc_new(False);
+		else
+			rdp->mppc_enc->flush = True;
+	}
+	else
+	{
+		mppc_enc_free(rdp->mppc_enc);
+		rdp->mppc_enc = NULL;
+	}
 }
 
 /**
@@ -35,7 +35,11 @@ vchan_send(rdpChannels * chan, int mcs_id, char * data, int total_length)
 	int sent;
 	int chan_flags;
 	int chan_index;
+	int ctype;
+	int clen;
+	uint8 cdata[CHANNEL_CHUNK_LENGTH];
 	rdpSet * settings;
+	RDPCOMPENC * enc;
 	struct rdp_chan * channel;
 
 	settings = chan->mcs->net->rdp->settings;
@@ -49,6 +53,9 @@ vchan_send(rdpChannels * chan, int mcs_id, char * data, int total_length)
 	chan_flags = CHANNEL_FLAG_FIRST;
 	sent = 0;
 	sec_flags = settings->encryption ? SEC_ENCRYPT : 0;
+	enc = NULL;
+	if (channel->flags & (CHANNEL_OPTION_COMPRESS | CHANNEL_OPTION_COMPRESS_RDP))
+		enc = chan->mcs->net->rdp->mppc_enc;
 	while (sent < total_length)
 	{
 		length = MIN(CHANNEL_CHUNK_LENGTH, total_length);
@@ -61,10 +68,24 @@ vchan_send(rdpChannels * chan, int mcs_id, char * data, int total_length)
 		{
 			chan_flags |= CHANNEL_FLAG_SHOW_PROTOCOL;
 		}
-		s = sec_init(chan->mcs->net->sec, sec_flags, length + 8);
-		out_uint32_le(s, total_length);
-		out_uint32_le(s, chan_flags);
-		out_uint8p(s, data + sent, length);
+		ctype = 0;
+		if (enc != NULL)
+			ctype = mppc_compress(enc, (uint8 *) data + sent, length, cdata, &clen);
+		if (ctype != 0)
+		{
+			/* the compression flags go in the third byte of the channel flags */
+			s = sec_init(chan->mcs->net->sec, sec_flags, clen + 8);
+			out_uint32_le(s, total_length);
+			out_uint32_le(s, chan_flags | (ctype << 16));
+			out_uint8p(s, cdata, clen);
+		}
+		else
+		{
+			s = sec_init(chan->mcs->net->sec, sec_flags, length + 8);
+			out_uint32_le(s, total_length);
+			out_uint32_le(s, chan_flags);
+			out_uint8p(s, data + sent, length);
+		}
 		s_mark_end(s);
 		sec_send_to_channel(chan->mcs->net->sec, s, sec_flags, mcs_id);
 		sent += length;
@@ -451,12 +451,16 @@ l_rdp_get_fds(rdpInst * inst, void ** read_fds, int * read_count,
 	rdpRdp * rdp;
 
 	rdp = RDP_FROM_INST(inst);
+	/* the ui is about to wait, send what this round of events queued */
+	rdp_flush_input(rdp);
+	network_flush(rdp->net);
 #ifdef _WIN32
 	read_fds[*read_count] = (void *) (rdp->net->tcp->wsa_event);
 #else
 	read_fds[*read_count] = (void *)(long) (rdp->net->tcp->sockfd);
 #endif
 	(*read_count)++;
+	inst->sock_generation = rdp->sock_generation;
 	return 0;
 }
 
@@ -473,12 +477,18 @@ l_rdp_check_fds(rdpInst * inst)
 	WSAResetEvent(rdp->net->tcp->wsa_event);
 #endif
 	rv = 0;
-	if (tcp_can_recv(rdp->net->tcp->sockfd, 0))
+	if (network_pending(rdp->net) || tcp_can_recv(rdp->net->tcp->sockfd, 0))
 	{
-		if (!rdp_loop(rdp, &deactivated))
+		/* the PDUs read ahead with this one do not wake up the socket */
+		do
 		{
-			rv = 1;
+			if (!rdp_loop(rdp, &deactivated))
+			{
+				rv = 1;
+				break;
+			}
 		}
+		while (network_pending(rdp->net));
 	}
 	if ((rv != 0) && rdp->redirect)
 	{
@@ -303,15 +303,15 @@ iso_send(rdpIso * iso, STREAM s)
 	network_send(iso->net, s);
 }
 
-/* Send an fast path data PDU */
+/* Send an fast path data PDU carrying num_events (at most 15) input events */
 void
-iso_fp_send(rdpIso * iso, STREAM s, uint32 flags)
+iso_fp_send(rdpIso * iso, STREAM s, uint32 flags, int num_events)
 {
 	int fp_flags;
 	int len;
 	int index;
 
-	fp_flags = (1 << 2) | 0;	/* one event, fast path */
+	fp_flags = ((num_events & 0xf) << 2) | 0;	/* numberEvents, fast path */
 	if (flags & SEC_ENCRYPT)
 	{
 		fp_flags |= 2 << 6;	/* FASTPATH_INPUT_ENCRYPTED */
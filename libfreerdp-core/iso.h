@@ -50,7 +50,7 @@ iso_fp_init(rdpIso * iso, int length);
 void
 iso_send(rdpIso * iso, STREAM s);
 void
-iso_fp_send(rdpIso * iso, STREAM s, uint32 flags);
+iso_fp_send(rdpIso * iso, STREAM s, uint32 flags, int num_events);
 void
 x224_send_connection_request(rdpIso * iso);
 STREAM
@@ -22,6 +22,7 @@
 
 #include "frdp.h"
 #include "rdp.h"
+#include <freerdp/utils/memory.h>
 
 /* mppc decompression                       */
 /* http://www.faqs.org/rfcs/rfc2118.html    */
@@ -52,14 +53,142 @@
 /* more information is available in         */
 /* http://www.ietf.org/ietf/IPR/hifn-ipr-draft-friend-tls-lzs-compression.txt */
 
+/*
+   The decoder keeps up to 64 bits of the stream in a window, most significant
+   bit first. A token never takes more than 49 bits, so one refill per token
+   is enough while there is input left.
+
+   The first 5 bits of a token are enough to tell literals from copy tuples
+   and, for the latter, which offset class it is. They index a table giving
+   the length of the prefix, the number of value bits after it and the base
+   added to the value. Literals are 0 + 7 bits or 10 + 7 bits, base 0x80.
+*/
+
+struct mppc_code
+{
+	uint8 copy;
+	uint8 prefix;
+	uint8 extra;
+	uint16 base;
+};
+
+#define MPPC_LITERAL		{ 0, 1, 7, 0 }
+#define MPPC_LITERAL_HIGH	{ 0, 2, 7, 0x80 }
+
+/* RDP 5.0, 64K history */
+static const struct mppc_code mppc_codes_big[32] =
+{
+	MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL,
+	MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL,
+	MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL,
+	MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL,
+	MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH,
+	MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH,
+	{ 1, 3, 16, 2368 }, { 1, 3, 16, 2368 }, { 1, 3, 16, 2368 }, { 1, 3, 16, 2368 },	/* 110 */
+	{ 1, 4, 11, 320 }, { 1, 4, 11, 320 },	/* 1110 */
+	{ 1, 5, 8, 64 },	/* 11110 */
+	{ 1, 5, 6, 0 }	/* 11111 */
+};
+
+/* RDP 4.0, 8K history */
+static const struct mppc_code mppc_codes_small[32] =
+{
+	MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL,
+	MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL,
+	MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL,
+	MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL, MPPC_LITERAL,
+	MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH,
+	MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH, MPPC_LITERAL_HIGH,
+	{ 1, 3, 13, 320 }, { 1, 3, 13, 320 }, { 1, 3, 13, 320 }, { 1, 3, 13, 320 },	/* 110 */
+	{ 1, 4, 8, 64 }, { 1, 4, 8, 64 },	/* 1110 */
+	{ 1, 4, 6, 0 }, { 1, 4, 6, 0 }	/* 1111 */
+};
+
+/* top n bits of the window */
+#define MPPC_PEEK(_n) ((uint32) (bits >> (64 - (_n))))
+
+#define MPPC_SKIP(_n) \
+{ \
+	bits <<= (_n); \
+	nbits -= (_n); \
+}
+
+/*
+   Top up the window. With 8 bytes of input left they are read at once, the
+   bits that don't fit are the next ones anyway and are or'ed in again by the
+   following refill.
+*/
+#define MPPC_REFILL() \
+{ \
+	if (i + 8 <= clen) \
+	{ \
+		bits |= mppc_load_be64(data + i) >> nbits; \
+		i += (63 - nbits) >> 3; \
+		nbits |= 56; \
+	} \
+	else \
+	{ \
+		while (nbits <= 56 && i < clen) \
+		{ \
+			bits |= (uint64) data[i++] << (56 - nbits); \
+			nbits += 8; \
+		} \
+	} \
+}
+
+static __inline uint64
+mppc_load_be64(const uint8 * p)
+{
+	return ((uint64) p[0] << 56) | ((uint64) p[1] << 48) | ((uint64) p[2] << 40) | ((uint64) p[3] << 32) |
+		((uint64) p[4] << 24) | ((uint64) p[5] << 16) | ((uint64) p[6] << 8) | (uint64) p[7];
+}
+
+/* copy a match within the history, the areas overlap when the offset is below the length */
+static __inline void
+mppc_copy(uint8 * dict, int dst, int src, int len)
+{
+	int distance = dst - src;
+
+	if (distance >= len)
+	{
+		memcpy(dict + dst, dict + src, len);
+	}
+	else if (distance >= 8)
+	{
+		/* chunks of 8 bytes only read what was already written */
+		for (; len >= 8; len -= 8, dst += 8, src += 8)
+			memcpy(dict + dst, dict + src, 8);
+
+		while (len-- > 0)
+			dict[dst++] = dict[src++];
+	}
+	else if (distance == 1)
+	{
+		memset(dict + dst, dict[src], len);
+	}
+	else
+	{
+		/* short repeating pattern, or an offset wrapping before the start of the history */
+		while (len-- > 0)
+			dict[dst++] = dict[(src++) & (RDP_MPPC_DICT_SIZE - 1)];
+	}
+}
+
 int
 mppc_expand(rdpRdp * rdp, uint8 * data, uint32 clen, uint8 ctype, uint32 * roff, uint32 * rlen)
 {
-	int k, walker_len = 0, walker;
+	uint64 bits = 0;
+	int nbits = 0;
 	uint32 i = 0;
-	int next_offset, match_off;
+	int next_offset;
+	int old_offset;
+	int match_off;
 	int match_len;
-	int old_offset, match_bits;
+	int max_ones;
+	int ones;
+	int mask;
+	const struct mppc_code * codes;
+	const struct mppc_code * code;
 	RD_BOOL big = ctype & RDP_MPPC_BIG ? True : False;
 
 	uint8 *dict = rdp->mppc_dict.hist;
@@ -85,293 +214,302 @@ mppc_expand(rdpRdp * rdp, uint8 * data, uint32 clen, uint8 ctype, uint32 * roff,
 	*roff = 0;
 	*rlen = 0;
 
-	walker = rdp->mppc_dict.roff;
-
-	next_offset = walker;
+	next_offset = rdp->mppc_dict.roff;
 	old_offset = next_offset;
 	*roff = old_offset;
 	if (clen == 0)
 		return 0;
-	clen += i;
 
-	do
+	codes = big ? mppc_codes_big : mppc_codes_small;
+	mask = big ? 65535 : 8191;
+	max_ones = big ? 14 : 11;
+
+	while (1)
 	{
-		if (walker_len == 0)
-		{
-			if (i >= clen)
-				break;
-			walker = data[i++] << 24;
-			walker_len = 8;
-		}
-		if (walker >= 0)
+		MPPC_REFILL();
+
+		if (nbits == 0)
+			break;
+
+		code = &codes[MPPC_PEEK(5)];
+
+		if (!code->copy)
 		{
-			if (walker_len < 8)
+			if (code->prefix + code->extra > nbits)
 			{
-				if (i >= clen)
-				{
-					if (walker != 0)
-						return -1;
+				/* the last byte may be padded with zero bits */
+				if (code->prefix == 1 && MPPC_PEEK(nbits) == 0)
 					break;
-				}
-				walker |= (data[i++] & 0xff) << (24 - walker_len);
-				walker_len += 8;
+				return -1;
 			}
+
 			if (next_offset >= RDP_MPPC_DICT_SIZE)
 				return -1;
-			dict[next_offset++] = (((uint32) walker) >> ((uint32) 24));
-			walker <<= 8;
-			walker_len -= 8;
+
+			dict[next_offset++] = (uint8) (code->base + ((bits << code->prefix) >> (64 - code->extra)));
+			MPPC_SKIP(code->prefix + code->extra);
 			continue;
 		}
-		walker <<= 1;
-		/* fetch next 8-bits */
-		if (--walker_len == 0)
+
+		/* offset */
+		if (code->prefix + code->extra > nbits)
+			return -1;
+
+		match_off = code->base + ((bits << code->prefix) >> (64 - code->extra));
+		MPPC_SKIP(code->prefix + code->extra);
+
+		/*
+		   length: 0 for 3, otherwise n ones, a zero and n + 1 bits of
+		   value, which is 2 to the power of n + 1 plus the value.
+		*/
+		if (nbits < 1)
+			return -1;
+
+		if ((bits >> 63) == 0)
 		{
-			if (i >= clen)
-				return -1;
-			walker = data[i++] << 24;
-			walker_len = 8;
+			match_len = 3;
+			MPPC_SKIP(1);
 		}
-		/* literal decoding */
-		if (walker >= 0)
+		else
 		{
-			if (walker_len < 8)
-			{
-				if (i >= clen)
-					return -1;
-				walker |= (data[i++] & 0xff) << (24 - walker_len);
-				walker_len += 8;
-			}
-			if (next_offset >= RDP_MPPC_DICT_SIZE)
-				return -1;
-			dict[next_offset++] = (uint8) (walker >> 24 | 0x80);
-			walker <<= 8;
-			walker_len -= 8;
-			continue;
-		}
+			ones = (~bits == 0) ? 64 : __builtin_clzll(~bits);
 
-		/* decode offset  */
-		/* length pair    */
-		walker <<= 1;
-		if (--walker_len < (big ? 3 : 2))
-		{
-			if (i >= clen)
+			if (ones > max_ones || 2 * ones + 2 > nbits)
 				return -1;
-			walker |= (data[i++] & 0xff) << (24 - walker_len);
-			walker_len += 8;
+
+			MPPC_SKIP(ones + 1);
+			match_len = (1 << (ones + 1)) | MPPC_PEEK(ones + 1);
+			MPPC_SKIP(ones + 1);
 		}
 
-		if (big)
-		{
-			/* offset decoding where offset len is:
-			   -63: 11111 followed by the lower 6 bits of the value
-			   64-319: 11110 followed by the lower 8 bits of the value ( value - 64 )
-			   320-2367: 1110 followed by lower 11 bits of the value ( value - 320 )
-			   2368-65535: 110 followed by lower 16 bits of the value ( value - 2368 )
-			 */
-			switch (((uint32) walker) >> ((uint32) 29))
-			{
-				case 7:	/* - 63 */
-					for (; walker_len < 9; walker_len += 8)
-					{
-						if (i >= clen)
-							return -1;
-						walker |= (data[i++] & 0xff) << (24 - walker_len);
-					}
-					walker <<= 3;
-					match_off = ((uint32) walker) >> ((uint32) 26);
-					walker <<= 6;
-					walker_len -= 9;
-					break;
+		if (next_offset + match_len >= RDP_MPPC_DICT_SIZE)
+			return -1;
 
-				case 6:	/* 64 - 319 */
-					for (; walker_len < 11; walker_len += 8)
-					{
-						if (i >= clen)
-							return -1;
-						walker |= (data[i++] & 0xff) << (24 - walker_len);
-					}
+		mppc_copy(dict, next_offset, (next_offset - match_off) & mask, match_len);
+		next_offset += match_len;
+	}
 
-					walker <<= 3;
-					match_off = (((uint32) walker) >> ((uint32) 24)) + 64;
-					walker <<= 8;
-					walker_len -= 11;
-					break;
+	/* store history offset */
+	rdp->mppc_dict.roff = next_offset;
 
-				case 5:
-				case 4:	/* 320 - 2367 */
-					for (; walker_len < 13; walker_len += 8)
-					{
-						if (i >= clen)
-							return -1;
-						walker |= (data[i++] & 0xff) << (24 - walker_len);
-					}
+	*roff = old_offset;
+	*rlen = next_offset - old_offset;
 
-					walker <<= 2;
-					match_off = (((uint32) walker) >> ((uint32) 21)) + 320;
-					walker <<= 11;
-					walker_len -= 13;
-					break;
+	return 0;
+}
 
-				default:	/* 2368 - 65535 */
-					for (; walker_len < 17; walker_len += 8)
-					{
-						if (i >= clen)
-							return -1;
-						walker |= (data[i++] & 0xff) << (24 - walker_len);
-					}
+/*
+   Compression, for the client to server direction. Matches are found through
+   hash chains on the first three bytes of every position of the current pass
+   over the history, following at most MPPC_MAX_CHAIN links.
+*/
 
-					walker <<= 1;
-					match_off = (((uint32) walker) >> ((uint32) 16)) + 2368;
-					walker <<= 16;
-					walker_len -= 17;
-					break;
-			}
-		}
-		else
-		{
-			/* offset decoding where offset len is:
-			   -63: 1111 followed by the lower 6 bits of the value
-			   64-319: 1110 followed by the lower 8 bits of the value ( value - 64 )
-			   320-8191: 110 followed by the lower 13 bits of the value ( value - 320 )
-			 */
-			switch (((uint32) walker) >> ((uint32) 30))
-			{
-				case 3:	/* - 63 */
-					if (walker_len < 8)
-					{
-						if (i >= clen)
-							return -1;
-						walker |= (data[i++] & 0xff) << (24 - walker_len);
-						walker_len += 8;
-					}
-					walker <<= 2;
-					match_off = ((uint32) walker) >> ((uint32) 26);
-					walker <<= 6;
-					walker_len -= 8;
-					break;
+#define MPPC_MAX_CHAIN	32
+
+#define MPPC_HASH(_p) \
+	((((uint32) (_p)[0] << 16 | (uint32) (_p)[1] << 8 | (uint32) (_p)[2]) * 2654435761U) >> (32 - RDP_MPPC_HASH_BITS))
+
+/* append n bits, at most 25 at a time */
+#define MPPC_PUT(_v, _n) \
+{ \
+	acc = (acc << (_n)) | (_v); \
+	accbits += (_n); \
+	while (accbits >= 8) \
+	{ \
+		accbits -= 8; \
+		out[o++] = (uint8) (acc >> accbits); \
+	} \
+}
 
-				case 2:	/* 64 - 319 */
-					for (; walker_len < 10; walker_len += 8)
-					{
-						if (i >= clen)
-							return -1;
-						walker |= (data[i++] & 0xff) << (24 - walker_len);
-					}
+RDPCOMPENC *
+mppc_enc_new(RD_BOOL big)
+{
+	RDPCOMPENC * enc;
 
-					walker <<= 2;
-					match_off = (((uint32) walker) >> ((uint32) 24)) + 64;
-					walker <<= 8;
-					walker_len -= 10;
-					break;
+	enc = (RDPCOMPENC *) xmalloc(sizeof(RDPCOMPENC));
+	if (enc != NULL)
+	{
+		memset(enc, 0, sizeof(RDPCOMPENC));
+		enc->big = big;
+		enc->history_size = big ? RDP_MPPC_DICT_SIZE : 8192;
+		enc->flush = True;
+	}
+	return enc;
+}
 
-				default:	/* 320 - 8191 */
-					for (; walker_len < 14; walker_len += 8)
-					{
-						if (i >= clen)
-							return -1;
-						walker |= (data[i++] & 0xff) << (24 - walker_len);
-					}
+void
+mppc_enc_free(RDPCOMPENC * enc)
+{
+	xfree(enc);
+}
 
-					match_off = (walker >> 18) + 320;
-					walker <<= 14;
-					walker_len -= 14;
-					break;
-			}
-		}
-		if (walker_len == 0)
+/*
+   Compress len bytes into out, which must have room for len bytes. Returns
+   the compression flags and sets olen, or 0 when the data is to be sent as
+   is because it didn't get any smaller, in which case the next packet
+   flushes the history.
+*/
+int
+mppc_compress(RDPCOMPENC * enc, uint8 * data, int len, uint8 * out, int * olen)
+{
+	uint32 acc = 0;
+	int accbits = 0;
+	int o = 0;
+	int ctype;
+	int i, end;
+	int h;
+	int n, ones;
+	int cand;
+	int depth;
+	int limit;
+	int max_match;
+	int match_len;
+	int match_off;
+	uint8 * hist = enc->hist;
+
+	*olen = 0;
+
+	/* the decoder rejects a copy ending on the last byte of the history */
+	if (len <= 0 || len >= (int) enc->history_size)
+	{
+		enc->flush = True;
+		return 0;
+	}
+
+	ctype = RDP_MPPC_COMPRESSED | (enc->big ? RDP_MPPC_BIG : 0);
+
+	if (enc->flush)
+	{
+		ctype |= RDP_MPPC_FLUSH;
+		enc->flush = False;
+		enc->pos = 0;
+		memset(enc->head, 0xFF, sizeof(enc->head));
+	}
+	else if (enc->pos + len >= enc->history_size)
+	{
+		/* start over at the front, the hash chains only reach into this pass */
+		ctype |= RDP_MPPC_RESET;
+		enc->pos = 0;
+		memset(enc->head, 0xFF, sizeof(enc->head));
+	}
+
+	memcpy(hist + enc->pos, data, len);
+	i = enc->pos;
+	end = enc->pos + len;
+	max_match = enc->big ? 65535 : 8191;
+
+	while (i < end)
+	{
+		/* a token takes at most 49 bits */
+		if (o + 8 > len)
 		{
-			if (i >= clen)
-				return -1;
-			walker = data[i++] << 24;
-			walker_len = 8;
+			enc->flush = True;
+			return 0;
 		}
 
-		/* decode length of match */
 		match_len = 0;
-		if (walker >= 0)
-		{		/* special case - length of 3 is in bit 0 */
-			match_len = 3;
-			walker <<= 1;
-			walker_len--;
-		}
-		else
+		match_off = 0;
+
+		if (i + 3 <= end)
 		{
-			/* this is how it works len of:
-			   4-7: 10 followed by 2 bits of the value
-			   8-15: 110 followed by 3 bits of the value
-			   16-31: 1110 followed by 4 bits of the value
-			   32-63: .... and so forth
-			   64-127:
-			   128-255:
-			   256-511:
-			   512-1023:
-			   1024-2047:
-			   2048-4095:
-			   4096-8191:
-
-			   i.e. 4097 is encoded as: 111111111110 000000000001
-			   meaning 4096 + 1...
-			 */
-			match_bits = big ? 14 : 11;	/* 11 or 14 bits of value at most */
-			do
-			{
-				walker <<= 1;
-				if (--walker_len == 0)
-				{
-					if (i >= clen)
-						return -1;
-					walker = data[i++] << 24;
-					walker_len = 8;
-				}
-				if (walker >= 0)
-					break;
-				if (--match_bits == 0)
-				{
-					return -1;
-				}
-			}
-			while (1);
-			match_len = (big ? 16 : 13) - match_bits;
-			walker <<= 1;
-			if (--walker_len < match_len)
+			limit = MIN(end - i, max_match);
+			h = MPPC_HASH(hist + i);
+			cand = enc->head[h];
+
+			for (depth = MPPC_MAX_CHAIN; cand >= 0 && depth > 0; depth--)
 			{
-				for (; walker_len < match_len; walker_len += 8)
+				if (hist[cand + match_len] == hist[i + match_len])
 				{
-					if (i >= clen)
+					for (n = 0; n < limit && hist[cand + n] == hist[i + n]; n++);
+
+					if (n > match_len)
 					{
-						return -1;
+						match_len = n;
+						match_off = i - cand;
+						if (n == limit)
+							break;
 					}
-					walker |= (data[i++] & 0xff) << (24 - walker_len);
 				}
+				cand = enc->chain[cand];
 			}
 
-			match_bits = match_len;
-			match_len =
-				((walker >> (32 - match_bits)) & (~(-1 << match_bits))) | (1 <<
-											   match_bits);
-			walker <<= match_bits;
-			walker_len -= match_bits;
+			enc->chain[i] = enc->head[h];
+			enc->head[h] = i;
 		}
-		if (next_offset + match_len >= RDP_MPPC_DICT_SIZE)
+
+		if (match_len < 3)
 		{
-			return -1;
+			if (hist[i] < 0x80)
+				MPPC_PUT(hist[i], 8)
+			else
+				MPPC_PUT(0x100 | (hist[i] & 0x7F), 9)
+			i++;
+			continue;
+		}
+
+		/* offset */
+		if (match_off < 64)
+		{
+			if (enc->big)
+				MPPC_PUT((0x1F << 6) | match_off, 11)
+			else
+				MPPC_PUT((0xF << 6) | match_off, 10)
 		}
-		/* memory areas can overlap - meaning we can't use memXXX functions */
-		k = (next_offset - match_off) & (big ? 65535 : 8191);
-		do
+		else if (match_off < 320)
 		{
-			dict[next_offset++] = dict[k++];
+			if (enc->big)
+				MPPC_PUT((0x1E << 8) | (match_off - 64), 13)
+			else
+				MPPC_PUT((0xE << 8) | (match_off - 64), 12)
 		}
-		while (--match_len != 0);
+		else if (!enc->big)
+		{
+			MPPC_PUT((0x6 << 13) | (match_off - 320), 16)
+		}
+		else if (match_off < 2368)
+		{
+			MPPC_PUT((0xE << 11) | (match_off - 320), 15)
+		}
+		else
+		{
+			MPPC_PUT(0x6, 3)
+			MPPC_PUT(match_off - 2368, 16)
+		}
+
+		/* length */
+		if (match_len == 3)
+		{
+			MPPC_PUT(0, 1)
+		}
+		else
+		{
+			ones = 30 - __builtin_clz(match_len);
+			MPPC_PUT(((1 << ones) - 1) << 1, ones + 1)
+			MPPC_PUT(match_len & ((1 << (ones + 1)) - 1), ones + 1)
+		}
+
+		/* positions inside the match are matched from as well */
+		for (n = i + 1; n < i + match_len && n + 3 <= end; n++)
+		{
+			h = MPPC_HASH(hist + n);
+			enc->chain[n] = enc->head[h];
+			enc->head[h] = n;
+		}
+
+		i += match_len;
 	}
-	while (1);
 
-	/* store history offset */
-	rdp->mppc_dict.roff = next_offset;
+	if (accbits > 0)
+		out[o++] = (uint8) (acc << (8 - accbits));
 
-	*roff = old_offset;
-	*rlen = next_offset - old_offset;
+	if (o >= len)
+	{
+		enc->flush = True;
+		return 0;
+	}
 
-	return 0;
+	enc->pos = end;
+	*olen = o;
+
+	return ctype;
 }
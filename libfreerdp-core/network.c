@@ -22,6 +22,11 @@
 
 #include "network.h"
 
+/* large enough for a few full size PDUs */
+#define NETWORK_RECV_SIZE	0x10000
+/* queued PDUs are written out once they reach this size */
+#define NETWORK_SEND_SIZE	0x4000
+
 /* Initialize and return STREAM.
  * The stream will have room for at least min_size.
  * The tcp layers out stream will be used. */
@@ -112,6 +117,7 @@ network_connect_tls(rdpNetwork * net)
 {
 	RD_BOOL status = False;
 	net->tls = tls_new();
+	network_flush(net);
 
 	if (!tls_connect(net->tls, net->tcp->sockfd))
 		return False;
@@ -134,6 +140,7 @@ network_connect_nla(rdpNetwork * net)
 
 	RD_BOOL status = 1;
 	net->tls = tls_new();
+	network_flush(net);
 
 	if (!tls_connect(net->tls, net->tcp->sockfd))
 		return False;
@@ -174,6 +181,11 @@ network_connect(rdpNetwork * net, char* server, char* username, int port)
 	net->username = username;
 	net->license->license_issued = 0;
 
+	/* nothing read ahead or queued survives a reconnect */
+	net->recv_tail = 0;
+	net->send_length = 0;
+	net->in.data = net->in.p = net->in.end = net->recv_buf;
+
 	if (net->rdp->settings->nla_security)
 		nego->enabled_protocols[PROTOCOL_NLA] = 1;
 	if (net->rdp->settings->tls_security)
@@ -209,6 +221,7 @@ network_connect(rdpNetwork * net, char* server, char* username, int port)
 void
 network_disconnect(rdpNetwork * net)
 {
+	network_flush(net);
 #ifndef DISABLE_TLS
 	if (net->tls)
 		tls_disconnect(net->tls);
@@ -216,79 +229,144 @@ network_disconnect(rdpNetwork * net)
 	tcp_disconnect(net->tcp);
 }
 
-void
-network_send(rdpNetwork * net, STREAM s)
+static void
+network_write(rdpNetwork * net, uint8 * data, int length)
 {
 #ifndef DISABLE_TLS
 	if (net->tls_connected)
 	{
-		tls_write(net->tls, (char*) s->data, s->end - s->data);
+		tls_write(net->tls, (char*) data, length);
 	}
 	else
 #endif
 	{
-		tcp_write(net->tcp, (char*) s->data, s->end - s->data);
+		tcp_write(net->tcp, (char*) data, length);
+	}
+
+	net->send_count++;
+}
+
+/* Queue a PDU, it goes out with the others at the next network_flush.
+ * The stream is copied, the caller may reuse it right away. */
+
+void
+network_send(rdpNetwork * net, STREAM s)
+{
+	int length = s->end - s->data;
+
+	if (net->send_length + length > NETWORK_SEND_SIZE)
+		network_flush(net);
+
+	if (length > NETWORK_SEND_SIZE)
+	{
+		network_write(net, s->data, length);
+		return;
+	}
+
+	memcpy(net->send_buf + net->send_length, s->data, length);
+	net->send_length += length;
+}
+
+/* Write out the queued PDUs in one go. This happens before every
+ * blocking read and whenever the ui asks for the fds to wait on, so
+ * nothing is held back while the client sleeps. */
+
+void
+network_flush(rdpNetwork * net)
+{
+	if (net->send_length > 0)
+	{
+		network_write(net, net->send_buf, net->send_length);
+		net->send_length = 0;
 	}
 }
 
+/* Receive length more bytes of a PDU.
+ * With s NULL a new PDU is started, otherwise s must be the stream returned
+ * for the current one and is extended. The socket is read for as much as it
+ * has, so the following PDUs are usually in the buffer already and handed
+ * out without another read. The stream points into the receive buffer and
+ * stays valid until the next PDU is started. */
+
 STREAM
 network_recv(rdpNetwork * net, STREAM s, uint32 length)
 {
 	int rcvd = 0;
+	uint32 start;
 	uint32 p_offset;
-	uint32 new_length;
 	uint32 end_offset;
 
 	if (s == NULL)
 	{
-		/* read into "new" stream */
-		if (length > net->in.size)
-		{
-			net->in.data = (uint8 *) xrealloc(net->in.data, length);
-			net->in.size = length;
-		}
+		/* the previous PDU is done with, start right after it */
+		start = net->in.end - net->recv_buf;
+		if (start == net->recv_tail)
+			start = net->recv_tail = 0;
 
-		net->in.end = net->in.p = net->in.data;
 		s = &(net->in);
+		s->data = s->p = s->end = net->recv_buf + start;
 	}
-	else
+
+	start = s->data - net->recv_buf;
+	p_offset = s->p - s->data;
+	end_offset = (s->end - s->data) + length;
+
+	if (start + end_offset > net->recv_size)
 	{
-		/* append to existing stream */
-		new_length = (s->end - s->data) + length;
-		if (new_length > s->size)
+		/* move the PDU and what was read after it to the front */
+		memmove(net->recv_buf, s->data, net->recv_tail - start);
+		net->recv_tail -= start;
+		start = 0;
+
+		if (end_offset > net->recv_size)
 		{
-			p_offset = s->p - s->data;
-			end_offset = s->end - s->data;
-			s->data = (uint8 *) xrealloc(s->data, new_length);
-			s->size = new_length;
-			s->p = s->data + p_offset;
-			s->end = s->data + end_offset;
+			net->recv_buf = (uint8 *) xrealloc(net->recv_buf, end_offset);
+			net->recv_size = end_offset;
 		}
 	}
 
-	while (length > 0)
+	if (net->recv_tail < start + end_offset)
+		network_flush(net);
+
+	while (net->recv_tail < start + end_offset)
 	{
 #ifndef DISABLE_TLS
 		if (net->tls_connected)
 		{
-			rcvd = tls_read(net->tls, (char*) s->end, length);
+			rcvd = tls_read(net->tls, (char*) net->recv_buf + net->recv_tail,
+				net->recv_size - net->recv_tail);
 		}
 		else
 #endif
 		{
-			rcvd = tcp_read(net->tcp, (char*) s->end, length);
+			rcvd = tcp_read(net->tcp, (char*) net->recv_buf + net->recv_tail,
+				net->recv_size - net->recv_tail);
 		}
 
 		if (rcvd < 0)
 			return NULL;
 
-		s->end += rcvd;
-		length -= rcvd;
+		net->recv_tail += rcvd;
+		net->recv_count++;
 	}
 
+	s->data = net->recv_buf + start;
+	s->p = s->data + p_offset;
+	s->end = s->data + end_offset;
+	s->size = end_offset;
+
 	return s;
 }
 
+/* Return True when bytes past the current PDU have been read already,
+ * the socket does not signal those. */
+
+RD_BOOL
+network_pending(rdpNetwork * net)
+{
+	return net->recv_tail > (uint32) (net->in.end - net->recv_buf);
+}
+
 rdpNetwork*
 network_new(rdpRdp * rdp)
 {
@@ -308,11 +386,14 @@ network_new(rdpRdp * rdp)
 		self->license = license_new(self);
 		self->sec->net = self;
 
-		self->in.size = 4096;
-		self->in.data = (uint8 *) xmalloc(self->in.size);
+		self->recv_size = NETWORK_RECV_SIZE;
+		self->recv_buf = (uint8 *) xmalloc(self->recv_size);
+		self->in.data = self->in.p = self->in.end = self->recv_buf;
 
 		self->out.size = 4096;
 		self->out.data = (uint8 *) xmalloc(self->out.size);
+
+		self->send_buf = (uint8 *) xmalloc(NETWORK_SEND_SIZE);
 	}
 
 	return self;
@@ -323,7 +404,8 @@ network_free(rdpNetwork * net)
 {
 	if (net != NULL)
 	{
-		xfree(net->in.data);
+		xfree(net->recv_buf);
+		xfree(net->send_buf);
 		xfree(net->out.data);
 
 		if (net->tcp != NULL)
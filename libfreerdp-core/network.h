@@ -40,6 +40,15 @@ struct rdp_network
 	char* username;
 	struct stream in;
 	struct stream out;
+	/* receive buffer, bytes up to recv_tail are read, in is a view into it */
+	uint8 * recv_buf;
+	uint32 recv_size;
+	uint32 recv_tail;
+	uint32 recv_count;
+	/* PDUs queued for sending */
+	uint8 * send_buf;
+	int send_length;
+	uint32 send_count;
 	int tls_connected;
 	struct _NEGO * nego;
 	struct rdp_rdp * rdp;
@@ -62,8 +71,12 @@ network_disconnect(rdpNetwork * net);
 
 void
 network_send(rdpNetwork * net, STREAM s);
+void
+network_flush(rdpNetwork * net);
 STREAM
 network_recv(rdpNetwork * net, STREAM s, uint32 length);
+RD_BOOL
+network_pending(rdpNetwork * net);
 
 rdpNetwork*
 network_new(rdpRdp * rdp);
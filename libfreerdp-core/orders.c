@@ -1650,7 +1650,7 @@ process_cache_bitmap_compressed(rdpOrders * orders, STREAM s, uint16 flags)
 
 	bmpdata = (uint8 *) orders->buffer;
 
-	if (bitmap_decompress(orders->rdp->inst, bmpdata, width, height, data, size, Bpp))
+	if (bitmap_decompress(orders->rdp->inst, orders->rdp->bitmap_scratch, bmpdata, width, height, data, size, Bpp))
 	{
 		bitmap = ui_create_bitmap(orders->rdp->inst, width, height, bmpdata);
 		cache_put_bitmap(orders->rdp->cache, cache_id, cache_idx, bitmap);
@@ -1719,7 +1719,7 @@ process_cache_bitmap_rev2(rdpOrders * orders, STREAM s, uint16 flags, RD_BOOL co
 
 	if (compressed)
 	{
-		if (!bitmap_decompress(orders->rdp->inst, bmpdata, width, height, data, bufsize, Bpp))
+		if (!bitmap_decompress(orders->rdp->inst, orders->rdp->bitmap_scratch, bmpdata, width, height, data, bufsize, Bpp))
 		{
 			DEBUG_ORDERS("Failed to decompress bitmap data");
 			xfree(bmpdata);
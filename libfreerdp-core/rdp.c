@@ -38,12 +38,14 @@
 #include "network.h"
 #include <freerdp/freerdp.h>
 #include <freerdp/utils/hexdump.h>
+#include <freerdp/utils/thread_pool.h>
 
 #include "rdp.h"
 
 RD_BOOL
 rdp_global_init(void)
 {
+	bitmap_init(True);
 	return sec_global_init();
 }
 
@@ -203,9 +205,47 @@ rdp_send_data(rdpRdp * rdp, STREAM s, uint8 data_pdu_type)
 
 /* Send a fast path RDP data packet */
 static void
-rdp_fp_send(rdpRdp * rdp, STREAM s)
+rdp_fp_send(rdpRdp * rdp, STREAM s, int num_events)
 {
-	sec_fp_send(rdp->sec, s, rdp->settings->encryption ? SEC_ENCRYPT : 0);
+	sec_fp_send(rdp->sec, s, rdp->settings->encryption ? SEC_ENCRYPT : 0, num_events);
+}
+
+/* Send all queued fast path input events in one PDU */
+void
+rdp_flush_input(rdpRdp * rdp)
+{
+	STREAM s;
+
+	if (rdp->input_count == 0)
+		return;
+
+	s = rdp_fp_init(rdp, rdp->input_length);
+	out_uint8a(s, rdp->input_events, rdp->input_length);
+	s_mark_end(s);
+	rdp_fp_send(rdp, s, rdp->input_count);
+
+	rdp->input_length = 0;
+	rdp->input_count = 0;
+	rdp->input_last_move = False;
+}
+
+/* Queue a fast path input event behind the ones already pending, and return
+   where it goes. The queue is sent by rdp_flush_input once per main loop
+   iteration, or here when it is full. */
+static uint8 *
+rdp_queue_input(rdpRdp * rdp, int length)
+{
+	uint8 * event;
+
+	if (rdp->input_count == RDP_MAX_INPUT_EVENTS)
+		rdp_flush_input(rdp);
+
+	event = rdp->input_events + rdp->input_length;
+	rdp->input_length += length;
+	rdp->input_count++;
+	rdp->input_last_move = False;
+
+	return event;
 }
 
 int
@@ -474,11 +514,9 @@ rdp_send_input_scancode(rdpRdp * rdp, time_t time, RD_BOOL up, RD_BOOL extended,
 		uint8 fp_flags = FASTPATH_INPUT_EVENT_SCANCODE << 5 |
 				(up ? FASTPATH_INPUT_KBDFLAGS_RELEASE : 0) |
 				(extended ? FASTPATH_INPUT_KBDFLAGS_EXTENDED : 0);
-		s = rdp_fp_init(rdp, 2);
-		out_uint8(s, fp_flags);
-		out_uint8(s, keyCode);
-		s_mark_end(s);
-		rdp_fp_send(rdp, s);
+		uint8 * event = rdp_queue_input(rdp, 2);
+		event[0] = fp_flags;
+		event[1] = keyCode;
 	}
 	else
 	{
@@ -508,14 +546,26 @@ rdp_send_input_mouse(rdpRdp * rdp, time_t time, uint16 pointerFlags, uint16 xPos
 	if (rdp->use_input_fast_path)
 	{
 		/* @msdn{cc240594} */
-		int fp_flags = FASTPATH_INPUT_EVENT_MOUSE << 5;
-		s = rdp_fp_init(rdp, 7);
-		out_uint8(s, fp_flags);
-		out_uint16_le(s, pointerFlags);
-		out_uint16_le(s, xPos);
-		out_uint16_le(s, yPos);
-		s_mark_end(s);
-		rdp_fp_send(rdp, s);
+		uint8 * event;
+
+		/* a move following a move only updates the position, so nothing
+		   but the latest one needs to reach the server */
+		if (pointerFlags == PTRFLAGS_MOVE && rdp->input_last_move)
+		{
+			event = rdp->input_events + rdp->input_length - 7;
+		}
+		else
+		{
+			event = rdp_queue_input(rdp, 7);
+			event[0] = FASTPATH_INPUT_EVENT_MOUSE << 5;
+			event[1] = (uint8) pointerFlags;
+			event[2] = (uint8) (pointerFlags >> 8);
+			rdp->input_last_move = (pointerFlags == PTRFLAGS_MOVE);
+		}
+		event[3] = (uint8) xPos;
+		event[4] = (uint8) (xPos >> 8);
+		event[5] = (uint8) yPos;
+		event[6] = (uint8) (yPos >> 8);
 	}
 	else
 	{
@@ -548,10 +598,7 @@ rdp_sync_input(rdpRdp * rdp, time_t time, uint32 toggle_keys_state)
 		   FASTPATH_INPUT_SYNC_NUM_LOCK    = KBD_SYNC_NUM_LOCK    = 2
 		   FASTPATH_INPUT_SYNC_CAPS_LOCK   = KBD_SYNC_CAPS_LOCK   = 4
 		   FASTPATH_INPUT_SYNC_KANA_LOCK   = KBD_SYNC_KANA_LOCK   = 8 */
-		s = rdp_fp_init(rdp, 1);
-		out_uint8(s, fp_flags);
-		s_mark_end(s);
-		rdp_fp_send(rdp, s);
+		*rdp_queue_input(rdp, 1) = fp_flags;
 	}
 	else
 	{
@@ -577,11 +624,10 @@ rdp_send_input_unicode(rdpRdp * rdp, time_t time, uint16 unicode_character)
 	if (rdp->use_input_fast_path)
 	{
 		fp_flags = 4 << 5; /* FASTPATH_INPUT_EVENT_UNICODE */
-		s = rdp_fp_init(rdp, 3);
-		out_uint8(s, fp_flags);
-		out_uint16_le(s, unicode_character);
-		s_mark_end(s);
-		rdp_fp_send(rdp, s);
+		uint8 * event = rdp_queue_input(rdp, 3);
+		event[0] = fp_flags;
+		event[1] = (uint8) unicode_character;
+		event[2] = (uint8) (unicode_character >> 8);
 	}
 	else
 	{
@@ -1111,19 +1157,65 @@ process_play_sound_pdu(rdpRdp * rdp, STREAM s)
 	DEBUG_RDP("(beep not implemented) duration %d frequency %d", duration, frequency);
 }
 
-/* Process bitmap updates @msdn{cc240612} */
+/* below this many pixels an update is decoded without waking the workers */
+#define BITMAP_PARALLEL_MIN (64 * 64 * 4)
+
+/* decode one rectangle of a bitmap update into its part of rdp->buffer */
+static void
+process_bitmap_rect(void * arg, int index, void * scratch)
+{
+	rdpRdp * rdp = (rdpRdp *) arg;
+	RDPBITMAPRECT * rect = &rdp->bitmap_rects[index];
+	uint8 * bmpdata = (uint8 *) rdp->buffer + rect->offset;
+	int line_size;
+	int y;
+
+	if (!rect->compress)
+	{
+		line_size = rect->width * rect->Bpp;
+		for (y = 0; y < rect->height; y++)
+		{
+			memcpy(&bmpdata[(rect->height - y - 1) * line_size],
+				rect->data + y * line_size, line_size);
+		}
+		rect->decoded = True;
+		return;
+	}
+
+	rect->decoded = bitmap_decompress(rdp->inst, (BITMAP_SCRATCH *) scratch, bmpdata,
+		rect->width, rect->height, rect->data, rect->size, rect->Bpp);
+}
+
+/*
+   Process bitmap updates @msdn{cc240612}
+   The rectangles are independent: all of them are parsed first, decoded on
+   the worker pool into their own buffers and then painted in order.
+*/
 void
 process_bitmap_updates(rdpRdp * rdp, STREAM s)
 {
 	int i;
 	size_t buffer_size;
+	size_t pixels;
 	uint16 num_updates;
 	uint16 left, top, right, bottom, width, height;
-	uint16 cx, cy, bpp, Bpp, compress, bufsize, size;
-	uint8 *data, *bmpdata;
+	uint16 bpp, Bpp, compress, bufsize;
+	int size;
+	uint8 *data;
+	RDPBITMAPRECT * rect;
 
 	in_uint16_le(s, num_updates);
 
+	if (num_updates > rdp->bitmap_rects_size)
+	{
+		rdp->bitmap_rects = (RDPBITMAPRECT *) xrealloc(rdp->bitmap_rects,
+			num_updates * sizeof(RDPBITMAPRECT));
+		rdp->bitmap_rects_size = num_updates;
+	}
+
+	buffer_size = 0;
+	pixels = 0;
+
 	for (i = 0; i < num_updates; i++)
 	{
 		in_uint16_le(s, left);
@@ -1137,34 +1229,14 @@ process_bitmap_updates(rdpRdp * rdp, STREAM s)
 		in_uint16_le(s, compress);
 		in_uint16_le(s, bufsize);
 
-		cx = right - left + 1;
-		cy = bottom - top + 1;
-
 		DEBUG_RDP("BITMAP_UPDATE(l=%d,t=%d,r=%d,b=%d,w=%d,h=%d,Bpp=%d,cmp=%d)",
 		       left, top, right, bottom, width, height, Bpp, compress);
 
-		buffer_size = width * height * Bpp;
-
-		if (buffer_size > rdp->buffer_size)
-		{
-			rdp->buffer = xrealloc(rdp->buffer, buffer_size);
-			rdp->buffer_size = buffer_size;
-		}
-
 		if (!compress)
 		{
-			int y;
-			bmpdata = (uint8 *) rdp->buffer;
-			for (y = 0; y < height; y++)
-			{
-				in_uint8a(s, &bmpdata[(height - y - 1) * (width * Bpp)],
-					  width * Bpp);
-			}
-			ui_paint_bitmap(rdp->inst, left, top, cx, cy, width, height, bmpdata);
-			continue;
+			size = width * height * Bpp;
 		}
-
-		if (compress & 0x400)
+		else if (compress & 0x400)
 		{
 			size = bufsize;
 		}
@@ -1176,19 +1248,49 @@ process_bitmap_updates(rdpRdp * rdp, STREAM s)
 		}
 		in_uint8p(s, data, size);
 
-		buffer_size = width * height * Bpp;
+		rect = &rdp->bitmap_rects[i];
+		rect->left = left;
+		rect->top = top;
+		rect->cx = right - left + 1;
+		rect->cy = bottom - top + 1;
+		rect->width = width;
+		rect->height = height;
+		rect->Bpp = Bpp;
+		rect->compress = compress;
+		rect->data = data;
+		rect->size = size;
+		rect->offset = buffer_size;
+
+		buffer_size += width * height * Bpp;
+		pixels += width * height;
+	}
 
-		if (buffer_size > rdp->buffer_size)
-		{
-			rdp->buffer = xrealloc(rdp->buffer, buffer_size);
-			rdp->buffer_size = buffer_size;
-		}
+	if (buffer_size > rdp->buffer_size)
+	{
+		rdp->buffer = xrealloc(rdp->buffer, buffer_size);
+		rdp->buffer_size = buffer_size;
+	}
 
-		bmpdata = (uint8 *) rdp->buffer;
+	if ((num_updates > 1) && (pixels >= BITMAP_PARALLEL_MIN) && (rdp->num_threads > 1))
+	{
+		if (rdp->thread_pool == NULL)
+			rdp->thread_pool = thread_pool_new(rdp->num_threads - 1, bitmap_scratch_new, bitmap_scratch_free);
+		thread_pool_run(rdp->thread_pool, process_bitmap_rect, rdp, num_updates, rdp->bitmap_scratch);
+	}
+	else
+	{
+		for (i = 0; i < num_updates; i++)
+			process_bitmap_rect(rdp, i, rdp->bitmap_scratch);
+	}
+
+	for (i = 0; i < num_updates; i++)
+	{
+		rect = &rdp->bitmap_rects[i];
 
-		if (bitmap_decompress(rdp->inst, bmpdata, width, height, data, size, Bpp))
+		if (rect->decoded)
 		{
-			ui_paint_bitmap(rdp->inst, left, top, cx, cy, width, height, bmpdata);
+			ui_paint_bitmap(rdp->inst, rect->left, rect->top, rect->cx, rect->cy,
+				rect->width, rect->height, (uint8 *) rdp->buffer + rect->offset);
 		}
 		else
 		{
@@ -1716,6 +1818,7 @@ rdp_reconnect(rdpRdp * rdp)
 
 	rdp->sec = sec_new(rdp);
 	rdp->net = network_new(rdp);
+	rdp->sock_generation++;
 
 	if (!network_connect(rdp->net, server, username, rdp->settings->tcp_port_rdp))
 		return False;
@@ -1744,6 +1847,7 @@ rdp_reconnect(rdpRdp * rdp)
 void
 rdp_disconnect(rdpRdp * rdp)
 {
+	rdp_flush_input(rdp);
 	sec_disconnect(rdp->sec);
 }
 
@@ -1770,6 +1874,8 @@ rdp_new(struct rdp_set *settings, struct rdp_inst *inst)
 		self->cache = cache_new(self);
 		self->ext = ext_new(self);
 		self->rail_session = rail_session_new(self);
+		self->num_threads = thread_pool_get_num_cpus();
+		self->bitmap_scratch = (BITMAP_SCRATCH *) bitmap_scratch_new();
 	}
 	return self;
 }
@@ -1803,6 +1909,10 @@ rdp_free(rdpRdp * rdp)
 			stream_delete(rdp->out_codec_caps[index]);
 		}
 		stream_delete(rdp->fragment_data);
+		mppc_enc_free(rdp->mppc_enc);
+		thread_pool_free(rdp->thread_pool);
+		bitmap_scratch_free(rdp->bitmap_scratch);
+		xfree(rdp->bitmap_rects);
 		xfree(rdp);
 	}
 }
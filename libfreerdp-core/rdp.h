@@ -47,6 +47,37 @@ typedef struct _RDPCOMP
 	struct stream ns;
 } RDPCOMP;
 
+#define RDP_MPPC_HASH_BITS	13
+
+/* client to server bulk compression */
+typedef struct _RDPCOMPENC
+{
+	RD_BOOL big;
+	uint32 history_size;
+	uint32 pos;
+	RD_BOOL flush;
+	uint8 hist[RDP_MPPC_DICT_SIZE];
+	sint32 head[1 << RDP_MPPC_HASH_BITS];
+	sint32 chain[RDP_MPPC_DICT_SIZE];
+} RDPCOMPENC;
+
+/* a rectangle of a bitmap update, decoded apart from the others */
+typedef struct rdp_bitmap_rect
+{
+	uint16 left;
+	uint16 top;
+	uint16 cx;
+	uint16 cy;
+	uint16 width;
+	uint16 height;
+	uint16 Bpp;
+	uint16 compress;
+	uint8 * data;
+	int size;
+	size_t offset;
+	RD_BOOL decoded;
+} RDPBITMAPRECT;
+
 RD_BOOL
 rdp_global_init(void);
 void
@@ -54,6 +85,11 @@ rdp_global_finish(void);
 
 #define MAX_BITMAP_CODECS 2
 
+/* numberEvents in the fast-path input header is 4 bits wide; the largest
+   fast-path input event (mouse) is 7 bytes */
+#define RDP_MAX_INPUT_EVENTS 15
+#define RDP_INPUT_EVENTS_SIZE (RDP_MAX_INPUT_EVENTS * 7)
+
 struct rdp_rdp
 {
 	uint8 * next_packet;
@@ -64,6 +100,7 @@ struct rdp_rdp
 	int current_status;
 	UNICONV *uniconv;
 	RDPCOMP mppc_dict;
+	RDPCOMPENC * mppc_enc;
 	struct rdp_sec * sec;
 	struct rdp_network * net;
 	struct rdp_set * settings;
@@ -74,6 +111,8 @@ struct rdp_rdp
 	struct rdp_ext * ext;
 	/* Session Directory redirection */
 	int redirect;
+	/* bumped when a reconnect puts the session on a new socket */
+	uint32 sock_generation;
 	uint32 redirect_session_id;
 	char* redirect_server;
 	char* redirect_domain;
@@ -108,11 +147,29 @@ struct rdp_rdp
 	/* bitmap codecs */
 	int got_bitmap_codecs_caps;
 	STREAM out_codec_caps[MAX_BITMAP_CODECS];
+	/* bitmap update rectangles and the workers decoding them */
+	RDPBITMAPRECT * bitmap_rects;
+	int bitmap_rects_size;
+	int num_threads;
+	struct _THREAD_POOL * thread_pool;
+	/* the decoding scratch of this thread, the workers have their own */
+	struct _BITMAP_SCRATCH * bitmap_scratch;
+	/* fast-path input events waiting for rdp_flush_input */
+	uint8 input_events[RDP_INPUT_EVENTS_SIZE];
+	int input_length;
+	int input_count;
+	RD_BOOL input_last_move;
 };
 typedef struct rdp_rdp rdpRdp;
 
 int
 mppc_expand(rdpRdp * rdp, uint8 * data, uint32 clen, uint8 ctype, uint32 * roff, uint32 * rlen);
+RDPCOMPENC *
+mppc_enc_new(RD_BOOL big);
+void
+mppc_enc_free(RDPCOMPENC * enc);
+int
+mppc_compress(RDPCOMPENC * enc, uint8 * data, int len, uint8 * out, int * olen);
 void
 rdp5_process(rdpRdp * rdp, STREAM s);
 void
@@ -126,6 +183,8 @@ rdp_sync_input(rdpRdp * rdp, time_t time, uint32 toggle_keys_state);
 void
 rdp_send_input_unicode(rdpRdp * rdp, time_t time, uint16 unicode_character);
 void
+rdp_flush_input(rdpRdp * rdp);
+void
 rdp_send_client_window_status(rdpRdp * rdp, int status);
 void
 process_color_pointer_pdu(rdpRdp * rdp, STREAM s);
@@ -348,7 +348,7 @@ sec_send(rdpSec * sec, STREAM s, uint32 flags)
 
 /* Transmit secure fast path packet */
 void
-sec_fp_send(rdpSec * sec, STREAM s, uint32 flags)
+sec_fp_send(rdpSec * sec, STREAM s, uint32 flags, int num_events)
 {
 	int datalen;
 	s_pop_layer(s, sec_hdr);
@@ -358,7 +358,7 @@ sec_fp_send(rdpSec * sec, STREAM s, uint32 flags)
 		sec_sign(s->p, 8, sec->sec_sign_key, sec->rc4_key_len, s->p + 8, datalen);
 		sec_encrypt(sec, s->p + 8, datalen);
 	}
-	mcs_fp_send(sec->net->mcs, s, flags);
+	mcs_fp_send(sec->net->mcs, s, flags, num_events);
 }
 
 /* Transfer the client random to the server */
@@ -88,7 +88,7 @@ sec_send_to_channel(rdpSec * sec, STREAM s, uint32 flags, uint16 channel);
 void
 sec_send(rdpSec * sec, STREAM s, uint32 flags);
 void
-sec_fp_send(rdpSec * sec, STREAM s, uint32 flags);
+sec_fp_send(rdpSec * sec, STREAM s, uint32 flags, int num_events);
 void
 sec_reverse_copy(uint8 * out, uint8 * in, int len);
 RD_BOOL
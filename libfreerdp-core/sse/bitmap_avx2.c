@@ -0,0 +1,109 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Bitmap decompression routines - AVX2 Optimizations
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <immintrin.h>
+
+#include "bitmap_avx2.h"
+
+/* same as the SSE2 version, over the full 96 byte period of the pattern */
+void bitmap_run_AVX2(uint8 * dst, uint8 * src, uint8 * pattern, int n)
+{
+	int i;
+	__m256i p0 = _mm256_loadu_si256((__m256i *) pattern);
+	__m256i p1 = _mm256_loadu_si256((__m256i *) (pattern + 32));
+	__m256i p2 = _mm256_loadu_si256((__m256i *) (pattern + 64));
+
+	if (src == NULL)
+	{
+		for (; n >= 96; n -= 96, dst += 96)
+		{
+			_mm256_storeu_si256((__m256i *) dst, p0);
+			_mm256_storeu_si256((__m256i *) (dst + 32), p1);
+			_mm256_storeu_si256((__m256i *) (dst + 64), p2);
+		}
+
+		for (i = 0; n - i >= 32; i += 32)
+			_mm256_storeu_si256((__m256i *) (dst + i), _mm256_loadu_si256((__m256i *) (pattern + i)));
+
+		for (; i < n; i++)
+			dst[i] = pattern[i];
+	}
+	else
+	{
+		for (; n >= 96; n -= 96, dst += 96, src += 96)
+		{
+			_mm256_storeu_si256((__m256i *) dst, _mm256_xor_si256(_mm256_loadu_si256((__m256i *) src), p0));
+			_mm256_storeu_si256((__m256i *) (dst + 32), _mm256_xor_si256(_mm256_loadu_si256((__m256i *) (src + 32)), p1));
+			_mm256_storeu_si256((__m256i *) (dst + 64), _mm256_xor_si256(_mm256_loadu_si256((__m256i *) (src + 64)), p2));
+		}
+
+		for (i = 0; n - i >= 32; i += 32)
+			_mm256_storeu_si256((__m256i *) (dst + i), _mm256_xor_si256(_mm256_loadu_si256((__m256i *) (src + i)),
+				_mm256_loadu_si256((__m256i *) (pattern + i))));
+
+		for (; i < n; i++)
+			dst[i] = src[i] ^ pattern[i];
+	}
+
+	_mm256_zeroupper();
+}
+
+/* the unpacks work within 128 bit lanes, the permutes put the pixels back in order */
+void bitmap_planes_to_argb_AVX2(uint8 * dst, uint8 * a, uint8 * r, uint8 * g, uint8 * b, int n)
+{
+	int i;
+	__m256i va, vr, vg, vb;
+	__m256i bg, ra;
+	__m256i p0, p1, p2, p3;
+
+	for (i = 0; n - i >= 32; i += 32, dst += 128)
+	{
+		va = _mm256_loadu_si256((__m256i *) (a + i));
+		vr = _mm256_loadu_si256((__m256i *) (r + i));
+		vg = _mm256_loadu_si256((__m256i *) (g + i));
+		vb = _mm256_loadu_si256((__m256i *) (b + i));
+
+		/* pixels 0-3 and 16-19, 4-7 and 20-23 */
+		bg = _mm256_unpacklo_epi8(vb, vg);
+		ra = _mm256_unpacklo_epi8(vr, va);
+		p0 = _mm256_unpacklo_epi16(bg, ra);
+		p1 = _mm256_unpackhi_epi16(bg, ra);
+
+		/* pixels 8-11 and 24-27, 12-15 and 28-31 */
+		bg = _mm256_unpackhi_epi8(vb, vg);
+		ra = _mm256_unpackhi_epi8(vr, va);
+		p2 = _mm256_unpacklo_epi16(bg, ra);
+		p3 = _mm256_unpackhi_epi16(bg, ra);
+
+		_mm256_storeu_si256((__m256i *) dst, _mm256_permute2x128_si256(p0, p1, 0x20));
+		_mm256_storeu_si256((__m256i *) (dst + 32), _mm256_permute2x128_si256(p2, p3, 0x20));
+		_mm256_storeu_si256((__m256i *) (dst + 64), _mm256_permute2x128_si256(p0, p1, 0x31));
+		_mm256_storeu_si256((__m256i *) (dst + 96), _mm256_permute2x128_si256(p2, p3, 0x31));
+	}
+
+	for (; i < n; i++, dst += 4)
+	{
+		dst[0] = b[i];
+		dst[1] = g[i];
+		dst[2] = r[i];
+		dst[3] = a[i];
+	}
+
+	_mm256_zeroupper();
+}
@@ -0,0 +1,28 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Bitmap decompression routines - AVX2 Optimizations
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __BITMAP_AVX2_H
+#define __BITMAP_AVX2_H
+
+#include "bitmap.h"
+
+void bitmap_run_AVX2(uint8 * dst, uint8 * src, uint8 * pattern, int n);
+void bitmap_planes_to_argb_AVX2(uint8 * dst, uint8 * a, uint8 * r, uint8 * g, uint8 * b, int n);
+
+#endif /* __BITMAP_AVX2_H */
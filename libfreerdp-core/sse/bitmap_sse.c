@@ -0,0 +1,43 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Bitmap decompression routines - SSE Optimizations
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "config.h"
+#include "bitmap_sse2.h"
+#include "bitmap_sse.h"
+
+#ifdef WITH_AVX2
+#include "bitmap_avx2.h"
+#endif
+
+void bitmap_init_sse(BITMAP_FUNCS * funcs)
+{
+	funcs->run = bitmap_run_SSE2;
+	funcs->plane_line = bitmap_plane_line_SSE2;
+	funcs->planes_to_argb = bitmap_planes_to_argb_SSE2;
+
+#ifdef WITH_AVX2
+	/* AVX2 needs support from both the CPU and the OS (saved YMM state) */
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		funcs->run = bitmap_run_AVX2;
+		funcs->planes_to_argb = bitmap_planes_to_argb_AVX2;
+	}
+#endif
+}
@@ -0,0 +1,31 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Bitmap decompression routines - SSE Optimizations
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __BITMAP_SSE_H
+#define __BITMAP_SSE_H
+
+#include "bitmap.h"
+
+void bitmap_init_sse(BITMAP_FUNCS * funcs);
+
+#ifndef BITMAP_INIT_SIMD
+#define BITMAP_INIT_SIMD(_funcs) bitmap_init_sse(_funcs)
+#endif
+
+#endif /* __BITMAP_SSE_H */
@@ -0,0 +1,190 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Bitmap decompression routines - SSE2 Optimizations
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <emmintrin.h>
+
+#include "bitmap_sse2.h"
+
+/*
+   Write n bytes of pattern, or of src xor pattern. The pattern repeats every
+   48 bytes, a multiple of every pixel pair size, so it is kept in three
+   registers and only the tail needs its offset.
+*/
+void bitmap_run_SSE2(uint8 * dst, uint8 * src, uint8 * pattern, int n)
+{
+	int i;
+	__m128i p0 = _mm_loadu_si128((__m128i *) pattern);
+	__m128i p1 = _mm_loadu_si128((__m128i *) (pattern + 16));
+	__m128i p2 = _mm_loadu_si128((__m128i *) (pattern + 32));
+
+	if (src == NULL)
+	{
+		for (; n >= 48; n -= 48, dst += 48)
+		{
+			_mm_storeu_si128((__m128i *) dst, p0);
+			_mm_storeu_si128((__m128i *) (dst + 16), p1);
+			_mm_storeu_si128((__m128i *) (dst + 32), p2);
+		}
+
+		for (i = 0; n - i >= 16; i += 16)
+			_mm_storeu_si128((__m128i *) (dst + i), _mm_loadu_si128((__m128i *) (pattern + i)));
+
+		for (; i < n; i++)
+			dst[i] = pattern[i];
+	}
+	else
+	{
+		for (; n >= 48; n -= 48, dst += 48, src += 48)
+		{
+			_mm_storeu_si128((__m128i *) dst, _mm_xor_si128(_mm_loadu_si128((__m128i *) src), p0));
+			_mm_storeu_si128((__m128i *) (dst + 16), _mm_xor_si128(_mm_loadu_si128((__m128i *) (src + 16)), p1));
+			_mm_storeu_si128((__m128i *) (dst + 32), _mm_xor_si128(_mm_loadu_si128((__m128i *) (src + 32)), p2));
+		}
+
+		for (i = 0; n - i >= 16; i += 16)
+			_mm_storeu_si128((__m128i *) (dst + i), _mm_xor_si128(_mm_loadu_si128((__m128i *) (src + i)),
+				_mm_loadu_si128((__m128i *) (pattern + i))));
+
+		for (; i < n; i++)
+			dst[i] = src[i] ^ pattern[i];
+	}
+}
+
+/*
+   Literals are taken 16 at a time and runs written 16 bytes at a time, the
+   bytes past the end of a code are overwritten by the next one. That needs
+   BITMAP_PLANE_PAD bytes after the plane, and the input is only read a
+   vector at a time while at least that much of it is left.
+*/
+int bitmap_plane_line_SSE2(uint8 * dst, uint8 * prev, uint8 * in, uint8 * end, int width)
+{
+	int i;
+	int x;
+	int code;
+	int collen;
+	int replen;
+	int revcode;
+	uint8 color;
+	uint8 * org_in;
+	__m128i v;
+	__m128i vc;
+	__m128i one = _mm_set1_epi8(1);
+	__m128i low = _mm_set1_epi8(0x7f);
+
+	org_in = in;
+	color = 0;
+	i = 0;
+	while (i < width)
+	{
+		if (in >= end)
+			return -1;
+		code = *in++;
+		replen = code & 0xf;
+		collen = (code >> 4) & 0xf;
+		revcode = (replen << 4) | collen;
+		if ((revcode <= 47) && (revcode >= 16))
+		{
+			replen = revcode;
+			collen = 0;
+		}
+		if ((i + collen + replen > width) || (collen > end - in))
+			return -1;
+		if (collen > 0)
+		{
+			if (end - in >= 16)
+			{
+				v = _mm_loadu_si128((__m128i *) in);
+				if (prev != NULL)
+				{
+					/* odd x stands for -((x >> 1) + 1), that is (x >> 1) xor 0xff */
+					v = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), low),
+						_mm_cmpeq_epi8(_mm_and_si128(v, one), one));
+					v = _mm_add_epi8(v, _mm_loadu_si128((__m128i *) (prev + i)));
+				}
+				_mm_storeu_si128((__m128i *) (dst + i), v);
+				in += collen;
+				i += collen;
+				x = in[-1];
+				color = (prev != NULL) ? (x >> 1) ^ -(x & 1) : x;
+			}
+			else
+			{
+				while (collen > 0)
+				{
+					x = *in++;
+					color = (prev != NULL) ? (x >> 1) ^ -(x & 1) : x;
+					dst[i] = (prev != NULL) ? prev[i] + color : color;
+					i++;
+					collen--;
+				}
+			}
+		}
+		if (replen > 0)
+		{
+			vc = _mm_set1_epi8((char) color);
+			if (prev != NULL)
+			{
+				for (x = 0; x < replen; x += 16)
+					_mm_storeu_si128((__m128i *) (dst + i + x),
+						_mm_add_epi8(_mm_loadu_si128((__m128i *) (prev + i + x)), vc));
+			}
+			else
+			{
+				for (x = 0; x < replen; x += 16)
+					_mm_storeu_si128((__m128i *) (dst + i + x), vc);
+			}
+			i += replen;
+		}
+	}
+
+	return (int) (in - org_in);
+}
+
+void bitmap_planes_to_argb_SSE2(uint8 * dst, uint8 * a, uint8 * r, uint8 * g, uint8 * b, int n)
+{
+	int i;
+	__m128i va, vr, vg, vb;
+	__m128i bg, ra;
+
+	for (i = 0; n - i >= 16; i += 16, dst += 64)
+	{
+		va = _mm_loadu_si128((__m128i *) (a + i));
+		vr = _mm_loadu_si128((__m128i *) (r + i));
+		vg = _mm_loadu_si128((__m128i *) (g + i));
+		vb = _mm_loadu_si128((__m128i *) (b + i));
+
+		bg = _mm_unpacklo_epi8(vb, vg);
+		ra = _mm_unpacklo_epi8(vr, va);
+		_mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi16(bg, ra));
+		_mm_storeu_si128((__m128i *) (dst + 16), _mm_unpackhi_epi16(bg, ra));
+
+		bg = _mm_unpackhi_epi8(vb, vg);
+		ra = _mm_unpackhi_epi8(vr, va);
+		_mm_storeu_si128((__m128i *) (dst + 32), _mm_unpacklo_epi16(bg, ra));
+		_mm_storeu_si128((__m128i *) (dst + 48), _mm_unpackhi_epi16(bg, ra));
+	}
+
+	for (; i < n; i++, dst += 4)
+	{
+		dst[0] = b[i];
+		dst[1] = g[i];
+		dst[2] = r[i];
+		dst[3] = a[i];
+	}
+}
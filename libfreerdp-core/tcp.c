@@ -43,17 +43,24 @@
 #define TCP_CLOSE(_sck) closesocket(_sck)
 #define TCP_STRERROR "tcp error"
 #define TCP_BLOCKS (WSAGetLastError() == WSAEWOULDBLOCK)
+#define TCP_CONNECTING (WSAGetLastError() == WSAEWOULDBLOCK)
 #define MSG_NOSIGNAL 0
 #else
 #define TCP_CLOSE(_sck) close(_sck)
 #define TCP_STRERROR strerror(errno)
 #define TCP_BLOCKS (errno == EWOULDBLOCK)
+#define TCP_CONNECTING (errno == EINPROGRESS)
 #endif
 
 #ifdef __APPLE__
 #define MSG_NOSIGNAL SO_NOSIGPIPE
 #endif
 
+/* delay before racing the next address against a slow one */
+#define TCP_CONNECT_STAGGER 250
+/* overall connect timeout unless the settings give one */
+#define TCP_CONNECT_TIMEOUT 15000
+
 #ifndef INADDR_NONE
 #define INADDR_NONE ((unsigned long) -1)
 #endif
@@ -190,18 +197,180 @@ tcp_read(rdpTcp * tcp, char* b, int length)
 	return rcvd;
 }
 
+/* milliseconds on a clock that only has to be good for intervals */
+static uint32
+tcp_get_ticks(void)
+{
+#ifdef _WIN32
+	return GetTickCount();
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint32) (tv.tv_sec * 1000 + tv.tv_usec / 1000);
+#endif
+}
+
+/* Start a non blocking connect, returns the socket or -1 if it failed right away */
+static int
+tcp_connect_start(TCP_ADDRESS * address, RD_BOOL * connected)
+{
+	int sockfd;
+
+	*connected = False;
+	sockfd = socket(address->family, SOCK_STREAM, 0);
+	if (sockfd < 0)
+		return -1;
+
+#ifdef _WIN32
+	{
+		u_long arg = 1;
+		ioctlsocket(sockfd, FIONBIO, &arg);
+	}
+#else
+	fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+#endif
+
+	if (connect(sockfd, address->addr, address->addrlen) == 0)
+	{
+		*connected = True;
+		return sockfd;
+	}
+	if (TCP_CONNECTING)
+		return sockfd;
+
+	TCP_CLOSE(sockfd);
+	return -1;
+}
+
+/*
+   Connect to the first of the addresses that answers. The attempts start
+   one after the other, each stagger milliseconds after the previous one or
+   as soon as the previous one failed, and then run side by side so a dead
+   address only costs the stagger. Gives up after timeout milliseconds.
+   Returns the connected socket, non blocking, or -1.
+*/
+int
+tcp_connect_race(TCP_ADDRESS * addresses, int count, int stagger, int timeout)
+{
+	int index;
+	int sockfd;
+	int max_fd;
+	int num_active;
+	int next;
+	int wait;
+	int * socks;
+	uint32 now;
+	uint32 start;
+	uint32 next_start;
+	RD_BOOL connected;
+	fd_set wfds;
+	fd_set efds;
+	struct timeval time;
+
+	socks = (int *) xmalloc(sizeof(int) * count);
+	for (index = 0; index < count; index++)
+		socks[index] = -1;
+
+	sockfd = -1;
+	num_active = 0;
+	next = 0;
+	start = next_start = tcp_get_ticks();
+
+	while (sockfd == -1)
+	{
+		now = tcp_get_ticks();
+		if ((int) (now - start) >= timeout)
+			break;
+
+		if ((next < count) && ((num_active == 0) || ((int) (now - next_start) >= 0)))
+		{
+			socks[next] = tcp_connect_start(&addresses[next], &connected);
+			if (connected)
+			{
+				sockfd = socks[next];
+			}
+			else if (socks[next] != -1)
+			{
+				num_active++;
+				next_start = now + stagger;
+			}
+			next++;
+			continue;
+		}
+
+		if (num_active == 0)
+			break;
+
+		FD_ZERO(&wfds);
+		FD_ZERO(&efds);
+		max_fd = 0;
+		for (index = 0; index < next; index++)
+		{
+			if (socks[index] == -1)
+				continue;
+			FD_SET(socks[index], &wfds);
+			FD_SET(socks[index], &efds);
+			if (socks[index] > max_fd)
+				max_fd = socks[index];
+		}
+
+		wait = timeout - (int) (now - start);
+		if ((next < count) && ((int) (next_start - now) < wait))
+			wait = (int) (next_start - now);
+		time.tv_sec = wait / 1000;
+		time.tv_usec = (wait % 1000) * 1000;
+
+		if (select(max_fd + 1, NULL, &wfds, &efds, &time) <= 0)
+			continue;
+
+		for (index = 0; index < next; index++)
+		{
+			if ((socks[index] == -1) ||
+				(!FD_ISSET(socks[index], &wfds) && !FD_ISSET(socks[index], &efds)))
+				continue;
+
+			if (!FD_ISSET(socks[index], &efds) && tcp_socket_ok(socks[index]))
+			{
+				sockfd = socks[index];
+				break;
+			}
+
+			/* refused or unreachable, move on to the next address now */
+			TCP_CLOSE(socks[index]);
+			socks[index] = -1;
+			num_active--;
+			next_start = now;
+		}
+	}
+
+	for (index = 0; index < next; index++)
+	{
+		if ((socks[index] != -1) && (socks[index] != sockfd))
+			TCP_CLOSE(socks[index]);
+	}
+	xfree(socks);
+
+	return sockfd;
+}
+
 /* Establish a connection on the TCP layer */
 RD_BOOL
 tcp_connect(rdpTcp * tcp, char * server, int port)
 {
 	int sockfd;
+	int timeout;
 	uint32 option_value;
 	socklen_t option_len;
 
 #ifdef IPv6
 
 	int n;
-	struct addrinfo hints, *res, *ressave;
+	int count;
+	int index;
+	RD_BOOL take_first;
+	struct addrinfo hints, *res, *ai, *ai_first, *ai_other;
+	TCP_ADDRESS * addresses;
 	char tcp_port_rdp_s[10];
 
 	printf("connecting to %s:%d\n", server, port);
@@ -218,21 +387,45 @@ tcp_connect(rdpTcp * tcp, char * server, int port)
 		return False;
 	}
 
-	ressave = res;
-	sockfd = -1;
-	while (res)
+	count = 0;
+	for (ai = res; ai != NULL; ai = ai->ai_next)
+		count++;
+	addresses = (TCP_ADDRESS *) xmalloc(sizeof(TCP_ADDRESS) * count);
+
+	/* alternate between the address families, starting with the one the
+	   resolver put first, so a broken IPv6 or IPv4 route costs one stagger */
+	ai_first = ai_other = res;
+	take_first = True;
+	for (index = 0; index < count; index++)
 	{
-		sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-		if (!(sockfd < 0))
+		while ((ai_first != NULL) && (ai_first->ai_family != res->ai_family))
+			ai_first = ai_first->ai_next;
+		while ((ai_other != NULL) && (ai_other->ai_family == res->ai_family))
+			ai_other = ai_other->ai_next;
+
+		if ((ai_first != NULL) && (take_first || (ai_other == NULL)))
 		{
-			if (connect(sockfd, res->ai_addr, res->ai_addrlen) == 0)
-				break;
-			TCP_CLOSE(sockfd);
-			sockfd = -1;
+			ai = ai_first;
+			ai_first = ai_first->ai_next;
 		}
-		res = res->ai_next;
+		else
+		{
+			ai = ai_other;
+			ai_other = ai_other->ai_next;
+		}
+		take_first = !take_first;
+
+		addresses[index].family = ai->ai_family;
+		addresses[index].addr = ai->ai_addr;
+		addresses[index].addrlen = ai->ai_addrlen;
 	}
-	freeaddrinfo(ressave);
+
+	timeout = tcp->net->rdp->settings->tcp_connect_timeout;
+	sockfd = tcp_connect_race(addresses, count, TCP_CONNECT_STAGGER,
+		(timeout > 0) ? timeout : TCP_CONNECT_TIMEOUT);
+
+	xfree(addresses);
+	freeaddrinfo(res);
 
 	if (sockfd == -1)
 	{
@@ -244,9 +437,11 @@ tcp_connect(rdpTcp * tcp, char * server, int port)
 
 	struct hostent *nslookup;
 	struct sockaddr_in servaddr;
+	TCP_ADDRESS address;
 
 	printf("connecting to %s:%d\n", server, port);
 
+	memset(&servaddr, 0, sizeof(servaddr));
 	if ((nslookup = gethostbyname(server)) != NULL)
 	{
 		memcpy(&servaddr.sin_addr, nslookup->h_addr, sizeof(servaddr.sin_addr));
@@ -257,19 +452,20 @@ tcp_connect(rdpTcp * tcp, char * server, int port)
 		return False;
 	}
 
-	if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
-	{
-		ui_error(tcp->net->rdp->inst, "socket: %s\n", TCP_STRERROR);
-		return False;
-	}
-
 	servaddr.sin_family = AF_INET;
 	servaddr.sin_port = htons((uint16) port);
 
-	if (connect(sockfd, (struct sockaddr *) &servaddr, sizeof(struct sockaddr)) < 0)
+	address.family = AF_INET;
+	address.addr = (struct sockaddr *) &servaddr;
+	address.addrlen = sizeof(servaddr);
+
+	timeout = tcp->net->rdp->settings->tcp_connect_timeout;
+	sockfd = tcp_connect_race(&address, 1, TCP_CONNECT_STAGGER,
+		(timeout > 0) ? timeout : TCP_CONNECT_TIMEOUT);
+
+	if (sockfd == -1)
 	{
-		ui_error(tcp->net->rdp->inst, "connect: %s\n", TCP_STRERROR);
-		TCP_CLOSE(sockfd);
+		ui_error(tcp->net->rdp->inst, "%s: unable to connect\n", server);
 		return False;
 	}
 
@@ -36,6 +36,15 @@ struct rdp_tcp
 };
 typedef struct rdp_tcp rdpTcp;
 
+/* an address for tcp_connect_race */
+struct _TCP_ADDRESS
+{
+	int family;
+	struct sockaddr * addr;
+	int addrlen;
+};
+typedef struct _TCP_ADDRESS TCP_ADDRESS;
+
 void
 tcp_write(rdpTcp * tcp, char* b, int length);
 int
@@ -45,6 +54,8 @@ RD_BOOL
 tcp_can_send(int sck, int millis);
 RD_BOOL
 tcp_can_recv(int sck, int millis);
+int
+tcp_connect_race(TCP_ADDRESS * addresses, int count, int stagger, int timeout);
 RD_BOOL
 tcp_connect(rdpTcp * tcp, char * server, int port);
 void
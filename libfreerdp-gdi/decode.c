@@ -37,6 +37,7 @@ int gdi_decode_bitmap_data_ex(GDI *gdi, uint16 x, uint16 y, uint8 * data, int si
 	uint8* bitmapData;
 	uint32 bitmapDataLength;
 	RFX_MESSAGE * message;
+	RFX_RECT clip;
 
 	/* BITMAP_DATA_EX */
 	/* bpp (1 byte) */
@@ -48,6 +49,33 @@ int gdi_decode_bitmap_data_ex(GDI *gdi, uint16 x, uint16 y, uint8 * data, int si
 	bitmapDataLength = GET_UINT32(data, 8); /* bitmapDataLength (4 bytes) */
 	bitmapData = data + 12; /* bitmapData */
 
+	if (gdi->dstBpp == 32)
+	{
+		/* decode straight into the primary surface, clipped to the current clipping region */
+		if (!gdi->primary->hdc->clip->null)
+		{
+			clip.x = gdi->primary->hdc->clip->x;
+			clip.y = gdi->primary->hdc->clip->y;
+			clip.width = gdi->primary->hdc->clip->w;
+			clip.height = gdi->primary->hdc->clip->h;
+		}
+
+		message = rfx_process_message_ex((RFX_CONTEXT *) gdi->rfx_context, bitmapData, bitmapDataLength,
+				x, y, gdi->primary_buffer, gdi->width, gdi->height, gdi->width * 4, RFX_PIXEL_FORMAT_BGRA,
+				gdi->primary->hdc->clip->null ? NULL : &clip, 1);
+
+		for (i = 0; i < message->num_rects; i++)
+		{
+			gdi_InvalidateRegion(gdi->primary->hdc,
+					message->rects[i].x + x, message->rects[i].y + y,
+					message->rects[i].width, message->rects[i].height);
+		}
+
+		rfx_message_free(gdi->rfx_context, message);
+
+		return bitmapDataLength + 12;
+	}
+
 	/* decode bitmap data */
 	message = rfx_process_message((RFX_CONTEXT *) gdi->rfx_context, bitmapData, bitmapDataLength);
 
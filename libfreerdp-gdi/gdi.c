@@ -296,38 +296,122 @@ gdi_rop3_code(uint8 code)
 	return rop3_code_table[code];
 }
 
-void
-gdi_copy_mem(uint8 * d, uint8 * s, int n)
+/* a word at a time once d is aligned, the loads may be unaligned */
+#define COPY_WORD	unsigned long
+
+static void
+gdi_copy_words(uint8 * d, uint8 * s, int n)
 {
-	memcpy(d, s, n);
+	COPY_WORD w0, w1, w2, w3;
+
+	while ((n > 0) && ((size_t) d & (sizeof(COPY_WORD) - 1)))
+	{
+		*(d++) = *(s++);
+		n--;
+	}
+
+	/* every load comes before the store that could overwrite it */
+	while (n >= 4 * (int) sizeof(COPY_WORD))
+	{
+		memcpy(&w0, s, sizeof(COPY_WORD));
+		memcpy(&w1, s + sizeof(COPY_WORD), sizeof(COPY_WORD));
+		memcpy(&w2, s + 2 * sizeof(COPY_WORD), sizeof(COPY_WORD));
+		memcpy(&w3, s + 3 * sizeof(COPY_WORD), sizeof(COPY_WORD));
+		memcpy(d, &w0, sizeof(COPY_WORD));
+		memcpy(d + sizeof(COPY_WORD), &w1, sizeof(COPY_WORD));
+		memcpy(d + 2 * sizeof(COPY_WORD), &w2, sizeof(COPY_WORD));
+		memcpy(d + 3 * sizeof(COPY_WORD), &w3, sizeof(COPY_WORD));
+		d += 4 * sizeof(COPY_WORD);
+		s += 4 * sizeof(COPY_WORD);
+		n -= 4 * sizeof(COPY_WORD);
+	}
+
+	while (n >= (int) sizeof(COPY_WORD))
+	{
+		memcpy(&w0, s, sizeof(COPY_WORD));
+		memcpy(d, &w0, sizeof(COPY_WORD));
+		d += sizeof(COPY_WORD);
+		s += sizeof(COPY_WORD);
+		n -= sizeof(COPY_WORD);
+	}
+
+	while (n > 0)
+	{
+		*(d++) = *(s++);
+		n--;
+	}
 }
 
-void
-gdi_copy_memb(uint8 * d, uint8 * s, int n)
+/* the same from the last byte down, with the end of d aligned */
+static void
+gdi_copy_wordsb(uint8 * d, uint8 * s, int n)
 {
-	d = (d + n) - 1;
-	s = (s + n) - 1;
-	
-	while (n & (~7))
+	COPY_WORD w0, w1, w2, w3;
+
+	d += n;
+	s += n;
+
+	while ((n > 0) && ((size_t) d & (sizeof(COPY_WORD) - 1)))
 	{
-		*(d--) = *(s--);
-		*(d--) = *(s--);
-		*(d--) = *(s--);
-		*(d--) = *(s--);
-		*(d--) = *(s--);
-		*(d--) = *(s--);
-		*(d--) = *(s--);
-		*(d--) = *(s--);
-		n = n - 8;
+		*(--d) = *(--s);
+		n--;
+	}
+
+	while (n >= 4 * (int) sizeof(COPY_WORD))
+	{
+		d -= 4 * sizeof(COPY_WORD);
+		s -= 4 * sizeof(COPY_WORD);
+		n -= 4 * sizeof(COPY_WORD);
+		memcpy(&w3, s + 3 * sizeof(COPY_WORD), sizeof(COPY_WORD));
+		memcpy(&w2, s + 2 * sizeof(COPY_WORD), sizeof(COPY_WORD));
+		memcpy(&w1, s + sizeof(COPY_WORD), sizeof(COPY_WORD));
+		memcpy(&w0, s, sizeof(COPY_WORD));
+		memcpy(d + 3 * sizeof(COPY_WORD), &w3, sizeof(COPY_WORD));
+		memcpy(d + 2 * sizeof(COPY_WORD), &w2, sizeof(COPY_WORD));
+		memcpy(d + sizeof(COPY_WORD), &w1, sizeof(COPY_WORD));
+		memcpy(d, &w0, sizeof(COPY_WORD));
+	}
+
+	while (n >= (int) sizeof(COPY_WORD))
+	{
+		d -= sizeof(COPY_WORD);
+		s -= sizeof(COPY_WORD);
+		n -= sizeof(COPY_WORD);
+		memcpy(&w0, s, sizeof(COPY_WORD));
+		memcpy(d, &w0, sizeof(COPY_WORD));
 	}
 
 	while (n > 0)
 	{
-		*(d--) = *(s--);
+		*(--d) = *(--s);
 		n--;
 	}
 }
 
+/* copies n bytes from s to d, which may overlap (memmove) */
+void
+gdi_copy_mem(uint8 * d, uint8 * s, int n)
+{
+	if ((d + n <= s) || (s + n <= d))
+		memcpy(d, s, n);
+	else if (d > s)
+		gdi_copy_memb(d, s, n);
+	else if (gdi_rop_funcs.copy_row != NULL)
+		gdi_rop_funcs.copy_row(d, s, n);
+	else
+		gdi_copy_words(d, s, n);
+}
+
+/* copies n bytes from s to d, last byte first, for d after s */
+void
+gdi_copy_memb(uint8 * d, uint8 * s, int n)
+{
+	if (gdi_rop_funcs.copy_rowb != NULL)
+		gdi_rop_funcs.copy_rowb(d, s, n);
+	else
+		gdi_copy_wordsb(d, s, n);
+}
+
 uint8*
 gdi_get_bitmap_pointer(HGDI_DC hdcBmp, int x, int y)
 {
@@ -1104,11 +1188,14 @@ gdi_register_callbacks(rdpInst * inst)
 /**
  * Initialize GDI
  * @param inst current instance
+ * @param flags color conversion and internal buffer format flags
+ * @param buffer primary buffer of width * height pixels in the internal
+ * format, kept by the caller, or NULL to allocate one
  * @return
  */
 
 int
-gdi_init(rdpInst * inst, uint32 flags)
+gdi_init(rdpInst * inst, uint32 flags, uint8* buffer)
 {
 	GDI *gdi = (GDI*) malloc(sizeof(GDI));
 	memset(gdi, 0, sizeof(GDI));
@@ -1164,14 +1251,26 @@ gdi_init(rdpInst * inst, uint32 flags)
 	gdi->hdc->rgb555 = gdi->clrconv->rgb555;
 
 	gdi->primary = gdi_bitmap_new(gdi, gdi->width, gdi->height, gdi->dstBpp, NULL);
+
+	if (buffer != NULL)
+	{
+		free(gdi->primary->bitmap->data);
+		gdi->primary->bitmap->data = buffer;
+		gdi->primary_extern = 1;
+	}
+
 	gdi->primary_buffer = gdi->primary->bitmap->data;
 	gdi->drawing = gdi->primary;
 
 	gdi->primary->hdc->hwnd = (HGDI_WND) malloc(sizeof(GDI_WND));
 	gdi->primary->hdc->hwnd->invalid = gdi_CreateRectRgn(0, 0, 0, 0);
 	gdi->primary->hdc->hwnd->invalid->null = 1;
+	gdi->primary->hdc->hwnd->count = GDI_MAX_INVALID;
+	gdi->primary->hdc->hwnd->cinvalid = (HGDI_RGN) malloc(sizeof(GDI_RGN) * GDI_MAX_INVALID);
+	gdi->primary->hdc->hwnd->ninvalid = 0;
 
 	gdi->rfx_context = rfx_context_new();
+	rfx_context_set_num_threads(gdi->rfx_context, 0);
 	gdi->tile = gdi_bitmap_new(gdi, 64, 64, 32, NULL);
 
 	gdi_register_callbacks(inst);
@@ -1192,6 +1291,10 @@ void gdi_free(rdpInst* inst)
 	{
 		gdi_bitmap_free(gdi->tile);
 		rfx_context_free(gdi->rfx_context);
+
+		if (gdi->primary_extern)
+			gdi->primary->bitmap->data = NULL;
+
 		gdi_bitmap_free(gdi->primary);
 		gdi_DeleteObject((HGDIOBJECT) gdi->hdc);
 		free(gdi->clrconv);
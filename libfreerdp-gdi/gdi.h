@@ -193,9 +193,15 @@ struct _GDI_BRUSH
 typedef struct _GDI_BRUSH GDI_BRUSH;
 typedef GDI_BRUSH* HGDI_BRUSH;
 
+/* damage rects kept per update, past that the closest ones are merged */
+#define GDI_MAX_INVALID		32
+
 struct _GDI_WND
 {
-	HGDI_RGN invalid;
+	HGDI_RGN invalid; /* bounding rect of the damage */
+	HGDI_RGN cinvalid; /* damage list, non-overlapping */
+	int ninvalid;
+	int count; /* room in cinvalid */
 };
 typedef struct _GDI_WND GDI_WND;
 typedef GDI_WND* HGDI_WND;
@@ -255,6 +261,7 @@ struct _GDI
 	GDI_IMAGE *primary;
 	GDI_IMAGE *drawing;
 	uint8* primary_buffer;
+	int primary_extern; /* primary_buffer belongs to the caller */
 	GDI_COLOR textColor;
 	void * rfx_context;
 	GDI_IMAGE *tile;
@@ -273,7 +280,7 @@ void gdi_copy_memb(uint8 *d, uint8 *s, int n);
 uint8* gdi_get_bitmap_pointer(HGDI_DC hdcBmp, int x, int y);
 uint8* gdi_get_brush_pointer(HGDI_DC hdcBrush, int x, int y);
 int gdi_is_mono_pixel_set(uint8* data, int x, int y, int width);
-int gdi_init(rdpInst * inst, uint32 flags);
+int gdi_init(rdpInst * inst, uint32 flags, uint8* buffer);
 GDI_IMAGE* gdi_bitmap_new(GDI *gdi, int width, int height, int bpp, uint8* data);
 void gdi_bitmap_free(GDI_IMAGE *gdi_bmp);
 void gdi_free(rdpInst* inst);
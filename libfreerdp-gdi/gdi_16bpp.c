@@ -168,23 +168,9 @@ static int BitBlt_SRCCOPY_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWi
 			}
 		}
 	}
-	else if (nYSrc > nYDest || nXSrc > nXDest)
-	{
-		/* copy up or left (top top bottom) */
-		for (y = 0; y < nHeight; y++)
-		{
-			srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-			dstp = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (srcp != 0 && dstp != 0)
-			{
-				gdi_copy_mem(dstp, srcp, nWidth * hdcDest->bytesPerPixel);
-			}
-		}
-	}
 	else
 	{
-		/* copy straight right */
+		/* copy up (top to bottom), along a row gdi_copy_mem goes the safe way */
 		for (y = 0; y < nHeight; y++)
 		{
 			srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
@@ -192,7 +178,7 @@ static int BitBlt_SRCCOPY_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWi
 
 			if (srcp != 0 && dstp != 0)
 			{
-				gdi_copy_memb(dstp, srcp, nWidth * hdcDest->bytesPerPixel);
+				gdi_copy_mem(dstp, srcp, nWidth * hdcDest->bytesPerPixel);
 			}
 		}
 	}
@@ -238,7 +224,11 @@ static int BitBlt_DSTINVERT_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int n
 	{
 		dstp = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
 
-		if (dstp != 0)
+		if (dstp != 0 && gdi_rop_funcs.dstinvert_row != NULL)
+		{
+			gdi_rop_funcs.dstinvert_row(dstp, nWidth * 2, 0xFFFFFFFF);
+		}
+		else if (dstp != 0)
 		{
 			for (x = 0; x < nWidth; x++)
 			{
@@ -591,7 +581,11 @@ static int BitBlt_PATCOPY_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWi
 		{
 			dstp16 = (uint16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
 
-			if (dstp16 != 0)
+			if (dstp16 != 0 && gdi_rop_funcs.patcopy_row != NULL)
+			{
+				gdi_rop_funcs.patcopy_row((uint8*) dstp16, color16 | ((uint32) color16 << 16), nWidth * 2);
+			}
+			else if (dstp16 != 0)
 			{
 				for (x = 0; x < nWidth; x++)
 				{
@@ -644,7 +638,11 @@ static int BitBlt_PATINVERT_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int n
 		{
 			dstp16 = (uint16*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
 
-			if (dstp16 != 0)
+			if (dstp16 != 0 && gdi_rop_funcs.patinvert_row != NULL)
+			{
+				gdi_rop_funcs.patinvert_row((uint8*) dstp16, color16 | ((uint32) color16 << 16), nWidth * 2);
+			}
+			else if (dstp16 != 0)
 			{
 				for (x = 0; x < nWidth; x++)
 				{
@@ -715,8 +713,29 @@ static int BitBlt_PATPAINT_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nW
 	return 0;
 }
 
+/* both bytes of every pixel take part */
+static int BitBlt_ROW_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, p_gdi_rop_row rop_row)
+{
+	int y;
+	uint8 *srcp;
+	uint8 *dstp;
+
+	for (y = 0; y < nHeight; y++)
+	{
+		dstp = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
+		srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
+
+		if (dstp != 0 && srcp != 0)
+			rop_row(dstp, srcp, nWidth * 2, 0xFFFFFFFF);
+	}
+
+	return 0;
+}
+
 int BitBlt_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop)
 {
+	p_gdi_rop_row rop_row;
+
 	if (hdcSrc != NULL)
 	{
 		if (gdi_ClipCoords(hdcDest, &nXDest, &nYDest, &nWidth, &nHeight, &nXSrc, &nYSrc) == 0)
@@ -729,6 +748,12 @@ int BitBlt_16bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeigh
 	}
 	
 	gdi_InvalidateRegion(hdcDest, nXDest, nYDest, nWidth, nHeight);
+
+	rop_row = gdi_get_rop_row(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc, rop);
+
+	if (rop_row != NULL)
+		return BitBlt_ROW_16bpp(hdcDest, nXDest, nYDest, nWidth, nHeight,
+			hdcSrc, nXSrc, nYSrc, rop_row);
 	
 	switch (rop)
 	{
@@ -185,23 +185,9 @@ static int BitBlt_SRCCOPY_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWi
 			}
 		}
 	}
-	else if (nYSrc > nYDest || nXSrc > nXDest)
-	{
-		/* copy up or left (top top bottom) */
-		for (y = 0; y < nHeight; y++)
-		{
-			srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-			dstp = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (srcp != 0 && dstp != 0)
-			{
-				gdi_copy_mem(dstp, srcp, nWidth * hdcDest->bytesPerPixel);
-			}
-		}
-	}
 	else
 	{
-		/* copy straight right */
+		/* copy up (top to bottom), along a row gdi_copy_mem goes the safe way */
 		for (y = 0; y < nHeight; y++)
 		{
 			srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
@@ -209,7 +195,7 @@ static int BitBlt_SRCCOPY_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWi
 
 			if (srcp != 0 && dstp != 0)
 			{
-				gdi_copy_memb(dstp, srcp, nWidth * hdcDest->bytesPerPixel);
+				gdi_copy_mem(dstp, srcp, nWidth * hdcDest->bytesPerPixel);
 			}
 		}
 	}
@@ -259,7 +245,11 @@ static int BitBlt_DSTINVERT_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int n
 	{
 		dstp = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
 
-		if (dstp != 0)
+		if (dstp != 0 && gdi_rop_funcs.dstinvert_row != NULL)
+		{
+			gdi_rop_funcs.dstinvert_row(dstp, nWidth * 4, 0x00FFFFFF);
+		}
+		else if (dstp != 0)
 		{
 			for (x = 0; x < nWidth; x++)
 			{
@@ -654,7 +644,11 @@ static int BitBlt_PATCOPY_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWi
 		{
 			dstp32 = (uint32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
 
-			if (dstp32 != 0)
+			if (dstp32 != 0 && gdi_rop_funcs.patcopy_row != NULL)
+			{
+				gdi_rop_funcs.patcopy_row((uint8*) dstp32, color32, nWidth * 4);
+			}
+			else if (dstp32 != 0)
 			{
 				for (x = 0; x < nWidth; x++)
 				{
@@ -710,7 +704,11 @@ static int BitBlt_PATINVERT_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int n
 		{
 			dstp32 = (uint32*) gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
 
-			if (dstp32 != 0)
+			if (dstp32 != 0 && gdi_rop_funcs.patinvert_row != NULL)
+			{
+				gdi_rop_funcs.patinvert_row((uint8*) dstp32, color32, nWidth * 4);
+			}
+			else if (dstp32 != 0)
 			{
 				for (x = 0; x < nWidth; x++)
 				{
@@ -788,8 +786,29 @@ static int BitBlt_PATPAINT_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nW
 	return 0;
 }
 
+/* the row kernels keep the alpha byte, like the loops above */
+static int BitBlt_ROW_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, p_gdi_rop_row rop_row)
+{
+	int y;
+	uint8 *srcp;
+	uint8 *dstp;
+
+	for (y = 0; y < nHeight; y++)
+	{
+		dstp = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
+		srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
+
+		if (dstp != 0 && srcp != 0)
+			rop_row(dstp, srcp, nWidth * 4, 0x00FFFFFF);
+	}
+
+	return 0;
+}
+
 int BitBlt_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop)
 {
+	p_gdi_rop_row rop_row;
+
 	if (hdcSrc != NULL)
 	{
 		if (gdi_ClipCoords(hdcDest, &nXDest, &nYDest, &nWidth, &nHeight, &nXSrc, &nYSrc) == 0)
@@ -802,6 +821,12 @@ int BitBlt_32bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeigh
 	}
 	
 	gdi_InvalidateRegion(hdcDest, nXDest, nYDest, nWidth, nHeight);
+
+	rop_row = gdi_get_rop_row(hdcDest, nXDest, nYDest, nWidth, nHeight, hdcSrc, nXSrc, nYSrc, rop);
+
+	if (rop_row != NULL)
+		return BitBlt_ROW_32bpp(hdcDest, nXDest, nYDest, nWidth, nHeight,
+			hdcSrc, nXSrc, nYSrc, rop_row);
 	
 	switch (rop)
 	{
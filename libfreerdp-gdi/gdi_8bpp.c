@@ -107,23 +107,9 @@ static int BitBlt_SRCCOPY_8bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWid
 			}
 		}
 	}
-	else if (nYSrc > nYDest || nXSrc > nXDest)
-	{
-		/* copy up or left (top top bottom) */
-		for (y = 0; y < nHeight; y++)
-		{
-			srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
-			dstp = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
-
-			if (srcp != 0 && dstp != 0)
-			{
-				gdi_copy_mem(dstp, srcp, nWidth * hdcDest->bytesPerPixel);
-			}
-		}
-	}
 	else
 	{
-		/* copy straight right */
+		/* copy up (top to bottom), along a row gdi_copy_mem goes the safe way */
 		for (y = 0; y < nHeight; y++)
 		{
 			srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
@@ -131,7 +117,7 @@ static int BitBlt_SRCCOPY_8bpp(HGDI_DC hdcDest, int nXDest, int nYDest, int nWid
 
 			if (srcp != 0 && dstp != 0)
 			{
-				gdi_copy_memb(dstp, srcp, nWidth * hdcDest->bytesPerPixel);
+				gdi_copy_mem(dstp, srcp, nWidth * hdcDest->bytesPerPixel);
 			}
 		}
 	}
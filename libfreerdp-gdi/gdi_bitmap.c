@@ -28,6 +28,7 @@
 #include "gdi_32bpp.h"
 #include "gdi_16bpp.h"
 #include "gdi_8bpp.h"
+#include "gdi_region.h"
 
 #include "gdi_bitmap.h"
 
@@ -40,6 +41,8 @@ p_gdi_BitBlt_bpp BitBlt_[5] =
 	BitBlt_32bpp
 };
 
+GDI_ROP_FUNCS gdi_rop_funcs;
+
 /**
  * Get pixel at the given coordinates.\n
  * @msdn{dd144909}
@@ -163,6 +166,74 @@ HGDI_BITMAP gdi_CreateCompatibleBitmap(HGDI_DC hdc, int nWidth, int nHeight)
 	return hBitmap;
 }
 
+/**
+ * Get the row kernel for a raster operation.\n
+ * The kernels read a whole vector of source before writing, so a blit within
+ * one bitmap whose source and destination overlap keeps the plain loops.
+ * @param hdcDest destination device context
+ * @param nXDest destination x1
+ * @param nYDest destination y1
+ * @param nWidth width
+ * @param nHeight height
+ * @param hdcSrc source device context
+ * @param nXSrc source x1
+ * @param nYSrc source y1
+ * @param rop raster operation code
+ * @return row kernel, or NULL if there is none for this blit
+ */
+
+p_gdi_rop_row gdi_get_rop_row(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop)
+{
+	int index;
+
+	switch (rop)
+	{
+		case GDI_NOTSRCCOPY:
+			index = GDI_ROW_NOTSRCCOPY;
+			break;
+
+		case GDI_SRCERASE:
+			index = GDI_ROW_SRCERASE;
+			break;
+
+		case GDI_NOTSRCERASE:
+			index = GDI_ROW_NOTSRCERASE;
+			break;
+
+		case GDI_SRCINVERT:
+			index = GDI_ROW_SRCINVERT;
+			break;
+
+		case GDI_SRCAND:
+			index = GDI_ROW_SRCAND;
+			break;
+
+		case GDI_SRCPAINT:
+			index = GDI_ROW_SRCPAINT;
+			break;
+
+		case GDI_DSna:
+			index = GDI_ROW_DSna;
+			break;
+
+		case GDI_MERGEPAINT:
+			index = GDI_ROW_MERGEPAINT;
+			break;
+
+		default:
+			return NULL;
+	}
+
+	if (hdcSrc == NULL)
+		return NULL;
+
+	if ((hdcSrc->selectedObject == hdcDest->selectedObject) &&
+		gdi_CopyOverlap(nXDest, nYDest, nWidth, nHeight, nXSrc, nYSrc))
+		return NULL;
+
+	return gdi_rop_funcs.rop_row[index];
+}
+
 /**
  * Perform a bit blit operation on the given pixel buffers.\n
  * @msdn{dd183370}
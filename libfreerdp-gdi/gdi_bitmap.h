@@ -40,4 +40,43 @@ int gdi_BitBlt(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight,
 typedef int (*p_gdi_BitBlt_bpp)(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop);
 typedef int (*p_gdi_BitBlt)(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop);
 
+/* raster operations with a row kernel, as indexes into GDI_ROP_FUNCS */
+enum GDI_ROP_ROW
+{
+	GDI_ROW_NOTSRCCOPY,	/* ~S */
+	GDI_ROW_SRCERASE,	/* S & ~D */
+	GDI_ROW_NOTSRCERASE,	/* ~S & ~D */
+	GDI_ROW_SRCINVERT,	/* S ^ D */
+	GDI_ROW_SRCAND,		/* S & D */
+	GDI_ROW_SRCPAINT,	/* S | D */
+	GDI_ROW_DSna,		/* ~S & D */
+	GDI_ROW_MERGEPAINT,	/* ~S | D */
+	GDI_ROW_COUNT
+};
+
+/* dst = op(src, dst) over n bytes, changing only the bits set in mask, which repeats every 4 bytes */
+typedef void (*p_gdi_rop_row)(uint8* dst, uint8* src, int n, uint32 mask);
+/* dst = pattern, or dst ^= pattern, over n bytes, the pattern repeating every 4 bytes */
+typedef void (*p_gdi_pat_row)(uint8* dst, uint32 pattern, int n);
+/* dst = ~dst over n bytes, on the bits set in mask as above */
+typedef void (*p_gdi_dst_row)(uint8* dst, int n, uint32 mask);
+/* copies n bytes, first byte first or last byte first, for overlapping rows */
+typedef void (*p_gdi_copy_row)(uint8* dst, uint8* src, int n);
+
+struct _GDI_ROP_FUNCS
+{
+	p_gdi_rop_row rop_row[GDI_ROW_COUNT];
+	p_gdi_pat_row patcopy_row;
+	p_gdi_pat_row patinvert_row;
+	p_gdi_dst_row dstinvert_row;
+	p_gdi_copy_row copy_row;
+	p_gdi_copy_row copy_rowb;
+};
+typedef struct _GDI_ROP_FUNCS GDI_ROP_FUNCS;
+
+/* filled in by GDI_INIT_SIMD, the NULL entries use the plain loops */
+extern GDI_ROP_FUNCS gdi_rop_funcs;
+
+p_gdi_rop_row gdi_get_rop_row(HGDI_DC hdcDest, int nXDest, int nYDest, int nWidth, int nHeight, HGDI_DC hdcSrc, int nXSrc, int nYSrc, int rop);
+
 #endif /* __GDI_BITMAP_H */
@@ -180,6 +180,7 @@ int gdi_DeleteDC(HGDI_DC hdc)
 	if (hdc->hwnd)
 	{
 		free(hdc->hwnd->invalid);
+		free(hdc->hwnd->cinvalid);
 		free(hdc->hwnd);
 	}
 
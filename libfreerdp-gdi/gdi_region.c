@@ -358,6 +358,98 @@ int gdi_PtInRect(HGDI_RECT rc, int x, int y)
 	return 0;
 }
 
+static int gdi_RectArea(HGDI_RECT rc)
+{
+	return (rc->right - rc->left + 1) * (rc->bottom - rc->top + 1);
+}
+
+static void gdi_UnionRect(HGDI_RECT dst, HGDI_RECT rc1, HGDI_RECT rc2)
+{
+	dst->left = (rc1->left < rc2->left) ? rc1->left : rc2->left;
+	dst->top = (rc1->top < rc2->top) ? rc1->top : rc2->top;
+	dst->right = (rc1->right > rc2->right) ? rc1->right : rc2->right;
+	dst->bottom = (rc1->bottom > rc2->bottom) ? rc1->bottom : rc2->bottom;
+}
+
+/**
+ * Add a rectangle to the damage list of a window.\n
+ * Rectangles that overlap, or that fill their bounding rectangle together,
+ * are merged, so the list never overlaps. Once the list is full the new
+ * rectangle is merged with the one that wastes the fewest pixels.
+ * @param hwnd window
+ * @param rect damaged rectangle
+ */
+
+static void gdi_InvalidateRect(HGDI_WND hwnd, HGDI_RECT rect)
+{
+	int index;
+	int best;
+	int waste;
+	int best_waste;
+	GDI_RECT cur;
+	GDI_RECT rgn;
+	GDI_RECT un;
+
+	gdi_CopyRect(&rgn, rect);
+
+	for (;;)
+	{
+		index = 0;
+
+		while (index < hwnd->ninvalid)
+		{
+			gdi_RgnToRect(&hwnd->cinvalid[index], &cur);
+
+			if (rgn.left >= cur.left && rgn.right <= cur.right &&
+				rgn.top >= cur.top && rgn.bottom <= cur.bottom)
+				return;
+
+			gdi_UnionRect(&un, &cur, &rgn);
+
+			if ((rgn.left <= cur.right && cur.left <= rgn.right &&
+				rgn.top <= cur.bottom && cur.top <= rgn.bottom) ||
+				gdi_RectArea(&un) <= gdi_RectArea(&cur) + gdi_RectArea(&rgn))
+			{
+				/* take it out and start over, the union may reach others */
+				gdi_CopyRect(&rgn, &un);
+				hwnd->cinvalid[index] = hwnd->cinvalid[--hwnd->ninvalid];
+				index = 0;
+				continue;
+			}
+
+			index++;
+		}
+
+		if (hwnd->ninvalid < hwnd->count)
+			break;
+
+		best = 0;
+		best_waste = 0;
+
+		for (index = 0; index < hwnd->ninvalid; index++)
+		{
+			gdi_RgnToRect(&hwnd->cinvalid[index], &cur);
+			gdi_UnionRect(&un, &cur, &rgn);
+			waste = gdi_RectArea(&un) - gdi_RectArea(&cur) - gdi_RectArea(&rgn);
+
+			if (index == 0 || waste < best_waste)
+			{
+				best = index;
+				best_waste = waste;
+			}
+		}
+
+		gdi_RgnToRect(&hwnd->cinvalid[best], &cur);
+		gdi_UnionRect(&rgn, &cur, &rgn);
+		hwnd->cinvalid[best] = hwnd->cinvalid[--hwnd->ninvalid];
+	}
+
+	gdi_RectToRgn(&rgn, &hwnd->cinvalid[hwnd->ninvalid]);
+	hwnd->cinvalid[hwnd->ninvalid].objectType = GDIOBJECT_REGION;
+	hwnd->cinvalid[hwnd->ninvalid].null = 0;
+	hwnd->ninvalid++;
+}
+
 /**
  * Invalidate a given region, such that it is redrawn on the next region update.\n
  * @msdn{dd145003}
@@ -385,6 +477,26 @@ int gdi_InvalidateRegion(HGDI_DC hdc, int x, int y, int w, int h)
 	invalid = hdc->hwnd->invalid;
 	bmp = (HGDI_BITMAP) hdc->selectedObject;
 
+	if (hdc->hwnd->cinvalid != NULL && hdc->hwnd->count > 0)
+	{
+		gdi_CRgnToRect(x, y, w, h, &rgn);
+
+		if (rgn.left < 0)
+			rgn.left = 0;
+
+		if (rgn.top < 0)
+			rgn.top = 0;
+
+		if (bmp != NULL && rgn.right >= bmp->width)
+			rgn.right = bmp->width - 1;
+
+		if (bmp != NULL && rgn.bottom >= bmp->height)
+			rgn.bottom = bmp->height - 1;
+
+		if (rgn.left <= rgn.right && rgn.top <= rgn.bottom)
+			gdi_InvalidateRect(hdc->hwnd, &rgn);
+	}
+
 	if (invalid->null)
 	{
 		invalid->x = x;
@@ -0,0 +1,198 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   GDI AVX2 Optimizations
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <immintrin.h>
+
+#include "gdi_avx2.h"
+
+#define NOT(_v) _mm256_xor_si256(_v, _mm256_set1_epi32(-1))
+
+/*
+ * dst = op(src, dst) where the mask bits are set, 32 bytes at a time and
+ * then byte by byte. _vop combines the vectors s and d, _op the bytes S and D.
+ */
+#define ROP_ROW_AVX2(_name, _vop, _op) \
+static void gdi_rop_row_##_name##_AVX2(uint8* dst, uint8* src, int n, uint32 mask) \
+{ \
+	int i; \
+	uint8 S, D, M; \
+	__m256i s, d; \
+	__m256i vm = _mm256_set1_epi32(mask); \
+	for (i = 0; n - i >= 32; i += 32) \
+	{ \
+		s = _mm256_loadu_si256((__m256i*) (src + i)); \
+		d = _mm256_loadu_si256((__m256i*) (dst + i)); \
+		_mm256_storeu_si256((__m256i*) (dst + i), \
+			_mm256_or_si256(_mm256_and_si256(vm, _vop), _mm256_andnot_si256(vm, d))); \
+	} \
+	_mm256_zeroupper(); \
+	for (; i < n; i++) \
+	{ \
+		S = src[i]; \
+		D = dst[i]; \
+		M = mask >> ((i & 3) * 8); \
+		dst[i] = (M & (_op)) | (~M & D); \
+	} \
+}
+
+ROP_ROW_AVX2(NOTSRCCOPY, NOT(s), ~S)
+ROP_ROW_AVX2(SRCERASE, _mm256_andnot_si256(d, s), S & ~D)
+ROP_ROW_AVX2(NOTSRCERASE, NOT(_mm256_or_si256(s, d)), ~S & ~D)
+ROP_ROW_AVX2(SRCINVERT, _mm256_xor_si256(s, d), S ^ D)
+ROP_ROW_AVX2(SRCAND, _mm256_and_si256(s, d), S & D)
+ROP_ROW_AVX2(SRCPAINT, _mm256_or_si256(s, d), S | D)
+ROP_ROW_AVX2(DSna, _mm256_andnot_si256(s, d), ~S & D)
+ROP_ROW_AVX2(MERGEPAINT, NOT(_mm256_andnot_si256(d, s)), ~S | D)
+
+static void gdi_dstinvert_row_AVX2(uint8* dst, int n, uint32 mask)
+{
+	int i;
+	__m256i vm = _mm256_set1_epi32(mask);
+
+	for (i = 0; n - i >= 32; i += 32)
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_xor_si256(_mm256_loadu_si256((__m256i*) (dst + i)), vm));
+
+	_mm256_zeroupper();
+
+	for (; i < n; i++)
+		dst[i] ^= (uint8) (mask >> ((i & 3) * 8));
+}
+
+static void gdi_patcopy_row_AVX2(uint8* dst, uint32 pattern, int n)
+{
+	int i;
+	__m256i p = _mm256_set1_epi32(pattern);
+
+	for (i = 0; n - i >= 32; i += 32)
+		_mm256_storeu_si256((__m256i*) (dst + i), p);
+
+	_mm256_zeroupper();
+
+	for (; i < n; i++)
+		dst[i] = pattern >> ((i & 3) * 8);
+}
+
+static void gdi_patinvert_row_AVX2(uint8* dst, uint32 pattern, int n)
+{
+	int i;
+	__m256i p = _mm256_set1_epi32(pattern);
+
+	for (i = 0; n - i >= 32; i += 32)
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_xor_si256(_mm256_loadu_si256((__m256i*) (dst + i)), p));
+
+	_mm256_zeroupper();
+
+	for (; i < n; i++)
+		dst[i] ^= pattern >> ((i & 3) * 8);
+}
+
+/* forward copy for dst before src, aligned stores once the head is done */
+static void gdi_copy_row_AVX2(uint8* dst, uint8* src, int n)
+{
+	__m256i v0, v1, v2, v3;
+
+	while ((n > 0) && ((size_t) dst & 31))
+	{
+		*(dst++) = *(src++);
+		n--;
+	}
+
+	/* every load comes before the store that could overwrite it */
+	for (; n >= 128; n -= 128, dst += 128, src += 128)
+	{
+		v0 = _mm256_loadu_si256((__m256i*) src);
+		v1 = _mm256_loadu_si256((__m256i*) (src + 32));
+		v2 = _mm256_loadu_si256((__m256i*) (src + 64));
+		v3 = _mm256_loadu_si256((__m256i*) (src + 96));
+		_mm256_store_si256((__m256i*) dst, v0);
+		_mm256_store_si256((__m256i*) (dst + 32), v1);
+		_mm256_store_si256((__m256i*) (dst + 64), v2);
+		_mm256_store_si256((__m256i*) (dst + 96), v3);
+	}
+
+	for (; n >= 32; n -= 32, dst += 32, src += 32)
+		_mm256_store_si256((__m256i*) dst, _mm256_loadu_si256((__m256i*) src));
+
+	_mm256_zeroupper();
+
+	while (n > 0)
+	{
+		*(dst++) = *(src++);
+		n--;
+	}
+}
+
+/* the same from the last byte down, for dst after src */
+static void gdi_copy_rowb_AVX2(uint8* dst, uint8* src, int n)
+{
+	__m256i v0, v1, v2, v3;
+
+	dst += n;
+	src += n;
+
+	while ((n > 0) && ((size_t) dst & 31))
+	{
+		*(--dst) = *(--src);
+		n--;
+	}
+
+	for (; n >= 128; n -= 128)
+	{
+		dst -= 128;
+		src -= 128;
+		v3 = _mm256_loadu_si256((__m256i*) (src + 96));
+		v2 = _mm256_loadu_si256((__m256i*) (src + 64));
+		v1 = _mm256_loadu_si256((__m256i*) (src + 32));
+		v0 = _mm256_loadu_si256((__m256i*) src);
+		_mm256_store_si256((__m256i*) (dst + 96), v3);
+		_mm256_store_si256((__m256i*) (dst + 64), v2);
+		_mm256_store_si256((__m256i*) (dst + 32), v1);
+		_mm256_store_si256((__m256i*) dst, v0);
+	}
+
+	for (; n >= 32; n -= 32)
+	{
+		dst -= 32;
+		src -= 32;
+		_mm256_store_si256((__m256i*) dst, _mm256_loadu_si256((__m256i*) src));
+	}
+
+	_mm256_zeroupper();
+
+	while (n > 0)
+	{
+		*(--dst) = *(--src);
+		n--;
+	}
+}
+
+void gdi_init_rop_AVX2(GDI_ROP_FUNCS* funcs)
+{
+	funcs->rop_row[GDI_ROW_NOTSRCCOPY] = gdi_rop_row_NOTSRCCOPY_AVX2;
+	funcs->rop_row[GDI_ROW_SRCERASE] = gdi_rop_row_SRCERASE_AVX2;
+	funcs->rop_row[GDI_ROW_NOTSRCERASE] = gdi_rop_row_NOTSRCERASE_AVX2;
+	funcs->rop_row[GDI_ROW_SRCINVERT] = gdi_rop_row_SRCINVERT_AVX2;
+	funcs->rop_row[GDI_ROW_SRCAND] = gdi_rop_row_SRCAND_AVX2;
+	funcs->rop_row[GDI_ROW_SRCPAINT] = gdi_rop_row_SRCPAINT_AVX2;
+	funcs->rop_row[GDI_ROW_DSna] = gdi_rop_row_DSna_AVX2;
+	funcs->rop_row[GDI_ROW_MERGEPAINT] = gdi_rop_row_MERGEPAINT_AVX2;
+	funcs->patcopy_row = gdi_patcopy_row_AVX2;
+	funcs->patinvert_row = gdi_patinvert_row_AVX2;
+	funcs->dstinvert_row = gdi_dstinvert_row_AVX2;
+	funcs->copy_row = gdi_copy_row_AVX2;
+	funcs->copy_rowb = gdi_copy_rowb_AVX2;
+}
@@ -0,0 +1,25 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   GDI AVX2 Optimizations
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __GDI_AVX2_H
+#define __GDI_AVX2_H
+
+#include "gdi.h"
+
+void gdi_init_rop_AVX2(GDI_ROP_FUNCS* funcs);
+
+#endif /* __GDI_AVX2_H */
@@ -21,12 +21,25 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "config.h"
 #include <freerdp/freerdp.h>
 #include "gdi.h"
 
+#include "gdi_sse2.h"
 #include "gdi_sse.h"
 
+#ifdef WITH_AVX2
+#include "gdi_avx2.h"
+#endif
+
 void gdi_init_sse(GDI* gdi)
 {
-
+	gdi_init_rop_SSE2(&gdi_rop_funcs);
+
+#ifdef WITH_AVX2
+	/* AVX2 needs support from both the CPU and the OS (saved YMM state) */
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		gdi_init_rop_AVX2(&gdi_rop_funcs);
+#endif
 }
@@ -0,0 +1,187 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   GDI SSE2 Optimizations
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <emmintrin.h>
+
+#include "gdi_sse2.h"
+
+#define NOT(_v) _mm_xor_si128(_v, _mm_set1_epi32(-1))
+
+/*
+ * dst = op(src, dst) where the mask bits are set, 16 bytes at a time and
+ * then byte by byte. _vop combines the vectors s and d, _op the bytes S and D.
+ */
+#define ROP_ROW_SSE2(_name, _vop, _op) \
+static void gdi_rop_row_##_name##_SSE2(uint8* dst, uint8* src, int n, uint32 mask) \
+{ \
+	int i; \
+	uint8 S, D, M; \
+	__m128i s, d; \
+	__m128i vm = _mm_set1_epi32(mask); \
+	for (i = 0; n - i >= 16; i += 16) \
+	{ \
+		s = _mm_loadu_si128((__m128i*) (src + i)); \
+		d = _mm_loadu_si128((__m128i*) (dst + i)); \
+		_mm_storeu_si128((__m128i*) (dst + i), \
+			_mm_or_si128(_mm_and_si128(vm, _vop), _mm_andnot_si128(vm, d))); \
+	} \
+	for (; i < n; i++) \
+	{ \
+		S = src[i]; \
+		D = dst[i]; \
+		M = mask >> ((i & 3) * 8); \
+		dst[i] = (M & (_op)) | (~M & D); \
+	} \
+}
+
+ROP_ROW_SSE2(NOTSRCCOPY, NOT(s), ~S)
+ROP_ROW_SSE2(SRCERASE, _mm_andnot_si128(d, s), S & ~D)
+ROP_ROW_SSE2(NOTSRCERASE, NOT(_mm_or_si128(s, d)), ~S & ~D)
+ROP_ROW_SSE2(SRCINVERT, _mm_xor_si128(s, d), S ^ D)
+ROP_ROW_SSE2(SRCAND, _mm_and_si128(s, d), S & D)
+ROP_ROW_SSE2(SRCPAINT, _mm_or_si128(s, d), S | D)
+ROP_ROW_SSE2(DSna, _mm_andnot_si128(s, d), ~S & D)
+ROP_ROW_SSE2(MERGEPAINT, NOT(_mm_andnot_si128(d, s)), ~S | D)
+
+static void gdi_dstinvert_row_SSE2(uint8* dst, int n, uint32 mask)
+{
+	int i;
+	__m128i vm = _mm_set1_epi32(mask);
+
+	for (i = 0; n - i >= 16; i += 16)
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(_mm_loadu_si128((__m128i*) (dst + i)), vm));
+
+	for (; i < n; i++)
+		dst[i] ^= (uint8) (mask >> ((i & 3) * 8));
+}
+
+static void gdi_patcopy_row_SSE2(uint8* dst, uint32 pattern, int n)
+{
+	int i;
+	__m128i p = _mm_set1_epi32(pattern);
+
+	for (i = 0; n - i >= 16; i += 16)
+		_mm_storeu_si128((__m128i*) (dst + i), p);
+
+	for (; i < n; i++)
+		dst[i] = pattern >> ((i & 3) * 8);
+}
+
+static void gdi_patinvert_row_SSE2(uint8* dst, uint32 pattern, int n)
+{
+	int i;
+	__m128i p = _mm_set1_epi32(pattern);
+
+	for (i = 0; n - i >= 16; i += 16)
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(_mm_loadu_si128((__m128i*) (dst + i)), p));
+
+	for (; i < n; i++)
+		dst[i] ^= pattern >> ((i & 3) * 8);
+}
+
+/* forward copy for dst before src, aligned stores once the head is done */
+static void gdi_copy_row_SSE2(uint8* dst, uint8* src, int n)
+{
+	__m128i v0, v1, v2, v3;
+
+	while ((n > 0) && ((size_t) dst & 15))
+	{
+		*(dst++) = *(src++);
+		n--;
+	}
+
+	/* every load comes before the store that could overwrite it */
+	for (; n >= 64; n -= 64, dst += 64, src += 64)
+	{
+		v0 = _mm_loadu_si128((__m128i*) src);
+		v1 = _mm_loadu_si128((__m128i*) (src + 16));
+		v2 = _mm_loadu_si128((__m128i*) (src + 32));
+		v3 = _mm_loadu_si128((__m128i*) (src + 48));
+		_mm_store_si128((__m128i*) dst, v0);
+		_mm_store_si128((__m128i*) (dst + 16), v1);
+		_mm_store_si128((__m128i*) (dst + 32), v2);
+		_mm_store_si128((__m128i*) (dst + 48), v3);
+	}
+
+	for (; n >= 16; n -= 16, dst += 16, src += 16)
+		_mm_store_si128((__m128i*) dst, _mm_loadu_si128((__m128i*) src));
+
+	while (n > 0)
+	{
+		*(dst++) = *(src++);
+		n--;
+	}
+}
+
+/* the same from the last byte down, for dst after src */
+static void gdi_copy_rowb_SSE2(uint8* dst, uint8* src, int n)
+{
+	__m128i v0, v1, v2, v3;
+
+	dst += n;
+	src += n;
+
+	while ((n > 0) && ((size_t) dst & 15))
+	{
+		*(--dst) = *(--src);
+		n--;
+	}
+
+	for (; n >= 64; n -= 64)
+	{
+		dst -= 64;
+		src -= 64;
+		v3 = _mm_loadu_si128((__m128i*) (src + 48));
+		v2 = _mm_loadu_si128((__m128i*) (src + 32));
+		v1 = _mm_loadu_si128((__m128i*) (src + 16));
+		v0 = _mm_loadu_si128((__m128i*) src);
+		_mm_store_si128((__m128i*) (dst + 48), v3);
+		_mm_store_si128((__m128i*) (dst + 32), v2);
+		_mm_store_si128((__m128i*) (dst + 16), v1);
+		_mm_store_si128((__m128i*) dst, v0);
+	}
+
+	for (; n >= 16; n -= 16)
+	{
+		dst -= 16;
+		src -= 16;
+		_mm_store_si128((__m128i*) dst, _mm_loadu_si128((__m128i*) src));
+	}
+
+	while (n > 0)
+	{
+		*(--dst) = *(--src);
+		n--;
+	}
+}
+
+void gdi_init_rop_SSE2(GDI_ROP_FUNCS* funcs)
+{
+	funcs->rop_row[GDI_ROW_NOTSRCCOPY] = gdi_rop_row_NOTSRCCOPY_SSE2;
+	funcs->rop_row[GDI_ROW_SRCERASE] = gdi_rop_row_SRCERASE_SSE2;
+	funcs->rop_row[GDI_ROW_NOTSRCERASE] = gdi_rop_row_NOTSRCERASE_SSE2;
+	funcs->rop_row[GDI_ROW_SRCINVERT] = gdi_rop_row_SRCINVERT_SSE2;
+	funcs->rop_row[GDI_ROW_SRCAND] = gdi_rop_row_SRCAND_SSE2;
+	funcs->rop_row[GDI_ROW_SRCPAINT] = gdi_rop_row_SRCPAINT_SSE2;
+	funcs->rop_row[GDI_ROW_DSna] = gdi_rop_row_DSna_SSE2;
+	funcs->rop_row[GDI_ROW_MERGEPAINT] = gdi_rop_row_MERGEPAINT_SSE2;
+	funcs->patcopy_row = gdi_patcopy_row_SSE2;
+	funcs->patinvert_row = gdi_patinvert_row_SSE2;
+	funcs->dstinvert_row = gdi_dstinvert_row_SSE2;
+	funcs->copy_row = gdi_copy_row_SSE2;
+	funcs->copy_rowb = gdi_copy_rowb_SSE2;
+}
@@ -24,15 +24,25 @@
 #include <freerdp/rfx.h>
 #include <freerdp/types/base.h>
 #include <freerdp/utils/stream.h>
+#include <freerdp/utils/thread_pool.h>
 
 #include "rfx_pool.h"
 #include "rfx_decode.h"
 #include "rfx_encode.h"
 #include "rfx_quantization.h"
 #include "rfx_dwt.h"
+#include "rfx_scratch.h"
 
 #include "librfx.h"
 
+#ifndef MIN
+#define MIN(_a, _b) ((_a) < (_b) ? (_a) : (_b))
+#endif
+
+#ifndef MAX
+#define MAX(_a, _b) ((_a) > (_b) ? (_a) : (_b))
+#endif
+
 /*
    The quantization values control the compression rate and quality. The value
    range is between 6 and 15. The higher value, the higher compression rate
@@ -50,6 +60,82 @@ static const uint32 rfx_default_quantization_values[] =
 	6, 6, 6, 6, 7, 7, 8, 8, 8, 9
 };
 
+/* how much coarser than the base set each adaptive quantization level is */
+static const int rfx_quant_level_steps[RFX_QUANT_LEVELS] =
+{
+	0, 1, 3
+};
+
+/*
+   Mean absolute difference between neighbouring samples below which a tile
+   is flat, and above which it is detailed.
+*/
+#define RFX_QUANT_FLAT_ACTIVITY		2
+#define RFX_QUANT_DETAIL_ACTIVITY	12
+
+/* range of the offset applied to all the sets to meet the tile budget */
+#define RFX_QUANT_OFFSET_MIN		-3
+#define RFX_QUANT_OFFSET_MAX		9
+
+/* a tile of the current tileset, parsed and waiting to be decoded */
+struct _RFX_TILE_JOB
+{
+	RFX_TILE * tile;
+	uint16 x;
+	uint16 y;
+	const uint8 * data;
+	uint16 YLen;
+	uint16 CbLen;
+	uint16 CrLen;
+	uint8 quantIdxY;
+	uint8 quantIdxCb;
+	uint8 quantIdxCr;
+};
+typedef struct _RFX_TILE_JOB RFX_TILE_JOB;
+
+/*
+   A tile of the image being composed. The worker threads encode it into its
+   own slot of encode_buffer, which is copied into the tileset afterwards.
+*/
+struct _RFX_ENCODE_JOB
+{
+	uint8 * tile_data;
+	uint16 width;
+	uint16 height;
+	uint16 xIdx;
+	uint16 yIdx;
+	int rowstride;
+	const uint32 * quantVals;
+	uint8 quantIdxY;
+	uint8 quantIdxCb;
+	uint8 quantIdxCr;
+	int size;
+};
+typedef struct _RFX_ENCODE_JOB RFX_ENCODE_JOB;
+
+/* size of a tile slot, large enough for a tile whose coefficients don't compress at all */
+#define RFX_ENCODE_SLOT_SIZE (19 + 3 * 4096 * 2)
+
+/* caller framebuffer that rfx_process_message_ex decodes the tiles into */
+struct _RFX_DESTINATION
+{
+	int left;
+	int top;
+	uint8 * data;
+	int width;
+	int height;
+	int stride;
+	RFX_PIXEL_FORMAT pixel_format;
+	int bytes_per_pixel;
+	const RFX_RECT * clip_rects;
+	int num_clip_rects;
+
+	/* message rects intersected with the clip rects, in surface coordinates */
+	RFX_RECT * rects;
+	int num_rects;
+};
+typedef struct _RFX_DESTINATION RFX_DESTINATION;
+
 void rfx_profiler_create(RFX_CONTEXT * context)
 {
 	PROFILER_CREATE(context->prof_rfx_decode_rgb, "rfx_decode_rgb");
@@ -151,6 +237,9 @@ rfx_context_new(void)
 	/* detect and enable SIMD CPU acceleration */
 	RFX_INIT_SIMD(context);
 
+	/* decode serially until told otherwise */
+	context->num_threads = 1;
+
 	return context;
 }
 
@@ -160,6 +249,29 @@ rfx_context_free(RFX_CONTEXT * context)
 	if (context->quants != NULL)
 		free(context->quants);
 
+	thread_pool_free(context->thread_pool);
+
+	if (context->tile_jobs != NULL)
+		free(context->tile_jobs);
+
+	if (context->dst_rects != NULL)
+		free(context->dst_rects);
+
+	if (context->encode_jobs != NULL)
+		free(context->encode_jobs);
+
+	if (context->encode_buffer != NULL)
+		free(context->encode_buffer);
+
+	if (context->shadow != NULL)
+		free(context->shadow);
+
+	if (context->dirty_tiles != NULL)
+		free(context->dirty_tiles);
+
+	if (context->dirty_rects != NULL)
+		free(context->dirty_rects);
+
 	rfx_pool_free(context->pool);
 
 	rfx_profiler_print(context);
@@ -189,6 +301,81 @@ rfx_context_set_pixel_format(RFX_CONTEXT * context, RFX_PIXEL_FORMAT pixel_forma
 	}
 }
 
+/* Set the number of free tiles the context keeps around between frames */
+void
+rfx_context_set_pool_limit(RFX_CONTEXT * context, int max_tiles)
+{
+	rfx_pool_set_max_count(context->pool, max_tiles);
+}
+
+/*
+   With differencing enabled the encoder keeps a copy of the last frame and
+   only sends the tiles that changed, with the rects of those tiles as the
+   region instead of the rects passed to rfx_compose_message_data. Calling it
+   again drops the copy, so that the next frame is sent whole.
+*/
+void
+rfx_context_set_differencing(RFX_CONTEXT * context, int enabled)
+{
+	context->differencing = enabled;
+
+	if (context->shadow != NULL)
+	{
+		free(context->shadow);
+		context->shadow = NULL;
+	}
+}
+
+/*
+   With adaptive quantization the encoder picks a quantization set for each
+   tile: coarse for flat tiles, fine for detailed ones and medium in between.
+   The fine set is the one the encoder would otherwise use.
+*/
+void
+rfx_context_set_adaptive_quant(RFX_CONTEXT * context, int enabled)
+{
+	context->adaptive_quant = enabled;
+}
+
+/*
+   Target size in bytes of an encoded tile, on average over a frame, or 0 for
+   none. The quantization of the following frames gets coarser while the
+   frames are over budget, and finer again when they take less than half.
+*/
+void
+rfx_context_set_tile_budget(RFX_CONTEXT * context, int bytes_per_tile)
+{
+	context->tile_budget = bytes_per_tile;
+	context->quant_offset = 0;
+}
+
+/*
+   Set the number of threads decoding the tiles of a tileset, including the
+   calling thread. A value of 0 or less uses one thread per online CPU, 1
+   decodes serially without any worker threads.
+*/
+void
+rfx_context_set_num_threads(RFX_CONTEXT * context, int num_threads)
+{
+	if (num_threads < 1)
+		num_threads = thread_pool_get_num_cpus();
+
+#ifdef WITH_PROFILER
+	/* the profilers are not thread-safe */
+	num_threads = 1;
+#endif
+
+	if (num_threads == context->num_threads)
+		return;
+
+	thread_pool_free(context->thread_pool);
+	context->thread_pool = NULL;
+	context->num_threads = num_threads;
+
+	if (num_threads > 1)
+		context->thread_pool = thread_pool_new(num_threads - 1, rfx_scratch_new, rfx_scratch_free);
+}
+
 static void
 rfx_process_message_sync(RFX_CONTEXT * context, uint8 * data, int size)
 {
@@ -328,10 +515,12 @@ rfx_process_message_region(RFX_CONTEXT * context, RFX_MESSAGE * message, uint8 *
 		return;
 	}
 
-	if (message->rects != NULL)
-		message->rects = (RFX_RECT*) realloc((void*) message->rects, message->num_rects * sizeof(RFX_RECT));
-	else
-		message->rects = (RFX_RECT*) malloc(message->num_rects * sizeof(RFX_RECT));
+	if (message->max_rects < message->num_rects)
+	{
+		message->max_rects = message->num_rects;
+		message->rects = (RFX_RECT*) rfx_pool_realloc(context->pool, (void*) message->rects,
+			message->max_rects * sizeof(RFX_RECT));
+	}
 
 	data += 3;
 	size -= 3;
@@ -354,43 +543,151 @@ rfx_process_message_region(RFX_CONTEXT * context, RFX_MESSAGE * message, uint8 *
 }
 
 static void
-rfx_process_message_tile(RFX_CONTEXT * context, RFX_TILE * tile, uint8 * data, int size)
+rfx_process_message_tile(RFX_CONTEXT * context, RFX_TILE_JOB * job, uint8 * data, int size)
 {
-	uint8 quantIdxY;
-	uint8 quantIdxCb;
-	uint8 quantIdxCr;
 	uint16 xIdx, yIdx;
-	uint16 YLen, CbLen, CrLen;
 
 	/* RFX_TILE */
-	quantIdxY = GET_UINT8(data, 0); /* quantIdxY (1 byte) */
-	quantIdxCb = GET_UINT8(data, 1); /* quantIdxCb (1 byte) */
-	quantIdxCr = GET_UINT8(data, 2); /* quantIdxCr (1 byte) */
+	job->quantIdxY = GET_UINT8(data, 0); /* quantIdxY (1 byte) */
+	job->quantIdxCb = GET_UINT8(data, 1); /* quantIdxCb (1 byte) */
+	job->quantIdxCr = GET_UINT8(data, 2); /* quantIdxCr (1 byte) */
 	xIdx = GET_UINT16(data, 3); /* xIdx (2 bytes) */
 	yIdx = GET_UINT16(data, 5); /* yIdx (2 bytes) */
-	YLen = GET_UINT16(data, 7); /* YLen (2 bytes) */
-	CbLen = GET_UINT16(data, 9); /* CbLen (2 bytes) */
-	CrLen = GET_UINT16(data, 11); /* CrLen (2 bytes) */
+	job->YLen = GET_UINT16(data, 7); /* YLen (2 bytes) */
+	job->CbLen = GET_UINT16(data, 9); /* CbLen (2 bytes) */
+	job->CrLen = GET_UINT16(data, 11); /* CrLen (2 bytes) */
 
 	DEBUG_RFX("quantIdxY:%d quantIdxCb:%d quantIdxCr:%d xIdx:%d yIdx:%d YLen:%d CbLen:%d CrLen:%d",
-		quantIdxY, quantIdxCb, quantIdxCr, xIdx, yIdx, YLen, CbLen, CrLen);
+		job->quantIdxY, job->quantIdxCb, job->quantIdxCr, xIdx, yIdx, job->YLen, job->CbLen, job->CrLen);
 
-	data += 13;
+	job->data = data + 13;
 
-	tile->x = xIdx * 64;
-	tile->y = yIdx * 64;
+	job->x = xIdx * 64;
+	job->y = yIdx * 64;
 
-	rfx_decode_rgb(context,
-		data, YLen, context->quants + (quantIdxY * 10),
-		data + YLen, CbLen, context->quants + (quantIdxCb * 10),
-		data + YLen + CbLen, CrLen, context->quants + (quantIdxCr * 10), tile->data);
+	if (job->tile != NULL)
+	{
+		job->tile->x = job->x;
+		job->tile->y = job->y;
+	}
 }
 
 static void
-rfx_process_message_tileset(RFX_CONTEXT * context, RFX_MESSAGE * message, uint8 * data, int size)
+rfx_decode_tile_job(void * arg, int index, void * worker_scratch)
+{
+	RFX_CONTEXT * context = (RFX_CONTEXT *) arg;
+	RFX_SCRATCH * scratch = (RFX_SCRATCH *) worker_scratch;
+	RFX_TILE_JOB * job = &context->tile_jobs[index];
+
+	rfx_decode_rgb_ex(context, scratch,
+		job->data, job->YLen, context->quants + (job->quantIdxY * 10),
+		job->data + job->YLen, job->CbLen, context->quants + (job->quantIdxCb * 10),
+		job->data + job->YLen + job->CbLen, job->CrLen, context->quants + (job->quantIdxCr * 10),
+		job->tile->data);
+}
+
+/* decode a tile and write the parts of it inside the clipping rects to the destination */
+static void
+rfx_decode_tile_job_to_destination(void * arg, int index, void * worker_scratch)
 {
 	int i;
+	int x1, y1, x2, y2;
+	RFX_RECT * rect;
+	RFX_CONTEXT * context = (RFX_CONTEXT *) arg;
+	RFX_SCRATCH * scratch = (RFX_SCRATCH *) worker_scratch;
+	RFX_DESTINATION * dst = context->destination;
+	RFX_TILE_JOB * job = &context->tile_jobs[index];
+	int tx = dst->left + job->x;
+	int ty = dst->top + job->y;
+
+	PROFILER_ENTER(context->prof_rfx_decode_rgb);
+
+	rfx_decode_planes(context, scratch,
+		job->data, job->YLen, context->quants + (job->quantIdxY * 10),
+		job->data + job->YLen, job->CbLen, context->quants + (job->quantIdxCb * 10),
+		job->data + job->YLen + job->CbLen, job->CrLen, context->quants + (job->quantIdxCr * 10));
+
+	PROFILER_ENTER(context->prof_rfx_decode_format_RGB);
+
+	for (i = 0; i < dst->num_rects; i++)
+	{
+		rect = &dst->rects[i];
+
+		x1 = MAX(tx, rect->x);
+		y1 = MAX(ty, rect->y);
+		x2 = MIN(tx + 64, rect->x + rect->width);
+		y2 = MIN(ty + 64, rect->y + rect->height);
+
+		if (x1 >= x2 || y1 >= y2)
+			continue;
+
+		rfx_decode_format_RGB_rect(scratch, dst->pixel_format,
+			x1 - tx, y1 - ty, x2 - x1, y2 - y1,
+			dst->data + y1 * dst->stride + x1 * dst->bytes_per_pixel, dst->stride);
+	}
+
+	PROFILER_EXIT(context->prof_rfx_decode_format_RGB);
+
+	PROFILER_EXIT(context->prof_rfx_decode_rgb);
+}
+
+/* intersect the message rects with the surface and the caller clipping rects */
+static void
+rfx_destination_clip_rects(RFX_CONTEXT * context, RFX_MESSAGE * message)
+{
+	int i, j;
+	int x1, y1, x2, y2;
+	const RFX_RECT * clip;
+	RFX_DESTINATION * dst = context->destination;
+	int max_rects = message->num_rects * (dst->clip_rects != NULL ? dst->num_clip_rects : 1);
+
+	if (context->max_dst_rects < max_rects)
+	{
+		context->max_dst_rects = max_rects;
+		context->dst_rects = (RFX_RECT*) rfx_pool_realloc(context->pool, (void*) context->dst_rects,
+			context->max_dst_rects * sizeof(RFX_RECT));
+	}
+
+	dst->rects = context->dst_rects;
+	dst->num_rects = 0;
+
+	for (i = 0; i < message->num_rects; i++)
+	{
+		for (j = 0; j < (dst->clip_rects != NULL ? dst->num_clip_rects : 1); j++)
+		{
+			x1 = MAX(0, dst->left + message->rects[i].x);
+			y1 = MAX(0, dst->top + message->rects[i].y);
+			x2 = MIN(dst->width, dst->left + message->rects[i].x + message->rects[i].width);
+			y2 = MIN(dst->height, dst->top + message->rects[i].y + message->rects[i].height);
+
+			if (dst->clip_rects != NULL)
+			{
+				clip = &dst->clip_rects[j];
+				x1 = MAX(x1, clip->x);
+				y1 = MAX(y1, clip->y);
+				x2 = MIN(x2, clip->x + clip->width);
+				y2 = MIN(y2, clip->y + clip->height);
+			}
+
+			if (x1 >= x2 || y1 >= y2)
+				continue;
+
+			dst->rects[dst->num_rects].x = x1;
+			dst->rects[dst->num_rects].y = y1;
+			dst->rects[dst->num_rects].width = x2 - x1;
+			dst->rects[dst->num_rects].height = y2 - y1;
+			dst->num_rects++;
+		}
+	}
+}
+
+static void
+rfx_process_message_tileset(RFX_CONTEXT * context, RFX_MESSAGE * message, uint8 * data, int size)
+{
+	int i, j;
 	uint16 subtype;
+	RFX_SCRATCH scratch;
+	THREAD_JOB_FUNC func;
 	uint32 blockLen;
 	uint32 blockType;
 	uint32 tilesDataSize;
@@ -425,13 +722,20 @@ rfx_process_message_tileset(RFX_CONTEXT * context, RFX_MESSAGE * message, uint8
 
 	tilesDataSize = GET_UINT32(data, 10); /* tilesDataSize (4 bytes) */
 
+	scratch.y_r_buffer = context->y_r_buffer;
+	scratch.cb_g_buffer = context->cb_g_buffer;
+	scratch.cr_b_buffer = context->cr_b_buffer;
+	scratch.dwt_buffer = context->dwt_buffer;
+
 	data += 14;
 	size -= 14;
 
-	if (context->quants != NULL)
-		context->quants = (uint32*) realloc((void*) context->quants, context->num_quants * 10 * sizeof(uint32));
-	else
-		context->quants = (uint32*) malloc(context->num_quants * 10 * sizeof(uint32));
+	if (context->max_quants < context->num_quants)
+	{
+		context->max_quants = context->num_quants;
+		context->quants = (uint32*) rfx_pool_realloc(context->pool, (void*) context->quants,
+			context->max_quants * 10 * sizeof(uint32));
+	}
 
 	/* quantVals */
 	for (i = 0; i < context->num_quants && size > 0; i++)
@@ -459,7 +763,29 @@ rfx_process_message_tileset(RFX_CONTEXT * context, RFX_MESSAGE * message, uint8
 		size -= 5;
 	}
 
-	message->tiles = rfx_pool_get_tiles(context->pool, message->num_tiles);
+	/* when decoding to a caller framebuffer no intermediate tiles are needed */
+	if (context->destination == NULL)
+	{
+		if (message->max_tiles < message->num_tiles)
+		{
+			message->max_tiles = message->num_tiles;
+			message->tiles = (RFX_TILE**) rfx_pool_realloc(context->pool, (void*) message->tiles,
+				message->max_tiles * sizeof(RFX_TILE*));
+		}
+
+		rfx_pool_get_tiles(context->pool, message->tiles, message->num_tiles);
+	}
+	else
+	{
+		rfx_destination_clip_rects(context, message);
+	}
+
+	if (context->max_tile_jobs < message->num_tiles)
+	{
+		context->max_tile_jobs = message->num_tiles;
+		context->tile_jobs = (RFX_TILE_JOB*) rfx_pool_realloc(context->pool, (void*) context->tile_jobs,
+			context->max_tile_jobs * sizeof(RFX_TILE_JOB));
+	}
 
 	/* tiles */
 	for (i = 0; i < message->num_tiles && size > 0; i++)
@@ -474,11 +800,33 @@ rfx_process_message_tileset(RFX_CONTEXT * context, RFX_MESSAGE * message, uint8
 			break;
 		}
 
-		rfx_process_message_tile(context, message->tiles[i], data + 6, blockLen - 6);
+		context->tile_jobs[i].tile = (context->destination == NULL) ? message->tiles[i] : NULL;
+		rfx_process_message_tile(context, &context->tile_jobs[i], data + 6, blockLen - 6);
 
 		size -= blockLen;
 		data += blockLen;
 	}
+
+	if (context->destination != NULL)
+	{
+		func = rfx_decode_tile_job_to_destination;
+		message->num_tiles = 0;
+	}
+	else
+	{
+		func = rfx_decode_tile_job;
+	}
+
+	/* decode the parsed tiles, spread across the worker threads if any */
+	if (context->thread_pool != NULL && i > 1)
+	{
+		thread_pool_run(context->thread_pool, func, context, i, &scratch);
+	}
+	else
+	{
+		for (j = 0; j < i; j++)
+			func(context, j, &scratch);
+	}
 }
 
 RFX_MESSAGE *
@@ -489,8 +837,7 @@ rfx_process_message(RFX_CONTEXT * context, uint8 * data, int size)
 	uint32 blockType;
 	RFX_MESSAGE * message;
 
-	message = (RFX_MESSAGE *) malloc(sizeof(RFX_MESSAGE));
-	memset(message, 0, sizeof(RFX_MESSAGE));
+	message = rfx_pool_get_message(context->pool);
 
 	while (size > 0)
 	{
@@ -555,22 +902,58 @@ rfx_process_message(RFX_CONTEXT * context, uint8 * data, int size)
 	return message;
 }
 
-void
-rfx_message_free(RFX_CONTEXT * context, RFX_MESSAGE * message)
+/*
+   Decode a message straight into a caller framebuffer instead of the message
+   tiles. The tiles are written at (left, top) plus their position, clipped to
+   the message rects, the clip_rects (the whole surface if NULL) and the
+   surface bounds. The returned message has the rects but no tiles.
+*/
+RFX_MESSAGE *
+rfx_process_message_ex(RFX_CONTEXT * context, uint8 * data, int size,
+	int left, int top, uint8 * dst, int dst_width, int dst_height, int dst_stride,
+	RFX_PIXEL_FORMAT dst_format, const RFX_RECT * clip_rects, int num_clip_rects)
 {
-	if (message != NULL)
+	RFX_MESSAGE * message;
+	RFX_DESTINATION destination;
+
+	memset(&destination, 0, sizeof(RFX_DESTINATION));
+	destination.left = left;
+	destination.top = top;
+	destination.data = dst;
+	destination.width = dst_width;
+	destination.height = dst_height;
+	destination.stride = dst_stride;
+	destination.pixel_format = dst_format;
+	destination.clip_rects = clip_rects;
+	destination.num_clip_rects = num_clip_rects;
+
+	switch (dst_format)
 	{
-		if (message->rects != NULL)
-			free(message->rects);
+		case RFX_PIXEL_FORMAT_BGRA:
+		case RFX_PIXEL_FORMAT_RGBA:
+			destination.bytes_per_pixel = 4;
+			break;
+		case RFX_PIXEL_FORMAT_BGR:
+		case RFX_PIXEL_FORMAT_RGB:
+			destination.bytes_per_pixel = 3;
+			break;
+		default:
+			break;
+	}
 
-		if (message->tiles != NULL)
-		{
-			rfx_pool_put_tiles(context->pool, message->tiles, message->num_tiles);
-			free(message->tiles);
-		}
+	context->destination = &destination;
+	message = rfx_process_message(context, data, size);
+	context->destination = NULL;
 
-		free(message);
-	}
+	return message;
+}
+
+void
+rfx_message_free(RFX_CONTEXT * context, RFX_MESSAGE * message)
+{
+	/* the message and its tiles are kept by the context for the next frame */
+	if (message != NULL)
+		rfx_pool_put_message(context->pool, message);
 }
 
 static int
@@ -728,7 +1111,7 @@ rfx_compose_message_region(RFX_CONTEXT * context, uint8 * buffer, int buffer_siz
 }
 
 static int
-rfx_compose_message_tile(RFX_CONTEXT * context, uint8 * buffer, int buffer_size,
+rfx_compose_message_tile(RFX_CONTEXT * context, RFX_SCRATCH * scratch, uint8 * buffer, int buffer_size,
 	uint8 * tile_data, int tile_width, int tile_height, int rowstride,
 	const uint32 * quantVals, int quantIdxY, int quantIdxCb, int quantIdxCr, int xIdx, int yIdx)
 {
@@ -751,7 +1134,7 @@ rfx_compose_message_tile(RFX_CONTEXT * context, uint8 * buffer, int buffer_size,
 	SET_UINT16(buffer, 9, xIdx); /* xIdx */
 	SET_UINT16(buffer, 11, yIdx); /* yIdx */
 
-	rfx_encode_rgb(context, tile_data, tile_width, tile_height, rowstride,
+	rfx_encode_rgb_ex(context, scratch, tile_data, tile_width, tile_height, rowstride,
 		quantVals + quantIdxY * 10, quantVals + quantIdxCb * 10, quantVals + quantIdxCr * 10,
 		buffer + 19, buffer_size - 19, &YLen, &CbLen, &CrLen);
 
@@ -767,9 +1150,214 @@ rfx_compose_message_tile(RFX_CONTEXT * context, uint8 * buffer, int buffer_size,
 	return size;
 }
 
+/* pick the adaptive quantization level of a tile from the differences between neighbouring samples */
+static void
+rfx_encode_tile_quant_level(RFX_CONTEXT * context, RFX_ENCODE_JOB * job)
+{
+	int x, y;
+	int bpp;
+	int line_size;
+	int level;
+	uint32 activity;
+	const uint8 * src;
+
+	bpp = context->bytes_per_pixel;
+	line_size = job->width * bpp;
+	activity = 0;
+
+	for (y = 0; y < job->height; y++)
+	{
+		src = job->tile_data + y * job->rowstride;
+
+		for (x = bpp; x < line_size; x++)
+			activity += abs(src[x] - src[x - bpp]);
+
+		if (y > 0)
+		{
+			for (x = 0; x < line_size; x++)
+				activity += abs(src[x] - src[x - job->rowstride]);
+		}
+	}
+
+	activity /= job->width * job->height * bpp;
+
+	if (activity < RFX_QUANT_FLAT_ACTIVITY)
+		level = RFX_QUANT_COARSE;
+	else if (activity < RFX_QUANT_DETAIL_ACTIVITY)
+		level = RFX_QUANT_MEDIUM;
+	else
+		level = RFX_QUANT_FINE;
+
+	job->quantIdxY = level * 3;
+	job->quantIdxCb = level * 3 + 1;
+	job->quantIdxCr = level * 3 + 2;
+}
+
+static void
+rfx_encode_tile_job(void * arg, int index, void * worker_scratch)
+{
+	RFX_CONTEXT * context = (RFX_CONTEXT *) arg;
+	RFX_SCRATCH * scratch = (RFX_SCRATCH *) worker_scratch;
+	RFX_ENCODE_JOB * job = &context->encode_jobs[index];
+
+	if (context->adaptive_quant)
+		rfx_encode_tile_quant_level(context, job);
+
+	job->size = rfx_compose_message_tile(context, scratch,
+		context->encode_buffer + index * RFX_ENCODE_SLOT_SIZE, RFX_ENCODE_SLOT_SIZE,
+		job->tile_data, job->width, job->height, job->rowstride, job->quantVals,
+		job->quantIdxY, job->quantIdxCb, job->quantIdxCr, job->xIdx, job->yIdx);
+}
+
+/*
+   Compare the tiles of the image with the last frame, mark the ones that
+   changed in dirty_tiles and update the copy. The dirty tiles are merged into
+   dirty_rects: runs of tiles on a row, stacked with the run above when both
+   have the same horizontal span. Returns the number of dirty tiles.
+*/
+static int
+rfx_compose_update_dirty_tiles(RFX_CONTEXT * context, uint8 * image_data, int width, int height,
+	int rowstride)
+{
+	int i;
+	int y;
+	int tw, th;
+	int xIdx, yIdx;
+	int numTilesX;
+	int numTilesY;
+	int numDirty;
+	int line_size;
+	int full;
+	uint8 * src;
+	uint8 * dst;
+	RFX_RECT * rect;
+	RFX_RECT run;
+
+	numTilesX = (width + 63) / 64;
+	numTilesY = (height + 63) / 64;
+	line_size = width * context->bytes_per_pixel;
+
+	if (context->max_dirty_tiles < numTilesX * numTilesY)
+	{
+		context->max_dirty_tiles = numTilesX * numTilesY;
+		context->dirty_tiles = (uint8 *) realloc(context->dirty_tiles, context->max_dirty_tiles);
+		context->dirty_rects = (RFX_RECT *) realloc(context->dirty_rects,
+			context->max_dirty_tiles * sizeof(RFX_RECT));
+	}
+
+	/* without a copy of a frame of the same size, everything has changed */
+	full = (context->shadow == NULL || context->shadow_width != width || context->shadow_height != height);
+
+	if (full)
+	{
+		context->shadow = (uint8 *) realloc(context->shadow, line_size * height);
+		context->shadow_width = width;
+		context->shadow_height = height;
+	}
+
+	numDirty = 0;
+	context->num_dirty_rects = 0;
+
+	for (yIdx = 0; yIdx < numTilesY; yIdx++)
+	{
+		th = (yIdx < numTilesY - 1) ? 64 : height - yIdx * 64;
+		run.width = 0;
+
+		for (xIdx = 0; xIdx <= numTilesX; xIdx++)
+		{
+			if (xIdx < numTilesX)
+			{
+				tw = ((xIdx < numTilesX - 1) ? 64 : width - xIdx * 64) * context->bytes_per_pixel;
+				src = image_data + yIdx * 64 * rowstride + xIdx * 64 * context->bytes_per_pixel;
+				dst = context->shadow + yIdx * 64 * line_size + xIdx * 64 * context->bytes_per_pixel;
+
+				context->dirty_tiles[yIdx * numTilesX + xIdx] = full;
+
+				for (y = 0; y < th && !full; y++)
+				{
+					if (memcmp(src + y * rowstride, dst + y * line_size, tw) != 0)
+					{
+						context->dirty_tiles[yIdx * numTilesX + xIdx] = 1;
+						break;
+					}
+				}
+
+				if (context->dirty_tiles[yIdx * numTilesX + xIdx])
+				{
+					for (y = 0; y < th; y++)
+						memcpy(dst + y * line_size, src + y * rowstride, tw);
+
+					if (run.width == 0)
+					{
+						run.x = xIdx * 64;
+						run.y = yIdx * 64;
+						run.height = th;
+					}
+
+					run.width = MIN(xIdx * 64 + 64, width) - run.x;
+					numDirty++;
+					continue;
+				}
+			}
+
+			if (run.width == 0)
+				continue;
+
+			/* the run ended, stack it on a rect of the same span ending right above */
+			for (i = 0; i < context->num_dirty_rects; i++)
+			{
+				rect = &context->dirty_rects[i];
+
+				if (rect->x == run.x && rect->width == run.width && rect->y + rect->height == run.y)
+				{
+					rect->height += run.height;
+					break;
+				}
+			}
+
+			if (i == context->num_dirty_rects)
+				context->dirty_rects[context->num_dirty_rects++] = run;
+
+			run.width = 0;
+		}
+	}
+
+	return numDirty;
+}
+
+/*
+   Fill encode_quants with the sets of the adaptive levels, RFX_QUANT_LEVELS
+   groups of a Y, Cb and Cr set, moved by quant_offset. Without adaptive
+   quantization only the first group is used.
+*/
+static void
+rfx_compose_encode_quants(RFX_CONTEXT * context, const uint32 * quantVals,
+	int quantIdxY, int quantIdxCb, int quantIdxCr)
+{
+	int i;
+	int level;
+	int value;
+	const uint32 * base[3];
+	uint32 * dst;
+
+	base[0] = quantVals + quantIdxY * 10;
+	base[1] = quantVals + quantIdxCb * 10;
+	base[2] = quantVals + quantIdxCr * 10;
+
+	dst = context->encode_quants;
+	for (level = 0; level < RFX_QUANT_LEVELS; level++)
+	{
+		for (i = 0; i < 3 * 10; i++)
+		{
+			value = base[i / 10][i % 10] + context->quant_offset + rfx_quant_level_steps[level];
+			*dst++ = MIN(MAX(value, 6), 15);
+		}
+	}
+}
+
 static int
 rfx_compose_message_tileset(RFX_CONTEXT * context, uint8 * buffer, int buffer_size,
-	uint8 * image_data, int width, int height, int rowstride)
+	uint8 * image_data, int width, int height, int rowstride, int numDirty)
 {
 	int size;
 	int i;
@@ -785,6 +1373,9 @@ rfx_compose_message_tileset(RFX_CONTEXT * context, uint8 * buffer, int buffer_si
 	int xIdx;
 	int yIdx;
 	int tilesDataSize;
+	int tileSize;
+	RFX_ENCODE_JOB * job;
+	RFX_SCRATCH scratch;
 
 	if (context->num_quants == 0)
 	{
@@ -803,9 +1394,19 @@ rfx_compose_message_tileset(RFX_CONTEXT * context, uint8 * buffer, int buffer_si
 		quantIdxCr = context->quant_idx_cr;
 	}
 
+	if (context->adaptive_quant || context->quant_offset != 0)
+	{
+		rfx_compose_encode_quants(context, quantVals, quantIdxY, quantIdxCb, quantIdxCr);
+		numQuants = context->adaptive_quant ? RFX_QUANT_LEVELS * 3 : 3;
+		quantVals = context->encode_quants;
+		quantIdxY = 0;
+		quantIdxCb = 1;
+		quantIdxCr = 2;
+	}
+
 	numTilesX = (width + 63) / 64;
 	numTilesY = (height + 63) / 64;
-	numTiles = numTilesX * numTilesY;
+	numTiles = context->differencing ? numDirty : numTilesX * numTilesY;
 
 	if (buffer_size < 22 + numQuants * 5)
 	{
@@ -836,24 +1437,93 @@ rfx_compose_message_tileset(RFX_CONTEXT * context, uint8 * buffer, int buffer_si
 
 	DEBUG_RFX("width:%d height:%d rowstride:%d", width, height, rowstride);
 
-	tilesDataSize = 0;
+	if (context->max_encode_jobs < numTiles)
+	{
+		context->max_encode_jobs = numTiles;
+		context->encode_jobs = (RFX_ENCODE_JOB*) rfx_pool_realloc(context->pool, (void*) context->encode_jobs,
+			context->max_encode_jobs * sizeof(RFX_ENCODE_JOB));
+	}
+
+	i = 0;
 	for (yIdx = 0; yIdx < numTilesY; yIdx++)
 	{
 		for (xIdx = 0; xIdx < numTilesX; xIdx++)
 		{
-			tilesDataSize += rfx_compose_message_tile(context,
+			if (context->differencing && !context->dirty_tiles[yIdx * numTilesX + xIdx])
+				continue;
+
+			job = &context->encode_jobs[i++];
+			job->tile_data = image_data + yIdx * 64 * rowstride + xIdx * 64 * context->bytes_per_pixel;
+			job->width = xIdx < numTilesX - 1 ? 64 : width - xIdx * 64;
+			job->height = yIdx < numTilesY - 1 ? 64 : height - yIdx * 64;
+			job->xIdx = xIdx;
+			job->yIdx = yIdx;
+			job->rowstride = rowstride;
+			job->quantVals = quantVals;
+			job->quantIdxY = quantIdxY;
+			job->quantIdxCb = quantIdxCb;
+			job->quantIdxCr = quantIdxCr;
+			job->size = 0;
+		}
+	}
+
+	scratch.y_r_buffer = context->y_r_buffer;
+	scratch.cb_g_buffer = context->cb_g_buffer;
+	scratch.cr_b_buffer = context->cr_b_buffer;
+	scratch.dwt_buffer = context->dwt_buffer;
+
+	/* encode the tiles into their slots on the worker threads, if any */
+	if (context->thread_pool != NULL && numTiles > 1)
+	{
+		if (context->max_encode_slots < numTiles)
+		{
+			context->max_encode_slots = numTiles;
+			context->encode_buffer = (uint8*) rfx_pool_realloc(context->pool, (void*) context->encode_buffer,
+				context->max_encode_slots * RFX_ENCODE_SLOT_SIZE);
+		}
+
+		thread_pool_run(context->thread_pool, rfx_encode_tile_job, context, numTiles, &scratch);
+	}
+
+	/* then append them in order, encoding in place the ones without a usable slot */
+	tilesDataSize = 0;
+	for (i = 0; i < numTiles; i++)
+	{
+		job = &context->encode_jobs[i];
+
+		if (job->size > 0 && job->size < RFX_ENCODE_SLOT_SIZE && job->size <= buffer_size - size - tilesDataSize)
+		{
+			memcpy(buffer + size + tilesDataSize, context->encode_buffer + i * RFX_ENCODE_SLOT_SIZE, job->size);
+			tileSize = job->size;
+		}
+		else
+		{
+			if (job->size == 0 && context->adaptive_quant)
+				rfx_encode_tile_quant_level(context, job);
+
+			/* a full slot may have been truncated, encode the tile where the serial encoder would */
+			tileSize = rfx_compose_message_tile(context, &scratch,
 				buffer + size + tilesDataSize, buffer_size - size - tilesDataSize,
-				image_data + yIdx * 64 * rowstride + xIdx * 64 * context->bytes_per_pixel,
-				xIdx < numTilesX - 1 ? 64 : width - xIdx * 64,
-				yIdx < numTilesY - 1 ? 64 : height - yIdx * 64,
-				rowstride, quantVals, quantIdxY, quantIdxCb, quantIdxCr, xIdx, yIdx);
+				job->tile_data, job->width, job->height, job->rowstride, job->quantVals,
+				job->quantIdxY, job->quantIdxCb, job->quantIdxCr, job->xIdx, job->yIdx);
 		}
+
+		tilesDataSize += tileSize;
 	}
 
 	size += tilesDataSize;
 	SET_UINT32(buffer, 2, size); /* CodecChannelT.blockLen */
 	SET_UINT32(buffer, 18, tilesDataSize); /* tilesDataSize */
 
+	/* steer the quantization of the next frames towards the tile budget */
+	if (context->tile_budget > 0 && numTiles > 0)
+	{
+		if (tilesDataSize / numTiles > context->tile_budget)
+			context->quant_offset = MIN(context->quant_offset + 1, RFX_QUANT_OFFSET_MAX);
+		else if (tilesDataSize / numTiles < context->tile_budget / 2)
+			context->quant_offset = MAX(context->quant_offset - 1, RFX_QUANT_OFFSET_MIN);
+	}
+
 	return size;
 }
 
@@ -879,12 +1549,20 @@ rfx_compose_message_data(RFX_CONTEXT * context, uint8 * buffer, int buffer_size,
 	const RFX_RECT * rects, int num_rects, uint8 * image_data, int width, int height, int rowstride)
 {
 	int composed_size;
+	int numDirty = 0;
+
+	if (context->differencing)
+	{
+		numDirty = rfx_compose_update_dirty_tiles(context, image_data, width, height, rowstride);
+		rects = context->dirty_rects;
+		num_rects = context->num_dirty_rects;
+	}
 
 	composed_size = rfx_compose_message_frame_begin(context, buffer, buffer_size);
 	composed_size += rfx_compose_message_region(context, buffer + composed_size, buffer_size - composed_size,
 		rects, num_rects);
 	composed_size += rfx_compose_message_tileset(context, buffer + composed_size, buffer_size - composed_size,
-		image_data, width, height, rowstride);
+		image_data, width, height, rowstride, numDirty);
 	composed_size += rfx_compose_message_frame_end(context, buffer + composed_size, buffer_size - composed_size);
 
 	return composed_size;
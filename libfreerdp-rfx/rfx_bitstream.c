@@ -85,6 +85,10 @@ rfx_bitstream_put_bits(RFX_BITSTREAM * bs, uint16 bits, int nbits)
 		if (b > bs->bits_left)
 			b = bs->bits_left;
 
+		/* a fresh byte is overwritten, the output buffer does not need to be zeroed */
+		if (bs->bits_left == 8)
+			bs->buffer[bs->byte_pos] = 0;
+
 		bs->buffer[bs->byte_pos] |= ((bits >> (nbits - b)) & ((1 << b) - 1)) << (bs->bits_left - b);
 		bs->bits_left -= b;
 		nbits -= b;
@@ -103,7 +103,7 @@ rfx_decode_YCbCr_to_RGB(sint16 * y_r_buf, sint16 * cb_g_buf, sint16 * cr_b_buf)
 
 static void
 rfx_decode_component(RFX_CONTEXT * context, const uint32 * quantization_values,
-	const uint8 * data, int size, sint16 * buffer)
+	const uint8 * data, int size, sint16 * buffer, sint16 * dwt_buffer)
 {
 	PROFILER_ENTER(context->prof_rfx_decode_component);
 
@@ -120,30 +120,104 @@ rfx_decode_component(RFX_CONTEXT * context, const uint32 * quantization_values,
 	PROFILER_EXIT(context->prof_rfx_quantization_decode);
 
 	PROFILER_ENTER(context->prof_rfx_dwt_2d_decode);
-		context->dwt_2d_decode(buffer, context->dwt_buffer);
+		context->dwt_2d_decode(buffer, dwt_buffer);
 	PROFILER_EXIT(context->prof_rfx_dwt_2d_decode);
 
 	PROFILER_EXIT(context->prof_rfx_decode_component);
 }
 
+/* Decode the three components of a tile into RGB planes in the scratch buffers */
+void
+rfx_decode_planes(RFX_CONTEXT * context, RFX_SCRATCH * scratch,
+	const uint8 * y_data, int y_size, const uint32 * y_quants,
+	const uint8 * cb_data, int cb_size, const uint32 * cb_quants,
+	const uint8 * cr_data, int cr_size, const uint32 * cr_quants)
+{
+	rfx_decode_component(context, y_quants, y_data, y_size, scratch->y_r_buffer, scratch->dwt_buffer); /* YData */
+	rfx_decode_component(context, cb_quants, cb_data, cb_size, scratch->cb_g_buffer, scratch->dwt_buffer); /* CbData */
+	rfx_decode_component(context, cr_quants, cr_data, cr_size, scratch->cr_b_buffer, scratch->dwt_buffer); /* CrData */
+
+	PROFILER_ENTER(context->prof_rfx_decode_YCbCr_to_RGB);
+		context->decode_YCbCr_to_RGB(scratch->y_r_buffer, scratch->cb_g_buffer, scratch->cr_b_buffer);
+	PROFILER_EXIT(context->prof_rfx_decode_YCbCr_to_RGB);
+}
+
+/*
+   Write the (x, y, width, height) part of the decoded RGB planes to dst_buf,
+   which points at the destination of the top-left pixel of that part.
+*/
+void
+rfx_decode_format_RGB_rect(RFX_SCRATCH * scratch, RFX_PIXEL_FORMAT pixel_format,
+	int x, int y, int width, int height, uint8 * dst_buf, int dst_stride)
+{
+	sint16 * r;
+	sint16 * g;
+	sint16 * b;
+	uint8 * dst;
+	int i, j;
+
+	for (j = 0; j < height; j++)
+	{
+		r = scratch->y_r_buffer + (y + j) * 64 + x;
+		g = scratch->cb_g_buffer + (y + j) * 64 + x;
+		b = scratch->cr_b_buffer + (y + j) * 64 + x;
+		dst = dst_buf + j * dst_stride;
+
+		switch (pixel_format)
+		{
+			case RFX_PIXEL_FORMAT_BGRA:
+				for (i = 0; i < width; i++)
+				{
+					*dst++ = (uint8) (*b++);
+					*dst++ = (uint8) (*g++);
+					*dst++ = (uint8) (*r++);
+					*dst++ = 0xFF;
+				}
+				break;
+			case RFX_PIXEL_FORMAT_RGBA:
+				for (i = 0; i < width; i++)
+				{
+					*dst++ = (uint8) (*r++);
+					*dst++ = (uint8) (*g++);
+					*dst++ = (uint8) (*b++);
+					*dst++ = 0xFF;
+				}
+				break;
+			case RFX_PIXEL_FORMAT_BGR:
+				for (i = 0; i < width; i++)
+				{
+					*dst++ = (uint8) (*b++);
+					*dst++ = (uint8) (*g++);
+					*dst++ = (uint8) (*r++);
+				}
+				break;
+			case RFX_PIXEL_FORMAT_RGB:
+				for (i = 0; i < width; i++)
+				{
+					*dst++ = (uint8) (*r++);
+					*dst++ = (uint8) (*g++);
+					*dst++ = (uint8) (*b++);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
 uint8*
-rfx_decode_rgb(RFX_CONTEXT * context,
+rfx_decode_rgb_ex(RFX_CONTEXT * context, RFX_SCRATCH * scratch,
 	const uint8 * y_data, int y_size, const uint32 * y_quants,
 	const uint8 * cb_data, int cb_size, const uint32 * cb_quants,
 	const uint8 * cr_data, int cr_size, const uint32 * cr_quants, uint8* rgb_buffer)
 {
 	PROFILER_ENTER(context->prof_rfx_decode_rgb);
 
-	rfx_decode_component(context, y_quants, y_data, y_size, context->y_r_buffer); /* YData */
-	rfx_decode_component(context, cb_quants, cb_data, cb_size, context->cb_g_buffer); /* CbData */
-	rfx_decode_component(context, cr_quants, cr_data, cr_size, context->cr_b_buffer); /* CrData */
-
-	PROFILER_ENTER(context->prof_rfx_decode_YCbCr_to_RGB);
-		context->decode_YCbCr_to_RGB(context->y_r_buffer, context->cb_g_buffer, context->cr_b_buffer);
-	PROFILER_EXIT(context->prof_rfx_decode_YCbCr_to_RGB);
+	rfx_decode_planes(context, scratch, y_data, y_size, y_quants,
+		cb_data, cb_size, cb_quants, cr_data, cr_size, cr_quants);
 
 	PROFILER_ENTER(context->prof_rfx_decode_format_RGB);
-		rfx_decode_format_RGB(context->y_r_buffer, context->cb_g_buffer, context->cr_b_buffer,
+		rfx_decode_format_RGB(scratch->y_r_buffer, scratch->cb_g_buffer, scratch->cr_b_buffer,
 			context->pixel_format, rgb_buffer);
 	PROFILER_EXIT(context->prof_rfx_decode_format_RGB);
 	
@@ -151,3 +225,21 @@ rfx_decode_rgb(RFX_CONTEXT * context,
 
 	return rgb_buffer;
 }
+
+uint8*
+rfx_decode_rgb(RFX_CONTEXT * context,
+	const uint8 * y_data, int y_size, const uint32 * y_quants,
+	const uint8 * cb_data, int cb_size, const uint32 * cb_quants,
+	const uint8 * cr_data, int cr_size, const uint32 * cr_quants, uint8* rgb_buffer)
+{
+	RFX_SCRATCH scratch;
+
+	scratch.y_r_buffer = context->y_r_buffer;
+	scratch.cb_g_buffer = context->cb_g_buffer;
+	scratch.cr_b_buffer = context->cr_b_buffer;
+	scratch.dwt_buffer = context->dwt_buffer;
+
+	return rfx_decode_rgb_ex(context, &scratch,
+		y_data, y_size, y_quants, cb_data, cb_size, cb_quants,
+		cr_data, cr_size, cr_quants, rgb_buffer);
+}
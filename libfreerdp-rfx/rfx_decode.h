@@ -22,6 +22,8 @@
 
 #include <freerdp/rfx.h>
 
+#include "rfx_scratch.h"
+
 void
 rfx_decode_YCbCr_to_RGB(sint16 * y_r_buf, sint16 * cb_g_buf, sint16 * cr_b_buf);
 
@@ -31,5 +33,21 @@ rfx_decode_rgb(RFX_CONTEXT * context,
 	const uint8 * cb_data, int cb_size, const uint32 * cb_quants,
 	const uint8 * cr_data, int cr_size, const uint32 * cr_quants, uint8* rgb_buffer);
 
+void
+rfx_decode_planes(RFX_CONTEXT * context, RFX_SCRATCH * scratch,
+	const uint8 * y_data, int y_size, const uint32 * y_quants,
+	const uint8 * cb_data, int cb_size, const uint32 * cb_quants,
+	const uint8 * cr_data, int cr_size, const uint32 * cr_quants);
+
+void
+rfx_decode_format_RGB_rect(RFX_SCRATCH * scratch, RFX_PIXEL_FORMAT pixel_format,
+	int x, int y, int width, int height, uint8 * dst_buf, int dst_stride);
+
+uint8*
+rfx_decode_rgb_ex(RFX_CONTEXT * context, RFX_SCRATCH * scratch,
+	const uint8 * y_data, int y_size, const uint32 * y_quants,
+	const uint8 * cb_data, int cb_size, const uint32 * cb_quants,
+	const uint8 * cr_data, int cr_size, const uint32 * cr_quants, uint8* rgb_buffer);
+
 #endif
 
@@ -127,12 +127,12 @@ rfx_encode_RGB_to_YCbCr(sint16 * y_r_buf, sint16 * cb_g_buf, sint16 * cr_b_buf)
 
 static void
 rfx_encode_component(RFX_CONTEXT * context, const uint32 * quantization_values,
-	sint16 * data, uint8 * buffer, int buffer_size, int * size)
+	sint16 * data, sint16 * dwt_buffer, uint8 * buffer, int buffer_size, int * size)
 {
 	PROFILER_ENTER(context->prof_rfx_encode_component);
 
 	PROFILER_ENTER(context->prof_rfx_dwt_2d_encode);
-		context->dwt_2d_encode(data, context->dwt_buffer);
+		context->dwt_2d_encode(data, dwt_buffer);
 	PROFILER_EXIT(context->prof_rfx_dwt_2d_encode);
 
 	PROFILER_ENTER(context->prof_rfx_quantization_encode);
@@ -151,13 +151,14 @@ rfx_encode_component(RFX_CONTEXT * context, const uint32 * quantization_values,
 }
 
 void
-rfx_encode_rgb(RFX_CONTEXT * context, const uint8 * rgb_data, int width, int height, int rowstride,
+rfx_encode_rgb_ex(RFX_CONTEXT * context, RFX_SCRATCH * scratch,
+	const uint8 * rgb_data, int width, int height, int rowstride,
 	const uint32 * y_quants, const uint32 * cb_quants, const uint32 * cr_quants,
 	uint8 * ycbcr_buffer, int buffer_size, int * y_size, int * cb_size, int * cr_size)
 {
-	sint16 * y_r_buffer = context->y_r_buffer;
-	sint16 * cb_g_buffer = context->cb_g_buffer;
-	sint16 * cr_b_buffer = context->cr_b_buffer;
+	sint16 * y_r_buffer = scratch->y_r_buffer;
+	sint16 * cb_g_buffer = scratch->cb_g_buffer;
+	sint16 * cr_b_buffer = scratch->cr_b_buffer;
 
 	PROFILER_ENTER(context->prof_rfx_encode_rgb);
 
@@ -167,16 +168,35 @@ rfx_encode_rgb(RFX_CONTEXT * context, const uint8 * rgb_data, int width, int hei
 	PROFILER_EXIT(context->prof_rfx_encode_format_RGB);
 
 	PROFILER_ENTER(context->prof_rfx_encode_RGB_to_YCbCr);
-		context->encode_RGB_to_YCbCr(context->y_r_buffer, context->cb_g_buffer, context->cr_b_buffer);
+		context->encode_RGB_to_YCbCr(y_r_buffer, cb_g_buffer, cr_b_buffer);
 	PROFILER_EXIT(context->prof_rfx_encode_RGB_to_YCbCr);
 
-	rfx_encode_component(context, y_quants, context->y_r_buffer, ycbcr_buffer, buffer_size, y_size);
+	rfx_encode_component(context, y_quants, y_r_buffer, scratch->dwt_buffer,
+		ycbcr_buffer, buffer_size, y_size);
 	ycbcr_buffer += (*y_size);
 	buffer_size -= (*y_size);
-	rfx_encode_component(context, cb_quants, context->cb_g_buffer, ycbcr_buffer, buffer_size, cb_size);
+	rfx_encode_component(context, cb_quants, cb_g_buffer, scratch->dwt_buffer,
+		ycbcr_buffer, buffer_size, cb_size);
 	ycbcr_buffer += (*cb_size);
 	buffer_size -= (*cb_size);
-	rfx_encode_component(context, cr_quants, context->cr_b_buffer, ycbcr_buffer, buffer_size, cr_size);
+	rfx_encode_component(context, cr_quants, cr_b_buffer, scratch->dwt_buffer,
+		ycbcr_buffer, buffer_size, cr_size);
 
 	PROFILER_EXIT(context->prof_rfx_encode_rgb);
 }
+
+void
+rfx_encode_rgb(RFX_CONTEXT * context, const uint8 * rgb_data, int width, int height, int rowstride,
+	const uint32 * y_quants, const uint32 * cb_quants, const uint32 * cr_quants,
+	uint8 * ycbcr_buffer, int buffer_size, int * y_size, int * cb_size, int * cr_size)
+{
+	RFX_SCRATCH scratch;
+
+	scratch.y_r_buffer = context->y_r_buffer;
+	scratch.cb_g_buffer = context->cb_g_buffer;
+	scratch.cr_b_buffer = context->cr_b_buffer;
+	scratch.dwt_buffer = context->dwt_buffer;
+
+	rfx_encode_rgb_ex(context, &scratch, rgb_data, width, height, rowstride,
+		y_quants, cb_quants, cr_quants, ycbcr_buffer, buffer_size, y_size, cb_size, cr_size);
+}
@@ -22,6 +22,8 @@
 
 #include <freerdp/rfx.h>
 
+#include "rfx_scratch.h"
+
 void
 rfx_encode_RGB_to_YCbCr(sint16 * y_r_buf, sint16 * cb_g_buf, sint16 * cr_b_buf);
 
@@ -30,5 +32,11 @@ rfx_encode_rgb(RFX_CONTEXT * context, const uint8 * rgb_data, int width, int hei
 	const uint32 * y_quants, const uint32 * cb_quants, const uint32 * cr_quants,
 	uint8 * ycbcr_buffer, int buffer_size, int * y_size, int * cb_size, int * cr_size);
 
+void
+rfx_encode_rgb_ex(RFX_CONTEXT * context, RFX_SCRATCH * scratch,
+	const uint8 * rgb_data, int width, int height, int rowstride,
+	const uint32 * y_quants, const uint32 * cb_quants, const uint32 * cr_quants,
+	uint8 * ycbcr_buffer, int buffer_size, int * y_size, int * cb_size, int * cr_size);
+
 #endif
 
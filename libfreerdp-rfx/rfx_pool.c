@@ -31,40 +31,77 @@ RFX_POOL* rfx_pool_new()
 	memset(pool, 0, sizeof(RFX_POOL));
 
 	pool->size = 64;
+	pool->max_count = RFX_POOL_MAX_TILES;
 	pool->tiles = (RFX_TILE**) malloc(sizeof(RFX_TILE*) * pool->size);
 	memset(pool->tiles, 0, sizeof(RFX_TILE*) * pool->size);
 
 	return pool;
 }
 
+static void rfx_pool_free_tile(RFX_TILE* tile)
+{
+	if (tile != NULL)
+	{
+		if (tile->data != NULL)
+			free (tile->data);
+
+		free(tile);
+	}
+}
+
+static void rfx_pool_free_message(RFX_MESSAGE* message)
+{
+	if (message->rects != NULL)
+		free(message->rects);
+
+	if (message->tiles != NULL)
+		free(message->tiles);
+
+	free(message);
+}
+
 void rfx_pool_free(RFX_POOL* pool)
 {
 	int i;
-	RFX_TILE* tile;
 
 	for (i = 0; i < pool->count; i++)
-	{
-		tile = pool->tiles[i];
+		rfx_pool_free_tile(pool->tiles[i]);
 
-		if (tile != NULL)
-		{
-			if (tile->data != NULL)
-				free (tile->data);
-
-			free(tile);
-		}
-	}
+	if (pool->message != NULL)
+		rfx_pool_free_message(pool->message);
 
 	free(pool->tiles);
 	free(pool);
 }
 
+/* realloc that is accounted for in the pool allocation counter */
+void* rfx_pool_realloc(RFX_POOL* pool, void* ptr, int size)
+{
+	pool->allocations++;
+	return realloc(ptr, size);
+}
+
+void rfx_pool_set_max_count(RFX_POOL* pool, int max_count)
+{
+	pool->max_count = max_count;
+
+	while (pool->count > pool->max_count)
+		rfx_pool_free_tile(pool->tiles[--(pool->count)]);
+}
+
 void rfx_pool_put_tile(RFX_POOL* pool, RFX_TILE* tile)
 {
+	/* above the high-water mark tiles go back to the heap */
+	if (pool->count >= pool->max_count)
+	{
+		rfx_pool_free_tile(tile);
+		return;
+	}
+
 	if (pool->count >= pool->size)
 	{
 		pool->size *= 2;
-		pool->tiles = (RFX_TILE**) realloc((void*) pool->tiles, sizeof(RFX_TILE*) * pool->size);
+		pool->tiles = (RFX_TILE**) rfx_pool_realloc(pool, (void*) pool->tiles, sizeof(RFX_TILE*) * pool->size);
 	}
 
 	pool->tiles[(pool->count)++] = tile;
@@ -78,6 +115,7 @@ RFX_TILE* rfx_pool_get_tile(RFX_POOL* pool)
 	{
 		tile = (RFX_TILE*) malloc(sizeof(RFX_TILE));
 		tile->data = (uint8*) malloc(4096 * 4); /* 64x64 * 4 */
+		pool->allocations += 2;
 	}
 	else
 	{
@@ -97,17 +135,46 @@ void rfx_pool_put_tiles(RFX_POOL* pool, RFX_TILE** tiles, int count)
 	}
 }
 
-RFX_TILE** rfx_pool_get_tiles(RFX_POOL* pool, int count)
+void rfx_pool_get_tiles(RFX_POOL* pool, RFX_TILE** tiles, int count)
 {
 	int i;
-	RFX_TILE** tiles;
-
-	tiles = (RFX_TILE**) malloc(sizeof(RFX_TILE*) * count);
 
 	for (i = 0; i < count; i++)
 	{
 		tiles[i] = rfx_pool_get_tile(pool);
 	}
+}
+
+/* Get an empty message, reusing the rects and tiles arrays of a released one */
+RFX_MESSAGE* rfx_pool_get_message(RFX_POOL* pool)
+{
+	RFX_MESSAGE* message;
+
+	if (pool->message != NULL)
+	{
+		message = pool->message;
+		pool->message = NULL;
+	}
+	else
+	{
+		message = (RFX_MESSAGE*) malloc(sizeof(RFX_MESSAGE));
+		memset(message, 0, sizeof(RFX_MESSAGE));
+		pool->allocations++;
+	}
+
+	message->num_rects = 0;
+	message->num_tiles = 0;
 
-	return tiles;
+	return message;
+}
+
+void rfx_pool_put_message(RFX_POOL* pool, RFX_MESSAGE* message)
+{
+	rfx_pool_put_tiles(pool, message->tiles, message->num_tiles);
+	message->num_tiles = 0;
+
+	if (pool->message == NULL)
+		pool->message = message;
+	else
+		rfx_pool_free_message(message);
 }
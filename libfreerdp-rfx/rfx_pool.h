@@ -22,12 +22,19 @@
 
 #include <freerdp/rfx.h>
 
+/* default number of free tiles kept around, enough for a 2048x2048 frame */
+#define RFX_POOL_MAX_TILES	1024
+
 RFX_POOL* rfx_pool_new();
 void rfx_pool_free(RFX_POOL* pool);
+void* rfx_pool_realloc(RFX_POOL* pool, void* ptr, int size);
+void rfx_pool_set_max_count(RFX_POOL* pool, int max_count);
 void rfx_pool_put_tile(RFX_POOL* pool, RFX_TILE* tile);
 RFX_TILE* rfx_pool_get_tile(RFX_POOL* pool);
 void rfx_pool_put_tiles(RFX_POOL* pool, RFX_TILE** tiles, int count);
-RFX_TILE** rfx_pool_get_tiles(RFX_POOL* pool, int count);
+void rfx_pool_get_tiles(RFX_POOL* pool, RFX_TILE** tiles, int count);
+RFX_MESSAGE* rfx_pool_get_message(RFX_POOL* pool);
+void rfx_pool_put_message(RFX_POOL* pool, RFX_MESSAGE* message);
 
 #endif /* __RFX_POOL_H */
 
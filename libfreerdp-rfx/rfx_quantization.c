@@ -45,7 +45,7 @@ rfx_quantization_decode(sint16 * buffer, const uint32 * quantization_values)
 	rfx_quantization_decode_block(buffer + 3584, 256, quantization_values[6]); /* HH2 */
 	rfx_quantization_decode_block(buffer + 3840, 64, quantization_values[2]); /* HL3 */
 	rfx_quantization_decode_block(buffer + 3904, 64, quantization_values[1]); /* LH3 */
-	rfx_quantization_decode_block(buffer + 3868, 64, quantization_values[3]); /* HH3 */
+	rfx_quantization_decode_block(buffer + 3968, 64, quantization_values[3]); /* HH3 */
 	rfx_quantization_decode_block(buffer + 4032, 64, quantization_values[0]); /* LL3 */
 }
 
@@ -75,7 +75,7 @@ rfx_quantization_encode(sint16 * buffer, const uint32 * quantization_values)
 	rfx_quantization_encode_block(buffer + 3584, 256, quantization_values[6]); /* HH2 */
 	rfx_quantization_encode_block(buffer + 3840, 64, quantization_values[2]); /* HL3 */
 	rfx_quantization_encode_block(buffer + 3904, 64, quantization_values[1]); /* LH3 */
-	rfx_quantization_encode_block(buffer + 3868, 64, quantization_values[3]); /* HH3 */
+	rfx_quantization_encode_block(buffer + 3968, 64, quantization_values[3]); /* HH3 */
 	rfx_quantization_encode_block(buffer + 4032, 64, quantization_values[0]); /* LL3 */
 }
 
@@ -129,9 +129,10 @@ rfx_rlgr_decode(RLGR_MODE mode, const uint8 * data, int data_size, sint16 * buff
 	int kr;
 	int krp;
 	sint16 * dst;
-	RFX_BITSTREAM * bs;
+	RFX_BITSTREAM bitstream;
+	RFX_BITSTREAM * bs = &bitstream;
 
-	bs = rfx_bitstream_new();
+	/* the bitstream lives on the stack, decoding a tile does not allocate */
 	rfx_bitstream_put_buffer(bs, (uint8 *) data, data_size);
 	dst = buffer;
 
@@ -226,7 +227,9 @@ rfx_rlgr_decode(RLGR_MODE mode, const uint8 * data, int data_size, sint16 * buff
 		}
 	}
 
-	rfx_bitstream_free(bs);
+	/* coefficients the encoder left out at the end of the stream are zero */
+	if (buffer_size > 0)
+		memset(dst, 0, buffer_size * sizeof(sint16));
 
 	return (dst - buffer);
 }
@@ -298,10 +301,10 @@ rfx_rlgr_encode(RLGR_MODE mode, const sint16 * data, int data_size, uint8 * buff
 	int kp;
 	int kr;
 	int krp;
-	RFX_BITSTREAM * bs;
+	RFX_BITSTREAM bitstream;
+	RFX_BITSTREAM * bs = &bitstream;
 	int processed_size;
 
-	bs = rfx_bitstream_new();
 	rfx_bitstream_put_buffer(bs, buffer, buffer_size);
 
 	/* initialize the parameters */
@@ -425,7 +428,6 @@ rfx_rlgr_encode(RLGR_MODE mode, const sint16 * data, int data_size, uint8 * buff
 	}
 
 	processed_size = rfx_bitstream_get_processed_bytes(bs);
-	rfx_bitstream_free(bs);
 
 	return processed_size;
 }
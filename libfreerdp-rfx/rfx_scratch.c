@@ -0,0 +1,58 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   RemoteFX Codec Library - Scratch Buffers
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "rfx_scratch.h"
+
+/* the scratch of a worker thread, with the memory its buffers point into */
+struct _RFX_WORKER_SCRATCH
+{
+	RFX_SCRATCH scratch;
+
+	sint16 y_r_mem[4096+8]; /* 4096 = 64x64 (+ 8x2 = 16 for mem align) */
+	sint16 cb_g_mem[4096+8]; /* 4096 = 64x64 (+ 8x2 = 16 for mem align) */
+	sint16 cr_b_mem[4096+8]; /* 4096 = 64x64 (+ 8x2 = 16 for mem align) */
+	sint16 dwt_mem[32*32*2*2 + 8]; /* maximum sub-band width is 32 */
+};
+typedef struct _RFX_WORKER_SCRATCH RFX_WORKER_SCRATCH;
+
+void *
+rfx_scratch_new(void)
+{
+	RFX_WORKER_SCRATCH * ws;
+
+	ws = (RFX_WORKER_SCRATCH *) malloc(sizeof(RFX_WORKER_SCRATCH));
+	memset(ws, 0, sizeof(RFX_WORKER_SCRATCH));
+
+	/* align buffers to 16 byte boundary (needed for SSE/SSE2 instructions) */
+	ws->scratch.y_r_buffer = (sint16 *)(((uintptr_t)ws->y_r_mem + 16) & ~ 0x0F);
+	ws->scratch.cb_g_buffer = (sint16 *)(((uintptr_t)ws->cb_g_mem + 16) & ~ 0x0F);
+	ws->scratch.cr_b_buffer = (sint16 *)(((uintptr_t)ws->cr_b_mem + 16) & ~ 0x0F);
+	ws->scratch.dwt_buffer = (sint16 *)(((uintptr_t)ws->dwt_mem + 16) & ~ 0x0F);
+
+	return &ws->scratch;
+}
+
+void
+rfx_scratch_free(void * scratch)
+{
+	/* the RFX_SCRATCH is the first member of its RFX_WORKER_SCRATCH */
+	free(scratch);
+}
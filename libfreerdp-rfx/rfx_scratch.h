@@ -0,0 +1,38 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   RemoteFX Codec Library - Scratch Buffers
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __RFX_SCRATCH_H
+#define __RFX_SCRATCH_H
+
+#include <freerdp/rfx.h>
+
+/* scratch buffers used by one thread while processing a tile */
+struct _RFX_SCRATCH
+{
+	sint16 * y_r_buffer;
+	sint16 * cb_g_buffer;
+	sint16 * cr_b_buffer;
+	sint16 * dwt_buffer;
+};
+typedef struct _RFX_SCRATCH RFX_SCRATCH;
+
+void *
+rfx_scratch_new(void);
+void
+rfx_scratch_free(void * scratch);
+
+#endif /* __RFX_SCRATCH_H */
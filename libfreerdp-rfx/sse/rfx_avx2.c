@@ -0,0 +1,353 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   RemoteFX Codec Library - AVX2 Optimizations
+
+   Copyright 2011 Vic Lee
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include "rfx_avx2.h"
+
+/*
+   The scratch buffers are only guaranteed to be 16 byte aligned, so all
+   256-bit loads and stores below are unaligned ones.
+*/
+
+static __inline __m256i __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+_mm256_between_epi16(__m256i val, __m256i min, __m256i max)
+{
+	return _mm256_min_epi16(_mm256_max_epi16(val, min), max);
+}
+
+void
+rfx_decode_YCbCr_to_RGB_AVX2(sint16 * y_r_buffer, sint16 * cb_g_buffer, sint16 * cr_b_buffer)
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i max = _mm256_set1_epi16(255);
+	__m256i half = _mm256_set1_epi16(128);
+
+	__m256i y;
+	__m256i cr;
+	__m256i cb;
+	__m256i r;
+	__m256i g;
+	__m256i b;
+
+	int i;
+
+	for (i = 0; i < 4096; i += 16)
+	{
+		/* y = y_r_buf[i] + 128; */
+		y = _mm256_loadu_si256((__m256i*) &y_r_buffer[i]);
+		y = _mm256_add_epi16(y, half);
+
+		cb = _mm256_loadu_si256((__m256i*) &cb_g_buffer[i]);
+		cr = _mm256_loadu_si256((__m256i*) &cr_b_buffer[i]);
+
+		/* r = between(y + cr + (cr >> 2) + (cr >> 3) + (cr >> 5), 0, 255); */
+		r = _mm256_add_epi16(y, cr);
+		r = _mm256_add_epi16(r, _mm256_srai_epi16(cr, 2));
+		r = _mm256_add_epi16(r, _mm256_srai_epi16(cr, 3));
+		r = _mm256_add_epi16(r, _mm256_srai_epi16(cr, 5));
+		_mm256_storeu_si256((__m256i*) &y_r_buffer[i], _mm256_between_epi16(r, zero, max));
+
+		/* g = between(y - (cb >> 2) - (cb >> 4) - (cb >> 5) - (cr >> 1) - (cr >> 3) - (cr >> 4) - (cr >> 5), 0, 255); */
+		g = _mm256_sub_epi16(y, _mm256_srai_epi16(cb, 2));
+		g = _mm256_sub_epi16(g, _mm256_srai_epi16(cb, 4));
+		g = _mm256_sub_epi16(g, _mm256_srai_epi16(cb, 5));
+		g = _mm256_sub_epi16(g, _mm256_srai_epi16(cr, 1));
+		g = _mm256_sub_epi16(g, _mm256_srai_epi16(cr, 3));
+		g = _mm256_sub_epi16(g, _mm256_srai_epi16(cr, 4));
+		g = _mm256_sub_epi16(g, _mm256_srai_epi16(cr, 5));
+		_mm256_storeu_si256((__m256i*) &cb_g_buffer[i], _mm256_between_epi16(g, zero, max));
+
+		/* b = between(y + cb + (cb >> 1) + (cb >> 2) + (cb >> 6), 0, 255); */
+		b = _mm256_add_epi16(y, cb);
+		b = _mm256_add_epi16(b, _mm256_srai_epi16(cb, 1));
+		b = _mm256_add_epi16(b, _mm256_srai_epi16(cb, 2));
+		b = _mm256_add_epi16(b, _mm256_srai_epi16(cb, 6));
+		_mm256_storeu_si256((__m256i*) &cr_b_buffer[i], _mm256_between_epi16(b, zero, max));
+	}
+}
+
+static __inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+rfx_quantization_decode_block_AVX2(sint16 * buffer, const int buffer_size, const uint32 factor)
+{
+	__m128i shift;
+	__m256i a;
+	sint16 * ptr;
+
+	if (factor <= 6)
+		return;
+
+	shift = _mm_cvtsi32_si128(factor - 6);
+
+	for (ptr = buffer; ptr < buffer + buffer_size; ptr += 16)
+	{
+		a = _mm256_loadu_si256((__m256i*) ptr);
+		a = _mm256_sll_epi16(a, shift);
+		_mm256_storeu_si256((__m256i*) ptr, a);
+	}
+}
+
+void
+rfx_quantization_decode_AVX2(sint16 * buffer, const uint32 * quantization_values)
+{
+	rfx_quantization_decode_block_AVX2(buffer, 1024, quantization_values[8]); /* HL1 */
+	rfx_quantization_decode_block_AVX2(buffer + 1024, 1024, quantization_values[7]); /* LH1 */
+	rfx_quantization_decode_block_AVX2(buffer + 2048, 1024, quantization_values[9]); /* HH1 */
+	rfx_quantization_decode_block_AVX2(buffer + 3072, 256, quantization_values[5]); /* HL2 */
+	rfx_quantization_decode_block_AVX2(buffer + 3328, 256, quantization_values[4]); /* LH2 */
+	rfx_quantization_decode_block_AVX2(buffer + 3584, 256, quantization_values[6]); /* HH2 */
+	rfx_quantization_decode_block_AVX2(buffer + 3840, 64, quantization_values[2]); /* HL3 */
+	rfx_quantization_decode_block_AVX2(buffer + 3904, 64, quantization_values[1]); /* LH3 */
+	rfx_quantization_decode_block_AVX2(buffer + 3968, 64, quantization_values[3]); /* HH3 */
+	rfx_quantization_decode_block_AVX2(buffer + 4032, 64, quantization_values[0]); /* LL3 */
+}
+
+/*
+   A 256-bit vector holds 16 coefficients, which is more than one row of the
+   8x8 sub-bands. The horizontal pass therefore works on 16 consecutive
+   coefficients that may span several rows, and uses these masks to patch the
+   lanes sitting on the first (n == 0) or last (n == subband_width - 1)
+   coefficient of a row.
+*/
+static __inline __m256i __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+rfx_dwt_row_first_mask_AVX2(int n, int subband_width)
+{
+	if (subband_width == 8)
+		return _mm256_setr_epi16(-1, 0, 0, 0, 0, 0, 0, 0, -1, 0, 0, 0, 0, 0, 0, 0);
+	if (n == 0)
+		return _mm256_setr_epi16(-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	return _mm256_setzero_si256();
+}
+
+static __inline __m256i __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+rfx_dwt_row_last_mask_AVX2(int n, int subband_width)
+{
+	if (subband_width == 8)
+		return _mm256_setr_epi16(0, 0, 0, 0, 0, 0, 0, -1, 0, 0, 0, 0, 0, 0, 0, -1);
+	if (n == subband_width - 16)
+		return _mm256_setr_epi16(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1);
+	return _mm256_setzero_si256();
+}
+
+/*
+   The neighbours of the 16 coefficients of v, moved along by one lane across
+   the 128-bit halves, with the coefficient before or after v coming in at the
+   end. The callers pass 0 at the edges of a band, where the row masks replace
+   that lane anyway, so nothing outside the band is read.
+*/
+static __inline __m256i __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+rfx_dwt_prev_AVX2(__m256i v, sint16 prev)
+{
+	/* low half zero, high half the low half of v */
+	__m256i t = _mm256_permute2x128_si256(v, v, 0x08);
+
+	return _mm256_insert_epi16(_mm256_alignr_epi8(v, t, 14), prev, 0);
+}
+
+static __inline __m256i __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+rfx_dwt_next_AVX2(__m256i v, sint16 next)
+{
+	/* low half the high half of v, high half zero */
+	__m256i t = _mm256_permute2x128_si256(v, v, 0x81);
+
+	return _mm256_insert_epi16(_mm256_alignr_epi8(t, v, 2), next, 15);
+}
+
+static __inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+rfx_dwt_2d_decode_block_horiz_AVX2(sint16 * l, sint16 * h, sint16 * dst, int subband_width)
+{
+	int i, n;
+	int total;
+	__m256i first;
+	__m256i last;
+	__m256i l_n;
+	__m256i h_n;
+	__m256i h_n_m;
+	__m256i tmp_n;
+	__m256i dst_n;
+	__m256i dst_n_p;
+	__m256i dst1;
+	__m256i dst2;
+
+	total = subband_width * subband_width;
+
+	/* Even coefficients, written back in place of l */
+	for (i = 0; i < total; i += 16)
+	{
+		/* dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1); */
+		n = i % subband_width;
+		first = rfx_dwt_row_first_mask_AVX2(n, subband_width);
+
+		l_n = _mm256_loadu_si256((__m256i*) (l + i));
+		h_n = _mm256_loadu_si256((__m256i*) (h + i));
+		h_n_m = rfx_dwt_prev_AVX2(h_n, (i > 0) ? h[i - 1] : 0);
+		h_n_m = _mm256_blendv_epi8(h_n_m, h_n, first);
+
+		tmp_n = _mm256_add_epi16(h_n, h_n_m);
+		tmp_n = _mm256_add_epi16(tmp_n, _mm256_set1_epi16(1));
+		tmp_n = _mm256_srai_epi16(tmp_n, 1);
+
+		_mm256_storeu_si256((__m256i*) (l + i), _mm256_sub_epi16(l_n, tmp_n));
+	}
+
+	/* Odd coefficients, interleaved with the even ones into dst */
+	for (i = 0; i < total; i += 16)
+	{
+		/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1); */
+		n = i % subband_width;
+		last = rfx_dwt_row_last_mask_AVX2(n, subband_width);
+
+		h_n = _mm256_loadu_si256((__m256i*) (h + i));
+		h_n = _mm256_slli_epi16(h_n, 1);
+
+		dst_n = _mm256_loadu_si256((__m256i*) (l + i));
+		dst_n_p = rfx_dwt_next_AVX2(dst_n, (i + 16 < total) ? l[i + 16] : 0);
+		dst_n_p = _mm256_blendv_epi8(dst_n_p, dst_n, last);
+
+		tmp_n = _mm256_add_epi16(dst_n_p, dst_n);
+		tmp_n = _mm256_srai_epi16(tmp_n, 1);
+		tmp_n = _mm256_add_epi16(tmp_n, h_n);
+
+		/* unpack works per 128-bit lane, put the halves back in order */
+		dst1 = _mm256_unpacklo_epi16(dst_n, tmp_n);
+		dst2 = _mm256_unpackhi_epi16(dst_n, tmp_n);
+
+		_mm256_storeu_si256((__m256i*) (dst + 2 * i), _mm256_permute2x128_si256(dst1, dst2, 0x20));
+		_mm256_storeu_si256((__m256i*) (dst + 2 * i + 16), _mm256_permute2x128_si256(dst1, dst2, 0x31));
+	}
+}
+
+static __inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+rfx_dwt_2d_decode_block_vert_AVX2(sint16 * l, sint16 * h, sint16 * dst, int subband_width)
+{
+	int x, n;
+	sint16 * l_ptr = l;
+	sint16 * h_ptr = h;
+	sint16 * dst_ptr = dst;
+	__m256i l_n;
+	__m256i h_n;
+	__m256i tmp_n;
+	__m256i h_n_m;
+	__m256i dst_n;
+	__m256i dst_n_m;
+	__m256i dst_n_p;
+
+	int total_width = subband_width + subband_width;
+
+	/* Even coefficients */
+	for (n = 0; n < subband_width; n++)
+	{
+		for (x = 0; x < total_width; x += 16)
+		{
+			/* dst[2n] = l[n] - ((h[n-1] + h[n] + 1) >> 1); */
+
+			l_n = _mm256_loadu_si256((__m256i*) l_ptr);
+			h_n = _mm256_loadu_si256((__m256i*) h_ptr);
+
+			tmp_n = _mm256_add_epi16(h_n, _mm256_set1_epi16(1));
+			if (n == 0)
+				tmp_n = _mm256_add_epi16(tmp_n, h_n);
+			else
+			{
+				h_n_m = _mm256_loadu_si256((__m256i*) (h_ptr - total_width));
+				tmp_n = _mm256_add_epi16(tmp_n, h_n_m);
+			}
+			tmp_n = _mm256_srai_epi16(tmp_n, 1);
+
+			dst_n = _mm256_sub_epi16(l_n, tmp_n);
+			_mm256_storeu_si256((__m256i*) dst_ptr, dst_n);
+
+			l_ptr += 16;
+			h_ptr += 16;
+			dst_ptr += 16;
+		}
+		dst_ptr += total_width;
+	}
+
+	h_ptr = h;
+	dst_ptr = dst + total_width;
+
+	/* Odd coefficients */
+	for (n = 0; n < subband_width; n++)
+	{
+		for (x = 0; x < total_width; x += 16)
+		{
+			/* dst[2n + 1] = (h[n] << 1) + ((dst[2n] + dst[2n + 2]) >> 1); */
+
+			h_n = _mm256_loadu_si256((__m256i*) h_ptr);
+			dst_n_m = _mm256_loadu_si256((__m256i*) (dst_ptr - total_width));
+			h_n = _mm256_slli_epi16(h_n, 1);
+
+			tmp_n = dst_n_m;
+			if (n == subband_width - 1)
+				tmp_n = _mm256_add_epi16(tmp_n, dst_n_m);
+			else
+			{
+				dst_n_p = _mm256_loadu_si256((__m256i*) (dst_ptr + total_width));
+				tmp_n = _mm256_add_epi16(tmp_n, dst_n_p);
+			}
+			tmp_n = _mm256_srai_epi16(tmp_n, 1);
+
+			dst_n = _mm256_add_epi16(tmp_n, h_n);
+			_mm256_storeu_si256((__m256i*) dst_ptr, dst_n);
+
+			h_ptr += 16;
+			dst_ptr += 16;
+		}
+		dst_ptr += total_width;
+	}
+}
+
+static __inline void __attribute__((__gnu_inline__, __always_inline__, __artificial__))
+rfx_dwt_2d_decode_block_AVX2(sint16 * buffer, sint16 * idwt, int subband_width)
+{
+	sint16 * hl, * lh, * hh, * ll;
+	sint16 * l_dst, * h_dst;
+
+	/* Inverse DWT in horizontal direction, results in 2 sub-bands in L, H order in tmp buffer idwt. */
+	/* The 4 sub-bands are stored in HL(0), LH(1), HH(2), LL(3) order. */
+	/* The lower part L uses LL(3) and HL(0). */
+	/* The higher part H uses LH(1) and HH(2). */
+
+	ll = buffer + subband_width * subband_width * 3;
+	hl = buffer;
+	l_dst = idwt;
+
+	rfx_dwt_2d_decode_block_horiz_AVX2(ll, hl, l_dst, subband_width);
+
+	lh = buffer + subband_width * subband_width;
+	hh = buffer + subband_width * subband_width * 2;
+	h_dst = idwt + subband_width * subband_width * 2;
+
+	rfx_dwt_2d_decode_block_horiz_AVX2(lh, hh, h_dst, subband_width);
+
+	/* Inverse DWT in vertical direction, results are stored in original buffer. */
+	rfx_dwt_2d_decode_block_vert_AVX2(l_dst, h_dst, buffer, subband_width);
+}
+
+void
+rfx_dwt_2d_decode_AVX2(sint16 * buffer, sint16 * dwt_buffer)
+{
+	rfx_dwt_2d_decode_block_AVX2(buffer + 3840, dwt_buffer, 8);
+	rfx_dwt_2d_decode_block_AVX2(buffer + 3072, dwt_buffer, 16);
+	rfx_dwt_2d_decode_block_AVX2(buffer, dwt_buffer, 32);
+}
@@ -24,6 +24,17 @@
 #include "rfx_sse2.h"
 #include "rfx_sse.h"
 
+#ifdef WITH_AVX2
+#include "rfx_avx2.h"
+
+/* AVX2 needs support from both the CPU and the OS (saved YMM state) */
+int rfx_cpu_has_avx2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
 void rfx_init_sse(RFX_CONTEXT * context)
 {
 		DEBUG_RFX("Using SSE2 optimizations");
@@ -41,4 +52,19 @@ void rfx_init_sse(RFX_CONTEXT * context)
 		context->quantization_encode = rfx_quantization_encode_SSE2;
 		context->dwt_2d_decode = rfx_dwt_2d_decode_SSE2;
 		context->dwt_2d_encode = rfx_dwt_2d_encode_SSE2;
+
+#ifdef WITH_AVX2
+		if (rfx_cpu_has_avx2())
+		{
+			DEBUG_RFX("Using AVX2 optimizations");
+
+			IF_PROFILER(context->prof_rfx_decode_YCbCr_to_RGB->name = "rfx_decode_YCbCr_to_RGB_AVX2");
+			IF_PROFILER(context->prof_rfx_quantization_decode->name = "rfx_quantization_decode_AVX2");
+			IF_PROFILER(context->prof_rfx_dwt_2d_decode->name = "rfx_dwt_2d_decode_AVX2");
+
+			context->decode_YCbCr_to_RGB = rfx_decode_YCbCr_to_RGB_AVX2;
+			context->quantization_decode = rfx_quantization_decode_AVX2;
+			context->dwt_2d_decode = rfx_dwt_2d_decode_AVX2;
+		}
+#endif
 }
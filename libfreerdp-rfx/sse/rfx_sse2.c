@@ -212,7 +212,7 @@ rfx_quantization_decode_SSE2(sint16 * buffer, const uint32 * quantization_values
 	rfx_quantization_decode_block_SSE2(buffer + 3584, 256, quantization_values[6]); /* HH2 */
 	rfx_quantization_decode_block_SSE2(buffer + 3840, 64, quantization_values[2]); /* HL3 */
 	rfx_quantization_decode_block_SSE2(buffer + 3904, 64, quantization_values[1]); /* LH3 */
-	rfx_quantization_decode_block_SSE2(buffer + 3868, 64, quantization_values[3]); /* HH3 */
+	rfx_quantization_decode_block_SSE2(buffer + 3968, 64, quantization_values[3]); /* HH3 */
 	rfx_quantization_decode_block_SSE2(buffer + 4032, 64, quantization_values[0]); /* LL3 */
 }
 
@@ -249,7 +249,7 @@ rfx_quantization_encode_SSE2(sint16 * buffer, const uint32 * quantization_values
 	rfx_quantization_encode_block_SSE2(buffer + 3584, 256, quantization_values[6]); /* HH2 */
 	rfx_quantization_encode_block_SSE2(buffer + 3840, 64, quantization_values[2]); /* HL3 */
 	rfx_quantization_encode_block_SSE2(buffer + 3904, 64, quantization_values[1]); /* LH3 */
-	rfx_quantization_encode_block_SSE2(buffer + 3868, 64, quantization_values[3]); /* HH3 */
+	rfx_quantization_encode_block_SSE2(buffer + 3968, 64, quantization_values[3]); /* HH3 */
 	rfx_quantization_encode_block_SSE2(buffer + 4032, 64, quantization_values[0]); /* LL3 */
 }
 
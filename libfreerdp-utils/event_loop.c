@@ -0,0 +1,318 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Event Loop
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#else
+#include <sys/select.h>
+#endif
+#include <freerdp/utils/memory.h>
+#include <freerdp/utils/event_loop.h>
+
+/* most fds reported by one epoll_wait, the rest are picked up by the next */
+#define EVENT_LOOP_MAX_EVENTS 32
+
+struct _EVENT_SOURCE
+{
+	int fd;			/* -1 once removed */
+	int events;
+	EVENT_LOOP_CALLBACK callback;
+	void * arg;
+};
+typedef struct _EVENT_SOURCE EVENT_SOURCE;
+
+struct _EVENT_LOOP
+{
+#ifdef HAVE_SYS_EPOLL_H
+	int epoll_fd;
+#endif
+	EVENT_SOURCE ** sources;
+	int num_sources;
+	int max_sources;
+	/* set while callbacks run, removed sources are freed afterwards */
+	int dispatching;
+	int num_removed;
+};
+
+EVENT_LOOP *
+event_loop_new(void)
+{
+	EVENT_LOOP * loop;
+
+	loop = (EVENT_LOOP *) xmalloc(sizeof(EVENT_LOOP));
+	memset(loop, 0, sizeof(EVENT_LOOP));
+
+#ifdef HAVE_SYS_EPOLL_H
+	loop->epoll_fd = epoll_create(EVENT_LOOP_MAX_EVENTS);
+	if (loop->epoll_fd < 0)
+	{
+		perror("event_loop_new: epoll_create");
+		xfree(loop);
+		return NULL;
+	}
+#endif
+
+	return loop;
+}
+
+void
+event_loop_free(EVENT_LOOP * loop)
+{
+	int index;
+
+	if (loop == NULL)
+		return;
+
+#ifdef HAVE_SYS_EPOLL_H
+	close(loop->epoll_fd);
+#endif
+	for (index = 0; index < loop->num_sources; index++)
+		xfree(loop->sources[index]);
+	xfree(loop->sources);
+	xfree(loop);
+}
+
+static EVENT_SOURCE *
+event_loop_find(EVENT_LOOP * loop, int fd)
+{
+	int index;
+
+	for (index = 0; index < loop->num_sources; index++)
+	{
+		if (loop->sources[index]->fd == fd)
+			return loop->sources[index];
+	}
+	return NULL;
+}
+
+/* Drop the sources removed while callbacks were running */
+static void
+event_loop_sweep(EVENT_LOOP * loop)
+{
+	int index;
+	int count;
+
+	count = 0;
+	for (index = 0; index < loop->num_sources; index++)
+	{
+		if (loop->sources[index]->fd == -1)
+			xfree(loop->sources[index]);
+		else
+			loop->sources[count++] = loop->sources[index];
+	}
+	loop->num_sources = count;
+	loop->num_removed = 0;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static int
+event_loop_epoll_ctl(EVENT_LOOP * loop, int op, EVENT_SOURCE * source)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = ((source->events & EVENT_LOOP_READ) ? EPOLLIN : 0) |
+		((source->events & EVENT_LOOP_WRITE) ? EPOLLOUT : 0);
+	ev.data.ptr = source;
+	return epoll_ctl(loop->epoll_fd, op, source->fd, &ev);
+}
+#endif
+
+/* Watch fd for the given EVENT_LOOP_* conditions. Adding an fd that is
+   already watched replaces its conditions and callback, and registers it
+   with the kernel again in case it was closed and its number reused. */
+int
+event_loop_add(EVENT_LOOP * loop, int fd, int events, EVENT_LOOP_CALLBACK callback, void * arg)
+{
+	EVENT_SOURCE * source;
+
+	if (fd < 0)
+		return 1;
+
+	source = event_loop_find(loop, fd);
+	if (source != NULL)
+	{
+		source->events = events;
+		source->callback = callback;
+		source->arg = arg;
+#ifdef HAVE_SYS_EPOLL_H
+		if (event_loop_epoll_ctl(loop, EPOLL_CTL_MOD, source) != 0)
+		{
+			if ((errno != ENOENT) || (event_loop_epoll_ctl(loop, EPOLL_CTL_ADD, source) != 0))
+			{
+				perror("event_loop_add: epoll_ctl");
+				return 1;
+			}
+		}
+#endif
+		return 0;
+	}
+
+#ifndef HAVE_SYS_EPOLL_H
+	if (fd >= FD_SETSIZE)
+	{
+		printf("event_loop_add: fd %d out of range for select\n", fd);
+		return 1;
+	}
+#endif
+
+	if (loop->num_sources == loop->max_sources)
+	{
+		loop->max_sources = loop->max_sources ? loop->max_sources * 2 : 8;
+		loop->sources = (EVENT_SOURCE **) xrealloc(loop->sources,
+			sizeof(EVENT_SOURCE *) * loop->max_sources);
+	}
+
+	source = (EVENT_SOURCE *) xmalloc(sizeof(EVENT_SOURCE));
+	source->fd = fd;
+	source->events = events;
+	source->callback = callback;
+	source->arg = arg;
+
+#ifdef HAVE_SYS_EPOLL_H
+	if (event_loop_epoll_ctl(loop, EPOLL_CTL_ADD, source) != 0)
+	{
+		perror("event_loop_add: epoll_ctl");
+		xfree(source);
+		return 1;
+	}
+#endif
+
+	loop->sources[loop->num_sources++] = source;
+	return 0;
+}
+
+/* Stop watching fd. Safe to call from a callback, for any fd. */
+int
+event_loop_remove(EVENT_LOOP * loop, int fd)
+{
+	EVENT_SOURCE * source;
+
+	source = event_loop_find(loop, fd);
+	if (source == NULL)
+		return 1;
+
+#ifdef HAVE_SYS_EPOLL_H
+	/* fails harmlessly when fd was already closed, which removes it too */
+	epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+
+	source->fd = -1;
+	loop->num_removed++;
+	if (!loop->dispatching)
+		event_loop_sweep(loop);
+	return 0;
+}
+
+/* Wait up to timeout milliseconds (forever when negative) for the watched
+   fds and call back the ready ones. Returns the number of callbacks made,
+   or -1 on error or when a callback asked to stop. */
+int
+event_loop_wait(EVENT_LOOP * loop, int timeout)
+{
+	EVENT_SOURCE * source;
+	int num_ready;
+	int events;
+	int index;
+	int rv;
+#ifdef HAVE_SYS_EPOLL_H
+	struct epoll_event ready[EVENT_LOOP_MAX_EVENTS];
+
+	num_ready = epoll_wait(loop->epoll_fd, ready, EVENT_LOOP_MAX_EVENTS, timeout);
+#else
+	int num_sources;
+	int max_fd;
+	fd_set rfds;
+	fd_set wfds;
+	struct timeval time;
+
+	FD_ZERO(&rfds);
+	FD_ZERO(&wfds);
+	max_fd = -1;
+	for (index = 0; index < loop->num_sources; index++)
+	{
+		source = loop->sources[index];
+		if (source->events & EVENT_LOOP_READ)
+			FD_SET(source->fd, &rfds);
+		if (source->events & EVENT_LOOP_WRITE)
+			FD_SET(source->fd, &wfds);
+		if (source->fd > max_fd)
+			max_fd = source->fd;
+	}
+	time.tv_sec = timeout / 1000;
+	time.tv_usec = (timeout % 1000) * 1000;
+
+	num_ready = select(max_fd + 1, &rfds, &wfds, NULL, (timeout < 0) ? NULL : &time);
+#endif
+
+	if (num_ready < 0)
+	{
+		/* a signal is not an error, the caller just comes around again */
+		if (errno == EINTR)
+			return 0;
+		perror("event_loop_wait");
+		return -1;
+	}
+
+	rv = 0;
+	loop->dispatching = 1;
+
+#ifdef HAVE_SYS_EPOLL_H
+	for (index = 0; index < num_ready; index++)
+	{
+		source = (EVENT_SOURCE *) ready[index].data.ptr;
+		events = ((ready[index].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) ? EVENT_LOOP_READ : 0) |
+			((ready[index].events & (EPOLLOUT | EPOLLERR)) ? EVENT_LOOP_WRITE : 0);
+#else
+	/* sources added by the callbacks were not part of this select */
+	num_sources = loop->num_sources;
+	for (index = 0; (index < num_sources) && (num_ready > 0); index++)
+	{
+		source = loop->sources[index];
+		if (source->fd == -1)
+			continue;
+		events = (FD_ISSET(source->fd, &rfds) ? EVENT_LOOP_READ : 0) |
+			(FD_ISSET(source->fd, &wfds) ? EVENT_LOOP_WRITE : 0);
+		if (events == 0)
+			continue;
+		num_ready--;
+#endif
+		/* an earlier callback may have removed this one */
+		events &= source->events;
+		if ((source->fd == -1) || (events == 0))
+			continue;
+
+		if (source->callback(source->fd, events, source->arg) != 0)
+		{
+			rv = -1;
+			break;
+		}
+		rv++;
+	}
+
+	loop->dispatching = 0;
+	if (loop->num_removed > 0)
+		event_loop_sweep(loop);
+
+	return rv;
+}
@@ -0,0 +1,210 @@
+/*
+   FreeRDP: A Remote Desktop Protocol client.
+   Worker Thread Pool
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <freerdp/types/base.h>
+#include <freerdp/utils/memory.h>
+#include <freerdp/utils/thread_pool.h>
+
+struct _THREAD_WORKER
+{
+	pthread_t thread;
+	THREAD_POOL * pool;
+	void * scratch;
+};
+typedef struct _THREAD_WORKER THREAD_WORKER;
+
+struct _THREAD_POOL
+{
+	int num_workers;
+	THREAD_WORKER * workers;
+	THREAD_SCRATCH_FREE scratch_free;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+
+	/* current batch of jobs, guarded by mutex */
+	THREAD_JOB_FUNC func;
+	void * arg;
+	int num_jobs;
+	int next_job;
+	int busy;
+	uint32 generation;
+	int shutdown;
+};
+
+int thread_pool_get_num_cpus(void)
+{
+	long num_cpus = 1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	return (num_cpus < 1) ? 1 : (int) num_cpus;
+}
+
+/* take jobs off the current batch until it is exhausted */
+static void thread_pool_work(THREAD_POOL * pool, void * scratch)
+{
+	int index;
+
+	while (1)
+	{
+		pthread_mutex_lock(&pool->mutex);
+		index = pool->next_job;
+		if (index < pool->num_jobs)
+			pool->next_job++;
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (index >= pool->num_jobs)
+			break;
+
+		pool->func(pool->arg, index, scratch);
+	}
+}
+
+static void * thread_pool_thread_func(void * arg)
+{
+	THREAD_WORKER * worker = (THREAD_WORKER *) arg;
+	THREAD_POOL * pool = worker->pool;
+	uint32 generation = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	while (1)
+	{
+		while (!pool->shutdown && pool->generation == generation)
+			pthread_cond_wait(&pool->work_cond, &pool->mutex);
+
+		if (pool->shutdown)
+			break;
+
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		thread_pool_work(pool, worker->scratch);
+
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->done_cond);
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+/*
+   Start num_workers threads. Each of them gets its own scratch from
+   scratch_new, which scratch_free releases again; both may be NULL when the
+   jobs need none.
+*/
+THREAD_POOL * thread_pool_new(int num_workers, THREAD_SCRATCH_NEW scratch_new, THREAD_SCRATCH_FREE scratch_free)
+{
+	int i;
+	THREAD_WORKER * worker;
+	THREAD_POOL * pool;
+
+	pool = (THREAD_POOL *) xmalloc(sizeof(THREAD_POOL));
+	memset(pool, 0, sizeof(THREAD_POOL));
+
+	pthread_mutex_init(&pool->mutex, 0);
+	pthread_cond_init(&pool->work_cond, 0);
+	pthread_cond_init(&pool->done_cond, 0);
+
+	pool->scratch_free = scratch_free;
+	pool->workers = (THREAD_WORKER *) xmalloc(sizeof(THREAD_WORKER) * num_workers);
+	memset(pool->workers, 0, sizeof(THREAD_WORKER) * num_workers);
+
+	for (i = 0; i < num_workers; i++)
+	{
+		worker = &pool->workers[i];
+		worker->pool = pool;
+
+		if (scratch_new != NULL)
+			worker->scratch = scratch_new();
+
+		if (pthread_create(&worker->thread, 0, thread_pool_thread_func, worker) != 0)
+		{
+			printf("thread_pool_new: failed to create worker thread %d.\n", i);
+			if (scratch_free != NULL)
+				scratch_free(worker->scratch);
+			break;
+		}
+
+		pool->num_workers++;
+	}
+
+	return pool;
+}
+
+void thread_pool_free(THREAD_POOL * pool)
+{
+	int i;
+
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i = 0; i < pool->num_workers; i++)
+	{
+		pthread_join(pool->workers[i].thread, NULL);
+
+		if (pool->scratch_free != NULL)
+			pool->scratch_free(pool->workers[i].scratch);
+	}
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->mutex);
+
+	xfree(pool->workers);
+	xfree(pool);
+}
+
+/*
+   Run func for every index in [0, num_jobs) and return once all of them are
+   done. The calling thread takes jobs as well, with the given scratch.
+*/
+void thread_pool_run(THREAD_POOL * pool, THREAD_JOB_FUNC func, void * arg, int num_jobs, void * scratch)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->func = func;
+	pool->arg = arg;
+	pool->num_jobs = num_jobs;
+	pool->next_job = 0;
+	pool->busy = pool->num_workers;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	thread_pool_work(pool, scratch);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->busy > 0)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -16,11 +16,18 @@
    limitations under the License.
 */
 
+#include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
 #include <freerdp/utils/wait_obj.h>
 
 #define LOG_LEVEL 1
@@ -29,9 +36,18 @@
 #define LLOGLN(_level, _args) \
   do { if (_level < LOG_LEVEL) { printf _args ; printf("\n"); } } while (0)
 
+/* most objects and fds one wait_obj_select call can wait on */
+#define WAIT_OBJ_MAX_FDS 64
+
 struct wait_obj
 {
+	/* read and write ends, the same eventfd when there is one */
 	int pipe_fd[2];
+	/* mirrors the fd so is_set, and set or clear when there is nothing
+	   to do, need no syscall. It changes before the fd does, so a
+	   readable fd with it clear is left over from a racing set and
+	   clear, and is drained by wait_obj_select */
+	volatile long signalled;
 };
 
 struct wait_obj *
@@ -41,14 +57,29 @@ wait_obj_new(const char * name)
 
 	obj = (struct wait_obj *) malloc(sizeof(struct wait_obj));
 
+	obj->signalled = 0;
 	obj->pipe_fd[0] = -1;
 	obj->pipe_fd[1] = -1;
+#ifdef HAVE_SYS_EVENTFD_H
+	obj->pipe_fd[0] = eventfd(0, 0);
+	if (obj->pipe_fd[0] < 0)
+	{
+		LLOGLN(0, ("init_wait_obj: eventfd failed"));
+		free(obj);
+		return NULL;
+	}
+	obj->pipe_fd[1] = obj->pipe_fd[0];
+#else
 	if (pipe(obj->pipe_fd) < 0)
 	{
 		LLOGLN(0, ("init_wait_obj: pipe failed"));
 		free(obj);
 		return NULL;
 	}
+	fcntl(obj->pipe_fd[1], F_SETFL, fcntl(obj->pipe_fd[1], F_GETFL) | O_NONBLOCK);
+#endif
+	/* a clear that races a set may find nothing to read */
+	fcntl(obj->pipe_fd[0], F_SETFL, fcntl(obj->pipe_fd[0], F_GETFL) | O_NONBLOCK);
 	return obj;
 }
 
@@ -57,16 +88,16 @@ wait_obj_free(struct wait_obj * obj)
 {
 	if (obj)
 	{
+		if (obj->pipe_fd[1] != -1 && obj->pipe_fd[1] != obj->pipe_fd[0])
+		{
+			close(obj->pipe_fd[1]);
+		}
+		obj->pipe_fd[1] = -1;
 		if (obj->pipe_fd[0] != -1)
 		{
 			close(obj->pipe_fd[0]);
 			obj->pipe_fd[0] = -1;
 		}
-		if (obj->pipe_fd[1] != -1)
-		{
-			close(obj->pipe_fd[1]);
-			obj->pipe_fd[1] = -1;
-		}
 		free(obj);
 	}
 	return 0;
@@ -75,28 +106,41 @@ wait_obj_free(struct wait_obj * obj)
 int
 wait_obj_is_set(struct wait_obj * obj)
 {
-	fd_set rfds;
-	int num_set;
-	struct timeval time;
-
-	FD_ZERO(&rfds);
-	FD_SET(obj->pipe_fd[0], &rfds);
-	memset(&time, 0, sizeof(time));
-	num_set = select(obj->pipe_fd[0] + 1, &rfds, 0, 0, &time);
-	return (num_set == 1);
+	return (obj->signalled != 0);
+}
+
+static void
+wait_obj_drain(struct wait_obj * obj)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+	eventfd_t value;
+#else
+	char value[64];
+#endif
+
+	/* an eventfd read takes the whole count at once */
+	while (read(obj->pipe_fd[0], &value, sizeof(value)) > 0)
+	{
+	}
 }
 
 int
 wait_obj_set(struct wait_obj * obj)
 {
 	int len;
+#ifdef HAVE_SYS_EVENTFD_H
+	eventfd_t value = 1;
+#else
+	char value[4] = "sig";
+#endif
 
-	if (wait_obj_is_set(obj))
+	if (wait_obj_is_set(obj) || __sync_lock_test_and_set(&obj->signalled, 1))
 	{
 		return 0;
 	}
-	len = write(obj->pipe_fd[1], "sig", 4);
-	if (len != 4)
+	len = write(obj->pipe_fd[1], &value, sizeof(value));
+	/* a full pipe is still readable, that is as good as set */
+	if (len != sizeof(value) && !(len == -1 && errno == EAGAIN))
 	{
 		LLOGLN(0, ("set_wait_obj: error"));
 		return 1;
@@ -107,66 +151,83 @@ wait_obj_set(struct wait_obj * obj)
 int
 wait_obj_clear(struct wait_obj * obj)
 {
-	int len;
-
-	while (wait_obj_is_set(obj))
+	if (wait_obj_is_set(obj) && __sync_lock_test_and_set(&obj->signalled, 0))
 	{
-		len = read(obj->pipe_fd[0], &len, 4);
-		if (len != 4)
-		{
-			LLOGLN(0, ("chan_man_clear_ev: error"));
-			return 1;
-		}
+		__sync_synchronize();
+		wait_obj_drain(obj);
 	}
 	return 0;
 }
 
+/* Wait up to timeout milliseconds (forever when negative) for any of the
+   objects to be set or any of the fds to be readable. Objects already set
+   return at once, without a syscall. Returns the number of ready
+   objects and fds, 0 on timeout, -1 on error or when there are more than
+   WAIT_OBJ_MAX_FDS of them together. */
 int
 wait_obj_select(struct wait_obj ** listobj, int numobj, int * listr, int numr,
 	int timeout)
 {
-	int max;
 	int rv;
 	int index;
-	int sock;
-	struct timeval time;
-	struct timeval * ptime;
-	fd_set fds;
+	int count;
+	struct pollfd fds[WAIT_OBJ_MAX_FDS];
 
-	ptime = 0;
-	if (timeout >= 0)
+	if (numobj + numr > WAIT_OBJ_MAX_FDS)
 	{
-		time.tv_sec = timeout / 1000;
-		time.tv_usec = (timeout * 1000) % 1000000;
-		ptime = &time;
+		LLOGLN(0, ("wait_obj_select: %d objects and fds, at most %d",
+			numobj + numr, WAIT_OBJ_MAX_FDS));
+		return -1;
 	}
-	max = 0;
-	FD_ZERO(&fds);
+
+	rv = 0;
 	if (listobj)
 	{
 		for (index = 0; index < numobj; index++)
 		{
-			sock = listobj[index]->pipe_fd[0];
-			FD_SET(sock, &fds);
-			if (sock > max)
+			if (wait_obj_is_set(listobj[index]))
 			{
-				max = sock;
+				rv++;
 			}
 		}
 	}
+	if (rv > 0)
+	{
+		return rv;
+	}
+
+	/* the objects come first, fds[index] is listobj[index] */
+	count = 0;
+	if (listobj)
+	{
+		for (index = 0; index < numobj; index++)
+		{
+			fds[count].fd = listobj[index]->pipe_fd[0];
+			fds[count].events = POLLIN;
+			fds[count].revents = 0;
+			count++;
+		}
+	}
 	if (listr)
 	{
 		for (index = 0; index < numr; index++)
 		{
-			sock = listr[index];
-			FD_SET(sock, &fds);
-			if (sock > max)
+			fds[count].fd = listr[index];
+			fds[count].events = POLLIN;
+			fds[count].revents = 0;
+			count++;
+		}
+	}
+	rv = poll(fds, count, timeout);
+	if (rv > 0 && listobj)
+	{
+		for (index = 0; index < numobj; index++)
+		{
+			if ((fds[index].revents & POLLIN) && !wait_obj_is_set(listobj[index]))
 			{
-				max = sock;
+				wait_obj_drain(listobj[index]);
 			}
 		}
 	}
-	rv = select(max + 1, &fds, 0, 0, ptime);
 	return rv;
 }
-